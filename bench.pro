@@ -0,0 +1,17 @@
+#
+#   Qmake project file for the benchmarks
+#
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt
+
+INCLUDEPATH += include
+
+QMAKE_CXXFLAGS += -std=c++14 -O3 -pthread
+LIBS += -pthread
+
+SOURCES += \
+    src/bench.cpp
+
+HEADERS += \
+    src/bench.h
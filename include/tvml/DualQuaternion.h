@@ -0,0 +1,201 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef DUALQUATERNION_H
+#define DUALQUATERNION_H
+
+#include <cmath>
+
+#include "Vector3.h"
+#include "Matrix4x4.h"
+#include "Quarternion.h"
+#include "Transform.h"
+
+/**
+  Rigid transform as a dual quarternion: real is the rotation, dual is
+  half the translation times the rotation. Unlike matrices, weighted sums
+  of unit dual quarternions renormalize to a rigid transform without the
+  volume loss of linear blend skinning (see skinning.h).
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+/**
+  Dual quarternion math on the 8 parts: real wxyz, dual wxyz. V is T, or
+  a SIMD pack holding one dual quarternion per lane for the batched
+  skinning kernels.
+**/
+template<typename V, typename T>
+struct DQ
+{
+  static V dot(const V* a, const V* b)
+  {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+  }
+
+  /// Scales both parts by one over the length of the real part
+  static void normalize(V* q)
+  {
+    using std::sqrt;
+    using tvml::simd::sqrt;
+    V inv = Splat<V,T>::of(T(1))/sqrt(dot(q, q));
+    for(int c=0; c<8; c++)
+      q[c] = q[c]*inv;
+  }
+
+  /// 2*dual*conjugate(real), for a unit real part
+  static void translation(const V* q, V* out)
+  {
+    const V *r = q, *d = q + 4;
+    V tx = r[0]*d[1] - d[0]*r[1] + (r[2]*d[3] - r[3]*d[2]);
+    V ty = r[0]*d[2] - d[0]*r[2] + (r[3]*d[1] - r[1]*d[3]);
+    V tz = r[0]*d[3] - d[0]*r[3] + (r[1]*d[2] - r[2]*d[1]);
+    out[0] = tx + tx;
+    out[1] = ty + ty;
+    out[2] = tz + tz;
+  }
+
+  static void point(const V* q, const V* v, V* out)
+  {
+    V r[3], t[3];
+    TRS<V,T>::rotate(q, v, r);
+    translation(q, t);
+    out[0] = r[0] + t[0];
+    out[1] = r[1] + t[1];
+    out[2] = r[2] + t[2];
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class DualQuaternion
+{
+  typedef DualQuaternion<T> DualT;
+  typedef tvml::detail::DQ<T,T> Ops;
+public:
+  DualQuaternion() = default;
+
+  constexpr DualQuaternion(const Quarternion<T>& real, const Quarternion<T>& dual)
+    :real(real),dual(dual){}
+
+  /// Rotation (unit quarternion) followed by translation
+  template<typename X>
+  DualQuaternion(const Quarternion<T>& rotation, const Vector3<X>& translation)
+    :real(rotation),dual(Quarternion<T>(0, translation.x, translation.y, translation.z)*rotation*T(0.5)){}
+
+  template<class X>
+  constexpr DualQuaternion(const DualQuaternion<X>& q)
+    :real(q.real),dual(q.dual){}
+
+  static const
+  DualQuaternion Identity;
+
+  /// Composition: (a*b).transformPoint(p) == a.transformPoint(b.transformPoint(p))
+  DualT operator*(const DualT& b) const{
+    return DualT(real*b.real, real*b.dual + dual*b.real);
+  }
+  DualT& operator*=(const DualT& b){
+    return *this = *this*b;
+  }
+
+  /// Weighted sums, for blending
+  DualT operator*(const T& t) const{
+    return DualT(real*t, dual*t);
+  }
+  DualT operator+(const DualT& b) const{
+    return DualT(real + b.real, dual + b.dual);
+  }
+  DualT operator-() const{
+    return DualT(-real, -dual);
+  }
+  DualT& operator+=(const DualT& b){
+    return *this = *this + b;
+  }
+
+  /// Inverse of a unit dual quarternion
+  DualT inverse() const{
+    return DualT(Quarternion<T>(real.w, -real.x, -real.y, -real.z),
+                 Quarternion<T>(dual.w, -dual.x, -dual.y, -dual.z));
+  }
+
+  /// Both parts divided by the length of the real part
+  DualT normal() const{
+    DualT r = *this;
+    r.normalize();
+    return r;
+  }
+  void normalize(){
+    Ops::normalize(data());
+  }
+
+  const Quarternion<T>& rotation() const { return real; }
+  Vector3<T> translation() const{
+    Vector3<T> t;
+    Ops::translation(data(), t.data());
+    return t;
+  }
+
+  /// rotation.rotate(p) + translation(), for a unit dual quarternion
+  template<typename X>
+  Vector3<T> transformPoint(const Vector3<X>& p) const{
+    Vector3<T> v(p), r;
+    Ops::point(data(), v.data(), r.data());
+    return r;
+  }
+  /// rotation.rotate(d), no translation
+  template<typename X>
+  Vector3<T> transformDirection(const Vector3<X>& d) const{
+    return real.rotate(d);
+  }
+  template<typename X>
+  Vector3<T> operator*(const Vector3<X>& p) const{
+    return transformPoint(p);
+  }
+
+  /// Rigid Matrix4x4, for a unit dual quarternion
+  template<typename X>
+  explicit operator Matrix4x4<X>() const{
+    return Matrix4x4<X>(tvml::detail::composeTRS(translation(), real, Vector3<T>(1,1,1)));
+  }
+
+  /// real (w,x,y,z), dual (w,x,y,z)
+  const T* data() const { return real.data(); }
+  T*       data()       { return real.data(); }
+
+  /// data
+  Quarternion<T> real, dual;
+};
+
+template<typename T>
+constexpr DualQuaternion<T> DualQuaternion<T>::Identity =
+  DualQuaternion<T>(Quarternion<T>(1,0,0,0), Quarternion<T>(0,0,0,0));
+
+static_assert(sizeof(DualQuaternion<float>) == 8*sizeof(float) &&
+              sizeof(DualQuaternion<double>) == 8*sizeof(double), "DualQuaternion parts must be contiguous");
+
+typedef DualQuaternion<float>  DualQuaternionf;
+typedef DualQuaternion<double> DualQuaterniond;
+
+#endif // DUALQUATERNION_H
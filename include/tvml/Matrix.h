@@ -0,0 +1,479 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <algorithm>
+#include <cassert>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+#include "misc.h"
+#include "Vector.h"
+
+/**
+  Matrix<T,R,C>, R rows by C columns, the one implementation behind
+  Matrix3x3 and Matrix4x4. Matrix is row major.
+
+  Element-wise operators and products expand over the indices at compile
+  time like Vector's. Size specific code plugs in through tvml::detail:
+    MatMul<T,R,K,C>  runtime product, Matrix4x4.h puts the SIMD kernels here
+    Square<T,N>      det() and adjoint(), N = 2 here, 3 and 4 in their headers
+    Inverse<T,N>     inverse() from Square, Matrix4x4.h replaces it
+  so include Matrix3x3.h / Matrix4x4.h (or stdmat.h), not this file alone.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+/// Determinant too close to zero to invert. Either sign is fine.
+template<typename T>
+inline bool singular(const T& det)
+{
+  return !(det > T(1e-07) || det < -T(1e-07));
+}
+
+/// Constructor tag: one value per element follows
+struct Elements {};
+
+/// a[0]*b[0] + a[1]*b[stride] + ... over K terms, summed left to right
+template<int K, int k = 1>
+struct RowDot
+{
+  template<typename T>
+  static constexpr T sum(const T* a, const T* b, int stride, const T& acc){
+    return RowDot<K, k+1>::sum(a, b, stride, acc + a[k]*b[k*stride]);
+  }
+};
+template<int K>
+struct RowDot<K,K>
+{
+  template<typename T>
+  static constexpr T sum(const T*, const T*, int, const T& acc){ return acc; }
+};
+
+/// Reference product out = a*b, a is RxK, b is KxC. out must not alias.
+template<typename T, int R, int K, int C>
+constexpr void mulRef(const T* a, const T* b, T* out)
+{
+  for(int r=0; r<R; r++)
+    for(int c=0; c<C; c++)
+      out[r*C + c] = RowDot<K>::sum(a + r*K, b + c, C, a[r*K]*b[c]);
+}
+
+/// Runtime product, out may alias a and/or b
+template<typename T, int R, int K, int C>
+struct MatMul
+{
+  static void mul(const T* a, const T* b, T* out)
+  {
+    T tmp[R*C];
+    mulRef<T,R,K,C>(a, b, tmp);
+    std::copy(tmp, tmp + R*C, out);
+  }
+};
+
+/// det(m) and adjugate(m, out) of an NxN matrix
+template<typename T, int N>
+struct Square;
+
+template<typename T>
+struct Square<T,2>
+{
+  static constexpr T det(const T* m)
+  {
+    return m[0]*m[3] - m[1]*m[2];
+  }
+  static void adjugate(const T* m, T* out)
+  {
+    out[0] =  m[3]; out[1] = -m[1];
+    out[2] = -m[2]; out[3] =  m[0];
+  }
+};
+
+/**
+  out = m^-1 through the adjugate. Returns false, leaving out untouched,
+  if CHECK and the matrix is singular. out may alias m.
+**/
+template<typename T, int N>
+struct Inverse
+{
+  template<bool CHECK>
+  static bool invert(const T* m, T* out)
+  {
+    T adj[N*N];
+    Square<T,N>::adjugate(m, adj);
+    T det = m[0]*adj[0];
+    for(int i=1; i<N; i++)
+      det = det + m[i]*adj[i*N];
+    if(CHECK && singular(det))
+      return false;
+    for(int i=0; i<N*N; i++)
+      out[i] = adj[i] / det;
+    return true;
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T, int R, int C>
+class Matrix : public tvml::Printable<Matrix<T,R,C>, C, R>
+{
+  static_assert(R >= 1 && C >= 1, "Matrices need at least one row and column");
+
+  typedef tvml::detail::Indices<R*C> Is;
+  template<typename, int, int> friend class Matrix;
+public:
+  Matrix() = default;
+
+  constexpr Matrix(std::initializer_list<T> l)
+    :m{}
+  {
+    assert(l.size() == R*C && "Matrix initializer list must have R*C elements.");
+    for(int i=0; i<R*C; i++)
+      m[i] = l.begin()[i];
+  }
+
+  explicit Matrix(const T* mat){
+    std::copy(mat, mat+R*C, m);
+  }
+
+  template<typename X>
+  constexpr Matrix(const Matrix<X,R,C>& mat)
+    :Matrix(convert(mat, Is()))
+  {}
+
+  /// Translation and scale, for 4x4 and 3x4 (affine) matrices
+  template<typename Z, typename X = T, int M = R,
+           typename = typename std::enable_if<C == 4 && (M == 3 || M == 4)>::type>
+  constexpr explicit Matrix(const Vector<Z,3> translation, const Vector<X,3> scale = Vector<X,3>(1,1,1))
+    :Matrix(translate(translation, scale, Is()))
+  {}
+
+  static const
+  Matrix Zero;
+
+  static const
+  Matrix Identity;
+
+  /// Math operators
+  constexpr Matrix operator -() const
+  {
+    return unary<tvml::detail::Neg>(Is());
+  }
+
+  template<typename X>
+  constexpr Matrix operator +(const Matrix<X,R,C>& mat) const
+  {
+    return binary<tvml::detail::Add>(mat.m, Is());
+  }
+
+  template<typename X>
+  constexpr Matrix operator -(const Matrix<X,R,C>& mat) const
+  {
+    return binary<tvml::detail::Sub>(mat.m, Is());
+  }
+
+  template<typename X, typename = tvml::IfScalar<X>>
+  constexpr Matrix operator *(const X& t) const
+  {
+    return scalar<tvml::detail::Mul>(t, Is());
+  }
+
+  template<typename X, typename = tvml::IfScalar<X>>
+  constexpr Matrix operator /(const X& t) const
+  {
+    return scalar<tvml::detail::Div>(t, Is());
+  }
+
+  /// Matrix multiplication
+  /// Runtime calls go through detail::MatMul (SIMD for 4x4), constant evaluation to mulRef
+  template<int K>
+  constexpr Matrix<T,R,K> operator *(const Matrix<T,C,K>& mat) const{
+    return TVML_CONSTANT_EVALUATED() ? mulConstexpr(mat) : mulRuntime(mat);
+  }
+  Matrix& operator *=(const Matrix<T,C,C>& mat){
+    tvml::detail::MatMul<T,R,C,C>::mul(m, mat.m, m);
+    return *this;
+  }
+
+  template<typename X>
+  constexpr Vector<T,R> operator *(const Vector<X,C>& vec) const{
+    return rows(vec, tvml::detail::Indices<R>());
+  }
+
+  /// Homogeneous point, assumes w=1. A square matrix drops its last row.
+  template<typename X, int D = C-1, typename = typename std::enable_if<(D >= 1 && R >= D)>::type>
+  constexpr Vector<T,C-1> operator *(const Vector<X,C-1>& vec) const{
+    return points(vec, tvml::detail::Indices<C-1>());
+  }
+
+  constexpr Matrix<T,C,R> transpose() const{
+    return transposed(Is());
+  }
+
+  /// Square matrices only
+  constexpr T det() const
+  {
+    static_assert(R == C, "det() needs a square matrix");
+    return tvml::detail::Square<T,R>::det(m);
+  }
+
+  /// Determinant with row ex_row and column ex_col removed
+  template<int ex_row, int ex_col>
+  T MINOR() const
+  {
+    static_assert(R == C && R >= 2, "MINOR() needs a square matrix");
+    static_assert(ex_row >= 0 && ex_row < R, "Row must be in [0,R)");
+    static_assert(ex_col >= 0 && ex_col < C, "Column must be in [0,C)");
+
+    Matrix<T,R-1,C-1> minor;
+
+    int i=0;
+    for(int row=0;row<R;row++)
+    {
+      if(row != ex_row)
+        for(int col=0;col<C;col++)
+        {
+          if(col != ex_col)
+            minor[i++] = m[row*C+col];
+        }
+    }
+    return minor.det();
+  }
+
+  Matrix adjoint() const
+  {
+    static_assert(R == C, "adjoint() needs a square matrix");
+    Matrix ret;
+    tvml::detail::Square<T,R>::adjugate(m, ret.m);
+    return ret;
+  }
+
+  /// Throws std::runtime_error if singular
+  Matrix inverse() const
+  {
+    Matrix ret;
+    if(!inverse(ret))
+      throw std::runtime_error("Matrix doesn't have an inverse.");
+    return ret;
+  }
+
+  /// Returns false and leaves out alone if singular
+  bool inverse(Matrix& out) const
+  {
+    static_assert(R == C, "inverse() needs a square matrix");
+    return tvml::detail::Inverse<T,R>::template invert<true>(m, out.m);
+  }
+
+  /// No singularity check, for matrices known to be invertible
+  Matrix inverseUnchecked() const
+  {
+    static_assert(R == C, "inverse() needs a square matrix");
+    Matrix ret;
+    tvml::detail::Inverse<T,R>::template invert<false>(m, ret.m);
+    return ret;
+  }
+
+  /**
+    Inverse of an affine 4x4 (bottom row 0,0,0,1) or 3x4 matrix: inverts
+    the upper 3x3 and maps the translation through it. Throws if the 3x3
+    part is singular.
+  **/
+  Matrix inverseAffine() const
+  {
+    static_assert(C == 4 && (R == 3 || R == 4), "inverseAffine() needs a 4x4 or 3x4 matrix");
+    T a0 = m[5]*m[10] - m[6]*m[9];
+    T a1 = m[6]*m[8]  - m[4]*m[10];
+    T a2 = m[4]*m[9]  - m[5]*m[8];
+    T det = m[0]*a0 + m[1]*a1 + m[2]*a2;
+    if(tvml::detail::singular(det))
+      throw std::runtime_error("Matrix doesn't have an inverse.");
+
+    Matrix ret;
+    ret[0] = a0;
+    ret[1] = m[2]*m[9]  - m[1]*m[10];
+    ret[2] = m[1]*m[6]  - m[2]*m[5];
+    ret[4] = a1;
+    ret[5] = m[0]*m[10] - m[2]*m[8];
+    ret[6] = m[2]*m[4]  - m[0]*m[6];
+    ret[8] = a2;
+    ret[9] = m[1]*m[8]  - m[0]*m[9];
+    ret[10]= m[0]*m[5]  - m[1]*m[4];
+    // the 3x3 part only; the translation column is still unset here
+    for(int r=0; r<3; r++)
+      for(int c=0; c<3; c++)
+        ret[4*r + c] /= det;
+    return ret.withInverseTranslation(m[3], m[7], m[11]);
+  }
+
+  /// Inverse of rotation + translation only: transposed rotation, mapped translation
+  Matrix inverseRigid() const
+  {
+    static_assert(C == 4 && (R == 3 || R == 4), "inverseRigid() needs a 4x4 or 3x4 matrix");
+    Matrix ret;
+    ret[0] = m[0]; ret[1] = m[4]; ret[2]  = m[8];
+    ret[4] = m[1]; ret[5] = m[5]; ret[6]  = m[9];
+    ret[8] = m[2]; ret[9] = m[6]; ret[10] = m[10];
+    return ret.withInverseTranslation(m[3], m[7], m[11]);
+  }
+
+  const T* data() const { return m; }
+  T*       data()       { return m; }
+
+  constexpr const T& operator[](uint32_t index)const{
+    return m[index];
+  }
+  constexpr T& operator[](uint32_t index){
+    return m[index];
+  }
+private:
+  template<typename... A>
+  constexpr explicit Matrix(tvml::detail::Elements, const A&... a):m{T(a)...}{}
+
+  template<typename X, int... I>
+  static constexpr Matrix convert(const Matrix<X,R,C>& mat, std::integer_sequence<int, I...>)
+  {
+    return Matrix(tvml::detail::Elements(), mat.m[I]...);
+  }
+
+  // element I of [scale | translation] over an identity bottom row
+  template<int I, typename Z, typename X>
+  static constexpr T trs(const Vector<Z,3>& t, const Vector<X,3>& s)
+  {
+    return I%C == 3 ? (I/C < 3 ? T(t.template get<(I/C < 3 ? I/C : 0)>()) : T(1))
+                    : (I/C == I%C ? T(s.template get<(I%C < 3 ? I%C : 0)>()) : T(0));
+  }
+  template<typename Z, typename X, int... I>
+  static constexpr Matrix translate(const Vector<Z,3>& t, const Vector<X,3>& s, std::integer_sequence<int, I...>)
+  {
+    return Matrix(tvml::detail::Elements(), trs<I>(t, s)...);
+  }
+
+  template<int... I>
+  static constexpr Matrix diagonal(const T& d, std::integer_sequence<int, I...>)
+  {
+    return Matrix(tvml::detail::Elements(), (I/C == I%C ? d : T(0))...);
+  }
+
+  template<typename Op, int... I>
+  constexpr Matrix unary(std::integer_sequence<int, I...>) const
+  {
+    return Matrix(tvml::detail::Elements(), Op::apply(m[I])...);
+  }
+  template<typename Op, typename X, int... I>
+  constexpr Matrix binary(const X* b, std::integer_sequence<int, I...>) const
+  {
+    return Matrix(tvml::detail::Elements(), Op::apply(m[I], b[I])...);
+  }
+  template<typename Op, typename X, int... I>
+  constexpr Matrix scalar(const X& t, std::integer_sequence<int, I...>) const
+  {
+    return Matrix(tvml::detail::Elements(), Op::apply(m[I], t)...);
+  }
+
+  template<int... I>
+  constexpr Matrix<T,C,R> transposed(std::integer_sequence<int, I...>) const
+  {
+    return Matrix<T,C,R>(tvml::detail::Elements(), m[(I%R)*C + I/R]...);
+  }
+
+  template<int K, int... I>
+  constexpr Matrix<T,R,K> product(const Matrix<T,C,K>& mat, std::integer_sequence<int, I...>) const
+  {
+    return Matrix<T,R,K>(tvml::detail::Elements(),
+        tvml::detail::RowDot<C>::sum(m + (I/K)*C, mat.m + I%K, K, m[(I/K)*C]*mat.m[I%K])...);
+  }
+  template<int K>
+  constexpr Matrix<T,R,K> mulConstexpr(const Matrix<T,C,K>& mat) const
+  {
+    return product(mat, tvml::detail::Indices<R*K>());
+  }
+  template<int K>
+  Matrix<T,R,K> mulRuntime(const Matrix<T,C,K>& mat) const
+  {
+    Matrix<T,R,K> ret;
+    tvml::detail::MatMul<T,R,C,K>::mul(m, mat.m, ret.m);
+    return ret;
+  }
+
+  // vec.x*row[0] + vec.y*row[1] + ... over the first D columns of row r
+  template<int r, int D, typename X, typename S>
+  constexpr S rowSum(const Vector<X,D>&, tvml::detail::Index<D>, const S& sum) const
+  {
+    return sum;
+  }
+  template<int r, int D, typename X, typename S, int k>
+  constexpr S rowSum(const Vector<X,D>& vec, tvml::detail::Index<k>, const S& sum) const
+  {
+    return rowSum<r>(vec, tvml::detail::Index<k+1>(), sum + vec.template get<k>()*m[r*C + k]);
+  }
+  template<int r, int D, typename X>
+  constexpr auto rowSum(const Vector<X,D>& vec) const -> decltype(X()*T())
+  {
+    return rowSum<r>(vec, tvml::detail::Index<1>(), vec.template get<0>()*m[r*C]);
+  }
+
+  template<typename X, int... r>
+  constexpr Vector<T,R> rows(const Vector<X,C>& vec, std::integer_sequence<int, r...>) const
+  {
+    return Vector<T,R>(rowSum<r>(vec)...);
+  }
+  template<typename X, int... r>
+  constexpr Vector<T,C-1> points(const Vector<X,C-1>& vec, std::integer_sequence<int, r...>) const
+  {
+    return Vector<T,C-1>((rowSum<r>(vec) + m[r*C + C-1])...);
+  }
+
+  // Fills column 3 with -R*t and the bottom row, if there is one, with 0,0,0,1
+  Matrix& withInverseTranslation(const T& tx, const T& ty, const T& tz)
+  {
+    m[3]  = -(m[0]*tx + m[1]*ty + m[2]*tz);
+    m[7]  = -(m[4]*tx + m[5]*ty + m[6]*tz);
+    m[11] = -(m[8]*tx + m[9]*ty + m[10]*tz);
+    for(int i=12; i<R*C; i++)
+      m[i] = i == 15 ? 1 : 0;
+    return *this;
+  }
+
+  T m[R*C];
+};
+
+// constexpr: constant initialized, no static init code, usable at compile time
+template<typename T, int R, int C>
+constexpr Matrix<T,R,C> Matrix<T,R,C>::Zero = Matrix<T,R,C>::diagonal(0, Is());
+
+/// Ones on the diagonal, also for non-square matrices
+template<typename T, int R, int C>
+constexpr Matrix<T,R,C> Matrix<T,R,C>::Identity = Matrix<T,R,C>::diagonal(1, Is());
+
+template<typename T>
+using Matrix2x2 = Matrix<T,2,2>;
+
+/// Affine transform, a Matrix4x4 without the 0,0,0,1 row
+template<typename T>
+using Matrix3x4 = Matrix<T,3,4>;
+
+#endif // MATRIX_H
@@ -1,290 +1,416 @@
-/*
-  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
-  All rights reserved.
-
-  Redistribution and use in source and binary forms, with or without
-  modification, are permitted provided that the following conditions are met:
-    * Redistributions of source code must retain the above copyright
-      notice, this list of conditions and the following disclaimer.
-
-  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
-  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*/
-#ifndef MATRIX4X4_H
-#define MATRIX4X4_H
-
-#include <algorithm>
-#include <stdexcept>
-
-#include "misc.h"
-#include "Matrix3x3.h"
-#include "Vector3.h"
-#include "Vector4.h"
-
-/**
-  Matrix is row major.
-**/
-
-template<typename T>
-class Matrix4x4 : public tvml::Printable<Matrix4x4<T>, 4, 4>
-{
-  typedef Matrix4x4<T> Mat4T;
-public:
-  Matrix4x4() = default;
-
-  Matrix4x4(std::initializer_list<T> l)
-  {
-    assert(l.size() == 16 && "Matrix4x4 initializer list must have 16 elements.");
-    for(int i=0; i<16; i++)
-      m[i] = l.begin()[i];
-  }
-
-  explicit Matrix4x4(const T* mat){
-    std::copy(mat,mat+16,m);
-  }
-
-  template<typename X>
-  Matrix4x4(const Matrix4x4<X>& mat){
-    std::copy(mat.data(),mat.data()+16,m);
-  }
-
-  template< typename Z, typename X = T>
-  explicit Matrix4x4(const Vector3<Z> translation, const Vector3<X> scale = Vector3<X>(1,1,1)){
-    m[0]  = scale.x;
-    m[5]  = scale.y;
-    m[10] = scale.z;
-
-    m[3]  = translation.x;
-    m[7]  = translation.y;
-    m[11] = translation.z;
-
-    m[1] = m[2] = m[4] = m[6] = m[8] = m[9] = m[12] = m[13] = m[14] =0;
-    m[15] = 1;
-  }
-
-  static const
-  Mat4T Zero;
-
-  static const
-  Mat4T Identity;
-
-  /// Math operators
-  Mat4T operator -()
-  {
-    Mat4T ret;
-    for(int i=0; i<16; i++)
-      ret[i] = -(*this)[i];
-    return ret;
-  }
-
-  template<typename X>
-  Mat4T operator +(Matrix4x4<X>& mat)
-  {
-    Mat4T ret;
-    for(int i=0; i<16; i++)
-      ret[i] = (*this)[i] + mat[i];
-    return ret;
-  }
-
-  template<typename X>
-  Mat4T operator -(Matrix4x4<X>& mat)
-  {
-    Mat4T ret;
-    for(int i=0; i<16; i++)
-      ret[i] = (*this)[i] - mat[i];
-    return ret;
-  }
-
-  template<typename X>
-  Mat4T operator *(const X& t)
-  {
-    Mat4T ret;
-    for(int i=0; i<16; i++)
-      ret[i] = (*this)[i] * t;
-    return ret;
-  }
-
-  template<typename X>
-  Mat4T operator /(const X& t)
-  {
-    Mat4T ret;
-    for(int i=0; i<16; i++)
-      ret[i] = (*this)[i] / t;
-    return ret;
-  }
-
-  /// Matrix multiplication
-  Matrix4x4<T> operator *(const Matrix4x4<T>& mat){
-    Matrix4x4<T> ret;
-    for(int i=0; i < 16; i+=4){
-      ret[i]  = m[i]*mat[0];
-      ret[i+1]= m[i]*mat[1];
-      ret[i+2]= m[i]*mat[2];
-      ret[i+3]= m[i]*mat[3];
-
-      for(int a=i+1,b=4; a< i+4 ; a++,b+=4){
-        ret[i]  += m[a]*mat[b];
-        ret[i+1]+= m[a]*mat[b+1];
-        ret[i+2]+= m[a]*mat[b+2];
-        ret[i+3]+= m[a]*mat[b+3];
-      }
-    }
-    return ret;
-  }
-  Matrix4x4& operator *=(const Matrix4x4<T>& mat){
-    Matrix4x4<T> ret;
-    for(int i=0; i < 16; i+=4){
-      ret[i]  = m[i]*mat[0];
-      ret[i+1]= m[i]*mat[1];
-      ret[i+2]= m[i]*mat[2];
-      ret[i+3]= m[i]*mat[3];
-
-      for(int a=i+1,b=4; a< i+4 ; a++,b+=4){
-        ret[i]  += m[a]*mat[b];
-        ret[i+1]+= m[a]*mat[b+1];
-        ret[i+2]+= m[a]*mat[b+2];
-        ret[i+3]+= m[a]*mat[b+3];
-      }
-    }
-    (*this) = ret;
-    return *this;
-  }
-
-  /// Assumes w=1
-  template<typename X>
-  Vector3<T> operator *(const Vector3<X>& vec){
-    return Vector3<T>(vec.x*m[0]  + vec.y*m[1]  + vec.z*m[2]  + m[3],
-        vec.x*m[4]  + vec.y*m[5]  + vec.z*m[6]  + m[7],
-        vec.x*m[8]  + vec.y*m[9]  + vec.z*m[10] + m[11]);
-  }
-
-  template<typename X>
-  Vector4<T> operator *(const Vector4<X>& vec){
-    return Vector4<T>(vec.x*m[0]  + vec.y*m[1]  + vec.z*m[2]  + vec.w * m[3],
-        vec.x*m[4]  + vec.y*m[5]  + vec.z*m[6]  + vec.w * m[7],
-        vec.x*m[8]  + vec.y*m[9]  + vec.z*m[10] + vec.w * m[11],
-        vec.x*m[12] + vec.y*m[13] + vec.z*m[14] + vec.w * m[15]);
-  }
-
-  Mat4T transpose(){
-    Mat4T ret = *this;
-
-    std::swap(ret[1], ret[4]);
-    std::swap(ret[2], ret[8]);
-    std::swap(ret[3], ret[12]);
-    std::swap(ret[6], ret[9]);
-    std::swap(ret[7], ret[13]);
-    std::swap(ret[11], ret[14]);
-
-    return ret;
-  }
-
-  /// Matrix inversion
-  T det()
-  {
-    return + m[0]*MINOR<0,0>()
-           - m[1]*MINOR<0,1>()
-           + m[2]*MINOR<0,2>()
-           - m[3]*MINOR<0,3>();
-  }
-
-  template<int ex_row, int ex_col>
-  T MINOR()
-  {
-    static_assert(ex_row >= 0 && ex_row < 4, "Row must be in [0,4]");
-    static_assert(ex_col >= 0 && ex_col < 4, "Column must be in [0,4]");
-
-    Matrix3x3<T> minor;
-
-    int i=0;
-    for(int row=0;row<4;row++)
-    {
-      if(row != ex_row)
-        for(int col=0;col<4;col++)
-        {
-          if(col != ex_col)
-            minor[i++] = m[row*4+col];
-        }
-    }
-    return minor.det();
-  }
-
-  Mat4T adjoint()
-  {
-    Mat4T ret;
-
-    // Create matrix of minors -> cofactors -> transpose
-    // aka, adjoint
-    ret[0] = MINOR<0,0>();
-    ret[1] = -MINOR<1,0>();
-    ret[2] = MINOR<2,0>();
-    ret[3] = -MINOR<3,0>();
-
-    ret[4] = -MINOR<0,1>();
-    ret[5] = MINOR<1,1>();
-    ret[6] = -MINOR<2,1>();
-    ret[7] = MINOR<3,1>();
-
-    ret[8]  = MINOR<0,2>();
-    ret[9]  = -MINOR<1,2>();
-    ret[10] = MINOR<2,2>();
-    ret[11] = -MINOR<3,2>();
-
-    ret[12] = -MINOR<0,3>();
-    ret[13] = MINOR<1,3>();
-    ret[14] = -MINOR<2,3>();
-    ret[15] = MINOR<3,3>();
-
-    return ret;
-  }
-
-  Mat4T inverse()
-  {
-    // Inverses with cofactors.
-
-    Mat4T ret = adjoint();
-
-    T det = m[0]*ret[0] +
-            m[1]*ret[4] +
-            m[2]*ret[8] +
-            m[3]*ret[12];
-
-    if(det < 1e-07)
-      throw std::runtime_error("Matrix doesn't have an inverse.");
-
-    return ret / det;
-  }
-
-  const T* data() const { return m; }
-  T*       data()       { return m; }
-
-  const T& operator[](uint32_t index)const{
-    return m[index];
-  }
-  T& operator[](uint32_t index){
-    return m[index];
-  }
-private:
-  T m[16];
-};
-
-template<typename T>
-const Matrix4x4<T> Matrix4x4<T>::Zero = {0,0,0,0,
-                                         0,0,0,0,
-                                         0,0,0,0,
-                                         0,0,0,0};
-
-template<typename T>
-const Matrix4x4<T> Matrix4x4<T>::Identity = {1,0,0,0,
-                                             0,1,0,0,
-                                             0,0,1,0,
-                                             0,0,0,1};
-#endif /* MATRIX4X4_H */
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MATRIX4X4_H
+#define MATRIX4X4_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "misc.h"
+#include "cpu.h"
+#include "Matrix.h"
+#include "Matrix3x3.h"
+#include "Vector3.h"
+#include "Vector4.h"
+
+/**
+  4x4 kernels for the generic Matrix, see Matrix.h. Matrix is row major.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+/**
+  4x4 multiply kernels, out = a*b.
+
+  mul4x4_scalar is the reference and the path for integer element types.
+  float and double pick an SSE2/AVX/AVX-512 kernel at runtime. Every
+  kernel sums in the same order as the reference; results only differ
+  where the compiler fuses a multiply-add. out may alias a and/or b.
+
+  mul4x4_rows is the constexpr core, out must not alias b.
+**/
+template<typename T>
+constexpr void mul4x4_rows(const T* a, const T* b, T* out)
+{
+  for(int i=0; i < 16; i+=4){
+    T r0 = a[i]*b[0];
+    T r1 = a[i]*b[1];
+    T r2 = a[i]*b[2];
+    T r3 = a[i]*b[3];
+
+    for(int k=i+1,j=4; k< i+4 ; k++,j+=4){
+      r0 += a[k]*b[j];
+      r1 += a[k]*b[j+1];
+      r2 += a[k]*b[j+2];
+      r3 += a[k]*b[j+3];
+    }
+    out[i] = r0; out[i+1] = r1; out[i+2] = r2; out[i+3] = r3;
+  }
+}
+
+template<typename T>
+inline void mul4x4_scalar(const T* a, const T* b, T* out)
+{
+  T tmp[16];
+  if(out == b){
+    std::copy(b, b+16, tmp);
+    b = tmp;
+  }
+  mul4x4_rows(a, b, out);
+}
+
+template<typename T>
+struct Mul4x4
+{
+  static void mul(const T* a, const T* b, T* out)
+  {
+    mul4x4_scalar(a, b, out);
+  }
+};
+
+#if defined(TVML_DISPATCH)
+TVML_TARGET("sse2")
+inline void mul4x4_sse2(const float* a, const float* b, float* out)
+{
+  __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b+4),
+         b2 = _mm_loadu_ps(b+8), b3 = _mm_loadu_ps(b+12);
+  for(int i=0; i<16; i+=4){
+    __m128 r = _mm_mul_ps(_mm_set1_ps(a[i]), b0);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i+1]), b1));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i+2]), b2));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i+3]), b3));
+    _mm_storeu_ps(out+i, r);
+  }
+}
+
+// Two rows per register.
+TVML_TARGET("avx")
+inline void mul4x4_avx(const float* a, const float* b, float* out)
+{
+  __m256 b0 = _mm256_broadcast_ps((const __m128*)b),
+         b1 = _mm256_broadcast_ps((const __m128*)(b+4)),
+         b2 = _mm256_broadcast_ps((const __m128*)(b+8)),
+         b3 = _mm256_broadcast_ps((const __m128*)(b+12));
+  for(int i=0; i<16; i+=8){
+    __m256 rows = _mm256_loadu_ps(a+i);
+    __m256 r = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x00), b0);
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x55), b1));
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0xAA), b2));
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0xFF), b3));
+    _mm256_storeu_ps(out+i, r);
+  }
+}
+
+// GCC 12 warns about _mm512_undefined_* inside its own intrinsics.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+// Whole matrix in one register.
+TVML_TARGET("avx512f")
+inline void mul4x4_avx512(const float* a, const float* b, float* out)
+{
+  __m512 rows = _mm512_loadu_ps(a);
+  __m512 b0 = _mm512_broadcast_f32x4(_mm_loadu_ps(b)),
+         b1 = _mm512_broadcast_f32x4(_mm_loadu_ps(b+4)),
+         b2 = _mm512_broadcast_f32x4(_mm_loadu_ps(b+8)),
+         b3 = _mm512_broadcast_f32x4(_mm_loadu_ps(b+12));
+  __m512 r = _mm512_mul_ps(_mm512_permute_ps(rows, 0x00), b0);
+  r = _mm512_add_ps(r, _mm512_mul_ps(_mm512_permute_ps(rows, 0x55), b1));
+  r = _mm512_add_ps(r, _mm512_mul_ps(_mm512_permute_ps(rows, 0xAA), b2));
+  r = _mm512_add_ps(r, _mm512_mul_ps(_mm512_permute_ps(rows, 0xFF), b3));
+  _mm512_storeu_ps(out, r);
+}
+
+TVML_TARGET("sse2")
+inline void mul4x4_sse2(const double* a, const double* b, double* out)
+{
+  __m128d b0l = _mm_loadu_pd(b),    b0h = _mm_loadu_pd(b+2),
+          b1l = _mm_loadu_pd(b+4),  b1h = _mm_loadu_pd(b+6),
+          b2l = _mm_loadu_pd(b+8),  b2h = _mm_loadu_pd(b+10),
+          b3l = _mm_loadu_pd(b+12), b3h = _mm_loadu_pd(b+14);
+  for(int i=0; i<16; i+=4){
+    __m128d a0 = _mm_set1_pd(a[i]),   a1 = _mm_set1_pd(a[i+1]),
+            a2 = _mm_set1_pd(a[i+2]), a3 = _mm_set1_pd(a[i+3]);
+    __m128d l = _mm_mul_pd(a0, b0l), h = _mm_mul_pd(a0, b0h);
+    l = _mm_add_pd(l, _mm_mul_pd(a1, b1l)); h = _mm_add_pd(h, _mm_mul_pd(a1, b1h));
+    l = _mm_add_pd(l, _mm_mul_pd(a2, b2l)); h = _mm_add_pd(h, _mm_mul_pd(a2, b2h));
+    l = _mm_add_pd(l, _mm_mul_pd(a3, b3l)); h = _mm_add_pd(h, _mm_mul_pd(a3, b3h));
+    _mm_storeu_pd(out+i, l);
+    _mm_storeu_pd(out+i+2, h);
+  }
+}
+
+TVML_TARGET("avx")
+inline void mul4x4_avx(const double* a, const double* b, double* out)
+{
+  __m256d b0 = _mm256_loadu_pd(b),   b1 = _mm256_loadu_pd(b+4),
+          b2 = _mm256_loadu_pd(b+8), b3 = _mm256_loadu_pd(b+12);
+  for(int i=0; i<16; i+=4){
+    __m256d r = _mm256_mul_pd(_mm256_broadcast_sd(a+i), b0);
+    r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_broadcast_sd(a+i+1), b1));
+    r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_broadcast_sd(a+i+2), b2));
+    r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_broadcast_sd(a+i+3), b3));
+    _mm256_storeu_pd(out+i, r);
+  }
+}
+
+// Two rows per register.
+TVML_TARGET("avx512f")
+inline void mul4x4_avx512(const double* a, const double* b, double* out)
+{
+  __m512d b0 = _mm512_broadcast_f64x4(_mm256_loadu_pd(b)),
+          b1 = _mm512_broadcast_f64x4(_mm256_loadu_pd(b+4)),
+          b2 = _mm512_broadcast_f64x4(_mm256_loadu_pd(b+8)),
+          b3 = _mm512_broadcast_f64x4(_mm256_loadu_pd(b+12));
+  __m512d rows0 = _mm512_loadu_pd(a), rows1 = _mm512_loadu_pd(a+8);
+  __m512d r0 = _mm512_mul_pd(_mm512_permutex_pd(rows0, 0x00), b0);
+  __m512d r1 = _mm512_mul_pd(_mm512_permutex_pd(rows1, 0x00), b0);
+  r0 = _mm512_add_pd(r0, _mm512_mul_pd(_mm512_permutex_pd(rows0, 0x55), b1));
+  r1 = _mm512_add_pd(r1, _mm512_mul_pd(_mm512_permutex_pd(rows1, 0x55), b1));
+  r0 = _mm512_add_pd(r0, _mm512_mul_pd(_mm512_permutex_pd(rows0, 0xAA), b2));
+  r1 = _mm512_add_pd(r1, _mm512_mul_pd(_mm512_permutex_pd(rows1, 0xAA), b2));
+  r0 = _mm512_add_pd(r0, _mm512_mul_pd(_mm512_permutex_pd(rows0, 0xFF), b3));
+  r1 = _mm512_add_pd(r1, _mm512_mul_pd(_mm512_permutex_pd(rows1, 0xFF), b3));
+  _mm512_storeu_pd(out, r0);
+  _mm512_storeu_pd(out+8, r1);
+}
+#pragma GCC diagnostic pop
+
+template<typename T>
+struct Mul4x4Dispatch
+{
+  typedef void (*Fn)(const T*, const T*, T*);
+
+  static Fn select()
+  {
+    const cpu::Features& f = cpu::features();
+    if(f.avx512f) return mul4x4_avx512;
+    if(f.avx)     return mul4x4_avx;
+    if(f.sse2)    return mul4x4_sse2;
+    return mul4x4_scalar<T>;
+  }
+
+  static void mul(const T* a, const T* b, T* out)
+  {
+    static const Fn fn = select();
+    fn(a, b, out);
+  }
+};
+
+template<> struct Mul4x4<float>  : Mul4x4Dispatch<float>  {};
+template<> struct Mul4x4<double> : Mul4x4Dispatch<double> {};
+#endif // TVML_DISPATCH
+
+/**
+  4x4 inverse from shared 2x2 sub-determinants.
+
+  s* are the 2x2 determinants of rows 0-1, c* of rows 2-3. det() needs
+  only those twelve, the adjugate reuses them for all sixteen cofactors.
+**/
+template<typename T>
+struct SubDet4x4
+{
+  constexpr explicit SubDet4x4(const T* m)
+    :s0(m[0]*m[5] - m[4]*m[1]),
+     s1(m[0]*m[6] - m[4]*m[2]),
+     s2(m[0]*m[7] - m[4]*m[3]),
+     s3(m[1]*m[6] - m[5]*m[2]),
+     s4(m[1]*m[7] - m[5]*m[3]),
+     s5(m[2]*m[7] - m[6]*m[3]),
+
+     c0(m[8]*m[13]  - m[12]*m[9]),
+     c1(m[8]*m[14]  - m[12]*m[10]),
+     c2(m[8]*m[15]  - m[12]*m[11]),
+     c3(m[9]*m[14]  - m[13]*m[10]),
+     c4(m[9]*m[15]  - m[13]*m[11]),
+     c5(m[10]*m[15] - m[14]*m[11])
+  {}
+
+  constexpr T det() const
+  {
+    return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+  }
+
+  void adjugate(const T* m, T* out) const
+  {
+    out[0]  =  m[5]*c5  - m[6]*c4  + m[7]*c3;
+    out[1]  = -m[1]*c5  + m[2]*c4  - m[3]*c3;
+    out[2]  =  m[13]*s5 - m[14]*s4 + m[15]*s3;
+    out[3]  = -m[9]*s5  + m[10]*s4 - m[11]*s3;
+
+    out[4]  = -m[4]*c5  + m[6]*c2  - m[7]*c1;
+    out[5]  =  m[0]*c5  - m[2]*c2  + m[3]*c1;
+    out[6]  = -m[12]*s5 + m[14]*s2 - m[15]*s1;
+    out[7]  =  m[8]*s5  - m[10]*s2 + m[11]*s1;
+
+    out[8]  =  m[4]*c4  - m[5]*c2  + m[7]*c0;
+    out[9]  = -m[0]*c4  + m[1]*c2  - m[3]*c0;
+    out[10] =  m[12]*s4 - m[13]*s2 + m[15]*s0;
+    out[11] = -m[8]*s4  + m[9]*s2  - m[11]*s0;
+
+    out[12] = -m[4]*c3  + m[5]*c1  - m[6]*c0;
+    out[13] =  m[0]*c3  - m[1]*c1  + m[2]*c0;
+    out[14] = -m[12]*s3 + m[13]*s1 - m[14]*s0;
+    out[15] =  m[8]*s3  - m[9]*s1  + m[10]*s0;
+  }
+
+  T s0,s1,s2,s3,s4,s5;
+  T c0,c1,c2,c3,c4,c5;
+};
+
+/// out = adj / det. Integers divide like operator/ does, floats multiply by 1/det.
+template<typename T>
+inline void scaleByInverse(T* out, T det, std::true_type /*floating*/)
+{
+  const T r = T(1)/det;
+  for(int i=0; i<16; i++)
+    out[i] *= r;
+}
+template<typename T>
+inline void scaleByInverse(T* out, T det, std::false_type)
+{
+  for(int i=0; i<16; i++)
+    out[i] /= det;
+}
+
+/**
+  out = m^-1. Returns false, leaving out untouched, if CHECK and the
+  matrix is singular. out may alias m.
+**/
+template<typename T>
+struct Inverse4x4
+{
+  template<bool CHECK>
+  static bool invert(const T* m, T* out)
+  {
+    SubDet4x4<T> sd(m);
+    T det = sd.det();
+    if(CHECK && singular(det))
+      return false;
+    T adj[16];
+    sd.adjugate(m, adj);
+    scaleByInverse(adj, det, typename std::is_floating_point<T>::type());
+    std::copy(adj, adj+16, out);
+    return true;
+  }
+};
+
+#if defined(TVML_SSE2)
+/**
+  Same thing as 2x2 blocks in SSE registers,
+  | A B | rows 0-1
+  | C D | rows 2-3
+  each block stored (m00, m01, m10, m11).
+**/
+#define TVML_SHUF(a,b,x,y,z,w) _mm_shuffle_ps(a, b, (x) | ((y)<<2) | ((z)<<4) | ((w)<<6))
+
+// A*B
+inline __m128 mat2Mul(__m128 a, __m128 b){
+  return _mm_add_ps(_mm_mul_ps(a, TVML_SHUF(b,b, 0,3,0,3)),
+                    _mm_mul_ps(TVML_SHUF(a,a, 1,0,3,2), TVML_SHUF(b,b, 2,1,2,1)));
+}
+// adj(A)*B
+inline __m128 mat2AdjMul(__m128 a, __m128 b){
+  return _mm_sub_ps(_mm_mul_ps(TVML_SHUF(a,a, 3,3,0,0), b),
+                    _mm_mul_ps(TVML_SHUF(a,a, 1,1,2,2), TVML_SHUF(b,b, 2,3,0,1)));
+}
+// A*adj(B)
+inline __m128 mat2MulAdj(__m128 a, __m128 b){
+  return _mm_sub_ps(_mm_mul_ps(a, TVML_SHUF(b,b, 3,0,3,0)),
+                    _mm_mul_ps(TVML_SHUF(a,a, 1,0,3,2), TVML_SHUF(b,b, 2,1,2,1)));
+}
+
+template<>
+struct Inverse4x4<float>
+{
+  template<bool CHECK>
+  static bool invert(const float* m, float* out)
+  {
+    __m128 r0 = _mm_loadu_ps(m),   r1 = _mm_loadu_ps(m+4),
+           r2 = _mm_loadu_ps(m+8), r3 = _mm_loadu_ps(m+12);
+
+    __m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+
+    // (|A| |B| |C| |D|)
+    __m128 detSub = _mm_sub_ps(_mm_mul_ps(TVML_SHUF(r0,r2, 0,2,0,2), TVML_SHUF(r1,r3, 1,3,1,3)),
+                               _mm_mul_ps(TVML_SHUF(r0,r2, 1,3,1,3), TVML_SHUF(r1,r3, 0,2,0,2)));
+    __m128 detA = TVML_SHUF(detSub,detSub, 0,0,0,0), detB = TVML_SHUF(detSub,detSub, 1,1,1,1);
+    __m128 detC = TVML_SHUF(detSub,detSub, 2,2,2,2), detD = TVML_SHUF(detSub,detSub, 3,3,3,3);
+
+    __m128 D_C = mat2AdjMul(D, C);
+    __m128 A_B = mat2AdjMul(A, B);
+    __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, D_C));
+    __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, A_B));
+    __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, A_B));
+    __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, D_C));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 tr = _mm_mul_ps(A_B, TVML_SHUF(D_C,D_C, 0,2,1,3));
+    tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+    tr = _mm_add_ss(tr, TVML_SHUF(tr,tr, 1,1,1,1));
+    __m128 det = _mm_sub_ss(_mm_add_ss(_mm_mul_ss(detA, detD), _mm_mul_ss(detB, detC)), tr);
+
+    if(CHECK && singular(_mm_cvtss_f32(det)))
+      return false;
+
+    __m128 rdet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), TVML_SHUF(det,det, 0,0,0,0));
+    X = _mm_mul_ps(X, rdet); Y = _mm_mul_ps(Y, rdet);
+    Z = _mm_mul_ps(Z, rdet); W = _mm_mul_ps(W, rdet);
+
+    _mm_storeu_ps(out,    TVML_SHUF(X,Y, 3,1,3,1));
+    _mm_storeu_ps(out+4,  TVML_SHUF(X,Y, 2,0,2,0));
+    _mm_storeu_ps(out+8,  TVML_SHUF(Z,W, 3,1,3,1));
+    _mm_storeu_ps(out+12, TVML_SHUF(Z,W, 2,0,2,0));
+    return true;
+  }
+};
+#undef TVML_SHUF
+#endif // TVML_SSE2
+
+/// Plugged into the generic Matrix, see Matrix.h
+template<typename T> struct MatMul<T,4,4,4> : Mul4x4<T> {};
+template<typename T> struct Inverse<T,4> : Inverse4x4<T> {};
+
+template<typename T>
+struct Square<T,4>
+{
+  static constexpr T det(const T* m)
+  {
+    return SubDet4x4<T>(m).det();
+  }
+  static void adjugate(const T* m, T* out)
+  {
+    SubDet4x4<T>(m).adjugate(m, out);
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+using Matrix4x4 = Matrix<T,4,4>;
+
+#endif /* MATRIX4X4_H */
@@ -30,12 +30,12 @@
 #include <cmath>
 /// A few useful functions for angles
 
-double rad(double degrees)
+constexpr double rad(double degrees)
 {
   return degrees * M_PI / 180;
 }
 
-double deg(double radians)
+constexpr double deg(double radians)
 {
   return radians * 180 / M_PI;
 }
@@ -45,8 +45,8 @@ class Quarternion
 {
 	typedef Quarternion<T> QuartT;
 public:
-	Quarternion(){}
-	Quarternion(const T& w, const T& x,const T& y,const T& z)
+	Quarternion() = default;
+	constexpr Quarternion(const T& w, const T& x,const T& y,const T& z)
 		:w(w),x(x),y(y),z(z){}
 
 	template<typename X>
@@ -59,40 +59,40 @@ public:
 
 
 	template<class X>
-	explicit Quarternion(const Vector4<X>& vec)
+	constexpr explicit Quarternion(const Vector4<X>& vec)
 		:w(vec.w),x(vec.x),y(vec.y),z(vec.z){}
 
 	template<class X>
-	Quarternion(const Quarternion<X>& q)
+	constexpr Quarternion(const Quarternion<X>& q)
 		:w(q.w), x(q.x), y(q.y), z(q.z){}
 
 	template<class X>
-	QuartT& operator = (const Quarternion<X>& quart){
+	constexpr QuartT& operator = (const Quarternion<X>& quart){
 		 w = quart.w; x = quart.x; y = quart.y; z = quart.z;
 		return *this;
 	}
 
   /// Math operators
 	template<class X>
-	QuartT operator+(const Quarternion<X>& quart) const{
+	constexpr QuartT operator+(const Quarternion<X>& quart) const{
 		return QuartT(w+quart.w, x+quart.x ,y+quart.y, z+quart.z);
 	}
 	template<class X>
-	QuartT operator-(const Quarternion<X>& quart) const{
+	constexpr QuartT operator-(const Quarternion<X>& quart) const{
 		return QuartT(w-quart.w, x-quart.x,y-quart.y,z-quart.z);
 	}
-	QuartT operator-() const{
+	constexpr QuartT operator-() const{
 		return QuartT(-w,-x,-y,-z);
 	}
-	QuartT operator*(const T& t) const{
+	constexpr QuartT operator*(const T& t) const{
 		return QuartT(w*t, x*t,y*t,z*t);
 	}
-	QuartT operator/(const T& t) const{
+	constexpr QuartT operator/(const T& t) const{
 		return QuartT(w/t, x/t,y/t,z/t);
 	}
 
 	template<class X>
-	QuartT operator*(const Quarternion<X>& q) const{
+	constexpr QuartT operator*(const Quarternion<X>& q) const{
 		return QuartT(w*q.w - x*q.x - y*q.y - z*q.z,
 									w*q.x + x*q.w + y*q.z - z*q.y,
 									w*q.y - x*q.z + y*q.w + z*q.x,
@@ -104,19 +104,16 @@ public:
 	}
 	/// COMPOUND
 	template<class X>
-	void operator/=(const X& t){
+	constexpr void operator/=(const X& t){
 		w/=t; x /=t;  y/=t;  z/=t;
 	}
 	template<class X>
-	void operator+=(const Quarternion<X>& quart){
+	constexpr void operator+=(const Quarternion<X>& quart){
 		w+=quart.w; x+=quart.x; y+=quart.y; z+=quart.z;
 	}
 	template<class X>
-	void operator*=(const Quarternion<X>& q){
-		w = w*q.w - x*q.x - y*q.y - z*q.z;
-		x = w*q.x + x*q.w + y*q.z - z*q.y;
-		y = w*q.y - x*q.z + y*q.w + z*q.x;
-		z = w*q.z + x*q.y - y*q.x + z*q.w;
+	constexpr void operator*=(const Quarternion<X>& q){
+		*this = (*this)*q;
 	}
 
 	/// Normalization
@@ -131,6 +128,26 @@ public:
 		return sqrt(w*w+x*x+y*y+z*z);
 	}
 
+	/// Fast normalization through rsqrt, see Vector3::normalFast
+	QuartT normalFast(tvml::Precision p = tvml::Precision::Approx) const{
+		return (*this)*invMagnitude(p);
+	}
+	void normalizeFast(tvml::Precision p = tvml::Precision::Approx){
+		*this = normalFast(p);
+	}
+	T invMagnitude(tvml::Precision p = tvml::Precision::Approx) const{
+		return tvml::rsqrt(w*w+x*x+y*y+z*z, p);
+	}
+
+	/// Rotation, assumes a unit quarternion.
+	/// v + w*t + cross(q.xyz, t) with t = 2*cross(q.xyz, v), no matrix needed.
+	template<typename X>
+	Vector3<T> rotate(const Vector3<X>& v) const{
+		Vector3<T> u(x,y,z);
+		Vector3<T> t = u.cross(v)*T(2);
+		return Vector3<T>(v) + t*w + u.cross(t);
+	}
+
 	/// Accessor functions
 	const T& operator [] (uint32_t i) const{
 		return data()[i];
@@ -191,13 +208,13 @@ public:
     operator Matrix4x4<X>() const {
 		Matrix4x4<X> mat;
 
-		QuartT normal = this->norm();
+		QuartT normal = this->normal();
 
-		float &x = normal.x,&y = normal.y,
-						&z = normal.z,&w = normal.w;
-		float q = magnitude();
-		float q2 = 2*q;
-		float qpowx2 = 2*q*q;
+		T &x = normal.x,&y = normal.y,
+				&z = normal.z,&w = normal.w;
+		T q = magnitude();
+		T q2 = 2*q;
+		T qpowx2 = 2*q*q;
 
 		mat[0] = 1 - q2*(y*y + z*z);
 		mat[1] = qpowx2*(x*y - z*w);
@@ -222,4 +239,70 @@ public:
 	/// data
 	T w,x,y,z;
 };
+
+template<typename T>
+T dot(const Quarternion<T>& a, const Quarternion<T>& b){
+	return a.w*b.w + a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+/// Interpolation between unit quarternions, always along the shorter arc.
+
+/// Normalized linear interpolation. Cheap, but not constant angular speed.
+template<typename T>
+Quarternion<T> nlerp(const Quarternion<T>& a, const Quarternion<T>& b, const T& t){
+	T bt = dot(a,b) < 0 ? -t : t;
+	return (a*(1 - t) + b*bt).normal();
+}
+
+namespace tvml
+{
+namespace detail
+{
+
+/// Slerp weights for cos(angle) = d >= 0. Nearly parallel inputs fall back
+/// to a lerp, flagged so the caller normalizes.
+template<typename T>
+inline bool slerpWeights(T d, T t, T& wa, T& wb){
+	if(d > T(0.9995)){
+		wa = 1 - t;
+		wb = t;
+		return true;
+	}
+	T theta = std::acos(d);
+	T s = std::sin(theta);
+	wa = std::sin((1 - t)*theta)/s;
+	wb = std::sin(t*theta)/s;
+	return false;
+}
+
+} // namespace detail
+} // namespace tvml
+
+/// Spherical linear interpolation
+template<typename T>
+Quarternion<T> slerp(const Quarternion<T>& a, const Quarternion<T>& b, const T& t){
+	T d = dot(a,b);
+	T sign = d < 0 ? T(-1) : T(1);
+	T wa, wb;
+	bool lerp = tvml::detail::slerpWeights(d*sign, t, wa, wb);
+	Quarternion<T> r = a*wa + b*(wb*sign);
+	return lerp ? r.normal() : r;
+}
+
+/**
+  Approximate slerp: nlerp with t corrected by a polynomial fit in t and
+  cos(angle) (Zeux' onlerp). No trig, about as fast as nlerp. Over all
+  unit inputs and t in [0,1] the rotation is within 8e-4 rad (0.045 deg)
+  of slerp, worst for opposite inputs; plain nlerp is off by up to 0.14 rad.
+**/
+template<typename T>
+Quarternion<T> slerpFast(const Quarternion<T>& a, const Quarternion<T>& b, const T& t){
+	T ca = dot(a,b);
+	T d = ca < 0 ? -ca : ca;
+	T A = T(1.0904) + d*(T(-3.2452) + d*(T(3.55645) - d*T(1.43519)));
+	T B = T(0.848013) + d*(T(-1.06021) + d*T(0.215638));
+	T k = A*(t - T(0.5))*(t - T(0.5)) + B;
+	T ot = t + t*(t - T(0.5))*(t - 1)*k;
+	return (a*(1 - ot) + b*(ca < 0 ? -ot : ot)).normal();
+}
 #endif // QUARTERNION_H
@@ -0,0 +1,346 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef QUARTERNIONARRAY_H
+#define QUARTERNIONARRAY_H
+
+#include <cassert>
+#include <vector>
+
+#include "simd.h"
+#include "Quarternion.h"
+#include "VectorArray.h"
+
+/**
+  Structure of arrays quarternions, see VectorArray.h.
+**/
+
+template<typename T>
+class QuarternionArray
+{
+public:
+  QuarternionArray(){}
+  explicit QuarternionArray(size_t n):w(n),x(n),y(n),z(n){}
+
+  template<class X>
+  QuarternionArray(const Quarternion<X>* q, size_t n):w(n),x(n),y(n),z(n){
+    for(size_t i=0; i<n; i++)
+      set(i, q[i]);
+  }
+
+  size_t size() const { return w.size(); }
+
+  void resize(size_t n){ w.resize(n); x.resize(n); y.resize(n); z.resize(n); }
+  void reserve(size_t n){ w.reserve(n); x.reserve(n); y.reserve(n); z.reserve(n); }
+
+  template<class X>
+  void push_back(const Quarternion<X>& q){
+    w.push_back(q.w); x.push_back(q.x); y.push_back(q.y); z.push_back(q.z);
+  }
+
+  /// Element access (gathers / scatters one quarternion)
+  Quarternion<T> operator [] (size_t i) const{
+    return Quarternion<T>(w[i], x[i], y[i], z[i]);
+  }
+  template<class X>
+  void set(size_t i, const Quarternion<X>& q){
+    w[i] = q.w; x[i] = q.x; y[i] = q.y; z[i] = q.z;
+  }
+
+  /// Copy back to array of structs
+  template<class X>
+  void copyTo(Quarternion<X>* q) const{
+    for(size_t i=0; i<size(); i++)
+      q[i] = Quarternion<X>(w[i], x[i], y[i], z[i]);
+  }
+
+  /// data
+  std::vector<T> w,x,y,z;
+};
+
+namespace tvml
+{
+namespace detail
+{
+
+/// Quarternion::rotate, lane wise. Quarternion lanes have stride 0 for a single q.
+template<typename T>
+struct RotateKernel
+{
+  const T *qw,*qx,*qy,*qz;
+  size_t qstride;
+  const T *x,*y,*z;
+  T *ox,*oy,*oz;
+
+  template<class P> static P lane(const T* p, size_t i, size_t stride){
+    return stride ? P::load(p+i) : P::set1(*p);
+  }
+
+  template<class P> void apply(size_t i) const{
+    P w  = lane<P>(qw, i, qstride), ux = lane<P>(qx, i, qstride),
+      uy = lane<P>(qy, i, qstride), uz = lane<P>(qz, i, qstride);
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+    P two = P::set1(T(2));
+
+    P tx = (uy*vz - uz*vy)*two;
+    P ty = (uz*vx - ux*vz)*two;
+    P tz = (ux*vy - uy*vx)*two;
+
+    (vx + tx*w + (uy*tz - uz*ty)).store(ox+i);
+    (vy + ty*w + (uz*tx - ux*tz)).store(oy+i);
+    (vz + tz*w + (ux*ty - uy*tx)).store(oz+i);
+  }
+};
+
+/// Loads / stores of the four lanes of a QuarternionArray
+template<typename T, class P>
+struct Quart4
+{
+  P w,x,y,z;
+
+  static Quart4 load(const QuarternionArray<T>& q, size_t i){
+    Quart4 r = { P::load(q.w.data()+i), P::load(q.x.data()+i),
+                 P::load(q.y.data()+i), P::load(q.z.data()+i) };
+    return r;
+  }
+  void store(QuarternionArray<T>& q, size_t i) const{
+    w.store(q.w.data()+i); x.store(q.x.data()+i);
+    y.store(q.y.data()+i); z.store(q.z.data()+i);
+  }
+  P dot(const Quart4& b) const{
+    return w*b.w + x*b.x + y*b.y + z*b.z;
+  }
+  // a*wa + b*wb per component; callers normalize or divide the result themselves
+  static Quart4 mix(const Quart4& a, P wa, const Quart4& b, P wb){
+    Quart4 r = { a.w*wa + b.w*wb, a.x*wa + b.x*wb, a.y*wa + b.y*wb, a.z*wa + b.z*wb };
+    return r;
+  }
+  Quart4 operator/(P div) const{
+    Quart4 r = { w/div, x/div, y/div, z/div };
+    return r;
+  }
+  Quart4 operator*(P s) const{
+    Quart4 r = { w*s, x*s, y*s, z*s };
+    return r;
+  }
+  P magnitude() const{
+    return sqrt(w*w + x*x + y*y + z*z);
+  }
+};
+
+template<typename T>
+struct NlerpKernel
+{
+  const QuarternionArray<T> *a,*b;
+  T t;
+  QuarternionArray<T>* out;
+
+  template<class P> void apply(size_t i) const{
+    typedef Quart4<T,P> Q;
+    Q qa = Q::load(*a, i), qb = Q::load(*b, i);
+    P pt = P::set1(t);
+    P bt = select(cmplt(qa.dot(qb), P::set1(0)), -pt, pt);
+    Q r = Q::mix(qa, P::set1(1 - t), qb, bt);
+    (r/r.magnitude()).store(*out, i);
+  }
+};
+
+/// acos/sin per lane, the blend itself across lanes
+template<typename T>
+struct SlerpKernel
+{
+  const QuarternionArray<T> *a,*b;
+  T t;
+  QuarternionArray<T>* out;
+
+  template<class P> void apply(size_t i) const{
+    typedef Quart4<T,P> Q;
+    Q qa = Q::load(*a, i), qb = Q::load(*b, i);
+
+    T d[P::width], wa[P::width], wb[P::width], div[P::width];
+    qa.dot(qb).store(d);
+    bool lerp = false;
+    for(int l=0; l<P::width; l++){
+      T sign = d[l] < 0 ? T(-1) : T(1);
+      div[l] = tvml::detail::slerpWeights(d[l]*sign, t, wa[l], wb[l]) ? T(0) : T(1);
+      lerp = lerp || div[l] == 0;
+      wb[l] *= sign;
+    }
+    Q r = Q::mix(qa, P::load(wa), qb, P::load(wb));
+    if(lerp){
+      P pdiv = P::load(div);
+      r = r/select(cmpgt(pdiv, P::set1(0)), pdiv, r.magnitude());
+    }
+    r.store(*out, i);
+  }
+};
+
+template<typename T>
+struct SlerpFastKernel
+{
+  const QuarternionArray<T> *a,*b;
+  T t;
+  QuarternionArray<T>* out;
+
+  template<class P> void apply(size_t i) const{
+    typedef Quart4<T,P> Q;
+    Q qa = Q::load(*a, i), qb = Q::load(*b, i);
+    P ca = qa.dot(qb);
+    P d = abs(ca);
+    P pt = P::set1(t), h = P::set1(t - T(0.5));
+    P A = P::set1(T(1.0904)) + d*(P::set1(T(-3.2452)) + d*(P::set1(T(3.55645)) - d*P::set1(T(1.43519))));
+    P B = P::set1(T(0.848013)) + d*(P::set1(T(-1.06021)) + d*P::set1(T(0.215638)));
+    P k = A*h*h + B;
+    P ot = pt + pt*h*P::set1(t - 1)*k;
+    Q r = Q::mix(qa, P::set1(T(1)) - ot, qb, select(cmplt(ca, P::set1(0)), -ot, ot));
+    (r/r.magnitude()).store(*out, i);
+  }
+};
+
+template<typename T>
+struct BlendKernel
+{
+  const QuarternionArray<T>* poses;
+  const T* weights;
+  size_t count;
+  QuarternionArray<T>* out;
+
+  template<class P> void apply(size_t i) const{
+    typedef Quart4<T,P> Q;
+    Q first = Q::load(poses[0], i);
+    P w0 = P::set1(weights[0]);
+    Q acc = { first.w*w0, first.x*w0, first.y*w0, first.z*w0 };
+    for(size_t k=1; k<count; k++){
+      Q q = Q::load(poses[k], i);
+      P wk = P::set1(weights[k]);
+      P s = select(cmplt(first.dot(q), P::set1(0)), -wk, wk);
+      acc = Q::mix(acc, P::set1(T(1)), q, s);
+    }
+    (acc/acc.magnitude()).store(*out, i);
+  }
+};
+
+template<typename T, Precision Pr>
+struct NormalFastKernel
+{
+  const QuarternionArray<T>* q;
+  QuarternionArray<T>* out;
+
+  template<class P> void apply(size_t i) const{
+    typedef Quart4<T,P> Q;
+    Q r = Q::load(*q, i);
+    (r*simd::rsqrt<Pr>(r.dot(r))).store(*out, i);
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+/// out[i] = q.rotate(in[i])
+template<typename T>
+void rotate(const Quarternion<T>& q, const Vector3Array<T>& in, Vector3Array<T>& out)
+{
+  out.resize(in.size());
+  tvml::detail::RotateKernel<T> k = { &q.w, &q.x, &q.y, &q.z, 0,
+                                      in.x.data(), in.y.data(), in.z.data(),
+                                      out.x.data(), out.y.data(), out.z.data() };
+  tvml::simd::run<T>(in.size(), k);
+}
+
+/// out[i] = q[i].rotate(in[i])
+template<typename T>
+void rotate(const QuarternionArray<T>& q, const Vector3Array<T>& in, Vector3Array<T>& out)
+{
+  assert(q.size() == in.size());
+  out.resize(in.size());
+  tvml::detail::RotateKernel<T> k = { q.w.data(), q.x.data(), q.y.data(), q.z.data(), 1,
+                                      in.x.data(), in.y.data(), in.z.data(),
+                                      out.x.data(), out.y.data(), out.z.data() };
+  tvml::simd::run<T>(in.size(), k);
+}
+
+/// Pose buffer interpolation, out[i] = f(a[i], b[i], t). out may be a or b.
+
+template<typename T>
+void nlerp(const QuarternionArray<T>& a, const QuarternionArray<T>& b, const T& t,
+           QuarternionArray<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::NlerpKernel<T> k = { &a, &b, t, &out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+void slerp(const QuarternionArray<T>& a, const QuarternionArray<T>& b, const T& t,
+           QuarternionArray<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::SlerpKernel<T> k = { &a, &b, t, &out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+void slerpFast(const QuarternionArray<T>& a, const QuarternionArray<T>& b, const T& t,
+               QuarternionArray<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::SlerpFastKernel<T> k = { &a, &b, t, &out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+/**
+  Weighted blend of `count` poses. Every pose is flipped into the
+  hemisphere of poses[0] and accumulated, then the sum is normalized
+  once. Weights need not add up to 1. out may be one of the poses.
+**/
+template<typename T>
+void blend(const QuarternionArray<T>* poses, const T* weights, size_t count,
+           QuarternionArray<T>& out)
+{
+  assert(count > 0);
+  for(size_t k=1; k<count; k++)
+    assert(poses[k].size() == poses[0].size());
+  out.resize(poses[0].size());
+  tvml::detail::BlendKernel<T> k = { poses, weights, count, &out };
+  tvml::simd::run<T>(poses[0].size(), k);
+}
+
+/// out[i] = q[i].normalFast(p), accuracy per tvml::Precision (rsqrt.h)
+template<typename T>
+void normalFast(const QuarternionArray<T>& q, QuarternionArray<T>& out,
+                tvml::Precision p = tvml::Precision::Approx)
+{
+  out.resize(q.size());
+  tvml::simd::run<T, tvml::detail::NormalFastKernel>(p, q.size(), &q, &out);
+}
+
+// renormalize in place, e.g. after integrating angular velocity
+template<typename T>
+void normalizeFast(QuarternionArray<T>& q, tvml::Precision p = tvml::Precision::Approx)
+{
+  normalFast(q, q, p);
+}
+
+typedef QuarternionArray<float>  QuarternionArrayf;
+typedef QuarternionArray<double> QuarternionArrayd;
+#endif // QUARTERNIONARRAY_H
@@ -0,0 +1,260 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cmath>
+#include <type_traits>
+
+#include "Vector3.h"
+#include "Matrix4x4.h"
+#include "Quarternion.h"
+
+/**
+  Translation, rotation and scale: p' = translation + rotation.rotate(scale*p),
+  the same as the matrix T*R*S. 10 numbers instead of the 16 of a Matrix4x4.
+
+  Composition and inverse work on the parts directly. They are exact when
+  the scale is uniform; a TRS can't hold shear, so with non-uniform scale
+  a*b keeps a's scale axis aligned (what most scene graphs do) and only
+  matches the matrix product when b's rotation doesn't mix the axes.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+template<typename V, typename T>
+struct Splat { static V of(const T& t){ return V::set1(t); } };
+template<typename T>
+struct Splat<T,T> { static T of(const T& t){ return t; } };
+
+/**
+  Transform math on the 10 parts: translation xyz, rotation wxyz, scale xyz.
+  V is T, or a SIMD pack holding one transform per lane for the batched
+  versions (batch.h). rotate is Quarternion::rotate, operation for operation.
+**/
+template<typename V, typename T>
+struct TRS
+{
+  static void rotate(const V* q, const V* v, V* out)
+  {
+    V tx = q[2]*v[2] - q[3]*v[1];
+    V ty = q[3]*v[0] - q[1]*v[2];
+    V tz = q[1]*v[1] - q[2]*v[0];
+    tx = tx + tx; ty = ty + ty; tz = tz + tz;
+    out[0] = v[0] + tx*q[0] + (q[2]*tz - q[3]*ty);
+    out[1] = v[1] + ty*q[0] + (q[3]*tx - q[1]*tz);
+    out[2] = v[2] + tz*q[0] + (q[1]*ty - q[2]*tx);
+  }
+
+  static void direction(const V* a, const V* v, V* out)
+  {
+    V s[3] = { a[7]*v[0], a[8]*v[1], a[9]*v[2] };
+    rotate(a + 3, s, out);
+  }
+
+  static void point(const V* a, const V* v, V* out)
+  {
+    V r[3];
+    direction(a, v, r);
+    out[0] = a[0] + r[0];
+    out[1] = a[1] + r[1];
+    out[2] = a[2] + r[2];
+  }
+
+  /// a*b: b first, then a. out may not alias a or b.
+  static void compose(const V* a, const V* b, V* out)
+  {
+    point(a, b, out);
+    const V *p = a + 3, *q = b + 3;
+    out[3] = p[0]*q[0] - p[1]*q[1] - p[2]*q[2] - p[3]*q[3];
+    out[4] = p[0]*q[1] + p[1]*q[0] + p[2]*q[3] - p[3]*q[2];
+    out[5] = p[0]*q[2] - p[1]*q[3] + p[2]*q[0] + p[3]*q[1];
+    out[6] = p[0]*q[3] + p[1]*q[2] - p[2]*q[1] + p[3]*q[0];
+    out[7] = a[7]*b[7];
+    out[8] = a[8]*b[8];
+    out[9] = a[9]*b[9];
+  }
+
+  /// Conjugate rotation, reciprocal scale, translation mapped back. out may not alias a.
+  static void inverse(const V* a, V* out)
+  {
+    V one = Splat<V,T>::of(T(1));
+    out[3] = a[3];
+    out[4] = -a[4];
+    out[5] = -a[5];
+    out[6] = -a[6];
+    out[7] = one/a[7];
+    out[8] = one/a[8];
+    out[9] = one/a[9];
+    V r[3];
+    rotate(out + 3, a, r);
+    out[0] = -(out[7]*r[0]);
+    out[1] = -(out[8]*r[1]);
+    out[2] = -(out[9]*r[2]);
+  }
+};
+
+/// Translation * rotation * scale, for a unit quarternion
+template<typename T>
+Matrix4x4<T> composeTRS(const Vector3<T>& t, const Quarternion<T>& q, const Vector3<T>& s)
+{
+  T xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+  T xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+  T wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+  return Matrix4x4<T>{ (1 - 2*(yy + zz))*s.x, 2*(xy - wz)*s.y,       2*(xz + wy)*s.z,       t.x,
+                       2*(xy + wz)*s.x,       (1 - 2*(xx + zz))*s.y, 2*(yz - wx)*s.z,       t.y,
+                       2*(xz - wy)*s.x,       2*(yz + wx)*s.y,       (1 - 2*(xx + yy))*s.z, t.z,
+                       0,                     0,                     0,                     1 };
+}
+
+/// Unit quarternion of a rotation matrix, rows of `stride` elements
+template<typename T>
+Quarternion<T> rotationOf(const T* m, int stride)
+{
+  T r00 = m[0],        r01 = m[1],          r02 = m[2];
+  T r10 = m[stride],   r11 = m[stride+1],   r12 = m[stride+2];
+  T r20 = m[2*stride], r21 = m[2*stride+1], r22 = m[2*stride+2];
+  T trace = r00 + r11 + r22;
+  Quarternion<T> q;
+  // largest of w,x,y,z first, the others follow without cancellation
+  if(trace > 0){
+    T s = std::sqrt(trace + 1)*2;
+    q = Quarternion<T>(s/4, (r21 - r12)/s, (r02 - r20)/s, (r10 - r01)/s);
+  }else if(r00 > r11 && r00 > r22){
+    T s = std::sqrt(1 + r00 - r11 - r22)*2;
+    q = Quarternion<T>((r21 - r12)/s, s/4, (r01 + r10)/s, (r02 + r20)/s);
+  }else if(r11 > r22){
+    T s = std::sqrt(1 + r11 - r00 - r22)*2;
+    q = Quarternion<T>((r02 - r20)/s, (r01 + r10)/s, s/4, (r12 + r21)/s);
+  }else{
+    T s = std::sqrt(1 + r22 - r00 - r11)*2;
+    q = Quarternion<T>((r10 - r01)/s, (r02 + r20)/s, (r12 + r21)/s, s/4);
+  }
+  return q.normal();
+}
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class Transform
+{
+  typedef tvml::detail::TRS<T,T> Ops;
+public:
+  Transform() = default;
+
+  constexpr Transform(const Vector3<T>& translation,
+                      const Quarternion<T>& rotation = Quarternion<T>(1,0,0,0),
+                      const Vector3<T>& scale = Vector3<T>(1,1,1))
+    :translation(translation),rotation(rotation),scale(scale){}
+
+  /// Uniform scale
+  constexpr Transform(const Vector3<T>& translation, const Quarternion<T>& rotation, const T& scale)
+    :translation(translation),rotation(rotation),scale(scale,scale,scale){}
+
+  /**
+    Decomposes an affine matrix without shear (anything built from
+    T*R*S). Scale is the length of each column, negative on x when the
+    matrix mirrors.
+  **/
+  template<typename X>
+  explicit Transform(const Matrix4x4<X>& mat){
+    Matrix4x4<T> m(mat);
+    translation = Vector3<T>(m[3], m[7], m[11]);
+    for(int c=0; c<3; c++)
+      scale[c] = std::sqrt(m[c]*m[c] + m[4+c]*m[4+c] + m[8+c]*m[8+c]);
+    if(Matrix3x3<T>{m[0],m[1],m[2], m[4],m[5],m[6], m[8],m[9],m[10]}.det() < 0)
+      scale.x = -scale.x;
+    T r[9];
+    for(int i=0; i<3; i++)
+      for(int c=0; c<3; c++)
+        r[i*3 + c] = m[i*4 + c]/scale[c];
+    rotation = tvml::detail::rotationOf(r, 3);
+  }
+
+  static const
+  Transform Identity;
+
+  /// T*R*S
+  template<typename X>
+  explicit operator Matrix4x4<X>() const{
+    return Matrix4x4<X>(tvml::detail::composeTRS(translation, rotation, scale));
+  }
+
+  /// Composition: (a*b).transformPoint(p) == a.transformPoint(b.transformPoint(p))
+  Transform operator*(const Transform& b) const{
+    Transform r;
+    Ops::compose(data(), b.data(), r.data());
+    return r;
+  }
+  Transform& operator*=(const Transform& b){
+    return *this = *this*b;
+  }
+
+  Transform inverse() const{
+    Transform r;
+    Ops::inverse(data(), r.data());
+    return r;
+  }
+
+  /// translation + rotation.rotate(scale*p)
+  template<typename X>
+  Vector3<T> transformPoint(const Vector3<X>& p) const{
+    Vector3<T> v(p), r;
+    Ops::point(data(), v.data(), r.data());
+    return r;
+  }
+  /// rotation.rotate(scale*d), no translation
+  template<typename X>
+  Vector3<T> transformDirection(const Vector3<X>& d) const{
+    Vector3<T> v(d), r;
+    Ops::direction(data(), v.data(), r.data());
+    return r;
+  }
+  /// Point, like Matrix4x4 * Vector3
+  template<typename X>
+  Vector3<T> operator*(const Vector3<X>& p) const{
+    return transformPoint(p);
+  }
+
+  /// translation, rotation (w,x,y,z), scale
+  const T* data() const { return translation.data(); }
+  T*       data()       { return translation.data(); }
+
+  /// data
+  Vector3<T> translation;
+  Quarternion<T> rotation;
+  Vector3<T> scale;
+};
+
+template<typename T>
+constexpr Transform<T> Transform<T>::Identity = Transform<T>(Vector3<T>(0,0,0));
+
+static_assert(sizeof(Transform<float>) == 10*sizeof(float) &&
+              sizeof(Transform<double>) == 10*sizeof(double), "Transform parts must be contiguous");
+
+typedef Transform<float>  Transformf;
+typedef Transform<double> Transformd;
+
+#endif // TRANSFORM_H
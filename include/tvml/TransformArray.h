@@ -0,0 +1,301 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef TRANSFORMARRAY_H
+#define TRANSFORMARRAY_H
+
+#include <cassert>
+#include <vector>
+
+#include "simd.h"
+#include "parallel.h"
+#include "Transform.h"
+#include "VectorArray.h"
+
+/**
+  Structure of arrays transforms, see VectorArray.h. Every batched
+  function gives the same result per element as the Transform operator
+  or method it is named after, up to FMA contraction when the compiler
+  may fuse them. out may be one of the inputs. `threads` > 1 splits
+  batches larger than a few thousand transforms (0 = all cores).
+**/
+
+template<typename T>
+class TransformArray
+{
+public:
+  TransformArray(){}
+  explicit TransformArray(size_t n){ resize(n); }
+
+  template<class X>
+  TransformArray(const Transform<X>* t, size_t n){
+    resize(n);
+    for(size_t i=0; i<n; i++)
+      set(i, t[i]);
+  }
+
+  size_t size() const { return parts[0].size(); }
+
+  void resize(size_t n){
+    for(int k=0; k<10; k++)
+      parts[k].resize(n);
+  }
+  void reserve(size_t n){
+    for(int k=0; k<10; k++)
+      parts[k].reserve(n);
+  }
+
+  template<class X>
+  void push_back(const Transform<X>& t){
+    for(int k=0; k<10; k++)
+      parts[k].push_back(T(t.data()[k]));
+  }
+
+  /// Element access (gathers / scatters one transform)
+  Transform<T> operator [] (size_t i) const{
+    Transform<T> t;
+    for(int k=0; k<10; k++)
+      t.data()[k] = parts[k][i];
+    return t;
+  }
+  template<class X>
+  void set(size_t i, const Transform<X>& t){
+    for(int k=0; k<10; k++)
+      parts[k][i] = T(t.data()[k]);
+  }
+
+  /// Copy back to array of structs
+  template<class X>
+  void copyTo(Transform<X>* t) const{
+    for(size_t i=0; i<size(); i++)
+      t[i] = Transform<X>((*this)[i]);
+  }
+
+  /// data: translation xyz, rotation wxyz, scale xyz, in Transform::data() order
+  std::vector<T> parts[10];
+};
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t TRS_GRAIN = 8192;
+
+/// Transform lanes; stride 0 gives every lane the same transform
+template<typename T>
+struct TRSLanes
+{
+  const T* p[10];
+  size_t stride;
+
+  static TRSLanes of(const TransformArray<T>& a, size_t begin){
+    TRSLanes l;
+    for(int k=0; k<10; k++)
+      l.p[k] = a.parts[k].data() + begin;
+    l.stride = 1;
+    return l;
+  }
+  static TRSLanes of(const Transform<T>& t){
+    TRSLanes l;
+    for(int k=0; k<10; k++)
+      l.p[k] = t.data() + k;
+    l.stride = 0;
+    return l;
+  }
+
+  template<class P> void load(size_t i, P* v) const{
+    for(int k=0; k<10; k++)
+      v[k] = stride ? P::load(p[k] + i) : P::set1(*p[k]);
+  }
+};
+
+template<typename T>
+struct TRSOut
+{
+  T* p[10];
+
+  static TRSOut of(TransformArray<T>& a, size_t begin){
+    TRSOut o;
+    for(int k=0; k<10; k++)
+      o.p[k] = a.parts[k].data() + begin;
+    return o;
+  }
+
+  template<class P> void store(size_t i, const P* v) const{
+    for(int k=0; k<10; k++)
+      v[k].store(p[k] + i);
+  }
+};
+
+template<typename T>
+struct ComposeKernel
+{
+  TRSLanes<T> a, b;
+  TRSOut<T> out;
+
+  template<class P> void apply(size_t i) const{
+    P pa[10], pb[10], r[10];
+    a.load(i, pa);
+    b.load(i, pb);
+    TRS<P,T>::compose(pa, pb, r);
+    out.store(i, r);
+  }
+};
+
+template<typename T>
+struct InverseTRSKernel
+{
+  TRSLanes<T> in;
+  TRSOut<T> out;
+
+  template<class P> void apply(size_t i) const{
+    P a[10], r[10];
+    in.load(i, a);
+    TRS<P,T>::inverse(a, r);
+    out.store(i, r);
+  }
+};
+
+template<typename T, bool POINT>
+struct TransformTRSKernel
+{
+  TRSLanes<T> t;
+  const T *x,*y,*z;
+  T *ox,*oy,*oz;
+
+  template<class P> void apply(size_t i) const{
+    P a[10], r[3];
+    P v[3] = { P::load(x+i), P::load(y+i), P::load(z+i) };
+    t.load(i, a);
+    if(POINT)
+      TRS<P,T>::point(a, v, r);
+    else
+      TRS<P,T>::direction(a, v, r);
+    r[0].store(ox+i); r[1].store(oy+i); r[2].store(oz+i);
+  }
+};
+
+template<typename T, bool POINT, class Lanes>
+inline void transformTRS(const Lanes& lanes, const Vector3Array<T>& in, Vector3Array<T>& out,
+                         unsigned threads)
+{
+  out.resize(in.size());
+  const T *x = in.x.data(), *y = in.y.data(), *z = in.z.data();
+  T *ox = out.x.data(), *oy = out.y.data(), *oz = out.z.data();
+  tvml::parallel_for(in.size(), TRS_GRAIN, threads, [&](size_t begin, size_t end){
+    TransformTRSKernel<T,POINT> k = { lanes(begin), x+begin, y+begin, z+begin, ox+begin, oy+begin, oz+begin };
+    simd::run<T>(end - begin, k);
+  });
+}
+
+} // namespace detail
+} // namespace tvml
+
+/// out[i] = a[i]*b[i]
+template<typename T>
+void compose(const TransformArray<T>& a, const TransformArray<T>& b, TransformArray<T>& out,
+             unsigned threads = 1)
+{
+  using namespace tvml::detail;
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::parallel_for(a.size(), TRS_GRAIN, threads, [&](size_t begin, size_t end){
+    ComposeKernel<T> k = { TRSLanes<T>::of(a, begin), TRSLanes<T>::of(b, begin), TRSOut<T>::of(out, begin) };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+/// out[i] = a*b[i], e.g. a parent applied to its children
+template<typename T>
+void compose(const Transform<T>& a, const TransformArray<T>& b, TransformArray<T>& out,
+             unsigned threads = 1)
+{
+  using namespace tvml::detail;
+  out.resize(b.size());
+  tvml::parallel_for(b.size(), TRS_GRAIN, threads, [&](size_t begin, size_t end){
+    ComposeKernel<T> k = { TRSLanes<T>::of(a), TRSLanes<T>::of(b, begin), TRSOut<T>::of(out, begin) };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+/// out[i] = in[i].inverse()
+template<typename T>
+void inverse(const TransformArray<T>& in, TransformArray<T>& out, unsigned threads = 1)
+{
+  using namespace tvml::detail;
+  out.resize(in.size());
+  tvml::parallel_for(in.size(), TRS_GRAIN, threads, [&](size_t begin, size_t end){
+    InverseTRSKernel<T> k = { TRSLanes<T>::of(in, begin), TRSOut<T>::of(out, begin) };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+/// out[i] = t.transformPoint(in[i])
+template<typename T>
+void transformPoints(const Transform<T>& t, const Vector3Array<T>& in, Vector3Array<T>& out,
+                     unsigned threads = 1)
+{
+  tvml::detail::transformTRS<T,true>([&](size_t){ return tvml::detail::TRSLanes<T>::of(t); },
+                                     in, out, threads);
+}
+
+/// out[i] = t[i].transformPoint(in[i])
+template<typename T>
+void transformPoints(const TransformArray<T>& t, const Vector3Array<T>& in, Vector3Array<T>& out,
+                     unsigned threads = 1)
+{
+  assert(t.size() == in.size());
+  tvml::detail::transformTRS<T,true>([&](size_t begin){ return tvml::detail::TRSLanes<T>::of(t, begin); },
+                                     in, out, threads);
+}
+
+/// out[i] = t.transformDirection(in[i])
+template<typename T>
+void transformDirections(const Transform<T>& t, const Vector3Array<T>& in, Vector3Array<T>& out,
+                         unsigned threads = 1)
+{
+  tvml::detail::transformTRS<T,false>([&](size_t){ return tvml::detail::TRSLanes<T>::of(t); },
+                                      in, out, threads);
+}
+
+/// out[i] = t[i].transformDirection(in[i])
+template<typename T>
+void transformDirections(const TransformArray<T>& t, const Vector3Array<T>& in, Vector3Array<T>& out,
+                         unsigned threads = 1)
+{
+  assert(t.size() == in.size());
+  tvml::detail::transformTRS<T,false>([&](size_t begin){ return tvml::detail::TRSLanes<T>::of(t, begin); },
+                                      in, out, threads);
+}
+
+/// out[i] = Matrix4x4<T>(t[i]), e.g. for upload
+template<typename T>
+void toMatrices(const TransformArray<T>& t, Matrix4x4<T>* out, unsigned threads = 1)
+{
+  tvml::parallel_for(t.size(), tvml::detail::TRS_GRAIN, threads, [&](size_t begin, size_t end){
+    for(size_t i=begin; i<end; i++)
+      out[i] = Matrix4x4<T>(t[i]);
+  });
+}
+
+typedef TransformArray<float>  TransformArrayf;
+typedef TransformArray<double> TransformArrayd;
+#endif // TRANSFORMARRAY_H
@@ -0,0 +1,328 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "misc.h"
+#include "rsqrt.h"
+
+/**
+  Vector<T,N>, the one implementation behind Vector2, Vector3 and Vector4.
+
+  Every operator expands over the element indices at compile time, so
+  there are no loops left for the compiler to unroll and everything stays
+  usable in constant expressions. Results are the same as writing the
+  operation out per element, in the same order (x first).
+
+  N up to 4 stores named members x,y,z,w, larger N a plain array.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+template<int I>
+using Index = std::integral_constant<int, I>;
+
+template<int N>
+using Indices = std::make_integer_sequence<int, N>;
+
+template<typename... A> struct AllScalar : std::true_type {};
+template<typename A, typename... B>
+struct AllScalar<A, B...> : std::integral_constant<bool,
+    tvml::IsScalar<A>::value && AllScalar<B...>::value> {};
+
+/// Element storage. at(Index<I>()) is the constant expression safe access.
+template<typename T, int N>
+struct VectorStorage
+{
+  static_assert(N >= 1, "Vectors need at least one element");
+
+  VectorStorage() = default;
+  template<typename... A, typename = typename std::enable_if<
+      sizeof...(A) == N && AllScalar<A...>::value>::type>
+  constexpr VectorStorage(const A&... a):v{T(a)...}{}
+
+  template<int I> constexpr const T& at(Index<I>) const { return v[I]; }
+  template<int I> constexpr T&       at(Index<I>)       { return v[I]; }
+
+  T*       data()       { return v; }
+  const T* data() const { return v; }
+
+  /// data
+  T v[N];
+};
+
+template<typename T>
+struct VectorStorage<T,2>
+{
+  VectorStorage() = default;
+  constexpr VectorStorage(const T& x,const T& y):x(x),y(y){}
+
+  constexpr const T& at(Index<0>) const { return x; }
+  constexpr const T& at(Index<1>) const { return y; }
+  constexpr T& at(Index<0>) { return x; }
+  constexpr T& at(Index<1>) { return y; }
+
+  T*       data()       { return &x; }
+  const T* data() const { return &x; }
+  operator const T*() const { return &x; }
+
+  /// data
+  T x,y;
+};
+
+template<typename T>
+struct VectorStorage<T,3>
+{
+  VectorStorage() = default;
+
+  constexpr VectorStorage(int zero)
+    :x(0),y(0),z(0)
+  {
+    assert(zero == 0);
+  }
+
+  constexpr VectorStorage(const T& x,const T& y,const T& z):x(x),y(y),z(z){}
+
+  constexpr const T& at(Index<0>) const { return x; }
+  constexpr const T& at(Index<1>) const { return y; }
+  constexpr const T& at(Index<2>) const { return z; }
+  constexpr T& at(Index<0>) { return x; }
+  constexpr T& at(Index<1>) { return y; }
+  constexpr T& at(Index<2>) { return z; }
+
+  T*       data()       { return &x; }
+  const T* data() const { return &x; }
+
+  /// data
+  T x,y,z;
+};
+
+template<typename T>
+struct VectorStorage<T,4>
+{
+  VectorStorage() = default;
+  constexpr VectorStorage(const T& x,const T& y,const T& z,const T& w)
+    :x(x),y(y),z(z),w(w){}
+
+  constexpr const T& at(Index<0>) const { return x; }
+  constexpr const T& at(Index<1>) const { return y; }
+  constexpr const T& at(Index<2>) const { return z; }
+  constexpr const T& at(Index<3>) const { return w; }
+  constexpr T& at(Index<0>) { return x; }
+  constexpr T& at(Index<1>) { return y; }
+  constexpr T& at(Index<2>) { return z; }
+  constexpr T& at(Index<3>) { return w; }
+
+  T*       data()       { return &x; }
+  const T* data() const { return &x; }
+
+  /// data
+  T x,y,z,w;
+};
+
+/// Element-wise operations, shared with expr.h
+struct Neg { template<class A>          static constexpr auto apply(const A& a)              -> decltype(-a)  { return -a; } };
+struct Add { template<class A, class B> static constexpr auto apply(const A& a, const B& b) -> decltype(a+b) { return a+b; } };
+struct Sub { template<class A, class B> static constexpr auto apply(const A& a, const B& b) -> decltype(a-b) { return a-b; } };
+struct Mul { template<class A, class B> static constexpr auto apply(const A& a, const B& b) -> decltype(a*b) { return a*b; } };
+struct Div { template<class A, class B> static constexpr auto apply(const A& a, const B& b) -> decltype(a/b) { return a/b; } };
+
+/// Compound assignment counterparts
+struct AddTo { template<class A, class B> static constexpr void apply(A& a, const B& b){ a += b; } };
+struct SubTo { template<class A, class B> static constexpr void apply(A& a, const B& b){ a -= b; } };
+struct MulTo { template<class A, class B> static constexpr void apply(A& a, const B& b){ a *= b; } };
+struct DivTo { template<class A, class B> static constexpr void apply(A& a, const B& b){ a /= b; } };
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T, int N>
+class Vector : public tvml::detail::VectorStorage<T,N>,
+               public tvml::Printable<Vector<T,N>, N>
+{
+  typedef tvml::detail::VectorStorage<T,N> Storage;
+  typedef tvml::detail::Indices<N> Is;
+  template<int I> using Idx = tvml::detail::Index<I>;
+  template<typename, int> friend class Vector;
+public:
+  Vector() = default;
+  using Storage::Storage;
+
+  template<class X>
+  constexpr Vector(const Vector<X,N>& vec):Vector(convert(vec, Is())){}
+
+  /// Math operators
+  constexpr Vector operator-() const{
+    return unary<tvml::detail::Neg>(Is());
+  }
+
+  template<class X>
+  constexpr Vector operator+(const Vector<X,N>& vec) const{
+    return binary<tvml::detail::Add>(vec, Is());
+  }
+  template<class X>
+  constexpr Vector operator-(const Vector<X,N>& vec) const{
+    return binary<tvml::detail::Sub>(vec, Is());
+  }
+  template<class X, class = tvml::IfScalar<X>>
+  constexpr Vector operator*(const X& t) const{
+    return binary<tvml::detail::Mul>(t, Is());
+  }
+  template<class X, class = tvml::IfScalar<X>>
+  constexpr Vector operator/(const X& t) const{
+    return binary<tvml::detail::Div>(t, Is());
+  }
+
+  /// DOT PRODUCT
+  template<class X>
+  constexpr T operator*(const Vector<X,N>& vec) const{
+    return T(dot(vec, Idx<1>(), get<0>()*vec.template get<0>()));
+  }
+
+  /// COMPOUND, element-wise with a vector or with every element for a scalar
+  template<class X>
+  constexpr Vector& operator+=(const X& t){
+    return compound<tvml::detail::AddTo>(t, Is());
+  }
+  template<class X>
+  constexpr Vector& operator-=(const X& t){
+    return compound<tvml::detail::SubTo>(t, Is());
+  }
+  template<class X>
+  constexpr Vector& operator*=(const X& t){
+    return compound<tvml::detail::MulTo>(t, Is());
+  }
+  template<class X>
+  constexpr Vector& operator/=(const X& t){
+    return compound<tvml::detail::DivTo>(t, Is());
+  }
+
+  /// CROSS
+  template<class X, int M = N, class = typename std::enable_if<M == 3>::type>
+  constexpr Vector cross(const Vector<X,3>& vec) const{
+    return Vector(this->y*vec.z - this->z*vec.y,
+                  this->z*vec.x - this->x*vec.z,
+                  this->x*vec.y - this->y*vec.x);
+  }
+
+  /// Normal
+  Vector normal() const{
+    return (*this)/(magnitude());
+  }
+  // normalize in place
+  void normalize(){
+    (*this)/=magnitude();
+  }
+
+  T magnitude() const{
+    return sqrt(squares());
+  }
+
+  /// Fast normal through rsqrt, accuracy per tvml::Precision (rsqrt.h)
+  Vector normalFast(tvml::Precision p = tvml::Precision::Approx) const{
+    return (*this)*invMagnitude(p);
+  }
+  void normalizeFast(tvml::Precision p = tvml::Precision::Approx){
+    *this = normalFast(p);
+  }
+  // 1/magnitude()
+  T invMagnitude(tvml::Precision p = tvml::Precision::Approx) const{
+    return tvml::rsqrt(squares(), p);
+  }
+
+  /// Accessor functions
+  T& operator [] (uint32_t i){
+    return this->data()[i];
+  }
+  const T& operator [] (uint32_t i) const{
+    return this->data()[i];
+  }
+  /// Compile time index, usable in constant expressions
+  template<int I>
+  constexpr const T& get() const{
+    return this->at(Idx<I>());
+  }
+  template<int I>
+  constexpr T& get(){
+    return this->at(Idx<I>());
+  }
+
+private:
+  // x*x + y*y + ... in the type the products have, like the old per size code
+  constexpr auto squares() const -> decltype(T()*T()){
+    return dot(*this, Idx<1>(), get<0>()*get<0>());
+  }
+
+  template<class X, class S>
+  constexpr S dot(const Vector<X,N>&, Idx<N>, const S& sum) const{
+    return sum;
+  }
+  template<class X, class S, int I>
+  constexpr S dot(const Vector<X,N>& vec, Idx<I>, const S& sum) const{
+    return dot(vec, Idx<I+1>(), sum + get<I>()*vec.template get<I>());
+  }
+
+  // operand element I, the scalar itself for scalars
+  template<int I, class X>
+  static constexpr const X& elem(const X& t, std::true_type){ return t; }
+  template<int I, class X>
+  static constexpr const X& elem(const Vector<X,N>& v, std::false_type){ return v.template get<I>(); }
+  template<int I, class X>
+  static constexpr auto elem(const X& t)
+    -> decltype(elem<I>(t, tvml::IsScalar<X>())){
+    return elem<I>(t, tvml::IsScalar<X>());
+  }
+
+  template<class X, int... I>
+  static constexpr Vector convert(const Vector<X,N>& vec, std::integer_sequence<int, I...>){
+    return Vector(T(vec.template get<I>())...);
+  }
+  template<class Op, int... I>
+  constexpr Vector unary(std::integer_sequence<int, I...>) const{
+    return Vector(Op::apply(get<I>())...);
+  }
+  template<class Op, class X, int... I>
+  constexpr Vector binary(const X& t, std::integer_sequence<int, I...>) const{
+    return Vector(Op::apply(get<I>(), elem<I>(t))...);
+  }
+  template<class Op, class X, int... I>
+  constexpr Vector& compound(const X& t, std::integer_sequence<int, I...>){
+    int expand[] = { (Op::apply(get<I>(), elem<I>(t)), 0)... };
+    (void)expand;
+    return *this;
+  }
+};
+
+template<typename T, int N>
+Vector<T,N> normalize(const Vector<T,N>& v){
+  return v.normal();
+}
+
+#endif // VECTOR_H
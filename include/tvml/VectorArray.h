@@ -0,0 +1,525 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef VECTORARRAY_H
+#define VECTORARRAY_H
+
+#include <cassert>
+#include <vector>
+
+#include "simd.h"
+#include "rsqrt.h"
+#include "Vector3.h"
+#include "Vector4.h"
+
+/**
+  Structure of arrays containers for bulk vector math.
+
+  Every lane is a separate contiguous array, so the kernels below load
+  full SIMD registers instead of shuffling x,y,z out of Vector3 structs.
+  Results are element for element the same as the Vector3/Vector4
+  operators. Output arrays may alias the inputs.
+**/
+
+template<typename T>
+class Vector3Array
+{
+public:
+  Vector3Array(){}
+  explicit Vector3Array(size_t n):x(n),y(n),z(n){}
+
+  template<class X>
+  Vector3Array(const Vector3<X>* vec, size_t n):x(n),y(n),z(n){
+    for(size_t i=0; i<n; i++)
+      set(i, vec[i]);
+  }
+
+  size_t size() const { return x.size(); }
+
+  void resize(size_t n){ x.resize(n); y.resize(n); z.resize(n); }
+  void reserve(size_t n){ x.reserve(n); y.reserve(n); z.reserve(n); }
+
+  template<class X>
+  void push_back(const Vector3<X>& vec){
+    x.push_back(vec.x); y.push_back(vec.y); z.push_back(vec.z);
+  }
+
+  /// Element access (gathers / scatters one vector)
+  Vector3<T> operator [] (size_t i) const{
+    return Vector3<T>(x[i], y[i], z[i]);
+  }
+  template<class X>
+  void set(size_t i, const Vector3<X>& vec){
+    x[i] = vec.x; y[i] = vec.y; z[i] = vec.z;
+  }
+
+  /// Copy back to array of structs
+  template<class X>
+  void copyTo(Vector3<X>* vec) const{
+    for(size_t i=0; i<size(); i++)
+      vec[i] = Vector3<X>(x[i], y[i], z[i]);
+  }
+
+  /// data
+  std::vector<T> x,y,z;
+};
+
+template<typename T>
+class Vector4Array
+{
+public:
+  Vector4Array(){}
+  explicit Vector4Array(size_t n):x(n),y(n),z(n),w(n){}
+
+  template<class X>
+  Vector4Array(const Vector4<X>* vec, size_t n):x(n),y(n),z(n),w(n){
+    for(size_t i=0; i<n; i++)
+      set(i, vec[i]);
+  }
+
+  size_t size() const { return x.size(); }
+
+  void resize(size_t n){ x.resize(n); y.resize(n); z.resize(n); w.resize(n); }
+  void reserve(size_t n){ x.reserve(n); y.reserve(n); z.reserve(n); w.reserve(n); }
+
+  template<class X>
+  void push_back(const Vector4<X>& vec){
+    x.push_back(vec.x); y.push_back(vec.y); z.push_back(vec.z); w.push_back(vec.w);
+  }
+
+  /// Element access (gathers / scatters one vector)
+  Vector4<T> operator [] (size_t i) const{
+    return Vector4<T>(x[i], y[i], z[i], w[i]);
+  }
+  template<class X>
+  void set(size_t i, const Vector4<X>& vec){
+    x[i] = vec.x; y[i] = vec.y; z[i] = vec.z; w[i] = vec.w;
+  }
+
+  /// Copy back to array of structs
+  template<class X>
+  void copyTo(Vector4<X>* vec) const{
+    for(size_t i=0; i<size(); i++)
+      vec[i] = Vector4<X>(x[i], y[i], z[i], w[i]);
+  }
+
+  /// data
+  std::vector<T> x,y,z,w;
+};
+
+namespace tvml
+{
+namespace detail
+{
+
+/// Kernels, see simd::run. Evaluation order matches the scalar operators.
+
+template<typename T>
+struct Dot3Kernel
+{
+  const T *ax,*ay,*az, *bx,*by,*bz;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P r = P::load(ax+i)*P::load(bx+i) + P::load(ay+i)*P::load(by+i) + P::load(az+i)*P::load(bz+i);
+    r.store(out+i);
+  }
+};
+
+template<typename T>
+struct Cross3Kernel
+{
+  const T *ax,*ay,*az, *bx,*by,*bz;
+  T *ox,*oy,*oz;
+
+  template<class P> void apply(size_t i) const{
+    P x1 = P::load(ax+i), y1 = P::load(ay+i), z1 = P::load(az+i);
+    P x2 = P::load(bx+i), y2 = P::load(by+i), z2 = P::load(bz+i);
+    (y1*z2 - z1*y2).store(ox+i);
+    (z1*x2 - x1*z2).store(oy+i);
+    (x1*y2 - y1*x2).store(oz+i);
+  }
+};
+
+template<typename T, typename Op>
+struct LaneKernel
+{
+  const T *a,*b;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    Op::apply(P::load(a+i), P::load(b+i)).store(out+i);
+  }
+};
+
+template<typename T>
+struct ScaleKernel
+{
+  const T *a;
+  T s;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    (P::load(a+i)*P::set1(s)).store(out+i);
+  }
+};
+
+struct AddOp { template<class P> static P apply(P a, P b){ return a + b; } };
+struct SubOp { template<class P> static P apply(P a, P b){ return a - b; } };
+
+template<typename T>
+struct Magnitude3Kernel
+{
+  const T *x,*y,*z;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+    sqrt(vx*vx + vy*vy + vz*vz).store(out+i);
+  }
+};
+
+template<typename T>
+struct Normal3Kernel
+{
+  const T *x,*y,*z;
+  T *ox,*oy,*oz;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+    P m = sqrt(vx*vx + vy*vy + vz*vz);
+    (vx/m).store(ox+i);
+    (vy/m).store(oy+i);
+    (vz/m).store(oz+i);
+  }
+};
+
+template<typename T>
+struct Dot4Kernel
+{
+  const T *ax,*ay,*az,*aw, *bx,*by,*bz,*bw;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P r = P::load(ax+i)*P::load(bx+i) + P::load(ay+i)*P::load(by+i)
+        + P::load(az+i)*P::load(bz+i) + P::load(aw+i)*P::load(bw+i);
+    r.store(out+i);
+  }
+};
+
+template<typename T>
+struct Magnitude4Kernel
+{
+  const T *x,*y,*z,*w;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i), vw = P::load(w+i);
+    sqrt(vx*vx + vy*vy + vz*vz + vw*vw).store(out+i);
+  }
+};
+
+template<typename T>
+struct Normal4Kernel
+{
+  const T *x,*y,*z,*w;
+  T *ox,*oy,*oz,*ow;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i), vw = P::load(w+i);
+    P m = sqrt(vx*vx + vy*vy + vz*vz + vw*vw);
+    (vx/m).store(ox+i);
+    (vy/m).store(oy+i);
+    (vz/m).store(oz+i);
+    (vw/m).store(ow+i);
+  }
+};
+
+/// rsqrt based variants of the above, see rsqrt.h
+template<typename T, Precision Pr>
+struct InvMagnitude3Kernel
+{
+  const T *x,*y,*z;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+    simd::rsqrt<Pr>(vx*vx + vy*vy + vz*vz).store(out+i);
+  }
+};
+
+template<typename T, Precision Pr>
+struct NormalFast3Kernel
+{
+  const T *x,*y,*z;
+  T *ox,*oy,*oz;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+    P r = simd::rsqrt<Pr>(vx*vx + vy*vy + vz*vz);
+    (vx*r).store(ox+i);
+    (vy*r).store(oy+i);
+    (vz*r).store(oz+i);
+  }
+};
+
+template<typename T, Precision Pr>
+struct InvMagnitude4Kernel
+{
+  const T *x,*y,*z,*w;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i), vw = P::load(w+i);
+    simd::rsqrt<Pr>(vx*vx + vy*vy + vz*vz + vw*vw).store(out+i);
+  }
+};
+
+template<typename T, Precision Pr>
+struct NormalFast4Kernel
+{
+  const T *x,*y,*z,*w;
+  T *ox,*oy,*oz,*ow;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i), vw = P::load(w+i);
+    P r = simd::rsqrt<Pr>(vx*vx + vy*vy + vz*vz + vw*vw);
+    (vx*r).store(ox+i);
+    (vy*r).store(oy+i);
+    (vz*r).store(oz+i);
+    (vw*r).store(ow+i);
+  }
+};
+
+template<typename Op, typename T>
+inline void lanewise(const std::vector<T>& a, const std::vector<T>& b, std::vector<T>& out)
+{
+  LaneKernel<T,Op> k = { a.data(), b.data(), out.data() };
+  simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+inline void scaleLane(const std::vector<T>& a, const T& s, std::vector<T>& out)
+{
+  ScaleKernel<T> k = { a.data(), s, out.data() };
+  simd::run<T>(a.size(), k);
+}
+
+} // namespace detail
+} // namespace tvml
+
+/// Vector3Array kernels
+
+/// DOT PRODUCT, out[i] = a[i]*b[i]
+template<typename T>
+void dot(const Vector3Array<T>& a, const Vector3Array<T>& b, T* out)
+{
+  assert(a.size() == b.size());
+  tvml::detail::Dot3Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(),
+                                    b.x.data(), b.y.data(), b.z.data(), out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+/// CROSS, out[i] = a[i].cross(b[i])
+template<typename T>
+void cross(const Vector3Array<T>& a, const Vector3Array<T>& b, Vector3Array<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::Cross3Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(),
+                                      b.x.data(), b.y.data(), b.z.data(),
+                                      out.x.data(), out.y.data(), out.z.data() };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+void add(const Vector3Array<T>& a, const Vector3Array<T>& b, Vector3Array<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.x, b.x, out.x);
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.y, b.y, out.y);
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.z, b.z, out.z);
+}
+
+template<typename T>
+void sub(const Vector3Array<T>& a, const Vector3Array<T>& b, Vector3Array<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.x, b.x, out.x);
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.y, b.y, out.y);
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.z, b.z, out.z);
+}
+
+template<typename T>
+void scale(const Vector3Array<T>& a, const T& s, Vector3Array<T>& out)
+{
+  out.resize(a.size());
+  tvml::detail::scaleLane(a.x, s, out.x);
+  tvml::detail::scaleLane(a.y, s, out.y);
+  tvml::detail::scaleLane(a.z, s, out.z);
+}
+
+template<typename T>
+void magnitude(const Vector3Array<T>& a, T* out)
+{
+  tvml::detail::Magnitude3Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(), out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+/// Normal, out[i] = a[i].normal()
+template<typename T>
+void normal(const Vector3Array<T>& a, Vector3Array<T>& out)
+{
+  out.resize(a.size());
+  tvml::detail::Normal3Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(),
+                                       out.x.data(), out.y.data(), out.z.data() };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+// normalize in place
+template<typename T>
+void normalize(Vector3Array<T>& a)
+{
+  normal(a, a);
+}
+
+/// Fast variants, accuracy per tvml::Precision (rsqrt.h)
+
+/// out[i] = 1/a[i].magnitude()
+template<typename T>
+void invMagnitude(const Vector3Array<T>& a, T* out,
+                  tvml::Precision p = tvml::Precision::Approx)
+{
+  tvml::simd::run<T, tvml::detail::InvMagnitude3Kernel>(p, a.size(),
+      a.x.data(), a.y.data(), a.z.data(), out);
+}
+
+/// out[i] = a[i].normalFast(p)
+template<typename T>
+void normalFast(const Vector3Array<T>& a, Vector3Array<T>& out,
+                tvml::Precision p = tvml::Precision::Approx)
+{
+  out.resize(a.size());
+  tvml::simd::run<T, tvml::detail::NormalFast3Kernel>(p, a.size(),
+      a.x.data(), a.y.data(), a.z.data(), out.x.data(), out.y.data(), out.z.data());
+}
+
+template<typename T>
+void normalizeFast(Vector3Array<T>& a, tvml::Precision p = tvml::Precision::Approx)
+{
+  normalFast(a, a, p);
+}
+
+/// Vector4Array kernels
+
+template<typename T>
+void dot(const Vector4Array<T>& a, const Vector4Array<T>& b, T* out)
+{
+  assert(a.size() == b.size());
+  tvml::detail::Dot4Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(), a.w.data(),
+                                    b.x.data(), b.y.data(), b.z.data(), b.w.data(), out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+void add(const Vector4Array<T>& a, const Vector4Array<T>& b, Vector4Array<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.x, b.x, out.x);
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.y, b.y, out.y);
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.z, b.z, out.z);
+  tvml::detail::lanewise<tvml::detail::AddOp>(a.w, b.w, out.w);
+}
+
+template<typename T>
+void sub(const Vector4Array<T>& a, const Vector4Array<T>& b, Vector4Array<T>& out)
+{
+  assert(a.size() == b.size());
+  out.resize(a.size());
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.x, b.x, out.x);
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.y, b.y, out.y);
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.z, b.z, out.z);
+  tvml::detail::lanewise<tvml::detail::SubOp>(a.w, b.w, out.w);
+}
+
+template<typename T>
+void scale(const Vector4Array<T>& a, const T& s, Vector4Array<T>& out)
+{
+  out.resize(a.size());
+  tvml::detail::scaleLane(a.x, s, out.x);
+  tvml::detail::scaleLane(a.y, s, out.y);
+  tvml::detail::scaleLane(a.z, s, out.z);
+  tvml::detail::scaleLane(a.w, s, out.w);
+}
+
+template<typename T>
+void magnitude(const Vector4Array<T>& a, T* out)
+{
+  tvml::detail::Magnitude4Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(), a.w.data(), out };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+void normal(const Vector4Array<T>& a, Vector4Array<T>& out)
+{
+  out.resize(a.size());
+  tvml::detail::Normal4Kernel<T> k = { a.x.data(), a.y.data(), a.z.data(), a.w.data(),
+                                       out.x.data(), out.y.data(), out.z.data(), out.w.data() };
+  tvml::simd::run<T>(a.size(), k);
+}
+
+template<typename T>
+void normalize(Vector4Array<T>& a)
+{
+  normal(a, a);
+}
+
+template<typename T>
+void invMagnitude(const Vector4Array<T>& a, T* out,
+                  tvml::Precision p = tvml::Precision::Approx)
+{
+  tvml::simd::run<T, tvml::detail::InvMagnitude4Kernel>(p, a.size(),
+      a.x.data(), a.y.data(), a.z.data(), a.w.data(), out);
+}
+
+template<typename T>
+void normalFast(const Vector4Array<T>& a, Vector4Array<T>& out,
+                tvml::Precision p = tvml::Precision::Approx)
+{
+  out.resize(a.size());
+  tvml::simd::run<T, tvml::detail::NormalFast4Kernel>(p, a.size(),
+      a.x.data(), a.y.data(), a.z.data(), a.w.data(),
+      out.x.data(), out.y.data(), out.z.data(), out.w.data());
+}
+
+template<typename T>
+void normalizeFast(Vector4Array<T>& a, tvml::Precision p = tvml::Precision::Approx)
+{
+  normalFast(a, a, p);
+}
+
+typedef Vector3Array<float>  Vector3Arrayf;
+typedef Vector3Array<double> Vector3Arrayd;
+typedef Vector4Array<float>  Vector4Arrayf;
+typedef Vector4Array<double> Vector4Arrayd;
+#endif // VECTORARRAY_H
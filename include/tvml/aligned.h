@@ -0,0 +1,317 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef ALIGNED_H
+#define ALIGNED_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "simd.h"
+#include "Vector3.h"
+#include "Vector4.h"
+#include "Matrix4x4.h"
+
+#if defined(_WIN32)
+#  include <malloc.h>
+#endif
+
+/**
+  SIMD friendly variants of Vector3, Vector4 and Matrix4x4.
+
+  Vector4a and Matrix4x4a are aligned to their size (at most 32 bytes),
+  Vector3a is padded to four elements so it is one aligned 16 byte load
+  for float and never straddles a cache line. The contents of the padding
+  are unspecified. All three are trivially copyable and standard layout,
+  they derive from the plain types and convert to and from them.
+
+  Their own operators load with aligned instructions where SSE2 is
+  available (float only), anything else goes through the plain operators.
+  Results are the same as the plain types' in either case.
+
+  Use aligned_allocator (or aligned_vector) to keep them aligned inside
+  std::vector, the default allocator ignores over-alignment before C++17.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+/// alignas() for n elements of T: the whole vector, capped at an AVX register
+template<typename T, size_t n>
+struct SimdAlign
+{
+  static const size_t value = n*sizeof(T) < 32 ? n*sizeof(T) : 32;
+};
+
+inline void* alignedMalloc(size_t size, size_t align)
+{
+  if(align < sizeof(void*))
+    align = sizeof(void*);
+#if defined(_WIN32)
+  return _aligned_malloc(size, align);
+#else
+  void* p = 0;
+  return posix_memalign(&p, align, size) == 0 ? p : 0;
+#endif
+}
+
+inline void alignedFree(void* p)
+{
+#if defined(_WIN32)
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+} // namespace detail
+
+/// std::vector allocator handing out Align byte aligned storage
+template<typename T, size_t Align = alignof(T)>
+class aligned_allocator
+{
+public:
+  typedef T value_type;
+  static const size_t alignment = Align > alignof(T) ? Align : alignof(T);
+
+  template<class U>
+  struct rebind { typedef aligned_allocator<U, Align> other; };
+
+  aligned_allocator() = default;
+  template<class U>
+  aligned_allocator(const aligned_allocator<U, Align>&){}
+
+  T* allocate(size_t n)
+  {
+    if(n > size_t(-1) / sizeof(T))
+      throw std::bad_alloc();
+    void* p = detail::alignedMalloc(n*sizeof(T), alignment);
+    if(!p)
+      throw std::bad_alloc();
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, size_t){
+    detail::alignedFree(p);
+  }
+};
+
+template<class T, class U, size_t A>
+bool operator==(const aligned_allocator<T,A>&, const aligned_allocator<U,A>&){ return true; }
+template<class T, class U, size_t A>
+bool operator!=(const aligned_allocator<T,A>&, const aligned_allocator<U,A>&){ return false; }
+
+template<typename T>
+using aligned_vector = std::vector< T, aligned_allocator<T> >;
+
+namespace detail
+{
+/// Operators of the aligned types. The generic version is the plain operator.
+template<typename T>
+struct AlignedOps
+{
+  template<class V> static V add(const V& a, const V& b){ return V(a.base() + b.base()); }
+  template<class V> static V sub(const V& a, const V& b){ return V(a.base() - b.base()); }
+  template<class V> static V neg(const V& a)            { return V(-a.base()); }
+  template<class V> static V mul(const V& a, const T& t){ return V(a.base() * t); }
+  template<class V> static V div(const V& a, const T& t){ return V(a.base() / t); }
+
+  template<class M> static M mulMat(const M& a, const M& b){ return M(a.base() * b.base()); }
+  template<class M, class V>
+  static V mulVec(const M& a, const V& v){ return V(a.base() * v.base()); }
+};
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class alignas(tvml::detail::SimdAlign<T,4>::value) Vector3a : public Vector3<T>
+{
+  typedef Vector3<T> Base;
+  typedef tvml::detail::AlignedOps<T> Ops;
+public:
+  Vector3a() = default;
+  using Base::Base;
+  constexpr Vector3a(const Base& vec):Base(vec){}
+
+  using Base::operator+;
+  using Base::operator-;
+  using Base::operator*;
+  using Base::operator/;
+
+  /// Math operators
+  Vector3a operator-() const                  { return Ops::neg(*this); }
+  Vector3a operator+(const Vector3a& v) const { return Ops::add(*this, v); }
+  Vector3a operator-(const Vector3a& v) const { return Ops::sub(*this, v); }
+  Vector3a operator*(const T& t) const        { return Ops::mul(*this, t); }
+  Vector3a operator/(const T& t) const        { return Ops::div(*this, t); }
+
+  /// DOT PRODUCT
+  T operator*(const Vector3a& v) const        { return base() * v.base(); }
+
+  const Base& base() const { return *this; }
+};
+
+template<typename T>
+class alignas(tvml::detail::SimdAlign<T,4>::value) Vector4a : public Vector4<T>
+{
+  typedef Vector4<T> Base;
+  typedef tvml::detail::AlignedOps<T> Ops;
+public:
+  Vector4a() = default;
+  using Base::Base;
+  constexpr Vector4a(const Base& vec):Base(vec){}
+
+  using Base::operator+;
+  using Base::operator-;
+  using Base::operator*;
+
+  /// Math operators
+  Vector4a operator-() const                  { return Ops::neg(*this); }
+  Vector4a operator+(const Vector4a& v) const { return Ops::add(*this, v); }
+  Vector4a operator-(const Vector4a& v) const { return Ops::sub(*this, v); }
+  Vector4a operator*(const T& t) const        { return Ops::mul(*this, t); }
+  Vector4a operator/(const T& t) const        { return Ops::div(*this, t); }
+
+  const Base& base() const { return *this; }
+};
+
+template<typename T>
+class alignas(tvml::detail::SimdAlign<T,16>::value) Matrix4x4a : public Matrix4x4<T>
+{
+  typedef Matrix4x4<T> Base;
+  typedef tvml::detail::AlignedOps<T> Ops;
+public:
+  Matrix4x4a() = default;
+  using Base::Base;
+  constexpr Matrix4x4a(const Base& mat):Base(mat){}
+
+  using Base::operator*;
+
+  /// Matrix multiplication
+  Matrix4x4a operator*(const Matrix4x4a& mat) const { return Ops::mulMat(*this, mat); }
+  Matrix4x4a& operator*=(const Matrix4x4a& mat){ return *this = Ops::mulMat(*this, mat); }
+
+  /// Assumes w=1
+  Vector3a<T> operator*(const Vector3a<T>& vec) const { return Ops::mulVec(*this, vec); }
+  Vector4a<T> operator*(const Vector4a<T>& vec) const { return Ops::mulVec(*this, vec); }
+
+  const Base& base() const { return *this; }
+};
+
+#if defined(TVML_SSE2)
+namespace tvml
+{
+namespace detail
+{
+/// Aligned SSE2 paths, same operation order as the plain operators.
+template<>
+struct AlignedOps<float>
+{
+  static __m128 load(const Vector3a<float>& v){ return _mm_load_ps(&v.x); }
+  static __m128 load(const Vector4a<float>& v){ return _mm_load_ps(&v.x); }
+  template<class V> static V store(__m128 r){ V v; _mm_store_ps(&v.x, r); return v; }
+
+  template<class V> static V add(const V& a, const V& b){ return store<V>(_mm_add_ps(load(a), load(b))); }
+  template<class V> static V sub(const V& a, const V& b){ return store<V>(_mm_sub_ps(load(a), load(b))); }
+  template<class V> static V neg(const V& a){ return store<V>(_mm_xor_ps(load(a), _mm_set1_ps(-0.0f))); }
+  template<class V> static V mul(const V& a, float t){ return store<V>(_mm_mul_ps(load(a), _mm_set1_ps(t))); }
+  template<class V> static V div(const V& a, float t){ return store<V>(_mm_div_ps(load(a), _mm_set1_ps(t))); }
+
+  /// Row times column broadcast, like mul4x4_sse2
+  static Matrix4x4a<float> mulMat(const Matrix4x4a<float>& a, const Matrix4x4a<float>& b)
+  {
+    const float* pa = a.data();
+    const float* pb = b.data();
+    __m128 b0 = _mm_load_ps(pb), b1 = _mm_load_ps(pb+4),
+           b2 = _mm_load_ps(pb+8), b3 = _mm_load_ps(pb+12);
+    Matrix4x4a<float> ret;
+    for(int i=0; i<16; i+=4){
+      __m128 r = _mm_mul_ps(_mm_set1_ps(pa[i]), b0);
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(pa[i+1]), b1));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(pa[i+2]), b2));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(pa[i+3]), b3));
+      _mm_store_ps(ret.data()+i, r);
+    }
+    return ret;
+  }
+
+  /// Multiplies every row by v, transposes and sums x+y+z+w in the plain order
+  static __m128 rowDots(const Matrix4x4a<float>& m, __m128 v)
+  {
+    const float* p = m.data();
+    __m128 r0 = _mm_mul_ps(_mm_load_ps(p),    v);
+    __m128 r1 = _mm_mul_ps(_mm_load_ps(p+4),  v);
+    __m128 r2 = _mm_mul_ps(_mm_load_ps(p+8),  v);
+    __m128 r3 = _mm_mul_ps(_mm_load_ps(p+12), v);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    return _mm_add_ps(_mm_add_ps(_mm_add_ps(r0, r1), r2), r3);
+  }
+  static Vector4a<float> mulVec(const Matrix4x4a<float>& m, const Vector4a<float>& v)
+  {
+    return store< Vector4a<float> >(rowDots(m, load(v)));
+  }
+  static Vector3a<float> mulVec(const Matrix4x4a<float>& m, const Vector3a<float>& v)
+  {
+    // w = 1, the padding lane is replaced
+    const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    __m128 p = _mm_or_ps(_mm_and_ps(load(v), xyz), _mm_set_ps(1.0f, 0, 0, 0));
+    return store< Vector3a<float> >(rowDots(m, p));
+  }
+};
+} // namespace detail
+} // namespace tvml
+#endif // TVML_SSE2
+
+#define TVML_CHECK_POD(type, size, align) \
+  static_assert(std::is_trivially_copyable< type >::value, #type " must be trivially copyable"); \
+  static_assert(std::is_trivially_default_constructible< type >::value, #type " must be trivially default constructible"); \
+  static_assert(std::is_standard_layout< type >::value, #type " must be standard layout"); \
+  static_assert(sizeof(type) == size && alignof(type) == align, #type " has the wrong size or alignment")
+
+TVML_CHECK_POD(Vector3<float>,     12,  4);
+TVML_CHECK_POD(Vector4<float>,     16,  4);
+TVML_CHECK_POD(Matrix4x4<float>,   64,  4);
+TVML_CHECK_POD(Vector3a<float>,    16, 16);
+TVML_CHECK_POD(Vector4a<float>,    16, 16);
+TVML_CHECK_POD(Matrix4x4a<float>,  64, 32);
+TVML_CHECK_POD(Vector3a<double>,   32, 32);
+TVML_CHECK_POD(Vector4a<double>,   32, 32);
+TVML_CHECK_POD(Matrix4x4a<double>, 128, 32);
+#undef TVML_CHECK_POD
+
+/// Opencl/cuda naming
+typedef Vector3a<float>     float3a;
+typedef Vector3a<double>    double3a;
+typedef Vector4a<float>     float4a;
+typedef Vector4a<double>    double4a;
+
+/// Opengl naming
+typedef Vector3a<float>     vec3a;
+typedef Vector3a<double>    dvec3a;
+typedef Vector4a<float>     vec4a;
+typedef Vector4a<double>    dvec4a;
+typedef Matrix4x4a<float>   mat4a;
+typedef Matrix4x4a<double>  dmat4a;
+
+#endif // ALIGNED_H
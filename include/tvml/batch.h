@@ -0,0 +1,374 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include "simd.h"
+#include "parallel.h"
+#include "Matrix3x3.h"
+#include "Matrix4x4.h"
+#include "VectorArray.h"
+
+/**
+  Batched transforms.
+
+  The matrix is loaded once per batch instead of once per vector. Every
+  function gives the same result per element as the matching operator*:
+    transformPoints      mat4 * Vector3 (w=1)
+    transformDirections  mat4 * Vector3 (w=0)
+    transformVectors     mat4 * Vector4, mat3 * Vector3
+    transformHomogeneous mat4 * Vector4, then divide by w
+  in and out may be the same array. `threads` > 1 splits batches larger
+  than a few thousand vectors (0 = all cores).
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t TRANSFORM_GRAIN = 16384;
+
+/// Rows of S elements, translation in column 3 when TRANSLATE.
+template<typename T, int S, bool TRANSLATE>
+struct Transform3
+{
+  static void run(const T* m, const Vector3<T>* in, Vector3<T>* out, size_t n)
+  {
+    const T m0 = m[0],   m1 = m[1],   m2 = m[2];
+    const T m4 = m[S],   m5 = m[S+1], m6 = m[S+2];
+    const T m8 = m[2*S], m9 = m[2*S+1], m10 = m[2*S+2];
+    const T t0 = TRANSLATE ? m[3]   : T(0);
+    const T t1 = TRANSLATE ? m[S+3] : T(0);
+    const T t2 = TRANSLATE ? m[2*S+3] : T(0);
+    for(size_t i=0; i<n; i++){
+      const T x = in[i].x, y = in[i].y, z = in[i].z;
+      T rx = x*m0 + y*m1 + z*m2;
+      T ry = x*m4 + y*m5 + z*m6;
+      T rz = x*m8 + y*m9 + z*m10;
+      if(TRANSLATE){
+        rx = rx + t0; ry = ry + t1; rz = rz + t2;
+      }
+      out[i].x = rx; out[i].y = ry; out[i].z = rz;
+    }
+  }
+};
+
+template<typename T>
+struct Transform4
+{
+  static void run(const T* m, const Vector4<T>* in, Vector4<T>* out, size_t n)
+  {
+    T c[16];
+    std::copy(m, m+16, c);
+    for(size_t i=0; i<n; i++){
+      const T x = in[i].x, y = in[i].y, z = in[i].z, w = in[i].w;
+      out[i].x = x*c[0]  + y*c[1]  + z*c[2]  + w*c[3];
+      out[i].y = x*c[4]  + y*c[5]  + z*c[6]  + w*c[7];
+      out[i].z = x*c[8]  + y*c[9]  + z*c[10] + w*c[11];
+      out[i].w = x*c[12] + y*c[13] + z*c[14] + w*c[15];
+    }
+  }
+};
+
+#if defined(TVML_SSE2)
+/// Columns live in registers, each vector is three broadcasts.
+template<int S, bool TRANSLATE>
+struct Transform3<float, S, TRANSLATE>
+{
+  static void run(const float* m, const Vector3<float>* in, Vector3<float>* out, size_t n)
+  {
+    const __m128 c0 = _mm_setr_ps(m[0], m[S],   m[2*S],   0);
+    const __m128 c1 = _mm_setr_ps(m[1], m[S+1], m[2*S+1], 0);
+    const __m128 c2 = _mm_setr_ps(m[2], m[S+2], m[2*S+2], 0);
+    const __m128 c3 = TRANSLATE ? _mm_setr_ps(m[3], m[S+3], m[2*S+3], 0) : _mm_setzero_ps();
+    for(size_t i=0; i<n; i++){
+      __m128 r = _mm_mul_ps(_mm_set1_ps(in[i].x), c0);
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[i].y), c1));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[i].z), c2));
+      if(TRANSLATE)
+        r = _mm_add_ps(r, c3);
+      // 12 byte store, never touches the next vector
+      _mm_storel_pi((__m64*)&out[i].x, r);
+      _mm_store_ss(&out[i].z, _mm_movehl_ps(r, r));
+    }
+  }
+};
+
+template<>
+struct Transform4<float>
+{
+  static void run(const float* m, const Vector4<float>* in, Vector4<float>* out, size_t n)
+  {
+    const __m128 c0 = _mm_setr_ps(m[0], m[4], m[8],  m[12]);
+    const __m128 c1 = _mm_setr_ps(m[1], m[5], m[9],  m[13]);
+    const __m128 c2 = _mm_setr_ps(m[2], m[6], m[10], m[14]);
+    const __m128 c3 = _mm_setr_ps(m[3], m[7], m[11], m[15]);
+    for(size_t i=0; i<n; i++){
+      __m128 r = _mm_mul_ps(_mm_set1_ps(in[i].x), c0);
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[i].y), c1));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[i].z), c2));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[i].w), c3));
+      _mm_storeu_ps(out[i].data(), r);
+    }
+  }
+};
+#endif // TVML_SSE2
+
+/// Structure of arrays, one full pack of vectors per step.
+template<typename T, int S, bool TRANSLATE>
+struct Transform3Kernel
+{
+  const T* m;
+  const T *x,*y,*z;
+  T *ox,*oy,*oz;
+
+  template<class P> void apply(size_t i) const{
+    P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+    P rx = vx*P::set1(m[0])   + vy*P::set1(m[1])     + vz*P::set1(m[2]);
+    P ry = vx*P::set1(m[S])   + vy*P::set1(m[S+1])   + vz*P::set1(m[S+2]);
+    P rz = vx*P::set1(m[2*S]) + vy*P::set1(m[2*S+1]) + vz*P::set1(m[2*S+2]);
+    if(TRANSLATE){
+      rx = rx + P::set1(m[3]);
+      ry = ry + P::set1(m[S+3]);
+      rz = rz + P::set1(m[2*S+3]);
+    }
+    rx.store(ox+i); ry.store(oy+i); rz.store(oz+i);
+  }
+};
+
+template<typename Kernel, typename T, typename V>
+inline void transformBatch(const T* m, const V* in, V* out, size_t n, unsigned threads)
+{
+  tvml::parallel_for(n, TRANSFORM_GRAIN, threads, [=](size_t begin, size_t end){
+    Kernel::run(m, in + begin, out + begin, end - begin);
+  });
+}
+
+template<typename T, int S, bool TRANSLATE>
+inline void transformArray(const T* m, const Vector3Array<T>& in, Vector3Array<T>& out,
+                           unsigned threads)
+{
+  out.resize(in.size());
+  const T *x = in.x.data(), *y = in.y.data(), *z = in.z.data();
+  T *ox = out.x.data(), *oy = out.y.data(), *oz = out.z.data();
+  tvml::parallel_for(in.size(), TRANSFORM_GRAIN, threads, [=](size_t begin, size_t end){
+    Transform3Kernel<T,S,TRANSLATE> k = { m, x+begin, y+begin, z+begin, ox+begin, oy+begin, oz+begin };
+    simd::run<T>(end - begin, k);
+  });
+}
+
+
+const size_t SQUARE3_GRAIN = 4096;
+
+/// One matrix per lane, through simd::Columns
+template<class P, typename T>
+inline void loadLanes(const Matrix3x3<T>* in, P* m)
+{
+  simd::Columns<9,P>::load(in->data(), sizeof(Matrix3x3<T>)/sizeof(T), m);
+}
+
+/// Only lanes whose bit is set in `lanes` are written
+template<class P, typename T>
+inline void storeLanes(const P* r, Matrix3x3<T>* out, int lanes = -1)
+{
+  simd::Columns<9,P>::store(r, out->data(), sizeof(Matrix3x3<T>)/sizeof(T), lanes);
+}
+
+template<typename T>
+struct Det3Kernel
+{
+  const Matrix3x3<T>* in;
+  T* det;
+
+  template<class P> void apply(size_t i) const{
+    P m[9];
+    loadLanes(in + i, m);
+    Square<T,3>::det(m).store(det + i);
+  }
+};
+
+template<typename T>
+struct Adjugate3Kernel
+{
+  const Matrix3x3<T>* in;
+  Matrix3x3<T>* out;
+
+  template<class P> void apply(size_t i) const{
+    P m[9], adj[9];
+    loadLanes(in + i, m);
+    Square<T,3>::adjugate(m, adj);
+    storeLanes(adj, out + i);
+  }
+};
+
+/// Inverse<T,3>::invert<true> per lane. Singular lanes keep their output.
+template<typename T>
+struct Inverse3Kernel
+{
+  const Matrix3x3<T>* in;
+  Matrix3x3<T>* out;
+  bool* singular;
+  size_t* count;
+
+  template<class P> void apply(size_t i) const{
+    P m[9], adj[9];
+    loadLanes(in + i, m);
+    Square<T,3>::adjugate(m, adj);
+    P det = m[0]*adj[0];
+    det = det + m[1]*adj[3];
+    det = det + m[2]*adj[6];
+
+    const P eps = P::set1(T(1e-07));
+    int ok = simd::movemask(cmpgt(det, eps) | cmplt(det, -eps));
+    for(int k=0; k<9; k++)
+      adj[k] = adj[k] / det;
+    storeLanes(adj, out + i, ok);
+
+    for(int j=0; j<P::width; j++){
+      bool s = !(ok >> j & 1);
+      if(singular)
+        singular[i+j] = s;
+      *count += s;
+    }
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+/// Points, w=1
+template<typename T>
+void transformPoints(const Matrix4x4<T>& mat, const Vector3<T>* in, Vector3<T>* out,
+                     size_t n, unsigned threads = 1)
+{
+  tvml::detail::transformBatch< tvml::detail::Transform3<T,4,true> >(mat.data(), in, out, n, threads);
+}
+
+/// Directions, w=0
+template<typename T>
+void transformDirections(const Matrix4x4<T>& mat, const Vector3<T>* in, Vector3<T>* out,
+                         size_t n, unsigned threads = 1)
+{
+  tvml::detail::transformBatch< tvml::detail::Transform3<T,4,false> >(mat.data(), in, out, n, threads);
+}
+
+template<typename T>
+void transformVectors(const Matrix4x4<T>& mat, const Vector4<T>* in, Vector4<T>* out,
+                      size_t n, unsigned threads = 1)
+{
+  tvml::detail::transformBatch< tvml::detail::Transform4<T> >(mat.data(), in, out, n, threads);
+}
+
+template<typename T>
+void transformVectors(const Matrix3x3<T>& mat, const Vector3<T>* in, Vector3<T>* out,
+                      size_t n, unsigned threads = 1)
+{
+  tvml::detail::transformBatch< tvml::detail::Transform3<T,3,false> >(mat.data(), in, out, n, threads);
+}
+
+/// Full 4x4 transform followed by the perspective divide
+template<typename T>
+void transformHomogeneous(const Matrix4x4<T>& mat, const Vector4<T>* in, Vector3<T>* out,
+                          size_t n, unsigned threads = 1)
+{
+  const T* m = mat.data();
+  tvml::parallel_for(n, tvml::detail::TRANSFORM_GRAIN, threads, [=](size_t begin, size_t end){
+    Vector4<T> tmp[64];
+    for(size_t i=begin; i<end; i+=64){
+      size_t count = std::min<size_t>(64, end - i);
+      tvml::detail::Transform4<T>::run(m, in + i, tmp, count);
+      for(size_t j=0; j<count; j++)
+        out[i+j] = Vector3<T>(tmp[j].x/tmp[j].w, tmp[j].y/tmp[j].w, tmp[j].z/tmp[j].w);
+    }
+  });
+}
+
+/// Structure of arrays versions, SIMD across vectors
+template<typename T>
+void transformPoints(const Matrix4x4<T>& mat, const Vector3Array<T>& in, Vector3Array<T>& out,
+                     unsigned threads = 1)
+{
+  tvml::detail::transformArray<T,4,true>(mat.data(), in, out, threads);
+}
+
+template<typename T>
+void transformDirections(const Matrix4x4<T>& mat, const Vector3Array<T>& in, Vector3Array<T>& out,
+                         unsigned threads = 1)
+{
+  tvml::detail::transformArray<T,4,false>(mat.data(), in, out, threads);
+}
+
+template<typename T>
+void transformVectors(const Matrix3x3<T>& mat, const Vector3Array<T>& in, Vector3Array<T>& out,
+                      unsigned threads = 1)
+{
+  tvml::detail::transformArray<T,3,false>(mat.data(), in, out, threads);
+}
+
+/**
+  Matrix3x3 batches, one matrix per SIMD lane (4, 8 or 16 floats at a
+  time with SSE2, AVX or AVX-512). Each result matches det(), adjoint()
+  and inverse() of the same matrix. in and out may be the same array.
+**/
+template<typename T>
+void determinants(const Matrix3x3<T>* in, T* det, size_t n, unsigned threads = 1)
+{
+  tvml::parallel_for(n, tvml::detail::SQUARE3_GRAIN, threads, [=](size_t begin, size_t end){
+    tvml::detail::Det3Kernel<T> k = { in + begin, det + begin };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+template<typename T>
+void adjugates(const Matrix3x3<T>* in, Matrix3x3<T>* out, size_t n, unsigned threads = 1)
+{
+  tvml::parallel_for(n, tvml::detail::SQUARE3_GRAIN, threads, [=](size_t begin, size_t end){
+    tvml::detail::Adjugate3Kernel<T> k = { in + begin, out + begin };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+/**
+  Inverts every matrix. Instead of throwing, singular matrices get
+  singular[i] = true (if singular isn't null) and out[i] left as it was,
+  like inverse(out). Returns how many were singular.
+**/
+template<typename T>
+size_t inverses(const Matrix3x3<T>* in, Matrix3x3<T>* out, bool* singular, size_t n,
+                unsigned threads = 1)
+{
+  std::atomic<size_t> total(0);
+  tvml::parallel_for(n, tvml::detail::SQUARE3_GRAIN, threads, [&](size_t begin, size_t end){
+    size_t count = 0;
+    tvml::detail::Inverse3Kernel<T> k = { in + begin, out + begin,
+                                          singular ? singular + begin : nullptr, &count };
+    tvml::simd::run<T>(end - begin, k);
+    total += count;
+  });
+  return total;
+}
+
+#endif // BATCH_H
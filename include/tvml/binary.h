@@ -0,0 +1,426 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "Vector.h"
+#include "Matrix.h"
+#include "Quarternion.h"
+#include "span.h"
+
+#if defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+/**
+  Binary container for arrays of vectors, matrices and quarternions.
+
+  A 64 byte BinaryHeader followed by the items exactly as they are in
+  memory, so a file maps straight into a Span of the item type:
+
+    tvml::BinaryWriter<mat4> out("poses.bin");
+    out.write(poses.data(), poses.size());
+    out.close();
+
+    tvml::MappedArray<mat4> in("poses.bin");   // mmap + header check
+    for(const mat4& m : in) ...
+
+  The header is in the writer's byte order. Readers check the magic, the
+  version, the byte order, the item kind and shape, the element type and
+  the item size, and throw std::runtime_error on any mismatch; there is no
+  conversion, a file written on a big endian machine does not load on a
+  little endian one. Matrices are row major, like Matrix<T,R,C> itself.
+  Padded types (Vector3a) are stored with their padding and only load as
+  the same padded type.
+
+  Items start at dataOffset (64), so a mapping, which is page aligned,
+  satisfies any item alignment up to 64 bytes.
+**/
+
+namespace tvml
+{
+
+enum class BinaryKind : uint32_t
+{
+  Vector = 1,      // rows = N, cols = 1
+  Matrix = 2,      // rows x cols, row major
+  Quarternion = 3  // w,x,y,z: rows = 4, cols = 1
+};
+
+enum class BinaryScalar : uint32_t
+{
+  Int8 = 1, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64, Float32, Float64
+};
+
+struct BinaryHeader
+{
+  char     magic[8];     // "TVMLARR"
+  uint32_t version;      // BinaryHeader::Version
+  uint32_t byteOrder;    // 0x01020304 as the writer stored it
+  uint32_t kind;         // BinaryKind
+  uint32_t scalar;       // BinaryScalar
+  uint32_t rows, cols;
+  uint32_t itemSize;     // bytes per item, padding included
+  uint32_t itemAlign;    // alignof the writer's item type
+  uint64_t count;        // items
+  uint64_t dataOffset;   // of the first item, from the start of the file
+  uint64_t reserved;
+
+  static const uint32_t Version = 1;
+  static const uint32_t ByteOrder = 0x01020304;
+};
+
+static_assert(sizeof(BinaryHeader) == 64, "BinaryHeader must stay 64 bytes");
+
+namespace detail
+{
+
+template<typename T>
+constexpr BinaryScalar binaryScalar()
+{
+  static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                "Binary files hold integer and floating point elements");
+  static_assert(!std::is_floating_point<T>::value || sizeof(T) == 4 || sizeof(T) == 8,
+                "Only 32 and 64 bit floating point elements");
+  return std::is_floating_point<T>::value ? (sizeof(T) == 4 ? BinaryScalar::Float32 : BinaryScalar::Float64) :
+         BinaryScalar(uint32_t(BinaryScalar::Int8) + 2*(sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : sizeof(T) == 8 ? 3 : 0)
+                      + (std::is_unsigned<T>::value ? 1 : 0));
+}
+
+struct BinaryLayout
+{
+  BinaryKind kind;
+  BinaryScalar scalar;
+  uint32_t rows, cols;
+};
+
+/// Overloads on base pointers, so derived types (the aligned ones) are found too
+template<typename T, int N>
+constexpr BinaryLayout binaryLayout(const Vector<T,N>*){
+  return {BinaryKind::Vector, binaryScalar<T>(), uint32_t(N), 1};
+}
+template<typename T, int R, int C>
+constexpr BinaryLayout binaryLayout(const Matrix<T,R,C>*){
+  return {BinaryKind::Matrix, binaryScalar<T>(), uint32_t(R), uint32_t(C)};
+}
+template<typename T>
+constexpr BinaryLayout binaryLayout(const Quarternion<T>*){
+  return {BinaryKind::Quarternion, binaryScalar<T>(), 4, 1};
+}
+
+inline const char* binaryKindName(uint32_t kind)
+{
+  switch(BinaryKind(kind)){
+  case BinaryKind::Vector:      return "Vector";
+  case BinaryKind::Matrix:      return "Matrix";
+  case BinaryKind::Quarternion: return "Quarternion";
+  }
+  return "unknown";
+}
+
+inline const char* binaryScalarName(uint32_t scalar)
+{
+  static const char* names[] = { "int8", "uint8", "int16", "uint16", "int32", "uint32",
+                                 "int64", "uint64", "float32", "float64" };
+  return scalar >= 1 && scalar <= 10 ? names[scalar - 1] : "unknown";
+}
+
+inline std::string describe(const BinaryHeader& h)
+{
+  return std::string(binaryKindName(h.kind)) + " " + std::to_string(h.rows) + "x" + std::to_string(h.cols) +
+         " " + binaryScalarName(h.scalar) + " (" + std::to_string(h.itemSize) + " bytes)";
+}
+
+} // namespace detail
+
+/// Header for count items of X, as BinaryWriter writes it
+template<typename X>
+BinaryHeader binaryHeader(uint64_t count)
+{
+  static_assert(std::is_trivially_copyable<X>::value, "Items are stored as raw bytes");
+  static_assert(alignof(X) <= 64, "Items are 64 byte aligned at most");
+
+  detail::BinaryLayout layout = detail::binaryLayout((const X*)nullptr);
+
+  BinaryHeader h;
+  std::memset(&h, 0, sizeof h);
+  std::memcpy(h.magic, "TVMLARR", 8);
+  h.version    = BinaryHeader::Version;
+  h.byteOrder  = BinaryHeader::ByteOrder;
+  h.kind       = uint32_t(layout.kind);
+  h.scalar     = uint32_t(layout.scalar);
+  h.rows       = layout.rows;
+  h.cols       = layout.cols;
+  h.itemSize   = uint32_t(sizeof(X));
+  h.itemAlign  = uint32_t(alignof(X));
+  h.count      = count;
+  h.dataOffset = sizeof(BinaryHeader);
+  return h;
+}
+
+/**
+  Checks the header at `bytes` against X and returns the items that follow
+  it, without copying. size is the number of readable bytes. Throws
+  std::runtime_error if the data is not a complete array of X.
+**/
+template<typename X>
+Span<const X> viewBinary(const void* bytes, size_t size)
+{
+  BinaryHeader want = binaryHeader<X>(0);
+  BinaryHeader h;
+  if(size < sizeof h)
+    throw std::runtime_error("Binary array: truncated header.");
+  std::memcpy(&h, bytes, sizeof h);
+
+  if(std::memcmp(h.magic, want.magic, sizeof h.magic) != 0)
+    throw std::runtime_error("Binary array: not a TVML binary array.");
+  if(h.byteOrder != BinaryHeader::ByteOrder)
+    throw std::runtime_error("Binary array: written with the other byte order.");
+  if(h.version != BinaryHeader::Version)
+    throw std::runtime_error("Binary array: unsupported version " + std::to_string(h.version) + ".");
+  if(h.kind != want.kind || h.scalar != want.scalar || h.rows != want.rows ||
+     h.cols != want.cols || h.itemSize != want.itemSize)
+    throw std::runtime_error("Binary array: holds " + detail::describe(h) +
+                             ", expected " + detail::describe(want) + ".");
+
+  const char* data = static_cast<const char*>(bytes) + h.dataOffset;
+  if(h.dataOffset < sizeof h || h.dataOffset > size ||
+     h.count > (size - h.dataOffset)/sizeof(X))
+    throw std::runtime_error("Binary array: truncated data.");
+  if(reinterpret_cast<uintptr_t>(data) % alignof(X) != 0)
+    throw std::runtime_error("Binary array: data is not aligned for the item type.");
+
+  return Span<const X>(reinterpret_cast<const X*>(data), size_t(h.count));
+}
+
+/**
+  Read only memory map of a binary array file. Opening maps the file and
+  checks the header, the items are used in place. Move only.
+**/
+template<typename X>
+class MappedArray
+{
+public:
+  explicit MappedArray(const std::string& path)
+  {
+    map(path);
+    try{
+      items = viewBinary<X>(base, length);
+    }catch(...){
+      unmap();
+      throw;
+    }
+  }
+
+  MappedArray(MappedArray&& o):base(o.base),length(o.length),items(o.items)
+#if defined(_WIN32)
+    ,mapping(o.mapping)
+#endif
+  {
+    o.base = nullptr;
+  }
+
+  MappedArray& operator=(MappedArray&& o)
+  {
+    if(this != &o){
+      unmap();
+      base = o.base;
+      length = o.length;
+      items = o.items;
+#if defined(_WIN32)
+      mapping = o.mapping;
+#endif
+      o.base = nullptr;
+    }
+    return *this;
+  }
+
+  MappedArray(const MappedArray&) = delete;
+  MappedArray& operator=(const MappedArray&) = delete;
+
+  ~MappedArray(){
+    unmap();
+  }
+
+  const BinaryHeader& header() const { return *static_cast<const BinaryHeader*>(base); }
+
+  Span<const X> span() const { return items; }
+  const X* data()  const { return items.data(); }
+  size_t   size()  const { return items.size(); }
+  const X* begin() const { return items.begin(); }
+  const X* end()   const { return items.end(); }
+  const X& operator[](size_t i) const { return items[i]; }
+
+private:
+  void* base = nullptr;
+  size_t length = 0;
+  Span<const X> items;
+
+#if defined(_WIN32)
+  HANDLE mapping = nullptr;
+
+  void map(const std::string& path)
+  {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("Binary array: cannot open " + path + ".");
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(file, &size) && size.QuadPart >= LONGLONG(sizeof(BinaryHeader)))
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(!mapping)
+      throw std::runtime_error("Binary array: cannot map " + path + ".");
+    base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!base){
+      CloseHandle(mapping);
+      throw std::runtime_error("Binary array: cannot map " + path + ".");
+    }
+    length = size_t(size.QuadPart);
+  }
+
+  void unmap()
+  {
+    if(base){
+      UnmapViewOfFile(base);
+      CloseHandle(mapping);
+      base = nullptr;
+    }
+  }
+#else
+  void map(const std::string& path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+      throw std::runtime_error("Binary array: cannot open " + path + ".");
+    struct stat st;
+    void* p = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(BinaryHeader))
+      p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED)
+      throw std::runtime_error("Binary array: cannot map " + path + ".");
+    base = p;
+    length = size_t(st.st_size);
+  }
+
+  void unmap()
+  {
+    if(base){
+      munmap(base, length);
+      base = nullptr;
+    }
+  }
+#endif
+};
+
+/**
+  Streams items of X to a binary array file. The header goes first with
+  the count left at zero and is rewritten by close(), so a file that was
+  not closed loads as empty rather than truncated. Write errors throw
+  std::runtime_error; the destructor closes without throwing.
+**/
+template<typename X>
+class BinaryWriter
+{
+public:
+  explicit BinaryWriter(const std::string& path)
+    :file(std::fopen(path.c_str(), "wb")),written(0)
+  {
+    if(!file)
+      throw std::runtime_error("Binary array: cannot create " + path + ".");
+    BinaryHeader h = binaryHeader<X>(0);
+    if(std::fwrite(&h, sizeof h, 1, file) != 1){
+      std::fclose(file);
+      throw std::runtime_error("Binary array: cannot write " + path + ".");
+    }
+  }
+
+  BinaryWriter(const BinaryWriter&) = delete;
+  BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+  ~BinaryWriter(){
+    try{ close(); }catch(...){}
+  }
+
+  void write(const X& item){
+    write(&item, 1);
+  }
+  void write(const X* items, size_t n)
+  {
+    if(!file)
+      throw std::runtime_error("Binary array: writer is closed.");
+    if(std::fwrite(items, sizeof(X), n, file) != n)
+      throw std::runtime_error("Binary array: write failed.");
+    written += n;
+  }
+
+  uint64_t count() const { return written; }
+
+  /// Writes the final count and closes the file
+  void close()
+  {
+    if(!file)
+      return;
+    BinaryHeader h = binaryHeader<X>(written);
+    bool ok = std::fflush(file) == 0 && std::fseek(file, 0, SEEK_SET) == 0 &&
+              std::fwrite(&h, sizeof h, 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if(!ok)
+      throw std::runtime_error("Binary array: write failed.");
+  }
+
+private:
+  std::FILE* file;
+  uint64_t written;
+};
+
+/// Writes items[0..n) as one binary array file
+template<typename X>
+void writeBinary(const std::string& path, const X* items, size_t n)
+{
+  BinaryWriter<X> out(path);
+  out.write(items, n);
+  out.close();
+}
+
+} // namespace tvml
+
+#endif // BINARY_H
@@ -0,0 +1,508 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "simd.h"
+#include "parallel.h"
+#include "Vector3.h"
+#include "Vector4.h"
+#include "Matrix4x4.h"
+#include "VectorArray.h"
+#include "Transform.h"
+
+/**
+  Bounding volumes and view frustum culling.
+
+  A Frustum is the six planes of a view-projection matrix, normalized and
+  facing inwards. Boxes are tested against each plane with the corner
+  furthest along the plane normal (the "positive vertex"), spheres with
+  their center distance; an object is culled only when it is completely
+  outside one plane, so a few objects near the frustum corners are kept
+  that a precise test would drop.
+
+  cull() does the same tests over structure-of-arrays bounds, one object
+  per SIMD lane (8 floats per iteration with AVX), and writes a bitmask:
+  bit i%32 of visible[i/32] is set when object i is visible. Results are
+  the same as Frustum::visible() per object.
+**/
+
+namespace tvml
+{
+
+/// Depth range of clip space: OpenGL style -w..w or Direct3D/Vulkan 0..w
+enum class ClipDepth
+{
+  NegativeOneToOne,
+  ZeroToOne
+};
+
+namespace detail
+{
+
+const size_t CULL_GRAIN = 16384;
+
+/**
+  The tests on V = T or a SIMD pack, one object per lane. Plane normals
+  are the same for every lane, so the positive vertex is picked per plane
+  rather than per lane.
+**/
+template<typename V, typename T>
+struct Bounds
+{
+  /// Signed distance of the box's positive vertex from one plane
+  static V boxPlane(const Vector4<T>& p, const V* lo, const V* hi)
+  {
+    V x = p.x > 0 ? hi[0] : lo[0];
+    V y = p.y > 0 ? hi[1] : lo[1];
+    V z = p.z > 0 ? hi[2] : lo[2];
+    return Splat<V,T>::of(p.x)*x + Splat<V,T>::of(p.y)*y + Splat<V,T>::of(p.z)*z + Splat<V,T>::of(p.w);
+  }
+
+  /// Smallest signed distance of the box's positive vertex over the planes, < 0 is outside
+  static V box(const Vector4<T>* planes, const V* lo, const V* hi)
+  {
+    using std::min;
+    using tvml::simd::min;
+    V d = boxPlane(planes[0], lo, hi);
+    for(int k=1; k<6; k++)
+      d = min(d, boxPlane(planes[k], lo, hi));
+    return d;
+  }
+
+  /// Signed distance of the sphere's surface from one plane
+  static V spherePlane(const Vector4<T>& p, const V* c, const V& r)
+  {
+    return Splat<V,T>::of(p.x)*c[0] + Splat<V,T>::of(p.y)*c[1] + Splat<V,T>::of(p.z)*c[2] +
+           Splat<V,T>::of(p.w) + r;
+  }
+
+  /// Smallest signed distance of the sphere's surface over the planes, < 0 is outside
+  static V sphere(const Vector4<T>* planes, const V* c, const V& r)
+  {
+    using std::min;
+    using tvml::simd::min;
+    V d = spherePlane(planes[0], c, r);
+    for(int k=1; k<6; k++)
+      d = min(d, spherePlane(planes[k], c, r));
+    return d;
+  }
+
+  /**
+    Box under an affine row major 4x4 matrix (Arvo): each output axis is
+    the translation plus, per input axis, the smaller and larger of
+    m*lo and m*hi. Exact bounds of the eight transformed corners. out may
+    alias the input.
+  **/
+  static void transform(const T* m, const V* lo, const V* hi, V* outLo, V* outHi)
+  {
+    using std::min;
+    using std::max;
+    using tvml::simd::min;
+    using tvml::simd::max;
+    V a[3], b[3];
+    for(int i=0; i<3; i++){
+      a[i] = b[i] = Splat<V,T>::of(m[i*4 + 3]);
+      for(int j=0; j<3; j++){
+        V s = Splat<V,T>::of(m[i*4 + j]);
+        V e = s*lo[j], f = s*hi[j];
+        a[i] = a[i] + min(e, f);
+        b[i] = b[i] + max(e, f);
+      }
+    }
+    for(int i=0; i<3; i++){
+      outLo[i] = a[i];
+      outHi[i] = b[i];
+    }
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+/// Axis aligned box, min <= max on every axis unless empty
+template<typename T>
+class AABB
+{
+  typedef tvml::detail::Bounds<T,T> Ops;
+public:
+  AABB() = default;
+  constexpr AABB(const Vector3<T>& min, const Vector3<T>& max):min(min),max(max){}
+
+  /// Contains nothing, extend() makes it the first point or box
+  static const
+  AABB Empty;
+
+  Vector3<T> center() const { return (min + max)*T(0.5); }
+  Vector3<T> size() const { return max - min; }
+  /// Half the size
+  Vector3<T> extents() const { return (max - min)*T(0.5); }
+  /// Surface area
+  T area() const{
+    Vector3<T> s = max - min;
+    return 2*(s.x*s.y + s.y*s.z + s.z*s.x);
+  }
+
+  bool empty() const { return !(min.x <= max.x && min.y <= max.y && min.z <= max.z); }
+
+  bool contains(const Vector3<T>& p) const{
+    return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z;
+  }
+  bool intersects(const AABB& b) const{
+    return min.x <= b.max.x && b.min.x <= max.x && min.y <= b.max.y && b.min.y <= max.y &&
+           min.z <= b.max.z && b.min.z <= max.z;
+  }
+
+  void extend(const Vector3<T>& p){
+    for(int k=0; k<3; k++){
+      min[k] = std::min(min[k], p[k]);
+      max[k] = std::max(max[k], p[k]);
+    }
+  }
+  void extend(const AABB& b){
+    for(int k=0; k<3; k++){
+      min[k] = std::min(min[k], b.min[k]);
+      max[k] = std::max(max[k], b.max[k]);
+    }
+  }
+
+  /// Bounds of the box under an affine matrix, without transforming the eight corners
+  AABB transformed(const Matrix4x4<T>& m) const{
+    AABB r;
+    Ops::transform(m.data(), min.data(), max.data(), r.min.data(), r.max.data());
+    return r;
+  }
+  AABB transformed(const Transform<T>& t) const{
+    return transformed(Matrix4x4<T>(t));
+  }
+
+  /// data
+  Vector3<T> min, max;
+};
+
+template<typename T>
+constexpr AABB<T> AABB<T>::Empty = AABB<T>(Vector3<T>(std::numeric_limits<T>::infinity(),
+                                                      std::numeric_limits<T>::infinity(),
+                                                      std::numeric_limits<T>::infinity()),
+                                           Vector3<T>(-std::numeric_limits<T>::infinity(),
+                                                      -std::numeric_limits<T>::infinity(),
+                                                      -std::numeric_limits<T>::infinity()));
+
+template<typename T>
+class Sphere
+{
+public:
+  Sphere() = default;
+  constexpr Sphere(const Vector3<T>& center, const T& radius):center(center),radius(radius){}
+
+  /// Smallest sphere around the box
+  explicit Sphere(const AABB<T>& b):center(b.center()),radius(b.extents().magnitude()){}
+
+  bool contains(const Vector3<T>& p) const{
+    Vector3<T> d = p - center;
+    return d*d <= radius*radius;
+  }
+  bool intersects(const Sphere& s) const{
+    Vector3<T> d = s.center - center;
+    T r = radius + s.radius;
+    return d*d <= r*r;
+  }
+
+  /**
+    Under an affine matrix, a sphere around the image. The radius is scaled
+    by a bound on the 3x3's largest stretch: the largest absolute row sum
+    of its Gram matrix (column dot products), which is at least the largest
+    eigenvalue. With orthogonal columns (rotation and scale) that is exactly
+    the largest axis scale; shear makes it looser but never too small.
+  **/
+  Sphere transformed(const Matrix4x4<T>& m) const{
+    T s = 0;
+    for(int a=0; a<3; a++){
+      T row = 0;
+      for(int b=0; b<3; b++)
+        row += std::abs(m[a]*m[b] + m[4+a]*m[4+b] + m[8+a]*m[8+b]);
+      s = std::max(s, row);
+    }
+    return Sphere(m*center, radius*std::sqrt(s));
+  }
+
+  /// data
+  Vector3<T> center;
+  T radius;
+};
+
+template<typename T>
+class Frustum
+{
+  typedef tvml::detail::Bounds<T,T> Ops;
+public:
+  enum Plane { Left, Right, Bottom, Top, Near, Far };
+
+  Frustum() = default;
+
+  /**
+    Planes of a row major view-projection matrix (clip = m*p), the
+    Gribb/Hartmann extraction. In world space when m is projection*view,
+    in object space when m also includes the model matrix.
+  **/
+  explicit Frustum(const Matrix4x4<T>& m, tvml::ClipDepth depth = tvml::ClipDepth::NegativeOneToOne){
+    Vector4<T> r[4];
+    for(int i=0; i<4; i++)
+      r[i] = Vector4<T>(m[i*4], m[i*4 + 1], m[i*4 + 2], m[i*4 + 3]);
+    planes[Left]   = r[3] + r[0];
+    planes[Right]  = r[3] - r[0];
+    planes[Bottom] = r[3] + r[1];
+    planes[Top]    = r[3] - r[1];
+    planes[Near]   = depth == tvml::ClipDepth::ZeroToOne ? r[2] : r[3] + r[2];
+    planes[Far]    = r[3] - r[2];
+    for(int k=0; k<6; k++){
+      Vector4<T>& p = planes[k];
+      p = p/std::sqrt(p.x*p.x + p.y*p.y + p.z*p.z);
+    }
+  }
+
+  /// Signed distance from a plane, positive inside
+  T distance(Plane k, const Vector3<T>& p) const{
+    return planes[k].x*p.x + planes[k].y*p.y + planes[k].z*p.z + planes[k].w;
+  }
+
+  bool visible(const Vector3<T>& p) const{
+    T r = 0;
+    return !(Ops::sphere(planes, p.data(), r) < 0);
+  }
+  bool visible(const AABB<T>& b) const{
+    return !(Ops::box(planes, b.min.data(), b.max.data()) < 0);
+  }
+  bool visible(const Sphere<T>& s) const{
+    return !(Ops::sphere(planes, s.center.data(), s.radius) < 0);
+  }
+
+  /// data: (normal, d) per Plane, normal.p + d >= 0 inside, |normal| = 1
+  Vector4<T> planes[6];
+};
+
+/// Structure of arrays boxes for cull() and transformBoxes()
+template<typename T>
+class AABBArray
+{
+public:
+  AABBArray(){}
+  explicit AABBArray(size_t n):min(n),max(n){}
+
+  AABBArray(const AABB<T>* b, size_t n):min(n),max(n){
+    for(size_t i=0; i<n; i++)
+      set(i, b[i]);
+  }
+
+  size_t size() const { return min.size(); }
+
+  void resize(size_t n){ min.resize(n); max.resize(n); }
+  void reserve(size_t n){ min.reserve(n); max.reserve(n); }
+
+  void push_back(const AABB<T>& b){
+    min.push_back(b.min); max.push_back(b.max);
+  }
+
+  /// Element access (gathers / scatters one box)
+  AABB<T> operator [] (size_t i) const{
+    return AABB<T>(min[i], max[i]);
+  }
+  void set(size_t i, const AABB<T>& b){
+    min.set(i, b.min); max.set(i, b.max);
+  }
+
+  /// data
+  Vector3Array<T> min, max;
+};
+
+/// Structure of arrays spheres for cull()
+template<typename T>
+class SphereArray
+{
+public:
+  SphereArray(){}
+  explicit SphereArray(size_t n):center(n),radius(n){}
+
+  SphereArray(const Sphere<T>* s, size_t n):center(n),radius(n){
+    for(size_t i=0; i<n; i++)
+      set(i, s[i]);
+  }
+
+  size_t size() const { return radius.size(); }
+
+  void resize(size_t n){ center.resize(n); radius.resize(n); }
+  void reserve(size_t n){ center.reserve(n); radius.reserve(n); }
+
+  void push_back(const Sphere<T>& s){
+    center.push_back(s.center); radius.push_back(s.radius);
+  }
+
+  /// Element access (gathers / scatters one sphere)
+  Sphere<T> operator [] (size_t i) const{
+    return Sphere<T>(center[i], radius[i]);
+  }
+  void set(size_t i, const Sphere<T>& s){
+    center.set(i, s.center); radius[i] = s.radius;
+  }
+
+  /// data
+  Vector3Array<T> center;
+  std::vector<T> radius;
+};
+
+namespace tvml
+{
+namespace detail
+{
+
+/// Sets the visible bits of lanes [i, i+width), bits starts at a multiple of 32 objects
+template<class P>
+inline void visibleBits(uint32_t* bits, size_t i, const P& d)
+{
+  uint32_t outside = uint32_t(simd::movemask(simd::cmplt(d, P::set1(0))));
+  uint32_t lanes = uint32_t((uint64_t(1) << P::width) - 1);
+  bits[i/32] |= (~outside & lanes) << (i%32);
+}
+
+template<typename T>
+struct CullBoxKernel
+{
+  const Vector4<T>* planes;
+  const T *lx,*ly,*lz,*hx,*hy,*hz;
+  uint32_t* bits;
+
+  template<class P> void apply(size_t i) const{
+    P lo[3] = { P::load(lx+i), P::load(ly+i), P::load(lz+i) };
+    P hi[3] = { P::load(hx+i), P::load(hy+i), P::load(hz+i) };
+    visibleBits(bits, i, Bounds<P,T>::box(planes, lo, hi));
+  }
+};
+
+template<typename T>
+struct CullSphereKernel
+{
+  const Vector4<T>* planes;
+  const T *x,*y,*z,*r;
+  uint32_t* bits;
+
+  template<class P> void apply(size_t i) const{
+    P c[3] = { P::load(x+i), P::load(y+i), P::load(z+i) };
+    visibleBits(bits, i, Bounds<P,T>::sphere(planes, c, P::load(r+i)));
+  }
+};
+
+template<typename T>
+struct TransformBoxKernel
+{
+  const T* m;
+  const T *lx,*ly,*lz,*hx,*hy,*hz;
+  T *olx,*oly,*olz,*ohx,*ohy,*ohz;
+
+  template<class P> void apply(size_t i) const{
+    P lo[3] = { P::load(lx+i), P::load(ly+i), P::load(lz+i) };
+    P hi[3] = { P::load(hx+i), P::load(hy+i), P::load(hz+i) };
+    P a[3], b[3];
+    Bounds<P,T>::transform(m, lo, hi, a, b);
+    a[0].store(olx+i); a[1].store(oly+i); a[2].store(olz+i);
+    b[0].store(ohx+i); b[1].store(ohy+i); b[2].store(ohz+i);
+  }
+};
+
+/// Runs f(begin, end, words) over whole 32 object words, so threads never share one
+template<typename F>
+inline void cullWords(size_t n, uint32_t* visible, unsigned threads, const F& f)
+{
+  size_t words = (n + 31)/32;
+  tvml::parallel_for(words, CULL_GRAIN/32, threads, [&](size_t wb, size_t we){
+    std::fill(visible + wb, visible + we, uint32_t(0));
+    f(wb*32, std::min(n, we*32), visible + wb);
+  });
+}
+
+} // namespace detail
+} // namespace tvml
+
+/// Words needed for the visibility mask of n objects
+inline size_t cullMaskWords(size_t n)
+{
+  return (n + 31)/32;
+}
+
+/**
+  Frustum culling, bit i%32 of visible[i/32] set when boxes[i] is visible
+  (the same answer as f.visible(boxes[i])). visible holds cullMaskWords(n)
+  words; bits past the last box are cleared.
+**/
+template<typename T>
+void cull(const Frustum<T>& f, const AABBArray<T>& boxes, uint32_t* visible, unsigned threads = 1)
+{
+  const Vector3Array<T> &lo = boxes.min, &hi = boxes.max;
+  tvml::detail::cullWords(boxes.size(), visible, threads, [&](size_t begin, size_t end, uint32_t* bits){
+    tvml::detail::CullBoxKernel<T> k = { f.planes,
+        lo.x.data() + begin, lo.y.data() + begin, lo.z.data() + begin,
+        hi.x.data() + begin, hi.y.data() + begin, hi.z.data() + begin, bits };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+/// Spheres, see above
+template<typename T>
+void cull(const Frustum<T>& f, const SphereArray<T>& spheres, uint32_t* visible, unsigned threads = 1)
+{
+  const Vector3Array<T>& c = spheres.center;
+  tvml::detail::cullWords(spheres.size(), visible, threads, [&](size_t begin, size_t end, uint32_t* bits){
+    tvml::detail::CullSphereKernel<T> k = { f.planes,
+        c.x.data() + begin, c.y.data() + begin, c.z.data() + begin, spheres.radius.data() + begin, bits };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+/// out[i] = in[i].transformed(m), m affine. out may be in.
+template<typename T>
+void transformBoxes(const Matrix4x4<T>& m, const AABBArray<T>& in, AABBArray<T>& out, unsigned threads = 1)
+{
+  out.resize(in.size());
+  const Vector3Array<T> &lo = in.min, &hi = in.max;
+  Vector3Array<T> &olo = out.min, &ohi = out.max;
+  tvml::parallel_for(in.size(), tvml::detail::CULL_GRAIN, threads, [&](size_t begin, size_t end){
+    tvml::detail::TransformBoxKernel<T> k = { m.data(),
+        lo.x.data() + begin, lo.y.data() + begin, lo.z.data() + begin,
+        hi.x.data() + begin, hi.y.data() + begin, hi.z.data() + begin,
+        olo.x.data() + begin, olo.y.data() + begin, olo.z.data() + begin,
+        ohi.x.data() + begin, ohi.y.data() + begin, ohi.z.data() + begin };
+    tvml::simd::run<T>(end - begin, k);
+  });
+}
+
+typedef AABB<float>     AABBf;
+typedef AABB<double>    AABBd;
+typedef Sphere<float>   Spheref;
+typedef Sphere<double>  Sphered;
+typedef Frustum<float>  Frustumf;
+typedef Frustum<double> Frustumd;
+#endif // BOUNDS_H
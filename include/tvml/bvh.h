@@ -0,0 +1,496 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounds.h"
+#include "parallel.h"
+#include "ray.h"
+#include "span.h"
+#include "Vector3.h"
+
+/**
+  Bounding volume hierarchy over triangles, for closest hit and any hit
+  ray queries.
+
+  The build bins triangle centroids into 16 slots per axis and splits
+  where the surface area heuristic is lowest. Large nodes are binned
+  across threads and the two halves of a split are built on separate
+  threads, so the tree is the same for any thread count (only the order
+  of nodes in memory differs).
+
+  Nodes are 32 bytes for float: bounds plus two indices. Siblings are
+  stored next to each other, so an inner node only needs its first
+  child. Triangles are copied into leaf order as a vertex and two edges,
+  each leaf's triangles contiguous.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+const int BVH_BINS = 16;
+const uint32_t BVH_MAX_LEAF = 8;
+const size_t BVH_BIN_GRAIN = 32768;    // triangles per thread when binning one node
+const size_t BVH_TASK_GRAIN = 4096;    // smallest subtree worth its own thread
+const unsigned BVH_MAX_DEPTH = 64;     // then median splits, at most 32 more levels
+const size_t BVH_QUERY_GRAIN = 256;    // rays per thread for the batched queries
+
+template<typename T>
+struct BVHTriangle
+{
+  Vector3<T> a, e1, e2;
+};
+
+/**
+  Slab test against [tmin, tmax]. NaNs, from an origin on a slab of a
+  direction parallel to it, are ignored rather than taken as a miss.
+**/
+template<typename T>
+inline bool enterBox(const Vector3<T>& bmin, const Vector3<T>& bmax, const Vector3<T>& o,
+                     const Vector3<T>& inv, T tmin, T tmax, T& entry)
+{
+  for(int k=0; k<3; k++){
+    T t0 = (bmin[k] - o[k])*inv[k], t1 = (bmax[k] - o[k])*inv[k];
+    T lo = t1 < t0 ? t1 : t0, hi = t1 < t0 ? t0 : t1;
+    if(lo > tmin) tmin = lo;
+    if(hi < tmax) tmax = hi;
+  }
+  entry = tmin;
+  return tmin <= tmax;
+}
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class BVH
+{
+  typedef tvml::detail::BVHTriangle<T> Triangle;
+public:
+  struct Node
+  {
+    bool leaf() const { return count != 0; }
+
+    /// data: offset is the first triangle of a leaf, or the first of two children
+    Vector3<T> min;
+    uint32_t offset;
+    Vector3<T> max;
+    uint32_t count;  // triangles, 0 for inner nodes
+  };
+
+  BVH(){}
+
+  /// Indexed mesh: triangle i is vertices[indices[3i]], [3i+1], [3i+2]
+  BVH(const Vector3<T>* vertices, const uint32_t* indices, size_t triangles, unsigned threads = 1){
+    build(vertices, indices, triangles, threads);
+  }
+  /// Triangle soup: triangle i is vertices[3i], [3i+1], [3i+2]
+  BVH(const Vector3<T>* vertices, size_t triangles, unsigned threads = 1){
+    build(vertices, nullptr, triangles, threads);
+  }
+
+  /// Rebuilds from scratch; indices may be null for a triangle soup
+  void build(const Vector3<T>* vertices, const uint32_t* indices, size_t triangles, unsigned threads = 1)
+  {
+    assert(triangles < Hit<T>::NONE);
+    const size_t n = triangles;
+    nodeList.clear();
+    tris.clear();
+    ids.clear();
+    if(n == 0)
+      return;
+
+    std::vector<Ref> refs(n);
+    ids.resize(n);
+    tris.resize(n);
+    tvml::parallel_for(n, tvml::detail::BVH_BIN_GRAIN, threads, [&](size_t begin, size_t end){
+      for(size_t i=begin; i<end; i++){
+        const Vector3<T>& a = corner(vertices, indices, i, 0);
+        refs[i].box = AABB<T>(a, a);
+        refs[i].box.extend(corner(vertices, indices, i, 1));
+        refs[i].box.extend(corner(vertices, indices, i, 2));
+        refs[i].id = uint32_t(i);
+      }
+    });
+
+    nodeList.resize(2*n - 1);
+    Builder b = { refs.data(), nodeList.data(), {1} };
+    Span all = b.bounds(0, uint32_t(n), threads);
+    b.split(0, 0, uint32_t(n), all, 0, tvml::threadCount(threads));
+    nodeList.resize(b.used);
+
+    tvml::parallel_for(n, tvml::detail::BVH_BIN_GRAIN, threads, [&](size_t begin, size_t end){
+      for(size_t i=begin; i<end; i++){
+        uint32_t id = refs[i].id;
+        const Vector3<T>& a = corner(vertices, indices, id, 0);
+        ids[i] = id;
+        tris[i].a = a;
+        tris[i].e1 = corner(vertices, indices, id, 1) - a;
+        tris[i].e2 = corner(vertices, indices, id, 2) - a;
+      }
+    });
+  }
+
+  size_t size() const { return tris.size(); }
+  bool empty() const { return tris.empty(); }
+
+  /// Root first, then sibling pairs
+  tvml::Span<const Node> nodes() const{
+    return tvml::Span<const Node>(nodeList.data(), nodeList.size());
+  }
+  /// Original index of the triangle at leaf position i
+  uint32_t triangleId(size_t i) const { return ids[i]; }
+
+  AABB<T> bounds() const{
+    return empty() ? AABB<T>::Empty : AABB<T>(nodeList[0].min, nodeList[0].max);
+  }
+
+  /// Nearest hit in [tmin, tmax); triangle is Hit::NONE on a miss
+  Hit<T> closestHit(const Ray<T>& r) const
+  {
+    Hit<T> h;
+    h.t = r.tmax; h.u = 0; h.v = 0;
+    h.triangle = Hit<T>::NONE;
+    traverse<false>(r, h);
+    return h;
+  }
+
+  /// Whether anything is hit in [tmin, tmax), e.g. for shadows and line of sight
+  bool anyHit(const Ray<T>& r) const
+  {
+    Hit<T> h;
+    h.t = r.tmax;
+    h.triangle = Hit<T>::NONE;
+    traverse<true>(r, h);
+    return bool(h);
+  }
+
+private:
+  static const Vector3<T>& corner(const Vector3<T>* v, const uint32_t* idx, size_t i, int k){
+    return idx ? v[idx[3*i + k]] : v[3*i + k];
+  }
+
+  /// Triangle bounds, moved around by the build instead of indices so it reads memory in order
+  struct Ref
+  {
+    T center(int a) const { return (box.min[a] + box.max[a])*T(0.5); }
+
+    AABB<T> box;
+    uint32_t id;
+  };
+
+  /// Bounds of some triangles and of their centroids
+  struct Span
+  {
+    AABB<T> box, centers;
+
+    static Span empty(){ Span s = { AABB<T>::Empty, AABB<T>::Empty }; return s; }
+    void add(const Span& s){ box.extend(s.box); centers.extend(s.centers); }
+  };
+
+  struct Bin
+  {
+    AABB<T> box;
+    uint32_t count;
+  };
+
+  struct Builder
+  {
+    Ref* refs;
+    Node* nodes;
+    std::atomic<uint32_t> used;
+
+    Span bounds(uint32_t first, uint32_t count, unsigned threads) const{
+      Span all = Span::empty();
+      std::mutex lock;
+      tvml::parallel_for(count, tvml::detail::BVH_BIN_GRAIN, threads, [&](size_t begin, size_t end){
+        Span s = Span::empty();
+        for(size_t i=first + begin; i<first + end; i++){
+          s.box.extend(refs[i].box);
+          s.centers.extend(refs[i].box.center());
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        all.add(s);
+      });
+      return all;
+    }
+
+    static int binOf(T c, T lo, T scale){
+      int k = int((c - lo)*scale);
+      return std::min(std::max(k, 0), tvml::detail::BVH_BINS - 1);
+    }
+
+    void binRange(size_t begin, size_t end, const AABB<T>& cb, const T* scale,
+                  Bin (*bins)[tvml::detail::BVH_BINS]) const{
+      for(size_t i=begin; i<end; i++){
+        const Ref& r = refs[i];
+        for(int a=0; a<3; a++){
+          Bin& b = bins[a][binOf(r.center(a), cb.min[a], scale[a])];
+          b.box.extend(r.box);
+          b.count++;
+        }
+      }
+    }
+
+    // bins of all three axes in one pass; min/max and counts merge the same in any order
+    void fill(uint32_t first, uint32_t count, const AABB<T>& cb, const T* scale,
+              Bin (*bins)[tvml::detail::BVH_BINS], unsigned threads) const{
+      const int B = tvml::detail::BVH_BINS;
+      const Bin none = { AABB<T>::Empty, 0 };
+      for(int a=0; a<3; a++)
+        std::fill(bins[a], bins[a] + B, none);
+      if(count <= tvml::detail::BVH_BIN_GRAIN || threads == 1){
+        binRange(first, first + count, cb, scale, bins);
+        return;
+      }
+      std::mutex lock;
+      tvml::parallel_for(count, tvml::detail::BVH_BIN_GRAIN, threads, [&](size_t begin, size_t end){
+        Bin local[3][tvml::detail::BVH_BINS];
+        for(int a=0; a<3; a++)
+          std::fill(local[a], local[a] + B, none);
+        binRange(first + begin, first + end, cb, scale, local);
+        std::lock_guard<std::mutex> guard(lock);
+        for(int a=0; a<3; a++)
+          for(int k=0; k<B; k++){
+            bins[a][k].box.extend(local[a][k].box);
+            bins[a][k].count += local[a][k].count;
+          }
+      });
+    }
+
+    void leaf(uint32_t node, uint32_t first, uint32_t count){
+      nodes[node].offset = first;
+      nodes[node].count = count;
+    }
+
+    void split(uint32_t node, uint32_t first, uint32_t count, const Span& all, unsigned depth, unsigned threads)
+    {
+      const int B = tvml::detail::BVH_BINS;
+      nodes[node].min = all.box.min;
+      nodes[node].max = all.box.max;
+      if(count == 1)
+        return leaf(node, first, count);
+
+      Vector3<T> extent = all.centers.size();
+      int axis = -1, at = 0;
+      T scale[3];
+      if(depth < tvml::detail::BVH_MAX_DEPTH && (extent.x > 0 || extent.y > 0 || extent.z > 0)){
+        for(int a=0; a<3; a++)
+          scale[a] = extent[a] > 0 ? B/extent[a] : 0;
+        Bin bins[3][tvml::detail::BVH_BINS];
+        fill(first, count, all.centers, scale, bins, threads);
+
+        // cost relative to intersecting one triangle, traversal step = 1
+        T area = all.box.area(), best = T(count);
+        if(!(area > 0))
+          area = 1;
+        for(int a=0; a<3; a++){
+          if(!(extent[a] > 0))
+            continue;
+          T rightArea[tvml::detail::BVH_BINS];
+          uint32_t rightCount[tvml::detail::BVH_BINS];
+          AABB<T> box = AABB<T>::Empty;
+          uint32_t n = 0;
+          for(int k=B-1; k>0; k--){
+            if(bins[a][k].count){
+              box.extend(bins[a][k].box);
+              n += bins[a][k].count;
+            }
+            rightArea[k] = n ? box.area() : 0;
+            rightCount[k] = n;
+          }
+          box = AABB<T>::Empty;
+          n = 0;
+          for(int k=1; k<B; k++){
+            if(bins[a][k-1].count == 0 && k > 1)
+              continue;  // same split as at k-1
+            box.extend(bins[a][k-1].box);
+            n += bins[a][k-1].count;
+            if(n == 0 || rightCount[k] == 0)
+              continue;
+            T cost = 1 + (box.area()*n + rightArea[k]*rightCount[k])/area;
+            if(cost < best){
+              best = cost; axis = a; at = k;
+            }
+          }
+        }
+        if(axis < 0 && count <= tvml::detail::BVH_MAX_LEAF)
+          return leaf(node, first, count);
+      }else if(count <= tvml::detail::BVH_MAX_LEAF)
+        return leaf(node, first, count);
+
+      uint32_t half;
+      Span left = Span::empty(), right = Span::empty();
+      if(axis >= 0 && count > tvml::detail::BVH_BIN_GRAIN && threads > 1){
+        T lo = all.centers.min[axis];
+        Ref* mid = std::partition(refs + first, refs + first + count, [&](const Ref& r){
+          return binOf(r.center(axis), lo, scale[axis]) < at;
+        });
+        half = uint32_t(mid - (refs + first));
+        left = bounds(first, half, threads);
+        right = bounds(first + half, count - half, threads);
+      }else if(axis >= 0){
+        // partition and bound both sides in one pass
+        T lo = all.centers.min[axis];
+        Ref *i = refs + first, *j = refs + first + count;
+        for(;;){
+          while(i < j && binOf(i->center(axis), lo, scale[axis]) < at){
+            left.box.extend(i->box);
+            left.centers.extend(i->box.center());
+            i++;
+          }
+          while(i < j && !(binOf((j-1)->center(axis), lo, scale[axis]) < at)){
+            j--;
+            right.box.extend(j->box);
+            right.centers.extend(j->box.center());
+          }
+          if(i == j)
+            break;
+          std::swap(*i, *(j-1));
+        }
+        half = uint32_t(i - (refs + first));
+      }else{
+        // no useful plane (too deep, or the centroids coincide): split at the median
+        int a = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+        half = count/2;
+        std::nth_element(refs + first, refs + first + half, refs + first + count, [&](const Ref& p, const Ref& q){
+          return p.center(a) < q.center(a);
+        });
+        left = bounds(first, half, threads);
+        right = bounds(first + half, count - half, threads);
+      }
+
+      uint32_t child = used.fetch_add(2);
+      nodes[node].offset = child;
+      nodes[node].count = 0;
+      if(threads > 1 && count > tvml::detail::BVH_TASK_GRAIN){
+        unsigned lt = threads/2;
+        std::thread t([this, child, first, half, left, depth, lt]{ split(child, first, half, left, depth + 1, lt); });
+        split(child + 1, first + half, count - half, right, depth + 1, threads - lt);
+        t.join();
+      }else{
+        split(child, first, half, left, depth + 1, threads);
+        split(child + 1, first + half, count - half, right, depth + 1, threads);
+      }
+    }
+  };
+
+  template<bool ANY>
+  void traverse(const Ray<T>& r, Hit<T>& h) const
+  {
+    if(empty())
+      return;
+    const Vector3<T> &o = r.origin, &d = r.direction;
+    Vector3<T> inv(1/d.x, 1/d.y, 1/d.z);
+    T entry;
+    if(!tvml::detail::enterBox(nodeList[0].min, nodeList[0].max, o, inv, r.tmin, h.t, entry))
+      return;
+
+    struct Pending { uint32_t node; T entry; };
+    Pending stack[2*tvml::detail::BVH_MAX_DEPTH];
+    int top = 0;
+    uint32_t n = 0;
+    for(;;){
+      const Node& node = nodeList[n];
+      if(node.leaf()){
+        for(uint32_t i=node.offset; i<node.offset + node.count; i++){
+          const Triangle& tri = tris[i];
+          T t, u, v;
+          if(intersectTriangle(o, d, tri.a, tri.e1, tri.e2, r.tmin, h.t, t, u, v)){
+            h.t = t; h.u = u; h.v = v;
+            h.triangle = ids[i];
+            if(ANY)
+              return;
+          }
+        }
+      }else{
+        uint32_t a = node.offset, b = a + 1;
+        T ea, eb;
+        bool ha = tvml::detail::enterBox(nodeList[a].min, nodeList[a].max, o, inv, r.tmin, h.t, ea);
+        bool hb = tvml::detail::enterBox(nodeList[b].min, nodeList[b].max, o, inv, r.tmin, h.t, eb);
+        if(ha && hb){
+          // nearer child first, the other waits
+          if(eb < ea){
+            std::swap(a, b);
+            std::swap(ea, eb);
+          }
+          stack[top].node = b;
+          stack[top].entry = eb;
+          top++;
+          n = a;
+          continue;
+        }
+        if(ha || hb){
+          n = ha ? a : b;
+          continue;
+        }
+      }
+      // next waiting node that a hit found meanwhile hasn't ruled out
+      do{
+        if(top == 0)
+          return;
+        top--;
+      }while(!(stack[top].entry < h.t));
+      n = stack[top].node;
+    }
+  }
+
+  std::vector<Node> nodeList;
+  std::vector<Triangle> tris;
+  std::vector<uint32_t> ids;
+};
+
+static_assert(sizeof(BVH<float>::Node) == 32, "BVH nodes are 32 bytes");
+
+/// hits[i] = bvh.closestHit(rays[i])
+template<typename T>
+void closestHits(const BVH<T>& bvh, const Ray<T>* rays, Hit<T>* hits, size_t n, unsigned threads = 1)
+{
+  tvml::parallel_for(n, tvml::detail::BVH_QUERY_GRAIN, threads, [&](size_t begin, size_t end){
+    for(size_t i=begin; i<end; i++)
+      hits[i] = bvh.closestHit(rays[i]);
+  });
+}
+
+/// hit[i] = bvh.anyHit(rays[i])
+template<typename T>
+void anyHits(const BVH<T>& bvh, const Ray<T>* rays, uint8_t* hit, size_t n, unsigned threads = 1)
+{
+  tvml::parallel_for(n, tvml::detail::BVH_QUERY_GRAIN, threads, [&](size_t begin, size_t end){
+    for(size_t i=begin; i<end; i++)
+      hit[i] = bvh.anyHit(rays[i]);
+  });
+}
+
+typedef BVH<float>  BVHf;
+typedef BVH<double> BVHd;
+#endif // BVH_H
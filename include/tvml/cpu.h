@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CPU_H
+#define CPU_H
+
+/**
+  Runtime CPU feature detection.
+
+  Kernels that are worth picking per machine are compiled with
+  TVML_TARGET("avx") etc. and selected once through tvml::cpu::features(),
+  so a binary built for plain x86-64 still uses AVX where it is there.
+  Only GCC and Clang on x86 dispatch at runtime; everything else uses
+  whatever the compiler flags allow (see simd.h).
+**/
+
+#if !defined(TVML_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#  define TVML_DISPATCH 1
+#  define TVML_TARGET(isa) __attribute__((target(isa)))
+#  include <immintrin.h>
+#  include <cpuid.h>
+#endif
+
+namespace tvml
+{
+namespace cpu
+{
+
+struct Features
+{
+  bool sse2;
+  bool avx;
+  bool avx2;
+  bool fma;
+  bool f16c;
+  bool avx512f;
+};
+
+inline Features detect()
+{
+  Features f = {false, false, false, false, false, false};
+#if defined(TVML_DISPATCH)
+  __builtin_cpu_init();
+  f.sse2    = __builtin_cpu_supports("sse2");
+  f.avx     = __builtin_cpu_supports("avx");
+  f.avx2    = __builtin_cpu_supports("avx2");
+  f.fma     = __builtin_cpu_supports("fma");
+  f.avx512f = __builtin_cpu_supports("avx512f");
+  // no builtin for f16c, read the cpuid bit (needs OS AVX state too)
+  unsigned a, b, c, d;
+  f.f16c    = f.avx && __get_cpuid(1, &a, &b, &c, &d) && (c & bit_F16C);
+#endif
+  return f;
+}
+
+/// Detected once, on first use.
+inline const Features& features()
+{
+  static const Features f = detect();
+  return f;
+}
+
+} // namespace cpu
+} // namespace tvml
+
+#endif // CPU_H
@@ -0,0 +1,264 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "Vector2.h"
+#include "Vector3.h"
+#include "Vector4.h"
+#include "Matrix3x3.h"
+#include "Matrix4x4.h"
+
+/**
+  Opt-in expression templates for element-wise arithmetic.
+
+  Wrap operands in tvml::lazy() and the whole expression is evaluated in
+  a single loop when it is converted back to a vector or matrix:
+
+    mat4 r = lazy(a)*s + lazy(b)*t - c;
+
+  Covered are the element-wise operators: + and - between values of the
+  same shape, unary -, and * and / by an arithmetic scalar. Each node
+  rounds to the element type of its left operand exactly like the eager
+  operator does, so results are bit-identical to the eager expression
+  (FP contraction permitting, as everywhere else).
+
+  Expressions hold references to their operands: convert them within the
+  full expression, don't keep them in auto variables. Assigning back to
+  an operand (a = lazy(a)*s + b) is fine, the result is built first.
+**/
+
+namespace tvml
+{
+
+template<typename N> class Expr;
+
+namespace detail
+{
+
+/// Element type, element count and scalar operand type of the value types
+/// lazy() accepts.
+template<typename V>
+struct Shape { enum { size = 0 }; };
+
+template<typename T, int N> struct Shape< Vector<T,N> >
+{
+  typedef T value_type; enum { size = N };
+  template<typename S> struct scalar { typedef S type; };
+};
+template<typename T, int R, int C> struct Shape< Matrix<T,R,C> >
+{
+  typedef T value_type; enum { size = R*C };
+  template<typename S> struct scalar { typedef S type; };
+};
+
+template<typename A, typename B> struct SameShape : std::false_type {};
+template<typename T, typename X, int N>
+struct SameShape< Vector<T,N>, Vector<X,N> > : std::true_type {};
+template<typename T, typename X, int R, int C>
+struct SameShape< Matrix<T,R,C>, Matrix<X,R,C> > : std::true_type {};
+
+/// Element-wise operations are Neg, Add, Sub, Mul and Div from Vector.h
+
+/// Expression nodes. result_type is what the eager operator returns,
+/// operator[] yields element i already rounded to its value_type.
+template<typename V>
+struct Leaf
+{
+  typedef V result_type;
+  typedef typename Shape<V>::value_type value_type;
+
+  value_type operator[](uint32_t i) const { return v[i]; }
+
+  const V& v;
+};
+
+template<typename E, typename Op>
+struct Unary
+{
+  typedef typename E::result_type result_type;
+  typedef typename E::value_type value_type;
+
+  value_type operator[](uint32_t i) const { return value_type(Op::apply(e[i])); }
+
+  E e;
+};
+
+template<typename L, typename R, typename Op>
+struct Binary
+{
+  static_assert(SameShape<typename L::result_type, typename R::result_type>::value,
+                "Element-wise operands must have the same shape");
+
+  typedef typename L::result_type result_type;
+  typedef typename L::value_type value_type;
+
+  value_type operator[](uint32_t i) const { return value_type(Op::apply(l[i], r[i])); }
+
+  L l;
+  R r;
+};
+
+template<typename E, typename S, typename Op>
+struct Scalar
+{
+  typedef typename E::result_type result_type;
+  typedef typename E::value_type value_type;
+
+  value_type operator[](uint32_t i) const { return value_type(Op::apply(e[i], s)); }
+
+  E e;
+  S s;
+};
+
+/// Maps an operand to its node: Expr<N> to N, a value to Leaf<V>.
+template<typename X, typename = void>
+struct Node {};
+
+template<typename V>
+struct Node<V, typename std::enable_if<(Shape<V>::size > 0)>::type>
+{
+  typedef Leaf<V> type;
+  static type get(const V& v){ type l = {v}; return l; }
+};
+
+template<typename N>
+struct Node< Expr<N> >
+{
+  typedef N type;
+  static const N& get(const Expr<N>& e){ return e.node; }
+};
+
+template<typename X> struct IsExpr : std::false_type {};
+template<typename N> struct IsExpr< Expr<N> > : std::true_type {};
+
+/// a op b, where at least one side is already an expression
+template<typename A, typename B, typename Op, typename = void>
+struct Lazy2 {};
+
+template<typename A, typename B, typename Op>
+struct Lazy2<A, B, Op, typename std::enable_if<
+    (IsExpr<A>::value || IsExpr<B>::value) &&
+    (IsExpr<A>::value || (Shape<A>::size > 0)) &&
+    (IsExpr<B>::value || (Shape<B>::size > 0))>::type>
+{
+  typedef Binary<typename Node<A>::type, typename Node<B>::type, Op> node_type;
+  typedef Expr<node_type> type;
+
+  static type make(const A& a, const B& b){
+    node_type n = {Node<A>::get(a), Node<B>::get(b)};
+    return type(n);
+  }
+};
+
+/// e op s
+template<typename N, typename S, typename Op, typename = void>
+struct LazyScalar {};
+
+template<typename N, typename S, typename Op>
+struct LazyScalar<N, S, Op, typename std::enable_if<tvml::IsScalar<S>::value>::type>
+{
+  typedef typename Shape<typename N::result_type>::template scalar<S>::type scalar_type;
+  typedef Scalar<N, scalar_type, Op> node_type;
+  typedef Expr<node_type> type;
+
+  static type make(const Expr<N>& e, const S& s){
+    node_type n = {e.node, scalar_type(s)};
+    return type(n);
+  }
+};
+
+} // namespace detail
+
+/// An unevaluated element-wise expression, converts to its result_type.
+template<typename N>
+class Expr
+{
+public:
+  typedef typename N::result_type result_type;
+  typedef typename N::value_type value_type;
+  enum { size = detail::Shape<result_type>::size };
+
+  explicit Expr(const N& node):node(node){}
+
+  value_type operator[](uint32_t i) const { return node[i]; }
+
+  result_type eval() const
+  {
+    result_type ret;
+    // fully unrolled, the vectorizer then treats it like the eager code
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 16
+#endif
+    for(uint32_t i=0; i<size; i++)
+      ret[i] = node[i];
+    return ret;
+  }
+  operator result_type() const { return eval(); }
+
+  N node;
+};
+
+/// Starts an expression
+template<typename V>
+Expr< detail::Leaf<V> > lazy(const V& v,
+    typename std::enable_if<(detail::Shape<V>::size > 0)>::type* = 0)
+{
+  return Expr< detail::Leaf<V> >(detail::Node<V>::get(v));
+}
+
+/// Math operators
+template<typename N>
+Expr< detail::Unary<N, detail::Neg> > operator-(const Expr<N>& e)
+{
+  detail::Unary<N, detail::Neg> n = {e.node};
+  return Expr< detail::Unary<N, detail::Neg> >(n);
+}
+
+template<typename A, typename B>
+typename detail::Lazy2<A, B, detail::Add>::type operator+(const A& a, const B& b)
+{
+  return detail::Lazy2<A, B, detail::Add>::make(a, b);
+}
+
+template<typename A, typename B>
+typename detail::Lazy2<A, B, detail::Sub>::type operator-(const A& a, const B& b)
+{
+  return detail::Lazy2<A, B, detail::Sub>::make(a, b);
+}
+
+template<typename N, typename S>
+typename detail::LazyScalar<N, S, detail::Mul>::type operator*(const Expr<N>& e, const S& s)
+{
+  return detail::LazyScalar<N, S, detail::Mul>::make(e, s);
+}
+
+template<typename N, typename S>
+typename detail::LazyScalar<N, S, detail::Div>::type operator/(const Expr<N>& e, const S& s)
+{
+  return detail::LazyScalar<N, S, detail::Div>::make(e, s);
+}
+
+} // namespace tvml
+#endif // EXPR_H
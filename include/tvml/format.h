@@ -0,0 +1,259 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#  if __has_include(<charconv>)
+#    include <charconv>
+#  endif
+#endif
+
+/**
+  Allocation free number formatting behind Printable::format_to and
+  operator<<.
+
+  With C++17 library support (__cpp_lib_to_chars) elements go through
+  std::to_chars, otherwise through snprintf into a stack buffer; both give
+  the same text for General and Fixed. Shortest is the shortest string
+  that reads back to the same value: to_chars picks between fixed and
+  scientific notation by length, the snprintf path always uses %g style,
+  so the two may differ in notation but never in value.
+
+  Precision is clamped to [0, 40]. long double is formatted as double,
+  half (half.h) as float. Integers ignore the precision.
+**/
+
+class half;
+
+namespace tvml
+{
+
+enum class Notation
+{
+  General,  // %g: `precision` significant digits
+  Fixed,    // %f: `precision` digits after the point
+  Shortest  // shortest round trip
+};
+
+struct FormatSpec
+{
+  Notation notation;
+  int precision;
+
+  static constexpr FormatSpec general(int precision){ return {Notation::General, precision}; }
+  static constexpr FormatSpec fixed(int precision){ return {Notation::Fixed, precision}; }
+  static constexpr FormatSpec shortest(){ return {Notation::Shortest, 0}; }
+};
+
+/// Like std::to_chars_result. ptr is one past the last character written;
+/// when ok is false the buffer was too small and the text is cut short.
+struct FormatResult
+{
+  char* ptr;
+  bool ok;
+};
+
+/// format_array: ptr is one past the last complete item and its separator,
+/// count the number of such items.
+struct FormatArrayResult
+{
+  char* ptr;
+  std::size_t count;
+};
+
+namespace detail
+{
+
+constexpr int kMaxFormatPrecision = 40;
+
+constexpr int clampPrecision(int p)
+{
+  return p < 0 ? 0 : p > kMaxFormatPrecision ? kMaxFormatPrecision : p;
+}
+
+/// Elements written as floating point, half included
+template<typename E>
+using IsFloating = std::integral_constant<bool, std::is_floating_point<E>::value || std::is_same<E, half>::value>;
+
+template<typename E>
+using FormatFloat = typename std::conditional<std::is_same<E, float>::value || std::is_same<E, half>::value,
+                                              float, double>::type;
+
+template<typename E>
+using FormatInt = typename std::conditional<std::is_same<E, bool>::value, int, E>::type;
+
+/// Longest text formatScalar can produce for an element of type E
+template<typename E>
+constexpr std::size_t scalarChars(FormatSpec, std::false_type /*floating*/)
+{
+  return std::numeric_limits<FormatInt<E>>::digits10 + 2;
+}
+template<typename E>
+constexpr std::size_t scalarChars(FormatSpec spec, std::true_type /*floating*/)
+{
+  typedef std::numeric_limits<FormatFloat<E>> L;
+  // sign, digits, point and e+XXX
+  return spec.notation == Notation::Fixed   ? 1 + (L::max_exponent10 + 1) + 1 + clampPrecision(spec.precision) :
+         spec.notation == Notation::General ? 1 + (clampPrecision(spec.precision) + 1) + 1 + 5 :
+                                              1 + L::max_digits10 + 1 + 5;
+}
+template<typename E>
+constexpr std::size_t scalarChars(FormatSpec spec)
+{
+  return scalarChars<E>(spec, IsFloating<E>());
+}
+/// The same over every notation and precision
+template<typename E>
+constexpr std::size_t scalarChars()
+{
+  return scalarChars<E>(FormatSpec::fixed(kMaxFormatPrecision));
+}
+
+inline char* copyChars(char* first, char* last, const char* s, std::size_t n)
+{
+  if(std::size_t(last - first) < n)
+    return nullptr;
+  std::memcpy(first, s, n);
+  return first + n;
+}
+
+template<typename E>
+char* formatInt(char* first, char* last, E v, std::false_type /*signed*/)
+{
+  char tmp[std::numeric_limits<E>::digits10 + 1];
+  char* p = tmp + sizeof tmp;
+  do{
+    *--p = char('0' + v % 10);
+    v /= 10;
+  }while(v);
+  return copyChars(first, last, p, tmp + sizeof tmp - p);
+}
+
+template<typename E>
+char* formatInt(char* first, char* last, E v, std::true_type /*signed*/)
+{
+  typedef typename std::make_unsigned<E>::type U;
+  if(v >= 0)
+    return formatInt(first, last, U(v), std::false_type());
+  if(first == last)
+    return nullptr;
+  *first = '-';
+  return formatInt(first + 1, last, U(U(0) - U(v)), std::false_type());
+}
+
+/// Writes v into [first,last), no terminator. nullptr if it does not fit.
+template<typename E>
+char* formatScalar(char* first, char* last, E v, FormatSpec, std::false_type /*floating*/)
+{
+  typedef FormatInt<E> I;
+#if defined(__cpp_lib_to_chars)
+  std::to_chars_result r = std::to_chars(first, last, I(v));
+  return r.ec == std::errc() ? r.ptr : nullptr;
+#else
+  return formatInt(first, last, I(v), std::is_signed<I>());
+#endif
+}
+
+#if !defined(__cpp_lib_to_chars)
+inline bool readsBack(const char* s, float v) { return std::strtof(s, nullptr) == v; }
+inline bool readsBack(const char* s, double v){ return std::strtod(s, nullptr) == v; }
+#endif
+
+template<typename E>
+char* formatScalar(char* first, char* last, E e, FormatSpec spec, std::true_type /*floating*/)
+{
+  typedef FormatFloat<E> F;
+  F v = F(e);
+  int p = clampPrecision(spec.precision);
+#if defined(__cpp_lib_to_chars)
+  std::to_chars_result r =
+      spec.notation == Notation::Fixed   ? std::to_chars(first, last, v, std::chars_format::fixed, p) :
+      spec.notation == Notation::General ? std::to_chars(first, last, v, std::chars_format::general, p) :
+                                           std::to_chars(first, last, v);
+  return r.ec == std::errc() ? r.ptr : nullptr;
+#else
+  char tmp[scalarChars<E>() + 1];
+  int n;
+  if(spec.notation == Notation::Fixed)
+    n = std::snprintf(tmp, sizeof tmp, "%.*f", p, double(v));
+  else if(spec.notation == Notation::General)
+    n = std::snprintf(tmp, sizeof tmp, "%.*g", p, double(v));
+  else{
+    // digits10 digits already give back every shorter decimal exactly
+    typedef std::numeric_limits<F> L;
+    for(p = L::digits10; ; p++){
+      n = std::snprintf(tmp, sizeof tmp, "%.*g", p, double(v));
+      if(p == L::max_digits10 || readsBack(tmp, v))
+        break;
+    }
+  }
+  return copyChars(first, last, tmp, std::size_t(n));
+#endif
+}
+
+template<typename E>
+char* formatScalar(char* first, char* last, E v, FormatSpec spec)
+{
+  return formatScalar(first, last, v, spec, IsFloating<E>());
+}
+
+} // namespace detail
+
+/**
+  Formats items[0..count) into buf, each followed by `separator`, with the
+  same text as operator<<. Stops before the first item that does not fit
+  completely, so a full buffer can be flushed and the rest formatted from
+  items + result.count.
+**/
+template<typename P>
+FormatArrayResult format_array(char* buf, std::size_t n, const P* items, std::size_t count,
+                               FormatSpec spec, const char* separator = "\n")
+{
+  char* end = buf + n;
+  std::size_t sepLen = std::strlen(separator);
+  FormatArrayResult result = {buf, 0};
+  for(; result.count < count; result.count++){
+    FormatResult r = items[result.count].format_to(result.ptr, std::size_t(end - result.ptr), spec);
+    char* next = r.ok ? detail::copyChars(r.ptr, end, separator, sepLen) : nullptr;
+    if(!next)
+      break;
+    result.ptr = next;
+  }
+  return result;
+}
+
+template<typename P>
+FormatArrayResult format_array(char* buf, std::size_t n, const P* items, std::size_t count)
+{
+  return format_array(buf, n, items, count, P::defaultFormat());
+}
+
+} // namespace tvml
+
+#endif // FORMAT_H
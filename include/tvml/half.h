@@ -0,0 +1,219 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "cpu.h"
+#include "parallel.h"
+#include "Vector.h"
+
+/**
+  IEEE 754 binary16 storage type.
+
+  half holds the 16 bits and nothing else; arithmetic converts to float,
+  computes there and rounds back, so Vector<half,N> works like a float
+  vector with half the memory. Conversion from float rounds to nearest
+  even, overflows to infinity and keeps NaNs NaN, the same as F16C.
+
+  The software conversions are bit-exact with F16C (vcvtps2ph with
+  round to nearest, vcvtph2ps), including the quieting of signalling
+  NaNs. The bulk convert() functions use F16C when the CPU has it.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+inline uint32_t floatBits(float f){ uint32_t u; std::memcpy(&u, &f, 4); return u; }
+inline float bitsFloat(uint32_t u){ float f; std::memcpy(&f, &u, 4); return f; }
+
+/// float -> binary16, round to nearest even
+inline uint16_t floatToHalfBits(float f)
+{
+  uint32_t u = floatBits(f);
+  uint32_t sign = (u >> 16) & 0x8000;
+  uint32_t a = u & 0x7fffffff;
+  uint32_t h;
+  if(a > 0x7f800000)                    // NaN, quieted, top payload bits kept
+    h = 0x7e00 | ((a >> 13) & 0x3ff);
+  else if(a >= 0x477ff000)              // rounds past 65504
+    h = 0x7c00;
+  else if(a < 0x38800000)               // subnormal or zero: let the FPU round,
+    h = floatBits(bitsFloat(a) + 0.5f) - 0x3f000000;  // 0.5 puts 2^-24 at bit 0
+  else{
+    a += 0xc8000fff + ((a >> 13) & 1);  // rebias 127 -> 15, round half to even
+    h = a >> 13;
+  }
+  return uint16_t(sign | h);
+}
+
+/// binary16 -> float, exact
+inline float halfBitsToFloat(uint16_t h)
+{
+  uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t a = h & 0x7fff;
+  uint32_t u;
+  if(a >= 0x7c00)                       // infinity, NaN quieted
+    u = 0x7f800000 | (a > 0x7c00 ? 0x400000 : 0) | ((a & 0x3ff) << 13);
+  else if(a >= 0x0400)                  // normal: rebias 15 -> 127
+    u = (a << 13) + 0x38000000;
+  else                                  // subnormal or zero, a*2^-24 is exact
+    u = floatBits(float(a)*5.9604644775390625e-8f);
+  return bitsFloat(sign | u);
+}
+
+#if defined(__F16C__) && !defined(TVML_NO_SIMD)
+inline uint16_t toHalf(float f){ return uint16_t(_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT)); }
+inline float fromHalf(uint16_t h){ return _cvtsh_ss(h); }
+#else
+inline uint16_t toHalf(float f){ return floatToHalfBits(f); }
+inline float fromHalf(uint16_t h){ return halfBitsToFloat(h); }
+#endif
+
+} // namespace detail
+} // namespace tvml
+
+class half
+{
+public:
+  half() = default;
+  /// Rounds to nearest even; doubles round through float
+  half(float f):bits(tvml::detail::toHalf(f)){}
+
+  static half fromBits(uint16_t b){ half h; h.bits = b; return h; }
+
+  operator float() const { return tvml::detail::fromHalf(bits); }
+
+  /// Arithmetic is done in float (through the conversion), these round back
+  half& operator+=(float f){ return *this = half(float(*this) + f); }
+  half& operator-=(float f){ return *this = half(float(*this) - f); }
+  half& operator*=(float f){ return *this = half(float(*this) * f); }
+  half& operator/=(float f){ return *this = half(float(*this) / f); }
+
+  /// data
+  uint16_t bits;
+};
+
+static_assert(sizeof(half) == 2 && sizeof(Vector<half,3>) == 6 && sizeof(Vector<half,4>) == 8,
+              "half vectors must be tightly packed");
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t HALF_GRAIN = 65536;
+
+inline void toFloat_scalar(const uint16_t* in, float* out, size_t n)
+{
+  for(size_t i=0; i<n; i++)
+    out[i] = fromHalf(in[i]);
+}
+inline void toHalf_scalar(const float* in, uint16_t* out, size_t n)
+{
+  for(size_t i=0; i<n; i++)
+    out[i] = toHalf(in[i]);
+}
+
+#if defined(TVML_DISPATCH)
+TVML_TARGET("avx,f16c")
+inline void toFloat_f16c(const uint16_t* in, float* out, size_t n)
+{
+  size_t i = 0;
+  for(; i+8 <= n; i+=8)
+    _mm256_storeu_ps(out+i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in+i))));
+  for(; i<n; i++)
+    out[i] = _cvtsh_ss(in[i]);
+}
+
+TVML_TARGET("avx,f16c")
+inline void toHalf_f16c(const float* in, uint16_t* out, size_t n)
+{
+  size_t i = 0;
+  for(; i+8 <= n; i+=8)
+    _mm_storeu_si128((__m128i*)(out+i), _mm256_cvtps_ph(_mm256_loadu_ps(in+i), _MM_FROUND_TO_NEAREST_INT));
+  for(; i<n; i++)
+    out[i] = uint16_t(_cvtss_sh(in[i], _MM_FROUND_TO_NEAREST_INT));
+}
+#endif // TVML_DISPATCH
+
+struct HalfConvert
+{
+  typedef void (*ToFloat)(const uint16_t*, float*, size_t);
+  typedef void (*ToHalf)(const float*, uint16_t*, size_t);
+
+#if defined(TVML_DISPATCH)
+  static ToFloat selectToFloat(){ return cpu::features().f16c ? toFloat_f16c : toFloat_scalar; }
+  static ToHalf  selectToHalf() { return cpu::features().f16c ? toHalf_f16c : toHalf_scalar; }
+#else
+  static ToFloat selectToFloat(){ return toFloat_scalar; }
+  static ToHalf  selectToHalf() { return toHalf_scalar; }
+#endif
+
+  static void toFloat(const uint16_t* in, float* out, size_t n){
+    static const ToFloat fn = selectToFloat();
+    fn(in, out, n);
+  }
+  static void toHalf(const float* in, uint16_t* out, size_t n){
+    static const ToHalf fn = selectToHalf();
+    fn(in, out, n);
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+/// out[i] = float(in[i]), n values
+inline void convert(const half* in, float* out, size_t n, unsigned threads = 1)
+{
+  const uint16_t* h = reinterpret_cast<const uint16_t*>(in);
+  tvml::parallel_for(n, tvml::detail::HALF_GRAIN, threads, [&](size_t begin, size_t end){
+    tvml::detail::HalfConvert::toFloat(h + begin, out + begin, end - begin);
+  });
+}
+
+/// out[i] = half(in[i]), n values
+inline void convert(const float* in, half* out, size_t n, unsigned threads = 1)
+{
+  uint16_t* h = reinterpret_cast<uint16_t*>(out);
+  tvml::parallel_for(n, tvml::detail::HALF_GRAIN, threads, [&](size_t begin, size_t end){
+    tvml::detail::HalfConvert::toHalf(in + begin, h + begin, end - begin);
+  });
+}
+
+/// Vectors, e.g. half3 normals to float3, n vectors
+template<int N>
+void convert(const Vector<half,N>* in, Vector<float,N>* out, size_t n, unsigned threads = 1)
+{
+  convert(reinterpret_cast<const half*>(in), reinterpret_cast<float*>(out), n*N, threads);
+}
+
+template<int N>
+void convert(const Vector<float,N>* in, Vector<half,N>* out, size_t n, unsigned threads = 1)
+{
+  convert(reinterpret_cast<const float*>(in), reinterpret_cast<half*>(out), n*N, threads);
+}
+
+#endif // HALF_H
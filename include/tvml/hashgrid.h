@@ -0,0 +1,286 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef HASHGRID_H
+#define HASHGRID_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "parallel.h"
+#include "span.h"
+#include "Vector3.h"
+
+/**
+  Uniform grid of cubic cells hashed into a table, for fixed radius
+  neighbour queries on particles that move every step.
+
+  Particles are keyed by their integer cell, hashed to one of a power of
+  two slots (at least as many as particles). rebuild() counting sorts
+  them by slot in two stable passes, O(n): the top 8 bits of the slot
+  across chunks of particles, then the rest inside each of those 256
+  ranges, each range with its own prefix sums on its own thread. Within
+  a slot particles keep their input order, so the result is the same for
+  any thread count.
+
+  Queries work in cell order: the grid keeps the positions sorted that
+  way, a neighbour j is the j-th of them, and order()[j] is its original
+  index. reorder() sorts other per-particle data the same way, so a
+  simulation can run in cell order and only translate when it must.
+
+  Slots may hold particles of other cells that hash to them; the distance
+  test drops those. Radii up to the cell size visit 27 cells.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t GRID_GRAIN = 65536;     // particles per thread
+const int GRID_COARSE_BITS = 8;      // first counting sort pass
+const int GRID_MIN_BITS = 10;
+
+/// Cell coordinates to a well mixed 32 bit key, the slot is its top bits
+inline uint32_t cellHash(int x, int y, int z)
+{
+  uint32_t h = uint32_t(x)*73856093u ^ uint32_t(y)*19349663u ^ uint32_t(z)*83492791u;
+  return h*0x9e3779b1u;
+}
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class HashGrid
+{
+public:
+  explicit HashGrid(T cellSize = 1):cell(cellSize),invCell(1/cellSize),bits(0){}
+
+  T cellSize() const { return cell; }
+  /// Takes effect on the next rebuild()
+  void setCellSize(T size){ cell = size; invCell = 1/size; }
+
+  Vector3<int> cellOf(const Vector3<T>& p) const{
+    return Vector3<int>(int(std::floor(p.x*invCell)), int(std::floor(p.y*invCell)), int(std::floor(p.z*invCell)));
+  }
+
+  /// Sorts positions[0, n) into cells; the grid keeps a copy
+  void rebuild(const Vector3<T>* positions, size_t n, unsigned threads = 1)
+  {
+    using namespace tvml::detail;
+    assert(n < (size_t(1) << 32));
+    bits = GRID_MIN_BITS;
+    while((size_t(1) << bits) < n && bits < 31)
+      bits++;
+    const size_t slots = size_t(1) << bits;
+    const int coarseShift = bits - GRID_COARSE_BITS;
+    const size_t B = size_t(1) << GRID_COARSE_BITS;
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(tvml::threadCount(threads), (n + GRID_GRAIN - 1)/GRID_GRAIN));
+    const size_t step = (n + chunks - 1)/chunks;
+
+    keys.resize(n);
+    moved.resize(n);
+    movedKeys.resize(n);
+    ids.resize(n);
+    sorted.resize(n);
+    starts.resize(slots + 1);
+    std::vector<uint32_t> counts(chunks*B, 0);
+
+    // slot of every particle, and per chunk counts of the top bits
+    tvml::parallel_for(chunks, 1, threads, [&](size_t cb, size_t ce){
+      for(size_t c=cb; c<ce; c++){
+        uint32_t* count = counts.data() + c*B;
+        for(size_t i=c*step; i<std::min(n, (c+1)*step); i++){
+          keys[i] = slotOf(positions[i]);
+          count[keys[i] >> coarseShift]++;
+        }
+      }
+    });
+
+    // where each chunk's share of each range starts; small, chunks x 256
+    std::vector<size_t> rangeStart(B + 1);
+    size_t sum = 0;
+    for(size_t b=0; b<B; b++){
+      rangeStart[b] = sum;
+      for(size_t c=0; c<chunks; c++){
+        uint32_t k = counts[c*B + b];
+        counts[c*B + b] = uint32_t(sum);
+        sum += k;
+      }
+    }
+    rangeStart[B] = sum;
+
+    tvml::parallel_for(chunks, 1, threads, [&](size_t cb, size_t ce){
+      for(size_t c=cb; c<ce; c++){
+        uint32_t* next = counts.data() + c*B;
+        for(size_t i=c*step; i<std::min(n, (c+1)*step); i++){
+          uint32_t at = next[keys[i] >> coarseShift]++;
+          moved[at] = uint32_t(i);
+          movedKeys[at] = keys[i];
+        }
+      }
+    });
+
+    // each range: count its slots, prefix sum to ends, fill backwards so the order holds
+    const size_t width = slots/B;
+    tvml::parallel_for(B, 1, threads, [&](size_t bb, size_t be){
+      for(size_t b=bb; b<be; b++){
+        uint32_t* s = starts.data() + b*width;
+        std::fill(s, s + width, uint32_t(0));
+        for(size_t j=rangeStart[b]; j<rangeStart[b+1]; j++)
+          starts[movedKeys[j]]++;
+        uint32_t end = uint32_t(rangeStart[b]);
+        for(size_t k=0; k<width; k++){
+          end += s[k];
+          s[k] = end;
+        }
+        for(size_t j=rangeStart[b+1]; j-- > rangeStart[b]; )
+          ids[--starts[movedKeys[j]]] = moved[j];
+      }
+    });
+    starts[slots] = uint32_t(n);
+
+    tvml::parallel_for(n, GRID_GRAIN, threads, [&](size_t begin, size_t end){
+      for(size_t j=begin; j<end; j++)
+        sorted[j] = positions[ids[j]];
+    });
+  }
+
+  size_t size() const { return ids.size(); }
+  size_t slotCount() const { return starts.empty() ? 0 : starts.size() - 1; }
+
+  /// Original index of the j-th particle in cell order
+  tvml::Span<const uint32_t> order() const { return tvml::Span<const uint32_t>(ids.data(), ids.size()); }
+  /// Positions in cell order
+  tvml::Span<const Vector3<T>> positions() const { return tvml::Span<const Vector3<T>>(sorted.data(), sorted.size()); }
+
+  /// out[j] = in[order()[j]], e.g. velocities into cell order
+  template<class X>
+  void reorder(const X* in, X* out, unsigned threads = 1) const
+  {
+    tvml::parallel_for(size(), tvml::detail::GRID_GRAIN, threads, [&](size_t begin, size_t end){
+      for(size_t j=begin; j<end; j++)
+        out[j] = in[ids[j]];
+    });
+  }
+
+  /// The other way, out[order()[j]] = in[j]
+  template<class X>
+  void restore(const X* in, X* out, unsigned threads = 1) const
+  {
+    tvml::parallel_for(size(), tvml::detail::GRID_GRAIN, threads, [&](size_t begin, size_t end){
+      for(size_t j=begin; j<end; j++)
+        out[ids[j]] = in[j];
+    });
+  }
+
+  /// f(j, distance2) for every particle j (in cell order) with |position j - p|^2 <= radius^2
+  template<class F>
+  void forEachNeighbor(const Vector3<T>& p, T radius, F f) const
+  {
+    if(size() == 0)
+      return;
+    const T r2 = radius*radius;
+    Vector3<int> lo = cellOf(p - Vector3<T>(radius, radius, radius)), hi = cellOf(p + Vector3<T>(radius, radius, radius));
+    size_t cells = size_t(hi.x - lo.x + 1)*size_t(hi.y - lo.y + 1)*size_t(hi.z - lo.z + 1);
+    // a slot shared by two of the cells must only be walked once
+    if(cells <= 27){
+      uint32_t slots[27];
+      int n = 0;
+      for(int z=lo.z; z<=hi.z; z++)
+        for(int y=lo.y; y<=hi.y; y++)
+          for(int x=lo.x; x<=hi.x; x++)
+            slots[n++] = tvml::detail::cellHash(x, y, z) >> (32 - bits);
+      for(int k=0; k<n; k++){
+        bool seen = false;
+        for(int i=0; i<k; i++)
+          seen |= slots[i] == slots[k];
+        if(!seen)
+          visitSlot(slots[k], p, r2, f);
+      }
+    }else{
+      std::vector<uint32_t> slots;
+      slots.reserve(std::min(cells, slotCount()));
+      for(int z=lo.z; z<=hi.z; z++)
+        for(int y=lo.y; y<=hi.y; y++)
+          for(int x=lo.x; x<=hi.x; x++)
+            slots.push_back(tvml::detail::cellHash(x, y, z) >> (32 - bits));
+      std::sort(slots.begin(), slots.end());
+      slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+      for(size_t k=0; k<slots.size(); k++)
+        visitSlot(slots[k], p, r2, f);
+    }
+  }
+
+  /// Appends the cell order indices of the particles within radius of p
+  void neighbors(const Vector3<T>& p, T radius, std::vector<uint32_t>& out) const
+  {
+    forEachNeighbor(p, radius, [&](uint32_t j, T){ out.push_back(j); });
+  }
+
+private:
+  template<class F>
+  void visitSlot(uint32_t s, const Vector3<T>& p, T r2, F& f) const{
+    for(uint32_t j=starts[s]; j<starts[s+1]; j++){
+      Vector3<T> d = sorted[j] - p;
+      T d2 = d*d;
+      if(d2 <= r2)
+        f(j, d2);
+    }
+  }
+
+  uint32_t slotOf(const Vector3<T>& p) const{
+    Vector3<int> c = cellOf(p);
+    return tvml::detail::cellHash(c.x, c.y, c.z) >> (32 - bits);
+  }
+
+  T cell, invCell;
+  int bits;
+  std::vector<uint32_t> starts;  // first particle of every slot, plus n
+  std::vector<uint32_t> ids;     // original index, cell order
+  std::vector< Vector3<T> > sorted;
+  std::vector<uint32_t> keys, moved, movedKeys;  // rebuild scratch, kept to reuse the memory
+};
+
+/**
+  f(i, j, distance2) for every pair of different particles within radius,
+  both in cell order, each ordered pair once (so both (i, j) and (j, i)).
+  Particles i are split across threads; f must be safe to call that way.
+**/
+template<typename T, class F>
+void forEachNeighborPair(const HashGrid<T>& grid, T radius, const F& f, unsigned threads = 1)
+{
+  tvml::Span<const Vector3<T>> p = grid.positions();
+  tvml::parallel_for(grid.size(), tvml::detail::GRID_GRAIN/16, threads, [&](size_t begin, size_t end){
+    for(size_t i=begin; i<end; i++)
+      grid.forEachNeighbor(p[i], radius, [&](uint32_t j, T d2){
+        if(j != i)
+          f(uint32_t(i), j, d2);
+      });
+  });
+}
+
+typedef HashGrid<float>  HashGridf;
+typedef HashGrid<double> HashGridd;
+#endif // HASHGRID_H
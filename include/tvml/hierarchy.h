@@ -0,0 +1,220 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix4x4.h"
+#include "Quarternion.h"
+#include "Transform.h"
+#include "parallel.h"
+#include "span.h"
+
+/**
+  Scene graph style transform hierarchy.
+
+  Nodes live in contiguous arrays indexed by the handle add() returns, and
+  a parent is always added before its children, so one pass in index order
+  sees every parent before its children. Setting a local transform marks
+  the node dirty; update() then recomputes world = parent world * local
+  for the dirty nodes and everything below them only.
+
+  With more than one thread the nodes are processed one depth level at a
+  time: nodes of the same level never depend on each other, so each level
+  is split across threads. Small levels stay on the calling thread.
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t HIERARCHY_GRAIN = 4096;
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class TransformHierarchy
+{
+public:
+  typedef uint32_t Handle;
+  static const Handle NO_PARENT = ~Handle(0);
+
+  TransformHierarchy(){}
+
+  size_t size() const { return parents.size(); }
+
+  void reserve(size_t n){
+    parents.reserve(n); depths.reserve(n); locals.reserve(n);
+    worlds.reserve(n); dirty.reserve(n); moved.reserve(n);
+  }
+
+  void clear(){
+    parents.clear(); depths.clear(); locals.clear();
+    worlds.clear(); dirty.clear(); moved.clear(); levels.clear();
+    pending = 0;
+  }
+
+  /// New node under `parent` (NO_PARENT for a root), dirty until the next update()
+  Handle add(Handle parent, const Matrix4x4<T>& local = Matrix4x4<T>::Identity){
+    assert(parent == NO_PARENT || parent < size());
+    Handle h = Handle(size());
+    uint32_t depth = parent == NO_PARENT ? 0 : depths[parent] + 1;
+    parents.push_back(parent);
+    depths.push_back(depth);
+    locals.push_back(local);
+    worlds.push_back(local);
+    dirty.push_back(1);
+    moved.push_back(0);
+    if(levels.size() <= depth)
+      levels.resize(depth + 1);
+    levels[depth].push_back(h);
+    pending++;
+    return h;
+  }
+
+  Handle add(Handle parent, const Vector3<T>& translation, const Quarternion<T>& rotation,
+             const Vector3<T>& scale = Vector3<T>(1,1,1)){
+    return add(parent, tvml::detail::composeTRS(translation, rotation, scale));
+  }
+  Handle add(Handle parent, const Transform<T>& local){
+    return add(parent, Matrix4x4<T>(local));
+  }
+
+  /// Local transform, relative to the parent
+  void setLocal(Handle h, const Matrix4x4<T>& local){
+    assert(h < size());
+    locals[h] = local;
+    markDirty(h);
+  }
+  void setLocal(Handle h, const Vector3<T>& translation, const Quarternion<T>& rotation,
+                const Vector3<T>& scale = Vector3<T>(1,1,1)){
+    setLocal(h, tvml::detail::composeTRS(translation, rotation, scale));
+  }
+  void setLocal(Handle h, const Transform<T>& local){
+    setLocal(h, Matrix4x4<T>(local));
+  }
+
+  /// Forces h and everything below it to be recomputed by the next update()
+  void markDirty(Handle h){
+    assert(h < size());
+    pending += !dirty[h];
+    dirty[h] = 1;
+  }
+
+  /// Forces every node to be recomputed by the next update()
+  void markAllDirty(){
+    std::fill(dirty.begin(), dirty.end(), uint8_t(1));
+    pending = size();
+  }
+
+  Handle parent(Handle h) const { return parents[h]; }
+  uint32_t depth(Handle h) const { return depths[h]; }
+  bool isDirty(Handle h) const { return dirty[h] != 0; }
+  const Matrix4x4<T>& local(Handle h) const { return locals[h]; }
+
+  /// World transform as of the last update()
+  const Matrix4x4<T>& world(Handle h) const { return worlds[h]; }
+
+  /// Every world transform, indexed by handle
+  tvml::Span<const Matrix4x4<T>> worldMatrices() const{
+    return tvml::Span<const Matrix4x4<T>>(worlds.data(), worlds.size());
+  }
+
+  /// Whether the last update() recomputed h's world transform
+  bool changed(Handle h) const { return moved[h] != 0; }
+
+  /**
+    Recomputes the world transforms of dirty nodes and their descendants,
+    using up to `threads` threads (0 for all). Returns how many were
+    recomputed. Results do not depend on the thread count.
+  **/
+  size_t update(unsigned threads = 1){
+    if(pending == 0){
+      std::fill(moved.begin(), moved.end(), uint8_t(0));
+      return 0;
+    }
+    pending = 0;
+
+    if(tvml::threadCount(threads) == 1 || size() < 2*tvml::detail::HIERARCHY_GRAIN)
+      return updateRange(Handle(0), Handle(size()));
+
+    std::atomic<size_t> total(0);
+    for(size_t d=0; d<levels.size(); d++){
+      const Handle* level = levels[d].data();
+      tvml::parallel_for(levels[d].size(), tvml::detail::HIERARCHY_GRAIN, threads,
+                         [&, level](size_t begin, size_t end){
+        size_t count = 0;
+        for(size_t i=begin; i<end; i++)
+          count += updateNode(level[i]);
+        total += count;
+      });
+    }
+    return total;
+  }
+
+  /// Recomputes every world transform, the way a hierarchy without dirty flags would
+  size_t updateAll(unsigned threads = 1){
+    markAllDirty();
+    return update(threads);
+  }
+
+private:
+  size_t updateRange(Handle begin, Handle end){
+    size_t count = 0;
+    for(Handle h=begin; h<end; h++)
+      count += updateNode(h);
+    return count;
+  }
+
+  // parents are always done before their children are visited
+  bool updateNode(Handle h){
+    Handle p = parents[h];
+    bool recompute = dirty[h] || (p != NO_PARENT && moved[p]);
+    dirty[h] = 0;
+    moved[h] = recompute;
+    if(!recompute)
+      return false;
+    if(p == NO_PARENT)
+      worlds[h] = locals[h];
+    else
+      tvml::detail::MatMul<T,4,4,4>::mul(worlds[p].data(), locals[h].data(), worlds[h].data());
+    return true;
+  }
+
+  std::vector<Handle> parents;
+  std::vector<uint32_t> depths;
+  std::vector< Matrix4x4<T> > locals, worlds;
+  std::vector<uint8_t> dirty, moved;
+  std::vector< std::vector<Handle> > levels;  // handles by depth, ascending
+  size_t pending = 0;
+};
+
+template<typename T>
+const typename TransformHierarchy<T>::Handle TransformHierarchy<T>::NO_PARENT;
+
+#endif // HIERARCHY_H
@@ -0,0 +1,389 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounds.h"
+#include "parallel.h"
+#include "span.h"
+#include "Vector3.h"
+
+/**
+  k-d tree index over a point cloud, for k nearest neighbours, radius and
+  box queries.
+
+  The tree is implicit: the build permutes an array of point indices so
+  the median of every range, along the widest axis of its bounds, sits in
+  the middle, with smaller coordinates before it and larger after. Ranges
+  of up to 8 points are leaves. Nothing but the permutation and one axis
+  byte per point is stored, 5 bytes per point, and the points themselves
+  stay where they are (they must outlive the tree and not move). The
+  build works on a temporary copy of the points with their indices, which
+  it frees when done.
+
+  All distances are squared, nothing takes a square root. Ties are broken
+  by the smaller point index, so results don't depend on the build.
+  Points must be finite.
+**/
+
+template<typename T>
+struct Neighbor
+{
+  static const uint32_t NONE = ~uint32_t(0);
+
+  /// data: point index (NONE for an empty slot), squared distance
+  uint32_t index;
+  T distance2;
+};
+
+template<typename T>
+const uint32_t Neighbor<T>::NONE;
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t KD_LEAF = 8;
+const size_t KD_TASK_GRAIN = 16384;    // smallest subtree worth its own thread
+const size_t KD_BOUNDS_GRAIN = 65536;
+const size_t KD_QUERY_GRAIN = 256;     // queries per thread for the batched queries
+
+/// Heap order, and the final order: nearer first, then lower index
+template<typename T>
+inline bool nearer(const Neighbor<T>& a, const Neighbor<T>& b)
+{
+  return a.distance2 < b.distance2 || (a.distance2 == b.distance2 && a.index < b.index);
+}
+
+} // namespace detail
+} // namespace tvml
+
+template<typename T>
+class KdTree
+{
+public:
+  KdTree():points(nullptr){}
+  KdTree(const Vector3<T>* points, size_t n, unsigned threads = 1):points(nullptr){
+    build(points, n, threads);
+  }
+  KdTree(tvml::Span<const Vector3<T>> points, unsigned threads = 1):points(nullptr){
+    build(points.data(), points.size(), threads);
+  }
+
+  /// Rebuilds over points[0, n)
+  void build(const Vector3<T>* p, size_t n, unsigned threads = 1)
+  {
+    assert(n < Neighbor<T>::NONE);
+    points = p;
+    ids.resize(n);
+    axes.assign(n, 0);
+    if(n == 0)
+      return;
+
+    // the medians are found in a copy of the points, selecting through ids would miss the cache
+    std::vector<Item> items(n);
+    AABB<T> all = AABB<T>::Empty;
+    std::mutex lock;
+    tvml::parallel_for(n, tvml::detail::KD_BOUNDS_GRAIN, threads, [&](size_t begin, size_t end){
+      AABB<T> b = AABB<T>::Empty;
+      for(size_t i=begin; i<end; i++){
+        items[i].p = p[i];
+        items[i].id = uint32_t(i);
+        b.extend(p[i]);
+      }
+      std::lock_guard<std::mutex> guard(lock);
+      all.extend(b);
+    });
+    split(items.data(), 0, n, all, tvml::threadCount(threads));
+    tvml::parallel_for(n, tvml::detail::KD_BOUNDS_GRAIN, threads, [&](size_t begin, size_t end){
+      for(size_t i=begin; i<end; i++)
+        ids[i] = items[i].id;
+    });
+  }
+
+  size_t size() const { return ids.size(); }
+  bool empty() const { return ids.empty(); }
+
+  /// Index bytes per point, 5 once built
+  double bytesPerPoint() const{
+    return empty() ? 0 : double(ids.capacity()*sizeof(uint32_t) + axes.capacity())/double(size());
+  }
+
+  /// The nearest point, index NONE if the tree is empty
+  Neighbor<T> nearest(const Vector3<T>& q) const
+  {
+    Neighbor<T> best = { Neighbor<T>::NONE, std::numeric_limits<T>::infinity() };
+    nearest(q, 1, &best);
+    return best;
+  }
+
+  /**
+    The k nearest points within maxDistance2, nearest first, into out[0, k).
+    Returns how many were found; the slots after them are left as they were.
+  **/
+  size_t nearest(const Vector3<T>& q, size_t k, Neighbor<T>* out,
+                 T maxDistance2 = std::numeric_limits<T>::infinity()) const
+  {
+    if(k == 0 || empty())
+      return 0;
+    Heap heap = { out, k, 0, maxDistance2 };
+    nearestIn(0, size(), q, heap);
+    std::sort_heap(out, out + heap.count, tvml::detail::nearer<T>);
+    return heap.count;
+  }
+
+  /// f(index, distance2) for every point with |p - q|^2 <= radius^2
+  template<class F>
+  void forEachInRadius(const Vector3<T>& q, T radius, F f) const
+  {
+    if(!empty())
+      radiusIn(0, size(), q, radius*radius, f);
+  }
+
+  /// Appends the indices of the points within radius of q, in tree order
+  void inRadius(const Vector3<T>& q, T radius, std::vector<uint32_t>& out) const
+  {
+    forEachInRadius(q, radius, [&](uint32_t i, T){ out.push_back(i); });
+  }
+
+  /// f(index) for every point inside box (boundary included)
+  template<class F>
+  void forEachInBox(const AABB<T>& box, F f) const
+  {
+    if(!empty())
+      boxIn(0, size(), box, f);
+  }
+
+  void inBox(const AABB<T>& box, std::vector<uint32_t>& out) const
+  {
+    forEachInBox(box, [&](uint32_t i){ out.push_back(i); });
+  }
+
+  /// The point array the tree indexes
+  const Vector3<T>* data() const { return points; }
+
+private:
+  /// Bounded max-heap over the caller's output, the worst kept neighbour on top
+  struct Heap
+  {
+    Neighbor<T>* items;
+    size_t k, count;
+    T limit;
+
+    T worst() const { return count == k ? items[0].distance2 : limit; }
+
+    void offer(uint32_t index, T d2){
+      Neighbor<T> n = { index, d2 };
+      if(count < k){
+        if(!(d2 <= limit))
+          return;
+        items[count++] = n;
+        std::push_heap(items, items + count, tvml::detail::nearer<T>);
+      }else if(tvml::detail::nearer(n, items[0])){
+        std::pop_heap(items, items + k, tvml::detail::nearer<T>);
+        items[k-1] = n;
+        std::push_heap(items, items + k, tvml::detail::nearer<T>);
+      }
+    }
+  };
+
+  T distance2(uint32_t i, const Vector3<T>& q) const{
+    Vector3<T> d = points[i] - q;
+    return d*d;
+  }
+
+  struct Item
+  {
+    Vector3<T> p;
+    uint32_t id;
+  };
+
+  void split(Item* items, size_t lo, size_t hi, const AABB<T>& box, unsigned threads)
+  {
+    if(hi - lo <= tvml::detail::KD_LEAF)
+      return;
+    Vector3<T> extent = box.size();
+    int a = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    size_t mid = lo + (hi - lo)/2;
+    std::nth_element(items + lo, items + mid, items + hi, [=](const Item& x, const Item& y){
+      return x.p[a] < y.p[a];
+    });
+    axes[mid] = uint8_t(a);
+
+    // children are bounded by the parent cut at the median, close enough to pick axes
+    AABB<T> left = box, right = box;
+    left.max[a] = right.min[a] = items[mid].p[a];
+    if(threads > 1 && hi - lo > tvml::detail::KD_TASK_GRAIN){
+      unsigned lt = threads/2;
+      std::thread t([this, items, lo, mid, left, lt]{ split(items, lo, mid, left, lt); });
+      split(items, mid + 1, hi, right, threads - lt);
+      t.join();
+    }else{
+      split(items, lo, mid, left, threads);
+      split(items, mid + 1, hi, right, threads);
+    }
+  }
+
+  void nearestIn(size_t lo, size_t hi, const Vector3<T>& q, Heap& heap) const
+  {
+    if(hi - lo <= tvml::detail::KD_LEAF){
+      for(size_t i=lo; i<hi; i++)
+        heap.offer(ids[i], distance2(ids[i], q));
+      return;
+    }
+    size_t mid = lo + (hi - lo)/2;
+    uint32_t id = ids[mid];
+    int a = axes[mid];
+    T d = q[a] - points[id][a];
+    heap.offer(id, distance2(id, q));
+    if(d < 0){
+      nearestIn(lo, mid, q, heap);
+      if(d*d <= heap.worst())
+        nearestIn(mid + 1, hi, q, heap);
+    }else{
+      nearestIn(mid + 1, hi, q, heap);
+      if(d*d <= heap.worst())
+        nearestIn(lo, mid, q, heap);
+    }
+  }
+
+  template<class F>
+  void radiusIn(size_t lo, size_t hi, const Vector3<T>& q, T r2, F& f) const
+  {
+    if(hi - lo <= tvml::detail::KD_LEAF){
+      for(size_t i=lo; i<hi; i++){
+        T d2 = distance2(ids[i], q);
+        if(d2 <= r2)
+          f(ids[i], d2);
+      }
+      return;
+    }
+    size_t mid = lo + (hi - lo)/2;
+    uint32_t id = ids[mid];
+    int a = axes[mid];
+    T d = q[a] - points[id][a], d2 = distance2(id, q);
+    if(d <= 0 || d*d <= r2)
+      radiusIn(lo, mid, q, r2, f);
+    if(d2 <= r2)
+      f(id, d2);
+    if(d >= 0 || d*d <= r2)
+      radiusIn(mid + 1, hi, q, r2, f);
+  }
+
+  template<class F>
+  void boxIn(size_t lo, size_t hi, const AABB<T>& box, F& f) const
+  {
+    if(hi - lo <= tvml::detail::KD_LEAF){
+      for(size_t i=lo; i<hi; i++)
+        if(box.contains(points[ids[i]]))
+          f(ids[i]);
+      return;
+    }
+    size_t mid = lo + (hi - lo)/2;
+    uint32_t id = ids[mid];
+    int a = axes[mid];
+    T s = points[id][a];
+    if(box.min[a] <= s)
+      boxIn(lo, mid, box, f);
+    if(box.contains(points[id]))
+      f(id);
+    if(box.max[a] >= s)
+      boxIn(mid + 1, hi, box, f);
+  }
+
+  const Vector3<T>* points;
+  std::vector<uint32_t> ids;  // tree order
+  std::vector<uint8_t> axes;  // split axis of the range whose middle this is
+};
+
+/**
+  out[i*k, i*k + k) = the k nearest points of queries[i], nearest first.
+  Slots past the number of points are {NONE, infinity}.
+**/
+template<typename T>
+void nearestNeighbors(const KdTree<T>& tree, const Vector3<T>* queries, size_t n, size_t k,
+                      Neighbor<T>* out, unsigned threads = 1)
+{
+  tvml::parallel_for(n, tvml::detail::KD_QUERY_GRAIN, threads, [&](size_t begin, size_t end){
+    for(size_t i=begin; i<end; i++){
+      Neighbor<T>* o = out + i*k;
+      size_t found = tree.nearest(queries[i], k, o);
+      for(size_t j=found; j<k; j++){
+        o[j].index = Neighbor<T>::NONE;
+        o[j].distance2 = std::numeric_limits<T>::infinity();
+      }
+    }
+  });
+}
+
+/**
+  Points within radius of every query, as lists: query i has
+  indices[offsets[i], offsets[i+1]), in tree order. offsets gets n + 1 entries.
+**/
+template<typename T>
+void pointsInRadius(const KdTree<T>& tree, const Vector3<T>* queries, size_t n, T radius,
+                    std::vector<size_t>& offsets, std::vector<uint32_t>& indices, unsigned threads = 1)
+{
+  offsets.assign(n + 1, 0);
+  indices.clear();
+  // each chunk lists into its own buffer, appended in chunk order afterwards
+  std::vector< std::pair< size_t, std::vector<uint32_t> > > chunks;
+  std::mutex lock;
+  tvml::parallel_for(n, tvml::detail::KD_QUERY_GRAIN, threads, [&](size_t begin, size_t end){
+    std::vector<uint32_t> found;
+    for(size_t i=begin; i<end; i++){
+      tree.inRadius(queries[i], radius, found);
+      offsets[i + 1] = found.size();
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    chunks.push_back(std::make_pair(begin, std::move(found)));
+  });
+  std::sort(chunks.begin(), chunks.end(), [](const std::pair< size_t, std::vector<uint32_t> >& a,
+                                             const std::pair< size_t, std::vector<uint32_t> >& b){
+    return a.first < b.first;
+  });
+  size_t total = 0;
+  for(size_t c=0; c<chunks.size(); c++)
+    total += chunks[c].second.size();
+  indices.reserve(total);
+  for(size_t c=0; c<chunks.size(); c++){
+    // offsets within the chunk were relative to its start
+    size_t base = indices.size(), end = c + 1 < chunks.size() ? chunks[c+1].first : n;
+    for(size_t i=chunks[c].first; i<end; i++)
+      offsets[i + 1] += base;
+    indices.insert(indices.end(), chunks[c].second.begin(), chunks[c].second.end());
+  }
+}
+
+typedef KdTree<float>  KdTreef;
+typedef KdTree<double> KdTreed;
+typedef Neighbor<float>  Neighborf;
+typedef Neighbor<double> Neighbord;
+#endif // KDTREE_H
@@ -21,14 +21,43 @@
 #ifndef MISC_H
 #define MISC_H
 
+#include <cstddef>
 #include <string>
-#include <sstream>
+#include <type_traits>
+#include <utility>
+
+#include "format.h"
+
+/// TVML_CONSTANT_EVALUATED() is true while the compiler evaluates a constant
+/// expression. constexpr functions use it to keep their runtime SIMD paths.
+/// Without the builtin it is always false and those functions are runtime only.
+#if defined(__has_builtin)
+#  if __has_builtin(__builtin_is_constant_evaluated)
+#    define TVML_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#  endif
+#endif
+// GCC 9 has the builtin but not __has_builtin, which came in GCC 10
+#if !defined(TVML_CONSTANT_EVALUATED) && defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9
+#  define TVML_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#ifndef TVML_CONSTANT_EVALUATED
+#  define TVML_CONSTANT_EVALUATED() false
+#endif
 
 /// Printing class for c++
 
 namespace tvml
 {
 
+/// Element types: arithmetic types and half (half.h, arithmetic through float)
+template<typename X>
+using IsScalar = std::integral_constant<bool, std::is_arithmetic<X>::value || std::is_same<X, half>::value>;
+
+/// Limits the scalar operator templates to scalars, so that types derived
+/// from a vector or matrix still pick the vector/matrix overloads.
+template<typename X>
+using IfScalar = typename std::enable_if<IsScalar<X>::value>::type;
+
 template<typename T, int cols, int rows = 1, int PRECISION = 3>
 class Printable
 {
@@ -36,35 +65,87 @@ public:
   static_assert(rows >=1, "Rows must be at least 1");
   static_assert(cols >=1, "Columns must be at least 1");
 
+  /// What repr() and operator<< use
+  static constexpr FormatSpec defaultFormat()
+  {
+    return FormatSpec::general(PRECISION);
+  }
+
+  /// Upper bound of the characters format_to writes, to size buffers
+  static constexpr std::size_t maxFormattedSize(FormatSpec spec = defaultFormat())
+  {
+    typedef typename std::decay<decltype(std::declval<const T&>()[0])>::type E;
+    return std::size_t(rows*cols)*detail::scalarChars<E>(spec) // elements
+         + std::size_t(rows*(cols - 1))*2                       // ", "
+         + std::size_t(rows)*2 + (rows > 1 ? 2 : 0);            // brackets
+  }
+
+  /// Writes repr() into buf without allocating or terminating it
+  FormatResult format_to(char* buf, std::size_t n, FormatSpec spec = defaultFormat()) const
+  {
+    char* p = buf;
+    char* end = buf + n;
+    bool ok = emit([&](const char* s, std::size_t k){
+      char* next = detail::copyChars(p, end, s, k);
+      if(next)
+        p = next;
+      return next != nullptr;
+    }, spec);
+    return {p, ok};
+  }
+
+  /// Output iterator version
+  template<typename Out>
+  Out format_to(Out out, FormatSpec spec = defaultFormat()) const
+  {
+    emit([&](const char* s, std::size_t k){
+      for(std::size_t i=0;i < k;i++)
+        *out++ = s[i];
+      return true;
+    }, spec);
+    return out;
+  }
+
   std::string repr() const
   {
-    std::stringstream ss;
-    ss.precision(PRECISION);
+    char buf[maxFormattedSize()];
+    return std::string(buf, format_to(buf, sizeof buf).ptr);
+  }
+
+  operator std::string() const
+  {
+    return repr();
+  }
 
-    if(rows > 1)
-      ss << "[";
+private:
+  // Hands the text to put(chars, count) piece by piece, stops when it fails
+  template<typename Put>
+  bool emit(const Put& put, FormatSpec spec) const
+  {
+    const T& self = (const T&)*this;
+    typedef typename std::decay<decltype(self[0])>::type E;
+    char tmp[detail::scalarChars<E>()];
+
+    if(rows > 1 && !put("[", 1))
+      return false;
 
     for(int row=0;row < rows;row++)
     {
-      ss << "[";
+      if(!put("[", 1))
+        return false;
       for(int col=0;col < cols;col++)
       {
-        if(col != 0)
-          ss << ", ";
-        ss << ((const T&)*this)[row*cols + col];
+        if(col != 0 && !put(", ", 2))
+          return false;
+        char* e = detail::formatScalar(tmp, tmp + sizeof tmp, self[row*cols + col], spec);
+        if(!put(tmp, std::size_t(e - tmp)))
+          return false;
       }
-      ss << "]";
+      if(!put("]", 1))
+        return false;
     }
 
-    if(rows > 1)
-      ss << "]";
-
-    return ss.str();
-  }
-
-  operator std::string() const
-  {
-    return repr();
+    return rows == 1 || put("]", 1);
   }
 };
 
@@ -74,7 +155,7 @@ public:
 #include <iostream>
 template<typename T, int R, int C, int P>
 std::ostream& operator<<(std::ostream& stream, const tvml::Printable<T,R,C,P>& to_print){
-  stream << to_print.repr();
-  return stream;
+  char buf[tvml::Printable<T,R,C,P>::maxFormattedSize()];
+  return stream.write(buf, to_print.format_to(buf, sizeof buf).ptr - buf);
 }
 #endif // MISC_H
@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// Minimal fork/join helper for the batched APIs. Needs -pthread.
+
+namespace tvml
+{
+
+/// 0 means "as many as the hardware has"
+inline unsigned threadCount(unsigned requested = 0)
+{
+  if(requested)
+    return requested;
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+/**
+  Calls f(begin, end) on contiguous chunks covering [0,n), using up to
+  `threads` threads (the caller is one of them). Chunks are never smaller
+  than `grain`, so small batches stay on the calling thread. f must not
+  throw.
+**/
+template<typename F>
+void parallel_for(size_t n, size_t grain, unsigned threads, const F& f)
+{
+  if(n == 0)
+    return;
+  grain = std::max<size_t>(grain, 1);
+  size_t chunks = std::min<size_t>(threadCount(threads), (n + grain - 1)/grain);
+  if(chunks <= 1){
+    f(size_t(0), n);
+    return;
+  }
+
+  size_t step = (n + chunks - 1)/chunks;
+  std::vector<std::thread> pool;
+  pool.reserve(chunks - 1);
+  for(size_t begin = step; begin < n; begin += step)
+    pool.push_back(std::thread(f, begin, std::min(n, begin + step)));
+  f(size_t(0), step);
+  for(size_t i=0; i<pool.size(); i++)
+    pool[i].join();
+}
+
+} // namespace tvml
+
+#endif // PARALLEL_H
@@ -0,0 +1,422 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <cstdint>
+
+#include "simd.h"
+#include "parallel.h"
+#include "Vector3.h"
+#include "Quarternion.h"
+
+/**
+  Quantized unit quarternions and unit vectors for storage and streaming.
+
+  SmallestThree<32|48|64> drops the largest magnitude component of a unit
+  quarternion (negating it first if needed, q and -q are the same
+  rotation) and stores its index in 2 bits and the other three as signed
+  fixed point in [-1/sqrt(2), 1/sqrt(2)]: 10, 15 or 20 bits each. Decoding
+  rebuilds the dropped one from the unit length.
+
+  Octahedral<16|32> maps a unit vector onto the octahedron |x|+|y|+|z| = 1,
+  unfolds that onto a square and stores the two coordinates as 8 or 16 bit
+  signed fixed point.
+
+  Both round to the nearest step. maxAngleError() bounds the angle between
+  the input and the decoded rotation or direction, for float or double
+  results. Zero and identity decode exactly.
+
+  The batched encode() / decode() give the same bits and values as the
+  constructors and conversions, one element per SIMD lane. `threads` > 1
+  splits large batches (0 = all cores).
+**/
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t QUANTIZE_GRAIN = 16384;
+
+/// Packed values are stored as 16 bit words, least significant first
+template<int WORDS>
+struct PackedWords
+{
+  static uint64_t get(const uint16_t* w){
+    uint64_t v = 0;
+    for(int i=0; i<WORDS; i++)
+      v |= uint64_t(w[i]) << 16*i;
+    return v;
+  }
+  static void set(uint16_t* w, uint64_t v){
+    for(int i=0; i<WORDS; i++)
+      w[i] = uint16_t(v >> 16*i);
+  }
+};
+
+/// Signed fixed point with B bits: -R..R stored biased by R
+template<class P, int B>
+struct Fixed
+{
+  typedef typename P::scalar T;
+
+  static T range(){ return T((int64_t(1) << (B-1)) - 1); }
+
+  /// x*scale rounded to the nearest step, biased, ready for truncation
+  static P quantize(P x, P scale){
+    P r = P::set1(range());
+    x = simd::min(simd::max(x*scale, -r), r);
+    return x + P::set1(range() + T(0.5));
+  }
+  static P dequantize(P u, T step){
+    return (u - P::set1(range()))*P::set1(step);
+  }
+};
+
+/**
+  Smallest three encoding, per lane. P is a SIMD pack or simd::Scalar,
+  packed values are `WORDS` 16 bit words apart.
+**/
+template<int BITS>
+struct SmallestThreeCodec
+{
+  static const int B = (BITS - 2)/3, WORDS = BITS/16;
+
+  template<typename T> static T sqrtHalf(){ return T(0.70710678118654752440); }
+
+  template<class P>
+  static void encode(const P* q, uint16_t* out)
+  {
+    typedef typename P::scalar T;
+    typedef Fixed<P,B> F;
+    P zero = P::set1(T(0));
+
+    // largest magnitude first, ties to the lower index
+    P big = simd::abs(q[0]), largest = q[0], index = zero;
+    for(int k=1; k<4; k++){
+      P a = simd::abs(q[k]);
+      auto m = simd::cmplt(big, a);
+      big = simd::select(m, a, big);
+      largest = simd::select(m, q[k], largest);
+      index = simd::select(m, P::set1(T(k)), index);
+    }
+    // negated when the dropped component is negative
+    T scale = F::range()/sqrtHalf<T>();
+    P s = simd::select(simd::cmplt(largest, zero), P::set1(-scale), P::set1(scale));
+    P u[3];
+    u[0] = F::quantize(simd::select(simd::cmplt(index, P::set1(T(1))), q[1], q[0]), s);
+    u[1] = F::quantize(simd::select(simd::cmplt(index, P::set1(T(2))), q[2], q[1]), s);
+    u[2] = F::quantize(simd::select(simd::cmplt(index, P::set1(T(3))), q[3], q[2]), s);
+
+    T a[4][P::width];
+    index.store(a[0]);
+    for(int c=0; c<3; c++)
+      u[c].store(a[c+1]);
+    for(int j=0; j<P::width; j++){
+      uint64_t v = uint64_t(a[0][j]) << 3*B | uint64_t(a[1][j]) << 2*B |
+                   uint64_t(a[2][j]) << B | uint64_t(a[3][j]);
+      PackedWords<WORDS>::set(out + j*WORDS, v);
+    }
+  }
+
+  template<class P>
+  static void decode(const uint16_t* in, P* q)
+  {
+    typedef typename P::scalar T;
+    typedef Fixed<P,B> F;
+    const uint64_t mask = (uint64_t(1) << B) - 1;
+
+    T a[4][P::width];
+    for(int j=0; j<P::width; j++){
+      uint64_t v = PackedWords<WORDS>::get(in + j*WORDS);
+      a[0][j] = T(v >> 3*B & 3);
+      a[1][j] = T(v >> 2*B & mask);
+      a[2][j] = T(v >> B & mask);
+      a[3][j] = T(v & mask);
+    }
+    T step = sqrtHalf<T>()/F::range();
+    P index = P::load(a[0]), c[3];
+    for(int k=0; k<3; k++)
+      c[k] = F::dequantize(P::load(a[k+1]), step);
+    P l = simd::sqrt(simd::max(P::set1(T(1)) - c[0]*c[0] - c[1]*c[1] - c[2]*c[2], P::set1(T(0))));
+
+    auto lt1 = simd::cmplt(index, P::set1(T(1)));
+    auto lt2 = simd::cmplt(index, P::set1(T(2)));
+    auto lt3 = simd::cmplt(index, P::set1(T(3)));
+    q[0] = simd::select(lt1, l, c[0]);
+    q[1] = simd::select(lt1, c[0], simd::select(lt2, l, c[1]));
+    q[2] = simd::select(lt2, c[1], simd::select(lt3, l, c[2]));
+    q[3] = simd::select(lt3, c[2], l);
+  }
+};
+
+/// Octahedral encoding, per lane, like SmallestThreeCodec
+template<int BITS>
+struct OctahedralCodec
+{
+  static const int B = BITS/2, WORDS = BITS/16;
+
+  template<class P>
+  static void encode(const P* v, uint16_t* out)
+  {
+    typedef typename P::scalar T;
+    typedef Fixed<P,B> F;
+    P zero = P::set1(T(0)), one = P::set1(T(1));
+
+    P n = simd::abs(v[0]) + simd::abs(v[1]) + simd::abs(v[2]);
+    P x = v[0]/n, y = v[1]/n;
+    // the lower half folds out over the diagonals
+    P fx = (one - simd::abs(y))*simd::select(simd::cmplt(x, zero), -one, one);
+    P fy = (one - simd::abs(x))*simd::select(simd::cmplt(y, zero), -one, one);
+    auto lower = simd::cmplt(v[2], zero);
+    P u[2] = { F::quantize(simd::select(lower, fx, x), P::set1(F::range())),
+               F::quantize(simd::select(lower, fy, y), P::set1(F::range())) };
+
+    T a[2][P::width];
+    u[0].store(a[0]);
+    u[1].store(a[1]);
+    for(int j=0; j<P::width; j++)
+      PackedWords<WORDS>::set(out + j*WORDS, uint64_t(a[0][j]) << B | uint64_t(a[1][j]));
+  }
+
+  template<class P>
+  static void decode(const uint16_t* in, P* v)
+  {
+    typedef typename P::scalar T;
+    typedef Fixed<P,B> F;
+    const uint64_t mask = (uint64_t(1) << B) - 1;
+    P zero = P::set1(T(0)), one = P::set1(T(1));
+
+    T a[2][P::width];
+    for(int j=0; j<P::width; j++){
+      uint64_t w = PackedWords<WORDS>::get(in + j*WORDS);
+      a[0][j] = T(w >> B & mask);
+      a[1][j] = T(w & mask);
+    }
+    P x = F::dequantize(P::load(a[0]), T(1)/F::range());
+    P y = F::dequantize(P::load(a[1]), T(1)/F::range());
+    P z = one - simd::abs(x) - simd::abs(y);
+    P t = simd::max(-z, zero);
+    x = x + simd::select(simd::cmplt(x, zero), t, -t);
+    y = y + simd::select(simd::cmplt(y, zero), t, -t);
+    P inv = one/simd::sqrt(x*x + y*y + z*z);
+    v[0] = x*inv;
+    v[1] = y*inv;
+    v[2] = z*inv;
+  }
+};
+
+} // namespace detail
+} // namespace tvml
+
+template<int BITS>
+class SmallestThree
+{
+  static_assert(BITS == 32 || BITS == 48 || BITS == 64, "SmallestThree is 32, 48 or 64 bits");
+  typedef tvml::detail::SmallestThreeCodec<BITS> Codec;
+public:
+  /// Bits per stored component
+  static const int COMPONENT_BITS = Codec::B;
+
+  SmallestThree() = default;
+
+  /// Encodes a unit quarternion
+  template<typename T>
+  explicit SmallestThree(const Quarternion<T>& q){
+    tvml::simd::Scalar<T> c[4];
+    for(int k=0; k<4; k++)
+      c[k].v = q[k];
+    Codec::encode(c, words);
+  }
+
+  template<typename T>
+  explicit operator Quarternion<T>() const{
+    tvml::simd::Scalar<T> c[4];
+    Codec::decode(words, c);
+    return Quarternion<T>(c[0].v, c[1].v, c[2].v, c[3].v);
+  }
+
+  /**
+    Largest angle in radians between an encoded rotation and the decoded
+    one. Every stored component is within half a step, S/(2R) with
+    S = 1/sqrt(2) and R = 2^(COMPONENT_BITS-1) - 1, of the exact value; the
+    rebuilt component (at least 1/2) moves at most sqrt(3) times as much,
+    and the rotation angle is twice the distance between unit quarternions,
+    so the angle stays under 4*sqrt(3)*S/(2R), about 2.45/R. The bound
+    returned adds rounding of the float results: 4.8e-3 (0.27 degrees),
+    1.5e-4 and 5e-6 radians for 32, 48 and 64 bits.
+  **/
+  static double maxAngleError(){
+    return 2.5/double((int64_t(1) << (COMPONENT_BITS-1)) - 1) + 4e-7;
+  }
+
+  /// The packed value: index of the dropped component, then the others
+  uint64_t bits() const { return tvml::detail::PackedWords<BITS/16>::get(words); }
+
+  /// data, least significant word first
+  uint16_t words[BITS/16];
+};
+
+template<int BITS>
+const int SmallestThree<BITS>::COMPONENT_BITS;
+
+template<int BITS>
+class Octahedral
+{
+  static_assert(BITS == 16 || BITS == 32, "Octahedral is 16 or 32 bits");
+  typedef tvml::detail::OctahedralCodec<BITS> Codec;
+public:
+  /// Bits per stored coordinate
+  static const int COMPONENT_BITS = Codec::B;
+
+  Octahedral() = default;
+
+  /// Encodes a unit vector
+  template<typename T>
+  explicit Octahedral(const Vector3<T>& v){
+    tvml::simd::Scalar<T> c[3];
+    for(int k=0; k<3; k++)
+      c[k].v = v[k];
+    Codec::encode(c, words);
+  }
+
+  /// Unit vector
+  template<typename T>
+  explicit operator Vector3<T>() const{
+    tvml::simd::Scalar<T> c[3];
+    Codec::decode(words, c);
+    return Vector3<T>(c[0].v, c[1].v, c[2].v);
+  }
+
+  /**
+    Largest angle in radians between an encoded direction and the decoded
+    one. Each coordinate is within half a step, 1/(2R) with
+    R = 2^(COMPONENT_BITS-1) - 1; the unfolding stretches that to at most
+    2.11/R radians on a dense sweep of the whole square. The bound returned
+    is 2.2/R plus rounding of the float results: 1.7e-2 (1 degree) and
+    6.8e-5 radians for 16 and 32 bits.
+  **/
+  static double maxAngleError(){
+    return 2.2/double((int64_t(1) << (COMPONENT_BITS-1)) - 1) + 4e-7;
+  }
+
+  /// The packed value: x then y
+  uint64_t bits() const { return tvml::detail::PackedWords<BITS/16>::get(words); }
+
+  /// data, least significant word first
+  uint16_t words[BITS/16];
+};
+
+template<int BITS>
+const int Octahedral<BITS>::COMPONENT_BITS;
+
+namespace tvml
+{
+namespace detail
+{
+
+template<class Codec, typename T, int K>
+struct EncodeKernel
+{
+  const T* in;
+  uint16_t* out;
+
+  template<class P> void apply(size_t i) const{
+    P c[K];
+    simd::Columns<K,P>::load(in + i*K, K, c);
+    Codec::encode(c, out + i*Codec::WORDS);
+  }
+};
+
+template<class Codec, typename T, int K>
+struct DecodeKernel
+{
+  const uint16_t* in;
+  T* out;
+
+  template<class P> void apply(size_t i) const{
+    P c[K];
+    Codec::decode(in + i*Codec::WORDS, c);
+    simd::Columns<K,P>::store(c, out + i*K, K);
+  }
+};
+
+template<class Codec, int K, typename T>
+inline void encodeAll(const T* in, uint16_t* out, size_t n, unsigned threads)
+{
+  tvml::parallel_for(n, QUANTIZE_GRAIN, threads, [&](size_t begin, size_t end){
+    EncodeKernel<Codec,T,K> k = { in + begin*K, out + begin*Codec::WORDS };
+    simd::run<T>(end - begin, k);
+  });
+}
+
+template<class Codec, int K, typename T>
+inline void decodeAll(const uint16_t* in, T* out, size_t n, unsigned threads)
+{
+  tvml::parallel_for(n, QUANTIZE_GRAIN, threads, [&](size_t begin, size_t end){
+    DecodeKernel<Codec,T,K> k = { in + begin*Codec::WORDS, out + begin*K };
+    simd::run<T>(end - begin, k);
+  });
+}
+
+} // namespace detail
+} // namespace tvml
+
+/// out[i] = SmallestThree<BITS>(in[i])
+template<typename T, int BITS>
+void encode(const Quarternion<T>* in, SmallestThree<BITS>* out, size_t n, unsigned threads = 1)
+{
+  tvml::detail::encodeAll<tvml::detail::SmallestThreeCodec<BITS>, 4>(in->data(), out->words, n, threads);
+}
+
+/// out[i] = Quarternion<T>(in[i])
+template<typename T, int BITS>
+void decode(const SmallestThree<BITS>* in, Quarternion<T>* out, size_t n, unsigned threads = 1)
+{
+  tvml::detail::decodeAll<tvml::detail::SmallestThreeCodec<BITS>, 4>(in->words, out->data(), n, threads);
+}
+
+/// out[i] = Octahedral<BITS>(in[i])
+template<typename T, int BITS>
+void encode(const Vector3<T>* in, Octahedral<BITS>* out, size_t n, unsigned threads = 1)
+{
+  tvml::detail::encodeAll<tvml::detail::OctahedralCodec<BITS>, 3>(in->data(), out->words, n, threads);
+}
+
+/// out[i] = Vector3<T>(in[i])
+template<typename T, int BITS>
+void decode(const Octahedral<BITS>* in, Vector3<T>* out, size_t n, unsigned threads = 1)
+{
+  tvml::detail::decodeAll<tvml::detail::OctahedralCodec<BITS>, 3>(in->words, out->data(), n, threads);
+}
+
+static_assert(sizeof(SmallestThree<32>) == 4 && sizeof(SmallestThree<48>) == 6 &&
+              sizeof(SmallestThree<64>) == 8 && sizeof(Octahedral<16>) == 2 &&
+              sizeof(Octahedral<32>) == 4, "packed encodings must not be padded");
+
+typedef SmallestThree<32> quart32;
+typedef SmallestThree<48> quart48;
+typedef SmallestThree<64> quart64;
+typedef Octahedral<16>    oct16;
+typedef Octahedral<32>    oct32;
+
+#endif // QUANTIZE_H
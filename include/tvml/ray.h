@@ -0,0 +1,267 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef RAY_H
+#define RAY_H
+
+#include <cstdint>
+#include <limits>
+
+#include "simd.h"
+#include "Vector3.h"
+
+/**
+  Rays and ray/triangle intersection.
+
+  A ray hits at distances t in [tmin, tmax), measured in units of the
+  direction, which need not be normalized. Triangles are given as a
+  vertex and the two edges from it, e1 = b - a and e2 = c - a, the form
+  the BVH stores; u and v are the barycentric weights of b and c.
+
+  RayPacket and TrianglePacket hold eight rays or triangles as structure
+  of arrays lanes, for testing eight rays against one triangle or one ray
+  against eight triangles at once. Each lane gives exactly what
+  intersectTriangle() gives for that pair (the same operations in the
+  same order), up to FMA contraction when the compiler may fuse them.
+**/
+
+template<typename T>
+class Ray
+{
+public:
+  Ray() = default;
+  constexpr Ray(const Vector3<T>& origin, const Vector3<T>& direction,
+                const T& tmin = 0, const T& tmax = std::numeric_limits<T>::infinity())
+    :origin(origin),direction(direction),tmin(tmin),tmax(tmax){}
+
+  Vector3<T> at(const T& t) const { return origin + direction*t; }
+
+  /// data
+  Vector3<T> origin, direction;
+  T tmin, tmax;
+};
+
+template<typename T>
+struct Hit
+{
+  static const uint32_t NONE = ~uint32_t(0);
+
+  explicit operator bool() const { return triangle != NONE; }
+
+  /// data: distance, barycentrics of the second and third vertex, triangle index or NONE
+  T t, u, v;
+  uint32_t triangle;
+};
+
+template<typename T>
+const uint32_t Hit<T>::NONE;
+
+/**
+  Möller-Trumbore, both sides. Returns whether o + t*d hits the triangle
+  with tmin <= t < tmax and sets t, u, v only then. Rays in the plane of
+  the triangle miss.
+**/
+template<typename T>
+inline bool intersectTriangle(const Vector3<T>& o, const Vector3<T>& d,
+                              const Vector3<T>& a, const Vector3<T>& e1, const Vector3<T>& e2,
+                              const T& tmin, const T& tmax, T& t, T& u, T& v)
+{
+  Vector3<T> p = d.cross(e2);
+  T det = e1*p;
+  if(det == 0)
+    return false;
+  T inv = 1/det;
+  Vector3<T> s = o - a;
+  T uu = (s*p)*inv;
+  if(!(uu >= 0 && uu <= 1))
+    return false;
+  Vector3<T> q = s.cross(e1);
+  T vv = (d*q)*inv;
+  if(!(vv >= 0 && uu + vv <= 1))
+    return false;
+  T tt = (e2*q)*inv;
+  if(!(tt >= tmin && tt < tmax))
+    return false;
+  t = tt; u = uu; v = vv;
+  return true;
+}
+
+template<typename T>
+inline bool intersectTriangle(const Ray<T>& r, const Vector3<T>& a, const Vector3<T>& b, const Vector3<T>& c,
+                              T& t, T& u, T& v)
+{
+  return intersectTriangle(r.origin, r.direction, a, b - a, c - a, r.tmin, r.tmax, t, u, v);
+}
+
+/// Eight 3D vectors, lane j is (x[j], y[j], z[j])
+template<typename T>
+struct Vector3x8
+{
+  Vector3<T> operator [] (int j) const { return Vector3<T>(x[j], y[j], z[j]); }
+  void set(int j, const Vector3<T>& v){ x[j] = v.x; y[j] = v.y; z[j] = v.z; }
+
+  /// data
+  T x[8], y[8], z[8];
+};
+
+template<typename T>
+struct RayPacket
+{
+  Ray<T> operator [] (int j) const { return Ray<T>(origin[j], direction[j], tmin[j], tmax[j]); }
+  void set(int j, const Ray<T>& r){
+    origin.set(j, r.origin);
+    direction.set(j, r.direction);
+    tmin[j] = r.tmin;
+    tmax[j] = r.tmax;
+  }
+
+  /// data
+  Vector3x8<T> origin, direction;
+  T tmin[8], tmax[8];
+};
+
+/// Triangles as a vertex and two edges, like intersectTriangle() takes them
+template<typename T>
+struct TrianglePacket
+{
+  void set(int j, const Vector3<T>& a, const Vector3<T>& b, const Vector3<T>& c){
+    this->a.set(j, a);
+    e1.set(j, b - a);
+    e2.set(j, c - a);
+  }
+
+  /// data
+  Vector3x8<T> a, e1, e2;
+};
+
+/// Distances and barycentrics per lane, written only for the lanes that hit
+template<typename T>
+struct HitPacket
+{
+  T t[8], u[8], v[8];
+};
+
+namespace tvml
+{
+namespace detail
+{
+
+/// The widest pack of T that is not wider than a packet
+template<typename T> struct PacketLanes { typedef simd::Pack<T> type; };
+#if defined(TVML_AVX512)
+template<> struct PacketLanes<float> { typedef simd::F32x8 type; };
+#endif
+
+/// intersectTriangle() on P::width lanes; vectors are {x, y, z}
+template<class P>
+inline typename P::mask intersectLanes(const P* o, const P* d, const P* a, const P* e1, const P* e2,
+                                       const P& tmin, const P& tmax, P& t, P& u, P& v)
+{
+  using namespace tvml::simd;
+  const P zero = P::set1(0), one = P::set1(1);
+  P p[3] = { d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0] };
+  P det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+  P inv = one/det;
+  P s[3] = { o[0] - a[0], o[1] - a[1], o[2] - a[2] };
+  u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*inv;
+  P q[3] = { s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0] };
+  v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2])*inv;
+  t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*inv;
+  return (cmplt(det, zero) | cmpgt(det, zero))
+       & cmple(zero, u) & cmple(u, one)
+       & cmple(zero, v) & cmple(u + v, one)
+       & cmple(tmin, t) & cmplt(t, tmax);
+}
+
+template<class P, typename T>
+inline void loadLanes(const Vector3x8<T>& v, int i, P* r){
+  r[0] = P::load(v.x + i); r[1] = P::load(v.y + i); r[2] = P::load(v.z + i);
+}
+template<class P, typename T>
+inline void splatLanes(const Vector3<T>& v, P* r){
+  r[0] = P::set1(v.x); r[1] = P::set1(v.y); r[2] = P::set1(v.z);
+}
+
+template<class P, typename T>
+inline uint32_t storeHits(typename P::mask m, const P& t, const P& u, const P& v, int i, HitPacket<T>& hit){
+  using namespace tvml::simd;
+  select(m, t, P::load(hit.t + i)).store(hit.t + i);
+  select(m, u, P::load(hit.u + i)).store(hit.u + i);
+  select(m, v, P::load(hit.v + i)).store(hit.v + i);
+  return uint32_t(movemask(m)) << i;
+}
+
+} // namespace detail
+} // namespace tvml
+
+/**
+  Eight rays against one triangle (vertex a, edges e1 = b - a, e2 = c - a).
+  Returns the lanes that hit as bits, and sets t, u, v of those lanes.
+**/
+template<typename T>
+inline uint32_t intersectTriangle(const RayPacket<T>& rays, const Vector3<T>& a,
+                                  const Vector3<T>& e1, const Vector3<T>& e2, HitPacket<T>& hit)
+{
+  typedef typename tvml::detail::PacketLanes<T>::type P;
+  using namespace tvml::detail;
+  P pa[3], pe1[3], pe2[3];
+  splatLanes(a, pa); splatLanes(e1, pe1); splatLanes(e2, pe2);
+  uint32_t mask = 0;
+  for(int i=0; i<8; i+=P::width){
+    P o[3], d[3], t, u, v;
+    loadLanes(rays.origin, i, o);
+    loadLanes(rays.direction, i, d);
+    typename P::mask m = intersectLanes(o, d, pa, pe1, pe2, P::load(rays.tmin + i), P::load(rays.tmax + i), t, u, v);
+    mask |= storeHits(m, t, u, v, i, hit);
+  }
+  return mask;
+}
+
+/**
+  One ray against eight triangles. Returns the triangles hit as bits, and
+  sets t, u, v of those lanes; the closest is the smallest t among them.
+**/
+template<typename T>
+inline uint32_t intersectTriangles(const Ray<T>& ray, const TrianglePacket<T>& tris, HitPacket<T>& hit)
+{
+  typedef typename tvml::detail::PacketLanes<T>::type P;
+  using namespace tvml::detail;
+  P o[3], d[3];
+  splatLanes(ray.origin, o); splatLanes(ray.direction, d);
+  P tmin = P::set1(ray.tmin), tmax = P::set1(ray.tmax);
+  uint32_t mask = 0;
+  for(int i=0; i<8; i+=P::width){
+    P a[3], e1[3], e2[3], t, u, v;
+    loadLanes(tris.a, i, a);
+    loadLanes(tris.e1, i, e1);
+    loadLanes(tris.e2, i, e2);
+    typename P::mask m = intersectLanes(o, d, a, e1, e2, tmin, tmax, t, u, v);
+    mask |= storeHits(m, t, u, v, i, hit);
+  }
+  return mask;
+}
+
+typedef Ray<float>  Rayf;
+typedef Ray<double> Rayd;
+typedef RayPacket<float>  RayPacketf;
+typedef RayPacket<double> RayPacketd;
+typedef TrianglePacket<float>  TrianglePacketf;
+typedef TrianglePacket<double> TrianglePacketd;
+#endif // RAY_H
@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef RSQRT_H
+#define RSQRT_H
+
+#include <type_traits>
+
+#include "simd.h"
+
+/**
+  Reciprocal square root with selectable precision, used by the
+  normalFast() / invMagnitude() family of the vector and quarternion
+  classes and by their batched counterparts.
+
+  Maximum relative error:
+
+    Approx   hardware estimate (rsqrtps)          3.7e-4  (11.4 bits)
+    Refined  estimate + one Newton-Raphson step   3.0e-7 float, 2.1e-7 double (~22 bits)
+    Exact    1/sqrt, one sqrt and one divide      2 ulp
+
+  Approx is the bound the x86 manuals give for rsqrtps (1.5*2^-12),
+  Refined follows from it (1.5*e^2) plus the float rounding of the step.
+  Both were checked against long double over every 7th float in the
+  normal range.
+
+  The estimate is the same for every pack width and for the scalar tail,
+  so batched and per object results agree lane for lane. Doubles use the
+  float estimate, hence the same bounds and the requirement that the
+  argument lies within the float range for Approx and Refined.
+  Without SSE2 (or with TVML_NO_SIMD) every precision is Exact.
+
+  rsqrt(0) is inf for Approx and Exact, NaN for Refined. Normalizing a
+  zero vector gives NaN in every mode, as normal() does.
+**/
+
+namespace tvml
+{
+
+enum class Precision
+{
+  Approx,
+  Refined,
+  Exact
+};
+
+namespace simd
+{
+
+/// 1/sqrt(x) lane wise
+template<Precision Pr, class P>
+inline P rsqrt(P x)
+{
+  typedef typename P::scalar T;
+  if(Pr == Precision::Exact)
+    return P::set1(T(1))/sqrt(x);
+  P y = rsqrte(x);
+  if(Pr == Precision::Refined)
+    y = y*(P::set1(T(1.5)) - P::set1(T(0.5))*x*y*y);
+  return y;
+}
+
+/**
+  Runs Kernel<T,p> over [0,n), the kernel being aggregate initialized
+  from args. Turns the run time precision into a template argument so
+  the per lane code has no branch.
+**/
+template<typename T, template<typename, Precision> class Kernel, typename... A>
+inline void run(Precision p, size_t n, A... args)
+{
+  switch(p){
+  case Precision::Approx:  { Kernel<T,Precision::Approx>  k = { args... }; run<T>(n, k); break; }
+  case Precision::Refined: { Kernel<T,Precision::Refined> k = { args... }; run<T>(n, k); break; }
+  case Precision::Exact:   { Kernel<T,Precision::Exact>   k = { args... }; run<T>(n, k); break; }
+  }
+}
+
+} // namespace simd
+
+/// Scalar 1/sqrt(x), floating point T only
+template<typename T>
+inline T rsqrt(T x, Precision p = Precision::Approx)
+{
+  static_assert(std::is_floating_point<T>::value, "rsqrt needs a floating point type");
+  typedef simd::Scalar<T> S;
+  switch(p){
+  case Precision::Approx:  return simd::rsqrt<Precision::Approx>(S::set1(x)).v;
+  case Precision::Refined: return simd::rsqrt<Precision::Refined>(S::set1(x)).v;
+  default:                 return simd::rsqrt<Precision::Exact>(S::set1(x)).v;
+  }
+}
+
+} // namespace tvml
+
+#endif // RSQRT_H
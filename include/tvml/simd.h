@@ -0,0 +1,583 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+#include <cstddef>
+
+/**
+  Thin SIMD abstraction used by the batched kernels.
+
+  Pack<T> is the widest register type the compiler was told it may use
+  (-msse2, -mavx, -mavx512f, ...), Scalar<T> is the one-lane fallback used
+  for tails and for element types without a vector unit. Kernels are written
+  once against the common interface and instantiated for both.
+
+  Comparisons return P::mask (a lane mask, a k register for AVX-512, or
+  bool for Scalar) which feeds select(mask, a, b) and movemask().
+
+  Define TVML_NO_SIMD to force the scalar path everywhere.
+**/
+
+#if !defined(TVML_NO_SIMD)
+#  if defined(__AVX512F__)
+#    define TVML_AVX512 1
+#  endif
+#  if defined(__AVX__)
+#    define TVML_AVX 1
+#  endif
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define TVML_SSE2 1
+#  endif
+#endif
+
+#if defined(TVML_SSE2) || defined(TVML_AVX) || defined(TVML_AVX512)
+#  include <immintrin.h>
+#endif
+
+namespace tvml
+{
+namespace simd
+{
+
+/// One lane, plain C++. Works for every arithmetic type.
+template<typename T>
+struct Scalar
+{
+  typedef T scalar;
+  typedef bool mask;
+  static const int width = 1;
+
+  static Scalar load(const T* p)  { Scalar r; r.v = *p; return r; }
+  static Scalar set1(const T& t)  { Scalar r; r.v = t;  return r; }
+  void store(T* p) const          { *p = v; }
+
+  T v;
+};
+
+template<typename T> inline Scalar<T> operator+(Scalar<T> a, Scalar<T> b){ return Scalar<T>::set1(a.v + b.v); }
+template<typename T> inline Scalar<T> operator-(Scalar<T> a, Scalar<T> b){ return Scalar<T>::set1(a.v - b.v); }
+template<typename T> inline Scalar<T> operator*(Scalar<T> a, Scalar<T> b){ return Scalar<T>::set1(a.v * b.v); }
+template<typename T> inline Scalar<T> operator/(Scalar<T> a, Scalar<T> b){ return Scalar<T>::set1(a.v / b.v); }
+template<typename T> inline Scalar<T> operator-(Scalar<T> a){ return Scalar<T>::set1(-a.v); }
+// Same conversion the Vector classes do: sqrt in floating point, back to T.
+template<typename T> inline Scalar<T> sqrt(Scalar<T> a){ return Scalar<T>::set1(T(std::sqrt(a.v))); }
+/// 1/sqrt(a) estimate, rsqrt.h adds the refinement. Exact for Scalar<T>.
+template<typename T> inline Scalar<T> rsqrte(Scalar<T> a){ return Scalar<T>::set1(T(1/std::sqrt(a.v))); }
+template<typename T> inline Scalar<T> abs(Scalar<T> a){ return Scalar<T>::set1(a.v < 0 ? -a.v : a.v); }
+template<typename T> inline Scalar<T> min(Scalar<T> a, Scalar<T> b){ return b.v < a.v ? b : a; }
+template<typename T> inline Scalar<T> max(Scalar<T> a, Scalar<T> b){ return a.v < b.v ? b : a; }
+template<typename T> inline bool cmplt(Scalar<T> a, Scalar<T> b){ return a.v <  b.v; }
+template<typename T> inline bool cmple(Scalar<T> a, Scalar<T> b){ return a.v <= b.v; }
+template<typename T> inline bool cmpgt(Scalar<T> a, Scalar<T> b){ return a.v >  b.v; }
+template<typename T> inline Scalar<T> select(bool m, Scalar<T> a, Scalar<T> b){ return m ? a : b; }
+/// Bit i set when lane i of the mask is
+inline int movemask(bool m){ return m ? 1 : 0; }
+
+#if defined(TVML_SSE2)
+struct F32x4
+{
+  typedef float scalar;
+  typedef F32x4 mask;
+  static const int width = 4;
+
+  static F32x4 load(const float* p) { F32x4 r; r.v = _mm_loadu_ps(p); return r; }
+  static F32x4 set1(float t)        { F32x4 r; r.v = _mm_set1_ps(t);  return r; }
+  void store(float* p) const        { _mm_storeu_ps(p, v); }
+
+  __m128 v;
+};
+
+inline F32x4 wrap(__m128 v){ F32x4 r; r.v = v; return r; }
+inline F32x4 operator+(F32x4 a, F32x4 b){ return wrap(_mm_add_ps(a.v, b.v)); }
+inline F32x4 operator-(F32x4 a, F32x4 b){ return wrap(_mm_sub_ps(a.v, b.v)); }
+inline F32x4 operator*(F32x4 a, F32x4 b){ return wrap(_mm_mul_ps(a.v, b.v)); }
+inline F32x4 operator/(F32x4 a, F32x4 b){ return wrap(_mm_div_ps(a.v, b.v)); }
+inline F32x4 operator-(F32x4 a){ return wrap(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+inline F32x4 sqrt(F32x4 a){ return wrap(_mm_sqrt_ps(a.v)); }
+inline F32x4 rsqrte(F32x4 a){ return wrap(_mm_rsqrt_ps(a.v)); }
+inline F32x4 abs(F32x4 a){ return wrap(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+inline F32x4 min(F32x4 a, F32x4 b){ return wrap(_mm_min_ps(a.v, b.v)); }
+inline F32x4 max(F32x4 a, F32x4 b){ return wrap(_mm_max_ps(a.v, b.v)); }
+inline F32x4 cmplt(F32x4 a, F32x4 b){ return wrap(_mm_cmplt_ps(a.v, b.v)); }
+inline F32x4 cmple(F32x4 a, F32x4 b){ return wrap(_mm_cmple_ps(a.v, b.v)); }
+inline F32x4 cmpgt(F32x4 a, F32x4 b){ return wrap(_mm_cmpgt_ps(a.v, b.v)); }
+inline F32x4 operator&(F32x4 a, F32x4 b){ return wrap(_mm_and_ps(a.v, b.v)); }
+inline F32x4 operator|(F32x4 a, F32x4 b){ return wrap(_mm_or_ps(a.v, b.v)); }
+inline F32x4 select(F32x4 m, F32x4 a, F32x4 b){
+  return wrap(_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)));
+}
+inline int movemask(F32x4 m){ return _mm_movemask_ps(m.v); }
+
+struct F64x2
+{
+  typedef double scalar;
+  typedef F64x2 mask;
+  static const int width = 2;
+
+  static F64x2 load(const double* p) { F64x2 r; r.v = _mm_loadu_pd(p); return r; }
+  static F64x2 set1(double t)        { F64x2 r; r.v = _mm_set1_pd(t);  return r; }
+  void store(double* p) const        { _mm_storeu_pd(p, v); }
+
+  __m128d v;
+};
+
+inline F64x2 wrap(__m128d v){ F64x2 r; r.v = v; return r; }
+inline F64x2 operator+(F64x2 a, F64x2 b){ return wrap(_mm_add_pd(a.v, b.v)); }
+inline F64x2 operator-(F64x2 a, F64x2 b){ return wrap(_mm_sub_pd(a.v, b.v)); }
+inline F64x2 operator*(F64x2 a, F64x2 b){ return wrap(_mm_mul_pd(a.v, b.v)); }
+inline F64x2 operator/(F64x2 a, F64x2 b){ return wrap(_mm_div_pd(a.v, b.v)); }
+inline F64x2 operator-(F64x2 a){ return wrap(_mm_xor_pd(a.v, _mm_set1_pd(-0.0))); }
+inline F64x2 sqrt(F64x2 a){ return wrap(_mm_sqrt_pd(a.v)); }
+// No double estimate below AVX-512, go through the float one.
+inline F64x2 rsqrte(F64x2 a){ return wrap(_mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(a.v)))); }
+inline F64x2 abs(F64x2 a){ return wrap(_mm_andnot_pd(_mm_set1_pd(-0.0), a.v)); }
+inline F64x2 min(F64x2 a, F64x2 b){ return wrap(_mm_min_pd(a.v, b.v)); }
+inline F64x2 max(F64x2 a, F64x2 b){ return wrap(_mm_max_pd(a.v, b.v)); }
+inline F64x2 cmplt(F64x2 a, F64x2 b){ return wrap(_mm_cmplt_pd(a.v, b.v)); }
+inline F64x2 cmple(F64x2 a, F64x2 b){ return wrap(_mm_cmple_pd(a.v, b.v)); }
+inline F64x2 cmpgt(F64x2 a, F64x2 b){ return wrap(_mm_cmpgt_pd(a.v, b.v)); }
+inline F64x2 operator&(F64x2 a, F64x2 b){ return wrap(_mm_and_pd(a.v, b.v)); }
+inline F64x2 operator|(F64x2 a, F64x2 b){ return wrap(_mm_or_pd(a.v, b.v)); }
+inline F64x2 select(F64x2 m, F64x2 a, F64x2 b){
+  return wrap(_mm_or_pd(_mm_and_pd(m.v, a.v), _mm_andnot_pd(m.v, b.v)));
+}
+inline int movemask(F64x2 m){ return _mm_movemask_pd(m.v); }
+
+// The tail lanes use the same estimate as the packs.
+inline Scalar<float> rsqrte(Scalar<float> a){
+  return Scalar<float>::set1(_mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(a.v))));
+}
+inline Scalar<double> rsqrte(Scalar<double> a){
+  return Scalar<double>::set1(double(rsqrte(Scalar<float>::set1(float(a.v))).v));
+}
+#endif // TVML_SSE2
+
+#if defined(TVML_AVX)
+struct F32x8
+{
+  typedef float scalar;
+  typedef F32x8 mask;
+  static const int width = 8;
+
+  static F32x8 load(const float* p) { F32x8 r; r.v = _mm256_loadu_ps(p); return r; }
+  static F32x8 set1(float t)        { F32x8 r; r.v = _mm256_set1_ps(t);  return r; }
+  void store(float* p) const        { _mm256_storeu_ps(p, v); }
+
+  __m256 v;
+};
+
+inline F32x8 wrap(__m256 v){ F32x8 r; r.v = v; return r; }
+inline F32x8 operator+(F32x8 a, F32x8 b){ return wrap(_mm256_add_ps(a.v, b.v)); }
+inline F32x8 operator-(F32x8 a, F32x8 b){ return wrap(_mm256_sub_ps(a.v, b.v)); }
+inline F32x8 operator*(F32x8 a, F32x8 b){ return wrap(_mm256_mul_ps(a.v, b.v)); }
+inline F32x8 operator/(F32x8 a, F32x8 b){ return wrap(_mm256_div_ps(a.v, b.v)); }
+inline F32x8 operator-(F32x8 a){ return wrap(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+inline F32x8 sqrt(F32x8 a){ return wrap(_mm256_sqrt_ps(a.v)); }
+inline F32x8 rsqrte(F32x8 a){ return wrap(_mm256_rsqrt_ps(a.v)); }
+inline F32x8 abs(F32x8 a){ return wrap(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+inline F32x8 min(F32x8 a, F32x8 b){ return wrap(_mm256_min_ps(a.v, b.v)); }
+inline F32x8 max(F32x8 a, F32x8 b){ return wrap(_mm256_max_ps(a.v, b.v)); }
+inline F32x8 cmplt(F32x8 a, F32x8 b){ return wrap(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+inline F32x8 cmple(F32x8 a, F32x8 b){ return wrap(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+inline F32x8 cmpgt(F32x8 a, F32x8 b){ return wrap(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+inline F32x8 operator&(F32x8 a, F32x8 b){ return wrap(_mm256_and_ps(a.v, b.v)); }
+inline F32x8 operator|(F32x8 a, F32x8 b){ return wrap(_mm256_or_ps(a.v, b.v)); }
+inline F32x8 select(F32x8 m, F32x8 a, F32x8 b){ return wrap(_mm256_blendv_ps(b.v, a.v, m.v)); }
+inline int movemask(F32x8 m){ return _mm256_movemask_ps(m.v); }
+
+struct F64x4
+{
+  typedef double scalar;
+  typedef F64x4 mask;
+  static const int width = 4;
+
+  static F64x4 load(const double* p) { F64x4 r; r.v = _mm256_loadu_pd(p); return r; }
+  static F64x4 set1(double t)        { F64x4 r; r.v = _mm256_set1_pd(t);  return r; }
+  void store(double* p) const        { _mm256_storeu_pd(p, v); }
+
+  __m256d v;
+};
+
+inline F64x4 wrap(__m256d v){ F64x4 r; r.v = v; return r; }
+inline F64x4 operator+(F64x4 a, F64x4 b){ return wrap(_mm256_add_pd(a.v, b.v)); }
+inline F64x4 operator-(F64x4 a, F64x4 b){ return wrap(_mm256_sub_pd(a.v, b.v)); }
+inline F64x4 operator*(F64x4 a, F64x4 b){ return wrap(_mm256_mul_pd(a.v, b.v)); }
+inline F64x4 operator/(F64x4 a, F64x4 b){ return wrap(_mm256_div_pd(a.v, b.v)); }
+inline F64x4 operator-(F64x4 a){ return wrap(_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))); }
+inline F64x4 sqrt(F64x4 a){ return wrap(_mm256_sqrt_pd(a.v)); }
+inline F64x4 rsqrte(F64x4 a){ return wrap(_mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(a.v)))); }
+inline F64x4 abs(F64x4 a){ return wrap(_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)); }
+inline F64x4 min(F64x4 a, F64x4 b){ return wrap(_mm256_min_pd(a.v, b.v)); }
+inline F64x4 max(F64x4 a, F64x4 b){ return wrap(_mm256_max_pd(a.v, b.v)); }
+inline F64x4 cmplt(F64x4 a, F64x4 b){ return wrap(_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)); }
+inline F64x4 cmple(F64x4 a, F64x4 b){ return wrap(_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)); }
+inline F64x4 cmpgt(F64x4 a, F64x4 b){ return wrap(_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)); }
+inline F64x4 operator&(F64x4 a, F64x4 b){ return wrap(_mm256_and_pd(a.v, b.v)); }
+inline F64x4 operator|(F64x4 a, F64x4 b){ return wrap(_mm256_or_pd(a.v, b.v)); }
+inline F64x4 select(F64x4 m, F64x4 a, F64x4 b){ return wrap(_mm256_blendv_pd(b.v, a.v, m.v)); }
+inline int movemask(F64x4 m){ return _mm256_movemask_pd(m.v); }
+#endif // TVML_AVX
+
+#if defined(TVML_AVX512)
+// GCC 12 warns about _mm512_undefined_* inside its own intrinsics.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/// AVX-512 compares give a k register, not a lane mask
+struct Mask16 { __mmask16 k; };
+struct Mask8  { __mmask8  k; };
+
+inline Mask16 operator&(Mask16 a, Mask16 b){ Mask16 r; r.k = __mmask16(a.k & b.k); return r; }
+inline Mask16 operator|(Mask16 a, Mask16 b){ Mask16 r; r.k = __mmask16(a.k | b.k); return r; }
+inline int movemask(Mask16 m){ return m.k; }
+inline Mask8 operator&(Mask8 a, Mask8 b){ Mask8 r; r.k = __mmask8(a.k & b.k); return r; }
+inline Mask8 operator|(Mask8 a, Mask8 b){ Mask8 r; r.k = __mmask8(a.k | b.k); return r; }
+inline int movemask(Mask8 m){ return m.k; }
+
+inline Mask16 kmask(__mmask16 k){ Mask16 r; r.k = k; return r; }
+inline Mask8  kmask(__mmask8 k) { Mask8 r;  r.k = k; return r; }
+
+struct F32x16
+{
+  typedef float scalar;
+  typedef Mask16 mask;
+  static const int width = 16;
+
+  static F32x16 load(const float* p) { F32x16 r; r.v = _mm512_loadu_ps(p); return r; }
+  static F32x16 set1(float t)        { F32x16 r; r.v = _mm512_set1_ps(t);  return r; }
+  void store(float* p) const         { _mm512_storeu_ps(p, v); }
+
+  __m512 v;
+};
+
+// Sign flips through the integer unit, the float xor needs AVX512DQ.
+inline F32x16 wrap(__m512 v){ F32x16 r; r.v = v; return r; }
+inline F32x16 operator+(F32x16 a, F32x16 b){ return wrap(_mm512_add_ps(a.v, b.v)); }
+inline F32x16 operator-(F32x16 a, F32x16 b){ return wrap(_mm512_sub_ps(a.v, b.v)); }
+inline F32x16 operator*(F32x16 a, F32x16 b){ return wrap(_mm512_mul_ps(a.v, b.v)); }
+inline F32x16 operator/(F32x16 a, F32x16 b){ return wrap(_mm512_div_ps(a.v, b.v)); }
+inline F32x16 operator-(F32x16 a){
+  return wrap(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32(int(0x80000000)))));
+}
+inline F32x16 sqrt(F32x16 a){ return wrap(_mm512_sqrt_ps(a.v)); }
+// rsqrt14 is more accurate than rsqrtps; use the 8 wide estimate so every width agrees (rsqrt.h)
+inline F32x16 rsqrte(F32x16 a){
+  __m256 lo = _mm256_rsqrt_ps(_mm512_castps512_ps256(a.v));
+  __m256 hi = _mm256_rsqrt_ps(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a.v), 1)));
+  return wrap(_mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)), _mm256_castps_pd(hi), 1)));
+}
+inline F32x16 abs(F32x16 a){
+  return wrap(_mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7fffffff))));
+}
+inline F32x16 min(F32x16 a, F32x16 b){ return wrap(_mm512_min_ps(a.v, b.v)); }
+inline F32x16 max(F32x16 a, F32x16 b){ return wrap(_mm512_max_ps(a.v, b.v)); }
+inline Mask16 cmplt(F32x16 a, F32x16 b){ return kmask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)); }
+inline Mask16 cmple(F32x16 a, F32x16 b){ return kmask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)); }
+inline Mask16 cmpgt(F32x16 a, F32x16 b){ return kmask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)); }
+inline F32x16 select(Mask16 m, F32x16 a, F32x16 b){ return wrap(_mm512_mask_blend_ps(m.k, b.v, a.v)); }
+
+struct F64x8
+{
+  typedef double scalar;
+  typedef Mask8 mask;
+  static const int width = 8;
+
+  static F64x8 load(const double* p) { F64x8 r; r.v = _mm512_loadu_pd(p); return r; }
+  static F64x8 set1(double t)        { F64x8 r; r.v = _mm512_set1_pd(t);  return r; }
+  void store(double* p) const        { _mm512_storeu_pd(p, v); }
+
+  __m512d v;
+};
+
+inline F64x8 wrap(__m512d v){ F64x8 r; r.v = v; return r; }
+inline F64x8 operator+(F64x8 a, F64x8 b){ return wrap(_mm512_add_pd(a.v, b.v)); }
+inline F64x8 operator-(F64x8 a, F64x8 b){ return wrap(_mm512_sub_pd(a.v, b.v)); }
+inline F64x8 operator*(F64x8 a, F64x8 b){ return wrap(_mm512_mul_pd(a.v, b.v)); }
+inline F64x8 operator/(F64x8 a, F64x8 b){ return wrap(_mm512_div_pd(a.v, b.v)); }
+inline F64x8 operator-(F64x8 a){
+  return wrap(_mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a.v), _mm512_set1_epi64((long long)0x8000000000000000ull))));
+}
+inline F64x8 sqrt(F64x8 a){ return wrap(_mm512_sqrt_pd(a.v)); }
+inline F64x8 rsqrte(F64x8 a){ return wrap(_mm512_cvtps_pd(_mm256_rsqrt_ps(_mm512_cvtpd_ps(a.v)))); }
+inline F64x8 abs(F64x8 a){
+  return wrap(_mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a.v), _mm512_set1_epi64(0x7fffffffffffffffll))));
+}
+inline F64x8 min(F64x8 a, F64x8 b){ return wrap(_mm512_min_pd(a.v, b.v)); }
+inline F64x8 max(F64x8 a, F64x8 b){ return wrap(_mm512_max_pd(a.v, b.v)); }
+inline Mask8 cmplt(F64x8 a, F64x8 b){ return kmask(_mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ)); }
+inline Mask8 cmple(F64x8 a, F64x8 b){ return kmask(_mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ)); }
+inline Mask8 cmpgt(F64x8 a, F64x8 b){ return kmask(_mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ)); }
+inline F64x8 select(Mask8 m, F64x8 a, F64x8 b){ return wrap(_mm512_mask_blend_pd(m.k, b.v, a.v)); }
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+#endif // TVML_AVX512
+
+/// Widest pack available for T
+template<typename T> struct Widest { typedef Scalar<T> type; };
+
+#if defined(TVML_AVX512)
+template<> struct Widest<float>  { typedef F32x16 type; };
+template<> struct Widest<double> { typedef F64x8 type; };
+#elif defined(TVML_AVX)
+template<> struct Widest<float>  { typedef F32x8 type; };
+template<> struct Widest<double> { typedef F64x4 type; };
+#elif defined(TVML_SSE2)
+template<> struct Widest<float>  { typedef F32x4 type; };
+template<> struct Widest<double> { typedef F64x2 type; };
+#endif
+
+template<typename T>
+using Pack = typename Widest<T>::type;
+
+/**
+  Rows to lanes and back, for kernels that work on arrays of small
+  matrices one matrix per lane. Columns<K,P>::load sets lane j of cols[k]
+  to rows[j*stride + k], for j < P::width and k < K; store is the inverse
+  and writes only the rows whose bit is set in `lanes`.
+
+  SIMD packs go through 4x4 (float) or 2x2 (double) register transposes
+  per 128 bit quarter, anything else through a stack buffer.
+**/
+template<class P> struct Quarters { static const bool simd = false; };
+
+#if defined(TVML_SSE2)
+struct QuartersF32
+{
+  typedef __m128 V;
+  static const int B = 4;
+  static V    loadu(const float* p)           { return _mm_loadu_ps(p); }
+  static void storeu(float* p, V v)           { _mm_storeu_ps(p, v); }
+  static V    strided(const float* p, size_t s){ return _mm_setr_ps(p[0], p[s], p[2*s], p[3*s]); }
+  static void transpose(V* r)                 { _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]); }
+};
+
+struct QuartersF64
+{
+  typedef __m128d V;
+  static const int B = 2;
+  static V    loadu(const double* p)           { return _mm_loadu_pd(p); }
+  static void storeu(double* p, V v)           { _mm_storeu_pd(p, v); }
+  static V    strided(const double* p, size_t s){ return _mm_setr_pd(p[0], p[s]); }
+  static void transpose(V* r){
+    V t = _mm_unpacklo_pd(r[0], r[1]);
+    r[1] = _mm_unpackhi_pd(r[0], r[1]);
+    r[0] = t;
+  }
+};
+
+template<> struct Quarters<F32x4> : QuartersF32
+{
+  static const bool simd = true;
+  static const int G = 1;
+  static F32x4 join(const V* q)      { return wrap(q[0]); }
+  static void  split(F32x4 p, V* q)  { q[0] = p.v; }
+};
+
+template<> struct Quarters<F64x2> : QuartersF64
+{
+  static const bool simd = true;
+  static const int G = 1;
+  static F64x2 join(const V* q)      { return wrap(q[0]); }
+  static void  split(F64x2 p, V* q)  { q[0] = p.v; }
+};
+#endif // TVML_SSE2
+
+#if defined(TVML_AVX)
+template<> struct Quarters<F32x8> : QuartersF32
+{
+  static const bool simd = true;
+  static const int G = 2;
+  static F32x8 join(const V* q){ return wrap(_mm256_insertf128_ps(_mm256_castps128_ps256(q[0]), q[1], 1)); }
+  static void  split(F32x8 p, V* q){
+    q[0] = _mm256_castps256_ps128(p.v);
+    q[1] = _mm256_extractf128_ps(p.v, 1);
+  }
+};
+
+template<> struct Quarters<F64x4> : QuartersF64
+{
+  static const bool simd = true;
+  static const int G = 2;
+  static F64x4 join(const V* q){ return wrap(_mm256_insertf128_pd(_mm256_castpd128_pd256(q[0]), q[1], 1)); }
+  static void  split(F64x4 p, V* q){
+    q[0] = _mm256_castpd256_pd128(p.v);
+    q[1] = _mm256_extractf128_pd(p.v, 1);
+  }
+};
+#endif // TVML_AVX
+
+#if defined(TVML_AVX512)
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+template<> struct Quarters<F32x16> : QuartersF32
+{
+  static const bool simd = true;
+  static const int G = 4;
+  static F32x16 join(const V* q){
+    __m512 r = _mm512_castps128_ps512(q[0]);
+    r = _mm512_insertf32x4(r, q[1], 1);
+    r = _mm512_insertf32x4(r, q[2], 2);
+    return wrap(_mm512_insertf32x4(r, q[3], 3));
+  }
+  static void split(F32x16 p, V* q){
+    q[0] = _mm512_castps512_ps128(p.v);
+    q[1] = _mm512_extractf32x4_ps(p.v, 1);
+    q[2] = _mm512_extractf32x4_ps(p.v, 2);
+    q[3] = _mm512_extractf32x4_ps(p.v, 3);
+  }
+};
+
+// 128 bit double inserts need AVX512DQ, go through 256 bit halves
+template<> struct Quarters<F64x8> : QuartersF64
+{
+  static const bool simd = true;
+  static const int G = 4;
+  static F64x8 join(const V* q){
+    __m256d lo = _mm256_insertf128_pd(_mm256_castpd128_pd256(q[0]), q[1], 1);
+    __m256d hi = _mm256_insertf128_pd(_mm256_castpd128_pd256(q[2]), q[3], 1);
+    return wrap(_mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1));
+  }
+  static void split(F64x8 p, V* q){
+    __m256d lo = _mm512_castpd512_pd256(p.v), hi = _mm512_extractf64x4_pd(p.v, 1);
+    q[0] = _mm256_castpd256_pd128(lo);
+    q[1] = _mm256_extractf128_pd(lo, 1);
+    q[2] = _mm256_castpd256_pd128(hi);
+    q[3] = _mm256_extractf128_pd(hi, 1);
+  }
+};
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+#endif // TVML_AVX512
+
+template<int K, class P, bool SIMD = Quarters<P>::simd>
+struct Columns
+{
+  typedef typename P::scalar T;
+
+  static void load(const T* rows, size_t stride, P* cols)
+  {
+    T lanes[K][P::width];
+    for(int j=0; j<P::width; j++)
+      for(int k=0; k<K; k++)
+        lanes[k][j] = rows[j*stride + k];
+    for(int k=0; k<K; k++)
+      cols[k] = P::load(lanes[k]);
+  }
+
+  static void store(const P* cols, T* rows, size_t stride, int lanes = -1)
+  {
+    T tmp[K][P::width];
+    for(int k=0; k<K; k++)
+      cols[k].store(tmp[k]);
+    for(int j=0; j<P::width; j++)
+      if(lanes >> j & 1)
+        for(int k=0; k<K; k++)
+          rows[j*stride + k] = tmp[k][j];
+  }
+};
+
+template<int K, class P>
+struct Columns<K, P, true>
+{
+  typedef Quarters<P> Q;
+  typedef typename P::scalar T;
+  typedef typename Q::V V;
+  static const int B = Q::B, G = Q::G, FULL = K - K % B;
+
+  static void load(const T* rows, size_t stride, P* cols)
+  {
+    V q[K][G];
+    for(int g=0; g<G; g++){
+      const T* r = rows + g*B*stride;
+      for(int k=0; k<FULL; k+=B){
+        V t[B];
+        for(int j=0; j<B; j++)
+          t[j] = Q::loadu(r + j*stride + k);
+        Q::transpose(t);
+        for(int j=0; j<B; j++)
+          q[k+j][g] = t[j];
+      }
+      for(int k=FULL; k<K; k++)
+        q[k][g] = Q::strided(r + k, stride);
+    }
+    for(int k=0; k<K; k++)
+      cols[k] = Q::join(q[k]);
+  }
+
+  static void store(const P* cols, T* rows, size_t stride, int lanes = -1)
+  {
+    V q[K][G];
+    for(int k=0; k<K; k++)
+      Q::split(cols[k], q[k]);
+    for(int g=0; g<G; g++){
+      T* r = rows + g*B*stride;
+      int m = lanes >> (g*B);
+      for(int k=0; k<FULL; k+=B){
+        V t[B];
+        for(int j=0; j<B; j++)
+          t[j] = q[k+j][g];
+        Q::transpose(t);
+        for(int j=0; j<B; j++)
+          if(m >> j & 1)
+            Q::storeu(r + j*stride + k, t[j]);
+      }
+      for(int k=FULL; k<K; k++){
+        T tmp[B];
+        Q::storeu(tmp, q[k][g]);
+        for(int j=0; j<B; j++)
+          if(m >> j & 1)
+            r[j*stride + k] = tmp[j];
+      }
+    }
+  }
+};
+
+/**
+  Runs kernel.apply<P>(i) over [0,n): full packs first, the remainder
+  one lane at a time. Kernels must only touch lanes [i, i+P::width).
+**/
+template<typename T, typename Kernel>
+inline void run(size_t n, const Kernel& kernel)
+{
+  typedef Pack<T> P;
+  size_t i = 0;
+  if(P::width > 1)
+    for(; i + P::width <= n; i += P::width)
+      kernel.template apply<P>(i);
+  for(; i < n; i++)
+    kernel.template apply< Scalar<T> >(i);
+}
+
+} // namespace simd
+} // namespace tvml
+
+#endif // SIMD_H
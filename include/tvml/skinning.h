@@ -0,0 +1,312 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "simd.h"
+#include "parallel.h"
+#include "Matrix4x4.h"
+#include "DualQuaternion.h"
+#include "VectorArray.h"
+
+/**
+  Batched skinning over structure of arrays vertex streams.
+
+  Every vertex has the same number of influences; SkinInfluences keeps
+  influence k of every vertex in its own bone index and weight arrays, so
+  a chunk of vertices reads every stream front to back. Weights are used
+  as given, they should add up to 1.
+
+  skinDualQuaternions blends the bones' dual quarternions, flipping the
+  ones on the other side of the first influence's hemisphere, then
+  normalizes (dual quarternion skinning). skinMatrices blends the top three
+  rows of the bone matrices (linear blend skinning). Both give the same
+  result per vertex as summing DualQuaternion / Matrix4x4 operators in
+  influence order and transforming with them. Normals are rotated by the
+  blended rotation, or multiplied by the blended 3x3; renormalize them
+  when the bones scale.
+
+  `threads` > 1 splits the vertices across threads (0 = all cores).
+**/
+
+template<typename T>
+class SkinInfluences
+{
+public:
+  typedef uint16_t Bone;
+  static const int MAX = 8;
+
+  SkinInfluences(){}
+  SkinInfluences(size_t vertices, int influences){ resize(vertices, influences); }
+
+  size_t size() const { return bones[0].size(); }
+  int influences() const { return count; }
+
+  void resize(size_t vertices, int influences){
+    assert(influences >= 1 && influences <= MAX);
+    count = influences;
+    for(int k=0; k<MAX; k++){
+      bones[k].assign(k < count ? vertices : 0, Bone(0));
+      weights[k].assign(k < count ? vertices : 0, T(0));
+    }
+  }
+
+  /// Influence k of vertex v
+  void set(size_t v, int k, Bone bone, const T& weight){
+    bones[k][v] = bone;
+    weights[k][v] = weight;
+  }
+  Bone bone(size_t v, int k) const { return bones[k][v]; }
+  const T& weight(size_t v, int k) const { return weights[k][v]; }
+
+  /// data: influence k of every vertex, for k < influences()
+  std::vector<Bone> bones[MAX];
+  std::vector<T> weights[MAX];
+
+private:
+  int count = 1;
+};
+
+template<typename T>
+const int SkinInfluences<T>::MAX;
+
+namespace tvml
+{
+namespace detail
+{
+
+const size_t SKIN_GRAIN = 4096;
+
+/// Pack for blending one bone's rows: 8 and 12 elements divide evenly
+template<typename T> struct BoneRow { typedef simd::Scalar<T> type; };
+#if defined(TVML_SSE2)
+template<> struct BoneRow<float>  { typedef simd::F32x4 type; };
+#endif
+#if defined(TVML_AVX)
+template<> struct BoneRow<double> { typedef simd::F64x4 type; };
+#elif defined(TVML_SSE2)
+template<> struct BoneRow<double> { typedef simd::F64x2 type; };
+#endif
+
+/**
+  Vertex streams and influences of one chunk, offset to its first vertex.
+
+  The bones are blended one vertex at a time along their rows, so every
+  vertex is transposed into the SIMD lanes once instead of once per
+  influence; the weighted sum is the same either way.
+**/
+template<typename T>
+struct SkinStreams
+{
+  const T* bones;
+  size_t stride;  // elements from one bone to the next
+  int count;
+  const uint16_t* index[SkinInfluences<T>::MAX];
+  const T* weight[SkinInfluences<T>::MAX];
+  const T *p[3], *n[3];
+  T *op[3], *on[3];
+
+  const T* bone(int k, size_t v) const { return bones + index[k][v]*stride; }
+
+  /// Weighted sum of the first K elements of vertex v's bones. DUAL flips
+  /// the quarternions on the other side of the first one's hemisphere.
+  template<int K, bool DUAL> void blend(size_t v, T* out) const{
+    typedef typename BoneRow<T>::type R;
+    static const T sign[2] = { T(1), T(-1) };
+    const int N = K/R::width;
+    const T* first = bone(0, v);
+    R w = R::set1(weight[0][v]), acc[N];
+    for(int q=0; q<N; q++)
+      acc[q] = R::load(first + q*R::width)*w;
+    for(int k=1; k<count; k++){
+      const T* b = bone(k, v);
+      T wk = weight[k][v];
+      if(DUAL){
+        // q and -q are the same transform, blend the one closer to the first bone.
+        // Looked up rather than branched on, the sign is as good as random.
+        T d[4];
+        for(int q=0; q<4; q+=R::width)
+          (R::load(first + q)*R::load(b + q)).store(d + q);
+        wk = wk*sign[d[0] + d[1] + d[2] + d[3] < 0];
+      }
+      w = R::set1(wk);
+      for(int q=0; q<N; q++)
+        acc[q] = acc[q] + R::load(b + q*R::width)*w;
+    }
+    for(int q=0; q<N; q++)
+      acc[q].store(out + q*R::width);
+  }
+
+  /// Blended bones of the vertices from i, one per lane
+  template<int K, bool DUAL, class P> void blend(size_t i, P* cols) const{
+    T rows[P::width][K];
+    for(int j=0; j<P::width; j++)
+      blend<K,DUAL>(i + j, rows[j]);
+    simd::Columns<K,P>::load(rows[0], K, cols);
+  }
+
+  template<class P> static void load(const T* const* a, size_t i, P* v){
+    for(int c=0; c<3; c++)
+      v[c] = P::load(a[c] + i);
+  }
+  template<class P> static void store(T* const* a, size_t i, const P* v){
+    for(int c=0; c<3; c++)
+      v[c].store(a[c] + i);
+  }
+};
+
+template<typename T, bool NORMALS>
+struct SkinDQKernel
+{
+  SkinStreams<T> s;
+
+  template<class P> void apply(size_t i) const{
+    typedef DQ<P,T> Ops;
+    P q[8];
+    s.template blend<8,true>(i, q);
+    Ops::normalize(q);
+
+    P v[3], r[3];
+    s.load(s.p, i, v);
+    Ops::point(q, v, r);
+    s.store(s.op, i, r);
+    if(NORMALS){
+      s.load(s.n, i, v);
+      TRS<P,T>::rotate(q, v, r);
+      s.store(s.on, i, r);
+    }
+  }
+};
+
+template<typename T, bool NORMALS>
+struct SkinMatrixKernel
+{
+  SkinStreams<T> s;
+
+  template<class P> void apply(size_t i) const{
+    P m[12];
+    s.template blend<12,false>(i, m);
+
+    // Matrix4x4 * Vector3, operation for operation
+    P v[3], r[3];
+    s.load(s.p, i, v);
+    for(int row=0; row<3; row++)
+      r[row] = v[0]*m[4*row] + v[1]*m[4*row+1] + v[2]*m[4*row+2] + m[4*row+3];
+    s.store(s.op, i, r);
+    if(NORMALS){
+      s.load(s.n, i, v);
+      for(int row=0; row<3; row++)
+        r[row] = v[0]*m[4*row] + v[1]*m[4*row+1] + v[2]*m[4*row+2];
+      s.store(s.on, i, r);
+    }
+  }
+};
+
+template<template<class,bool> class Kernel, typename T>
+inline void skin(const T* bones, size_t stride, const SkinInfluences<T>& influences,
+                 const Vector3Array<T>& positions, const Vector3Array<T>* normals,
+                 Vector3Array<T>& outPositions, Vector3Array<T>* outNormals, unsigned threads)
+{
+  size_t n = positions.size();
+  assert(influences.size() == n && (!normals || normals->size() == n));
+  outPositions.resize(n);
+  if(normals)
+    outNormals->resize(n);
+  tvml::parallel_for(n, SKIN_GRAIN, threads, [&](size_t begin, size_t end){
+    SkinStreams<T> s;
+    s.bones = bones;
+    s.stride = stride;
+    s.count = influences.influences();
+    for(int k=0; k<s.count; k++){
+      s.index[k] = influences.bones[k].data() + begin;
+      s.weight[k] = influences.weights[k].data() + begin;
+    }
+    const Vector3Array<T>* in[2] = { &positions, normals };
+    Vector3Array<T>* out[2] = { &outPositions, outNormals };
+    for(int a=0; a<2; a++){
+      const T** p = a ? s.n : s.p;
+      T** o = a ? s.on : s.op;
+      p[0] = in[a] ? in[a]->x.data() + begin : nullptr;
+      p[1] = in[a] ? in[a]->y.data() + begin : nullptr;
+      p[2] = in[a] ? in[a]->z.data() + begin : nullptr;
+      o[0] = out[a] ? out[a]->x.data() + begin : nullptr;
+      o[1] = out[a] ? out[a]->y.data() + begin : nullptr;
+      o[2] = out[a] ? out[a]->z.data() + begin : nullptr;
+    }
+    if(normals){
+      Kernel<T,true> k = { s };
+      simd::run<T>(end - begin, k);
+    }else{
+      Kernel<T,false> k = { s };
+      simd::run<T>(end - begin, k);
+    }
+  });
+}
+
+} // namespace detail
+} // namespace tvml
+
+/// Dual quarternion skinning of positions. out may be positions.
+template<typename T>
+void skinDualQuaternions(const DualQuaternion<T>* bones, const SkinInfluences<T>& influences,
+                         const Vector3Array<T>& positions, Vector3Array<T>& out, unsigned threads = 1)
+{
+  tvml::detail::skin<tvml::detail::SkinDQKernel, T>(bones->data(), 8, influences, positions, nullptr,
+                                                     out, nullptr, threads);
+}
+
+/// Dual quarternion skinning of positions and normals
+template<typename T>
+void skinDualQuaternions(const DualQuaternion<T>* bones, const SkinInfluences<T>& influences,
+                         const Vector3Array<T>& positions, const Vector3Array<T>& normals,
+                         Vector3Array<T>& outPositions, Vector3Array<T>& outNormals, unsigned threads = 1)
+{
+  tvml::detail::skin<tvml::detail::SkinDQKernel, T>(bones->data(), 8, influences, positions, &normals,
+                                                     outPositions, &outNormals, threads);
+}
+
+/// Linear blend skinning of positions. out may be positions.
+template<typename T>
+void skinMatrices(const Matrix4x4<T>* bones, const SkinInfluences<T>& influences,
+                  const Vector3Array<T>& positions, Vector3Array<T>& out, unsigned threads = 1)
+{
+  tvml::detail::skin<tvml::detail::SkinMatrixKernel, T>(bones->data(), 16, influences, positions, nullptr,
+                                                         out, nullptr, threads);
+}
+
+/// Linear blend skinning of positions and normals
+template<typename T>
+void skinMatrices(const Matrix4x4<T>* bones, const SkinInfluences<T>& influences,
+                  const Vector3Array<T>& positions, const Vector3Array<T>& normals,
+                  Vector3Array<T>& outPositions, Vector3Array<T>& outNormals, unsigned threads = 1)
+{
+  tvml::detail::skin<tvml::detail::SkinMatrixKernel, T>(bones->data(), 16, influences, positions, &normals,
+                                                         outPositions, &outNormals, threads);
+}
+
+typedef SkinInfluences<float>  SkinInfluencesf;
+typedef SkinInfluences<double> SkinInfluencesd;
+
+#endif // SKINNING_H
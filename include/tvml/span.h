@@ -0,0 +1,67 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cassert>
+#include <cstddef>
+
+/// Non-owning view of contiguous objects, the C++14 stand-in for std::span
+
+namespace tvml
+{
+
+template<typename T>
+class Span
+{
+public:
+  constexpr Span():ptr(nullptr),n(0){}
+  constexpr Span(T* data, size_t size):ptr(data),n(size){}
+
+  /// Span<const T> from Span<T>
+  template<class U>
+  constexpr Span(const Span<U>& s):ptr(s.data()),n(s.size()){}
+
+  constexpr T*     data()  const { return ptr; }
+  constexpr size_t size()  const { return n; }
+  constexpr bool   empty() const { return n == 0; }
+
+  constexpr T* begin() const { return ptr; }
+  constexpr T* end()   const { return ptr + n; }
+
+  T& operator[](size_t i) const{
+    assert(i < n);
+    return ptr[i];
+  }
+
+  Span subspan(size_t offset, size_t count) const{
+    assert(offset <= n && count <= n - offset);
+    return Span(ptr + offset, count);
+  }
+
+private:
+  T* ptr;
+  size_t n;
+};
+
+} // namespace tvml
+
+#endif // SPAN_H
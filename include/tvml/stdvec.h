@@ -24,6 +24,7 @@
 #include "Vector2.h"
 #include "Vector3.h"
 #include "Vector4.h"
+#include "half.h"
 
 /// Opencl/cuda naming
 
@@ -41,6 +42,7 @@ typedef Vector2<uint64_t>  ulong2;
 
 typedef Vector2<float>     float2;
 typedef Vector2<double>    double2;
+typedef Vector2<half>      half2;
 
 
 typedef Vector3<char>      char3;
@@ -57,6 +59,7 @@ typedef Vector3<uint64_t>  ulong3;
 
 typedef Vector3<float>     float3;
 typedef Vector3<double>    double3;
+typedef Vector3<half>      half3;
 
 
 typedef Vector4<char>      char4;
@@ -73,6 +76,7 @@ typedef Vector4<uint64_t>  ulong4;
 
 typedef Vector4<float>     float4;
 typedef Vector4<double>    double4;
+typedef Vector4<half>      half4;
 
 /// Opengl naming
 typedef Vector2<int32_t> ivec2;
@@ -0,0 +1,941 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Compile with g++ -std=c++14 -O3 -pthread bench.cpp -I ../include -o bench
+ *
+ * ./bench [--filter text] [--json file] [--samples n] [--min-time-ms x]
+ *         [--warmup-ms x] [--quick]
+ */
+
+#include "bench.h"
+
+#include <tvml/stdvec.h>
+#include <tvml/stdmat.h>
+#include <tvml/quart.h>
+#include <tvml/cpu.h>
+#include <tvml/VectorArray.h>
+#include <tvml/batch.h>
+#include <tvml/QuarternionArray.h>
+#include <tvml/expr.h>
+#include <tvml/aligned.h>
+#include <tvml/binary.h>
+#include <tvml/hierarchy.h>
+#include <tvml/TransformArray.h>
+#include <tvml/skinning.h>
+#include <tvml/quantize.h>
+#include <tvml/half.h>
+#include <tvml/bounds.h>
+#include <tvml/bvh.h>
+#include <tvml/kdtree.h>
+#include <tvml/hashgrid.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+using bench::Runner;
+using bench::keep;
+using bench::clobber;
+
+/// Elements per throughput pass (stays in L1) and per batched call
+static const size_t N = 256;
+static const size_t BATCH = 4096;
+
+/// Deterministic inputs: 1..9 for integers (nothing divides by zero), [-1,1] otherwise
+template<typename T>
+inline T value(size_t i, int k)
+{
+  if(std::is_integral<T>::value)
+    return T(1 + (i*7 + k*3) % 9);
+  return T(std::sin(double(i*7 + k*13 + 1)));
+}
+
+template<typename V>
+inline V vec(size_t i, int dim, int k = 0)
+{
+  V v{};
+  for(int d=0; d<dim; d++)
+    v[d] = value<typename std::remove_reference<decltype(v[0])>::type>(i, k + d);
+  return v;
+}
+
+/// Diagonally dominant, so never singular
+template<typename M>
+inline M mat(size_t i, int dim, int k = 0)
+{
+  M m;
+  for(int d=0; d<dim*dim; d++)
+    m[d] = value<typename std::remove_reference<decltype(m[0])>::type>(i, k + d) + (d % (dim+1) ? 0 : 20);
+  return m;
+}
+
+template<typename T>
+inline Quarternion<T> quat(size_t i, int k = 0)
+{
+  Vector3<T> axis = vec< Vector3<T> >(i, 3, k);
+  return Quarternion<T>(T(value<T>(i, k+3)*3), axis.normal());
+}
+
+/// f(i) for every i < N, per pass. Reported per call.
+template<typename F>
+inline void throughput(Runner& r, const string& name, const string& type, F f)
+{
+  r.run(name, type, "throughput", N, [&](size_t iters){
+    for(size_t k=0; k<iters; k++){
+      for(size_t i=0; i<N; i++)
+        f(i);
+      clobber();
+    }
+  });
+}
+
+/// v = step(v), every call depends on the previous one
+template<typename V, typename F>
+inline void latency(Runner& r, const string& name, const string& type, const V& start, F step)
+{
+  r.run(name, type, "latency", 1, [&](size_t iters){
+    V v = start;
+    for(size_t k=0; k<iters; k++)
+      v = step(v);
+    keep(v);
+  });
+}
+
+/// f() processes n elements per call
+template<typename F>
+inline void batch(Runner& r, const string& name, const string& type, size_t n, F f)
+{
+  r.run(name, type, "batch", n, [&](size_t iters){
+    for(size_t k=0; k<iters; k++){
+      f();
+      clobber();
+    }
+  });
+}
+
+/// Vector2/3/4 operators
+template<typename T, template<class> class Vec>
+inline void benchVector(Runner& r, const string& cls, const string& type, int dim)
+{
+  typedef Vec<T> V;
+  vector<V> a(N), b(N), out(N);
+  vector<T> s(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = vec<V>(i, dim);
+    b[i] = vec<V>(i, dim, 5);
+  }
+  T three = 3;
+
+  throughput(r, cls + "/add",       type, [&](size_t i){ out[i] = a[i] + b[i]; });
+  throughput(r, cls + "/sub",       type, [&](size_t i){ out[i] = a[i] - b[i]; });
+  throughput(r, cls + "/mul_scalar",type, [&](size_t i){ out[i] = a[i] * three; });
+  throughput(r, cls + "/div_scalar",type, [&](size_t i){ out[i] = a[i] / three; });
+  throughput(r, cls + "/dot",       type, [&](size_t i){ s[i] = a[i] * b[i]; });
+  throughput(r, cls + "/magnitude", type, [&](size_t i){ s[i] = a[i].magnitude(); });
+  throughput(r, cls + "/normal",    type, [&](size_t i){ out[i] = a[i].normal(); });
+
+  V zero = vec<V>(0, dim), unit = zero;
+  for(int d=0; d<dim; d++){
+    zero[d] = 0;
+    unit[d] = d == 0;
+  }
+  T one = 1;
+  latency(r, cls + "/add",        type, a[0], [&](const V& v){ keep(zero); return v + zero; });
+  latency(r, cls + "/mul_scalar", type, a[0], [&](const V& v){ keep(one); return v * one; });
+  latency(r, cls + "/div_scalar", type, a[0], [&](const V& v){ keep(one); return v / one; });
+  latency(r, cls + "/dot",        type, unit, [&](V v){ keep(unit); v[0] = v * unit; return v; });
+  latency(r, cls + "/magnitude",  type, unit, [&](V v){ v[0] = v.magnitude(); return v; });
+  latency(r, cls + "/normal",     type, unit, [&](const V& v){ return v.normal(); });
+}
+
+template<typename T>
+inline void benchCross(Runner& r, const string& type)
+{
+  typedef Vector3<T> V;
+  vector<V> a(N), b(N), out(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = vec<V>(i, 3);
+    b[i] = vec<V>(i, 3, 5);
+  }
+  throughput(r, "Vector3/cross", type, [&](size_t i){ out[i] = a[i].cross(b[i]); });
+
+  V ez(0,0,1);
+  latency(r, "Vector3/cross", type, V(1,0,0), [&](const V& v){ keep(ez); return v.cross(ez); });
+}
+
+/// Matrix3x3 and Matrix4x4 operators
+template<typename M, typename V>
+inline void benchMatrix(Runner& r, const string& cls, const string& type, int dim, const M& rotation)
+{
+  vector<M> a(N), b(N), out(N);
+  vector<V> v(N), vout(N);
+  vector<typename std::remove_reference<decltype(a[0][0])>::type> s(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = mat<M>(i, dim);
+    b[i] = mat<M>(i, dim, 3);
+    v[i] = vec<V>(i, 3);
+  }
+
+  throughput(r, cls + "/mul",       type, [&](size_t i){ out[i] = a[i] * b[i]; });
+  throughput(r, cls + "/mul_vec3",  type, [&](size_t i){ vout[i] = a[i] * v[i]; });
+  throughput(r, cls + "/transpose", type, [&](size_t i){ out[i] = a[i].transpose(); });
+  throughput(r, cls + "/det",       type, [&](size_t i){ s[i] = a[i].det(); });
+  throughput(r, cls + "/inverse",   type, [&](size_t i){ out[i] = a[i].inverse(); });
+
+  M id = M::Identity;
+  latency(r, cls + "/mul",       type, a[0], [&](const M& m){ keep(id); return m * id; });
+  latency(r, cls + "/mul_vec3",  type, v[0], [&](const V& x){ keep(id); return id * x; });
+  latency(r, cls + "/transpose", type, a[0], [&](const M& m){ return m.transpose(); });
+  latency(r, cls + "/det",       type, id,   [&](M m){ m[0] = m.det(); return m; });
+  latency(r, cls + "/inverse",   type, rotation, [&](const M& m){ return m.inverse(); });
+}
+
+template<typename T>
+inline void benchMatrix4Extra(Runner& r, const string& type)
+{
+  typedef Matrix4x4<T> M;
+  typedef Vector4<T> V;
+  vector<M> a(N), out(N);
+  vector<V> v(N), vout(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = mat<M>(i, 4);
+    a[i][12] = a[i][13] = a[i][14] = 0;
+    a[i][15] = 1;
+    v[i] = vec<V>(i, 4);
+  }
+  throughput(r, "Matrix4x4/mul_vec4",      type, [&](size_t i){ vout[i] = a[i] * v[i]; });
+  throughput(r, "Matrix4x4/inverseAffine", type, [&](size_t i){ out[i] = a[i].inverseAffine(); });
+  throughput(r, "Matrix4x4/inverseRigid",  type, [&](size_t i){ out[i] = a[i].inverseRigid(); });
+
+  M id = M::Identity;
+  latency(r, "Matrix4x4/mul_vec4", type, v[0], [&](const V& x){ keep(id); return id * x; });
+}
+
+/// Aligned variants of the hot matrix ops
+template<typename T>
+inline void benchAligned(Runner& r, const string& type)
+{
+  vector< Matrix4x4a<T>, tvml::aligned_allocator< Matrix4x4a<T> > > a(N), b(N), out(N);
+  vector< Vector4a<T>, tvml::aligned_allocator< Vector4a<T> > > v(N), vout(N);
+  vector< Vector3a<T>, tvml::aligned_allocator< Vector3a<T> > > p(N), pout(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = mat< Matrix4x4<T> >(i, 4);
+    b[i] = mat< Matrix4x4<T> >(i, 4, 3);
+    v[i] = vec< Vector4<T> >(i, 4);
+    p[i] = vec< Vector3<T> >(i, 3);
+  }
+  throughput(r, "Matrix4x4a/mul",      type, [&](size_t i){ out[i] = a[i] * b[i]; });
+  throughput(r, "Matrix4x4a/mul_vec3", type, [&](size_t i){ pout[i] = a[i] * p[i]; });
+  throughput(r, "Matrix4x4a/mul_vec4", type, [&](size_t i){ vout[i] = a[i] * v[i]; });
+  throughput(r, "Vector4a/add",        type, [&](size_t i){ vout[i] = v[i] + v[N-1-i]; });
+}
+
+template<typename T>
+inline void benchQuarternion(Runner& r, const string& type)
+{
+  typedef Quarternion<T> Q;
+  vector<Q> a(N), b(N), out(N);
+  vector< Vector3<T> > v(N), vout(N);
+  vector< Matrix3x3<T> > m(N);
+  vector< Matrix4x4<T> > m4(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = quat<T>(i);
+    b[i] = quat<T>(i, 7);
+    v[i] = vec< Vector3<T> >(i, 3);
+  }
+  T t = T(0.3);
+
+  throughput(r, "Quarternion/mul",       type, [&](size_t i){ out[i] = a[i] * b[i]; });
+  throughput(r, "Quarternion/rotate",    type, [&](size_t i){ vout[i] = a[i].rotate(v[i]); });
+  throughput(r, "Quarternion/to_mat3",   type, [&](size_t i){ m[i] = a[i]; });
+  throughput(r, "Quarternion/to_mat4",   type, [&](size_t i){ m4[i] = a[i]; });
+  throughput(r, "Quarternion/nlerp",     type, [&](size_t i){ out[i] = nlerp(a[i], b[i], t); });
+  throughput(r, "Quarternion/slerp",     type, [&](size_t i){ out[i] = slerp(a[i], b[i], t); });
+  throughput(r, "Quarternion/slerpFast", type, [&](size_t i){ out[i] = slerpFast(a[i], b[i], t); });
+
+  // t = 2 reflects across b, so the chain keeps its angle to b
+  Q q = b[1];
+  T t2 = 2;
+  latency(r, "Quarternion/mul",       type, a[0], [&](const Q& x){ keep(q); return x * q; });
+  latency(r, "Quarternion/rotate",    type, v[0], [&](const Vector3<T>& x){ keep(q); return q.rotate(x); });
+  latency(r, "Quarternion/nlerp",     type, a[0], [&](const Q& x){ keep(t2); return nlerp(x, q, t2); });
+  latency(r, "Quarternion/slerp",     type, a[0], [&](const Q& x){ keep(t2); return slerp(x, q, t2); });
+  latency(r, "Quarternion/slerpFast", type, a[0], [&](const Q& x){ keep(t2); return slerpFast(x, q, t2); });
+}
+
+/// normal() against the rsqrt based normalFast() at each precision
+template<typename T>
+inline void benchFastNormal(Runner& r, const string& type)
+{
+  vector< Vector3<T> > a(N), out(N);
+  vector< Vector4<T> > a4(N), out4(N);
+  vector< Quarternion<T> > q(N), qout(N);
+  for(size_t i=0; i<N; i++){
+    a[i] = vec< Vector3<T> >(i, 3);
+    a4[i] = vec< Vector4<T> >(i, 4);
+    q[i] = quat<T>(i)*T(1.5);
+  }
+  const size_t n = BATCH;
+  vector< Vector3<T> > p(n);
+  for(size_t i=0; i<n; i++)
+    p[i] = vec< Vector3<T> >(i, 3);
+  Vector3Array<T> pa(p.data(), n), pout(n);
+
+  const tvml::Precision modes[3] = { tvml::Precision::Approx, tvml::Precision::Refined, tvml::Precision::Exact };
+  const char* names[3] = { "approx", "refined", "exact" };
+  Vector3<T> unit(1, 0, 0);
+  for(int k=0; k<3; k++){
+    tvml::Precision m = modes[k];
+    string suffix = string("/normalFast_") + names[k];
+    throughput(r, "Vector3" + suffix, type, [&](size_t i){ out[i] = a[i].normalFast(m); });
+    throughput(r, "Vector4" + suffix, type, [&](size_t i){ out4[i] = a4[i].normalFast(m); });
+    throughput(r, "Quarternion" + suffix, type, [&](size_t i){ qout[i] = q[i].normalFast(m); });
+    latency(r, "Vector3" + suffix, type, unit, [&](const Vector3<T>& v){ return v.normalFast(m); });
+    batch(r, "Vector3Array" + suffix, type, n, [&]{ normalFast(pa, pout, m); });
+  }
+}
+
+/// Batched APIs, per element
+template<typename T>
+inline void benchBatched(Runner& r, const string& type)
+{
+  const size_t n = BATCH;
+  vector< Vector3<T> > p(n), pout(n);
+  vector< Vector4<T> > p4(n), p4out(n);
+  vector< Quarternion<T> > qa(n), qb(n);
+  for(size_t i=0; i<n; i++){
+    p[i] = vec< Vector3<T> >(i, 3);
+    p4[i] = vec< Vector4<T> >(i, 4);
+    qa[i] = quat<T>(i);
+    qb[i] = quat<T>(i, 7);
+  }
+  Vector3Array<T> a(p.data(), n), b(p.data(), n), out(n);
+  Vector4Array<T> a4(p4.data(), n), out4(n);
+  vector<T> s(n);
+  Matrix4x4<T> m = mat< Matrix4x4<T> >(0, 4);
+  Matrix3x3<T> m3 = mat< Matrix3x3<T> >(0, 3);
+
+  batch(r, "Vector3Array/add",    type, n, [&]{ add(a, b, out); });
+  batch(r, "Vector3Array/dot",    type, n, [&]{ dot(a, b, s.data()); });
+  batch(r, "Vector3Array/cross",  type, n, [&]{ cross(a, b, out); });
+  batch(r, "Vector3Array/normal", type, n, [&]{ normal(a, out); });
+  batch(r, "Vector4Array/add",    type, n, [&]{ add(a4, a4, out4); });
+  batch(r, "Vector4Array/dot",    type, n, [&]{ dot(a4, a4, s.data()); });
+  batch(r, "Vector4Array/normal", type, n, [&]{ normal(a4, out4); });
+
+  batch(r, "transformPoints",         type, n, [&]{ transformPoints(m, p.data(), pout.data(), n); });
+  batch(r, "transformPoints_soa",     type, n, [&]{ transformPoints(m, a, out); });
+  batch(r, "transformDirections",     type, n, [&]{ transformDirections(m, p.data(), pout.data(), n); });
+  batch(r, "transformVectors_mat4",   type, n, [&]{ transformVectors(m, p4.data(), p4out.data(), n); });
+  batch(r, "transformVectors_mat3",   type, n, [&]{ transformVectors(m3, p.data(), pout.data(), n); });
+  batch(r, "transformHomogeneous",    type, n, [&]{ transformHomogeneous(m, p4.data(), pout.data(), n); });
+
+  vector< Matrix3x3<T> > m3s(n), m3out(n);
+  vector<char> singular(n);
+  for(size_t i=0; i<n; i++)
+    m3s[i] = mat< Matrix3x3<T> >(i, 3);
+  batch(r, "Matrix3x3/determinants", type, n, [&]{ determinants(m3s.data(), s.data(), n); });
+  batch(r, "Matrix3x3/adjugates",    type, n, [&]{ adjugates(m3s.data(), m3out.data(), n); });
+  batch(r, "Matrix3x3/inverses",     type, n, [&]{
+    size_t bad = inverses(m3s.data(), m3out.data(), reinterpret_cast<bool*>(singular.data()), n);
+    keep(bad);
+  });
+
+  const size_t big = n*32;
+  vector< Vector3<T> > bp(big), bout(big);
+  for(size_t i=0; i<big; i++)
+    bp[i] = p[i % n];
+  batch(r, "transformPoints_threaded", type, big, [&]{ transformPoints(m, bp.data(), bout.data(), big, 0); });
+
+  QuarternionArray<T> A(qa.data(), n), B(qb.data(), n), Q(n);
+  QuarternionArray<T> poses[4] = {A, B, A, B};
+  T weights[4] = {T(0.1), T(0.2), T(0.3), T(0.4)};
+  batch(r, "QuarternionArray/rotate",      type, n, [&]{ rotate(qa[0], a, out); });
+  batch(r, "QuarternionArray/rotate_each", type, n, [&]{ rotate(A, a, out); });
+  batch(r, "QuarternionArray/nlerp",       type, n, [&]{ nlerp(A, B, T(0.3), Q); });
+  batch(r, "QuarternionArray/slerp",       type, n, [&]{ slerp(A, B, T(0.3), Q); });
+  batch(r, "QuarternionArray/slerpFast",   type, n, [&]{ slerpFast(A, B, T(0.3), Q); });
+  batch(r, "QuarternionArray/blend4",      type, n, [&]{ blend(poses, weights, 4, Q); });
+}
+
+/// out = a*s + b*t - c*u + d*v - a/w + b, eager vs tvml::lazy, per matrix
+template<typename T>
+inline void benchExpr(Runner& r, const string& type)
+{
+  const size_t n = BATCH;
+  vector< Matrix4x4<T> > a(n), b(n), c(n), d(n), out(n);
+  for(size_t i=0; i<n; i++){
+    a[i] = mat< Matrix4x4<T> >(i, 4);
+    b[i] = mat< Matrix4x4<T> >(i, 4, 1);
+    c[i] = mat< Matrix4x4<T> >(i, 4, 2);
+    d[i] = mat< Matrix4x4<T> >(i, 4, 3);
+  }
+
+  batch(r, "Matrix4x4/expr_chain_eager", type, n, [&]{
+    const T s = T(1.5), t = T(-0.75), u = T(2), v = T(0.125), w = T(3);
+    for(size_t i=0; i<n; i++)
+      out[i] = a[i]*s + b[i]*t - c[i]*u + d[i]*v - a[i]/w + b[i];
+  });
+  batch(r, "Matrix4x4/expr_chain_lazy", type, n, [&]{
+    using tvml::lazy;
+    const T s = T(1.5), t = T(-0.75), u = T(2), v = T(0.125), w = T(3);
+    for(size_t i=0; i<n; i++)
+      out[i] = lazy(a[i])*s + lazy(b[i])*t - lazy(c[i])*u + lazy(d[i])*v - lazy(a[i])/w + b[i];
+  });
+}
+
+/// Text output: repr() allocates, format_to/format_array write into a caller buffer
+template<typename T>
+inline void benchFormat(Runner& r, const string& type)
+{
+  vector< Vector3<T> > v(N);
+  vector< Matrix4x4<T> > m(N);
+  for(size_t i=0; i<N; i++){
+    v[i] = vec< Vector3<T> >(i, 3);
+    m[i] = mat< Matrix4x4<T> >(i, 4);
+  }
+  static char buf[N*Matrix4x4<T>::maxFormattedSize(tvml::FormatSpec::shortest())];
+
+  throughput(r, "Vector3/repr",        type, [&](size_t i){ size_t n = v[i].repr().size(); keep(n); });
+  throughput(r, "Vector3/format_to",   type, [&](size_t i){ char* e = v[i].format_to(buf, sizeof buf).ptr; keep(e); });
+  throughput(r, "Matrix4x4/repr",      type, [&](size_t i){ size_t n = m[i].repr().size(); keep(n); });
+  throughput(r, "Matrix4x4/format_to", type, [&](size_t i){ char* e = m[i].format_to(buf, sizeof buf).ptr; keep(e); });
+  throughput(r, "Matrix4x4/format_to_shortest", type, [&](size_t i){
+    char* e = m[i].format_to(buf, sizeof buf, tvml::FormatSpec::shortest()).ptr;
+    keep(e);
+  });
+  batch(r, "Matrix4x4/format_array", type, N, [&]{
+    size_t n = tvml::format_array(buf, sizeof buf, m.data(), N).count;
+    keep(n);
+  });
+}
+
+
+/// Binary arrays: writing BATCH matrices, mapping them back plus the header check
+template<typename T>
+inline void benchBinary(Runner& r, const string& type)
+{
+  vector< Matrix4x4<T> > m(BATCH);
+  for(size_t i=0; i<BATCH; i++)
+    m[i] = mat< Matrix4x4<T> >(i, 4);
+  string path = "tvml_bench_" + type + ".bin";
+
+  batch(r, "Matrix4x4/write_binary", type, BATCH, [&]{ tvml::writeBinary(path, m.data(), BATCH); });
+  batch(r, "Matrix4x4/map_binary",   type, BATCH, [&]{
+    tvml::MappedArray< Matrix4x4<T> > in(path);
+    T first = in[0][0];
+    keep(first);
+  });
+  std::remove(path.c_str());
+}
+
+/// Transform against the Matrix4x4 it replaces
+template<typename T>
+inline void benchTransform(Runner& r, const string& type)
+{
+  typedef Transform<T> TRS;
+  typedef Matrix4x4<T> Mat;
+  vector<TRS> a(BATCH), b(BATCH), out(BATCH);
+  vector<Mat> ma(BATCH), mb(BATCH), mout(BATCH);
+  vector< Vector3<T> > v(BATCH), vout(BATCH);
+  for(size_t i=0; i<BATCH; i++){
+    a[i] = TRS(vec< Vector3<T> >(i, 3), quat<T>(i), T(1.5));
+    b[i] = TRS(vec< Vector3<T> >(i, 3, 4), quat<T>(i, 7), T(0.5));
+    ma[i] = Mat(a[i]);
+    mb[i] = Mat(b[i]);
+    v[i] = vec< Vector3<T> >(i, 3, 9);
+  }
+
+  throughput(r, "Transform/compose",        type, [&](size_t i){ out[i] = a[i] * b[i]; });
+  throughput(r, "Matrix4x4/compose",        type, [&](size_t i){ mout[i] = ma[i] * mb[i]; });
+  throughput(r, "Transform/inverse",        type, [&](size_t i){ out[i] = a[i].inverse(); });
+  throughput(r, "Transform/transformPoint", type, [&](size_t i){ vout[i] = a[i] * v[i]; });
+  throughput(r, "Transform/to_mat4",        type, [&](size_t i){ mout[i] = Mat(a[i]); });
+  throughput(r, "Transform/from_mat4",      type, [&](size_t i){ out[i] = TRS(ma[i]); });
+
+  TransformArray<T> sa(a.data(), BATCH), sb(b.data(), BATCH), sout(BATCH);
+  Vector3Array<T> va(v.data(), BATCH), vaout(BATCH);
+  const size_t n = BATCH;
+  batch(r, "Transform/compose",         type, n, [&]{ compose(sa, sb, sout); });
+  batch(r, "Transform/compose_parent",  type, n, [&]{ compose(a[0], sb, sout); });
+  batch(r, "Transform/inverse",         type, n, [&]{ inverse(sa, sout); });
+  batch(r, "Transform/transformPoints", type, n, [&]{ transformPoints(a[0], va, vaout); });
+  batch(r, "Transform/transformPoints_each", type, n, [&]{ transformPoints(sa, va, vaout); });
+  batch(r, "Transform/toMatrices",      type, n, [&]{ toMatrices(sa, mout.data()); });
+  batch(r, "Matrix4x4/transformPoints", type, n, [&]{ transformPoints(ma[0], va, vaout); });
+}
+
+/// 200k node scene (4-ary trees). Per frame 5% of the nodes move, all of them leaves,
+/// so 5% of the world matrices change.
+template<typename T>
+inline void benchHierarchy(Runner& r, const string& type)
+{
+  const size_t n = 200000;
+  typedef TransformHierarchy<T> H;
+  H h;
+  h.reserve(n);
+  for(size_t i=0; i<n; i++){
+    typename H::Handle parent = i % 1000 == 0 ? H::NO_PARENT : typename H::Handle((i - 1)/4);
+    h.add(parent, vec< Vector3<T> >(i, 3), quat<T>(i));
+  }
+  h.update();
+
+  vector< Matrix4x4<T> > moved;
+  for(size_t i=n/4; i<n; i+=15)
+    moved.push_back(h.local(i));
+  auto frame = [&](unsigned threads){
+    for(size_t k=0; k<moved.size(); k++)
+      h.setLocal(typename H::Handle(n/4 + k*15), moved[k]);
+    h.update(threads);
+  };
+
+  batch(r, "TransformHierarchy/full",               type, n, [&]{ h.updateAll(); });
+  batch(r, "TransformHierarchy/incremental",        type, n, [&]{ frame(1); });
+  batch(r, "TransformHierarchy/full_threads",       type, n, [&]{ h.updateAll(0); });
+  batch(r, "TransformHierarchy/incremental_threads",type, n, [&]{ frame(0); });
+}
+
+/// 64 bones, 4 influences per vertex
+template<typename T>
+inline void benchSkinning(Runner& r, const string& type)
+{
+  const size_t n = 65536;
+  const int bones = 64, influences = 4;
+  vector< DualQuaternion<T> > dq(bones);
+  vector< Matrix4x4<T> > mat(bones);
+  for(int b=0; b<bones; b++){
+    dq[b] = DualQuaternion<T>(quat<T>(b), vec< Vector3<T> >(b, 3));
+    mat[b] = Matrix4x4<T>(dq[b]);
+  }
+  SkinInfluences<T> inf(n, influences);
+  Vector3Array<T> pos(n), nrm(n), outPos(n), outNrm(n);
+  for(size_t i=0; i<n; i++){
+    pos.set(i, vec< Vector3<T> >(i, 3));
+    nrm.set(i, vec< Vector3<T> >(i, 3, 5).normal());
+    for(int k=0; k<influences; k++)
+      inf.set(i, k, typename SkinInfluences<T>::Bone((i/16 + k*5) % bones), T(0.25));
+  }
+
+  vector< Vector3<T> > v(n), vout(n);
+  pos.copyTo(v.data());
+  auto blend = [&](size_t i){
+    Matrix4x4<T> m = mat[inf.bone(i,0)]*inf.weight(i,0);
+    for(int k=1; k<influences; k++)
+      m = m + mat[inf.bone(i,k)]*inf.weight(i,k);
+    vout[i] = m*v[i];
+  };
+  batch(r, "skinning/matrices_scalar",            type, n, [&]{ for(size_t i=0; i<n; i++) blend(i); });
+  batch(r, "skinning/matrices",                   type, n, [&]{ skinMatrices(mat.data(), inf, pos, outPos); });
+  batch(r, "skinning/matrices_normals",           type, n, [&]{ skinMatrices(mat.data(), inf, pos, nrm, outPos, outNrm); });
+  batch(r, "skinning/dual_quaternions",           type, n, [&]{ skinDualQuaternions(dq.data(), inf, pos, outPos); });
+  batch(r, "skinning/dual_quaternions_normals",   type, n, [&]{ skinDualQuaternions(dq.data(), inf, pos, nrm, outPos, outNrm); });
+  batch(r, "skinning/dual_quaternions_threads",   type, n, [&]{ skinDualQuaternions(dq.data(), inf, pos, outPos, 0); });
+}
+
+template<typename T, class Packed, class V>
+inline void benchCodec(Runner& r, const string& cls, const string& type, const vector<V>& in)
+{
+  const size_t n = in.size();
+  vector<Packed> packed(n);
+  vector<V> out(n);
+  encode(in.data(), packed.data(), n);
+  throughput(r, cls + "/encode_each", type, [&](size_t i){ packed[i] = Packed(in[i]); });
+  throughput(r, cls + "/decode_each", type, [&](size_t i){ out[i] = V(packed[i]); });
+  batch(r, cls + "/encode", type, n, [&]{ encode(in.data(), packed.data(), n); });
+  batch(r, cls + "/decode", type, n, [&]{ decode(packed.data(), out.data(), n); });
+}
+
+template<typename T>
+inline void benchQuantize(Runner& r, const string& type)
+{
+  vector< Quarternion<T> > q(BATCH);
+  vector< Vector3<T> > v(BATCH);
+  for(size_t i=0; i<BATCH; i++){
+    q[i] = quat<T>(i);
+    v[i] = vec< Vector3<T> >(i, 3).normal();
+  }
+  benchCodec<T, quart32>(r, "quart32", type, q);
+  benchCodec<T, quart48>(r, "quart48", type, q);
+  benchCodec<T, quart64>(r, "quart64", type, q);
+  benchCodec<T, oct16>(r, "oct16", type, v);
+  benchCodec<T, oct32>(r, "oct32", type, v);
+}
+
+/// half conversions, one value at a time, in bulk and in bulk without F16C
+inline void benchHalf(Runner& r)
+{
+  const size_t n = 4*BATCH;
+  vector<float> f(n);
+  vector<half> h(n);
+  for(size_t i=0; i<n; i++)
+    f[i] = value<float>(i, 0);
+  convert(f.data(), h.data(), n);
+  uint16_t* bits = reinterpret_cast<uint16_t*>(h.data());
+  throughput(r, "half/to_half_each", "half", [&](size_t i){ h[i] = half(f[i]); });
+  throughput(r, "half/to_float_each", "half", [&](size_t i){ f[i] = h[i]; });
+  batch(r, "half/to_half_software", "half", n, [&]{ tvml::detail::toHalf_scalar(f.data(), bits, n); });
+  batch(r, "half/to_float_software", "half", n, [&]{ tvml::detail::toFloat_scalar(bits, f.data(), n); });
+  batch(r, "half/to_half", "half", n, [&]{ convert(f.data(), h.data(), n); });
+  batch(r, "half/to_float", "half", n, [&]{ convert(h.data(), f.data(), n); });
+
+  vector<float4> v(BATCH);
+  vector<half4> hv(BATCH);
+  for(size_t i=0; i<BATCH; i++)
+    v[i] = vec<float4>(i, 4);
+  batch(r, "half4/from_float4", "half", BATCH, [&]{ convert(v.data(), hv.data(), BATCH); });
+  batch(r, "half4/to_float4", "half", BATCH, [&]{ convert(hv.data(), v.data(), BATCH); });
+}
+
+template<typename T>
+inline void benchBounds(Runner& r, const string& type)
+{
+  typedef Vector3<T> V;
+  Matrix4x4<T> proj = { T(1.2), 0, 0, 0,
+                        0, T(1.8), 0, 0,
+                        0, 0, T(-1.01), T(-1.0),
+                        0, 0, -1, 0 };
+  Matrix4x4<T> vp = proj*tvml::detail::composeTRS(V(0,0,-10), quat<T>(1), V(1,1,1));
+  Frustum<T> f(vp);
+
+  // about half of them visible, the 500k objects per view case for the threaded run
+  const size_t big = 500000;
+  vector< AABB<T> > boxes(big);
+  vector< Sphere<T> > spheres(big);
+  for(size_t i=0; i<big; i++){
+    V c = vec<V>(i, 3)*T(12), e = vec<V>(i, 3, 5)*T(0.5) + V(1,1,1);
+    boxes[i] = AABB<T>(c - e, c + e);
+    spheres[i] = Sphere<T>(c, e.x);
+  }
+  AABBArray<T> soa(boxes.data(), BATCH), all(boxes.data(), big), moved;
+  SphereArray<T> sphereSoa(spheres.data(), BATCH);
+  vector<uint32_t> bits(cullMaskWords(big));
+  vector< AABB<T> > out(N);
+  Matrix4x4<T> m = mat< Matrix4x4<T> >(3, 4);
+
+  throughput(r, "AABB/transform_corners", type, [&](size_t i){
+    AABB<T> b = AABB<T>::Empty;
+    for(int c=0; c<8; c++)
+      b.extend(m*V(c & 1 ? boxes[i].max.x : boxes[i].min.x, c & 2 ? boxes[i].max.y : boxes[i].min.y,
+                   c & 4 ? boxes[i].max.z : boxes[i].min.z));
+    out[i] = b;
+  });
+  throughput(r, "AABB/transformed", type, [&](size_t i){ out[i] = boxes[i].transformed(m); });
+  batch(r, "AABB/transform_boxes", type, BATCH, [&]{ transformBoxes(m, soa, moved); });
+
+  throughput(r, "Frustum/visible_box", type, [&](size_t i){ bits[i] = f.visible(boxes[i]); });
+  throughput(r, "Frustum/visible_sphere", type, [&](size_t i){ bits[i] = f.visible(spheres[i]); });
+  batch(r, "Frustum/cull_boxes", type, BATCH, [&]{ cull(f, soa, bits.data()); });
+  batch(r, "Frustum/cull_spheres", type, BATCH, [&]{ cull(f, sphereSoa, bits.data()); });
+  batch(r, "Frustum/cull_boxes_500k", type, big, [&]{ cull(f, all, bits.data()); });
+  batch(r, "Frustum/cull_boxes_500k_threads", type, big, [&]{ cull(f, all, bits.data(), 0); });
+}
+
+/// UV sphere of radius 1, rows*cols*2 triangles
+template<typename T>
+inline void sphereMesh(int rows, int cols, vector< Vector3<T> >& v, vector<uint32_t>& idx)
+{
+  for(int i=0; i<=rows; i++)
+    for(int j=0; j<cols; j++){
+      double a = M_PI*i/rows, b = 2*M_PI*j/cols;
+      v.push_back(Vector3<T>(T(std::sin(a)*std::cos(b)), T(std::sin(a)*std::sin(b)), T(std::cos(a))));
+    }
+  for(int i=0; i<rows; i++)
+    for(int j=0; j<cols; j++){
+      uint32_t p = i*cols + j, q = i*cols + (j+1) % cols;
+      uint32_t t[6] = { p, p + cols, q, q, p + cols, q + cols };
+      idx.insert(idx.end(), t, t + 6);
+    }
+}
+
+template<typename T>
+inline void benchBVH(Runner& r, const string& type)
+{
+  typedef Vector3<T> V;
+  vector<V> v, small;
+  vector<uint32_t> idx, smallIdx;
+  sphereMesh<T>(128, 256, v, idx);
+  sphereMesh<T>(16, 32, small, smallIdx);
+  const size_t tris = idx.size()/3, smallTris = smallIdx.size()/3;
+  BVH<T> bvh(v.data(), idx.data(), tris), smallBvh(small.data(), smallIdx.data(), smallTris);
+
+  // from outside towards points near the sphere, most of them hit
+  vector< Ray<T> > rays(BATCH);
+  vector< Hit<T> > hits(BATCH);
+  vector<uint8_t> any(BATCH);
+  for(size_t i=0; i<BATCH; i++){
+    V o = vec<V>(i, 3)*T(3) + V(0,0,4);
+    rays[i] = Ray<T>(o, vec<V>(i, 3, 7)*T(0.8) - o);
+  }
+
+  batch(r, "BVH/build_65k", type, tris, [&]{ bvh.build(v.data(), idx.data(), tris); });
+  batch(r, "BVH/build_65k_threads", type, tris, [&]{ bvh.build(v.data(), idx.data(), tris, 0); });
+  throughput(r, "BVH/closest_hit", type, [&](size_t i){ hits[i] = bvh.closestHit(rays[i]); });
+  throughput(r, "BVH/any_hit", type, [&](size_t i){ any[i] = bvh.anyHit(rays[i]); });
+  throughput(r, "BVH/closest_hit_1k", type, [&](size_t i){ hits[i] = smallBvh.closestHit(rays[i]); });
+  throughput(r, "BVH/brute_force_1k", type, [&](size_t i){
+    Hit<T> h;
+    h.t = rays[i].tmax; h.triangle = Hit<T>::NONE;
+    for(size_t k=0; k<smallTris; k++){
+      T t, u, w;
+      if(intersectTriangle(rays[i], small[smallIdx[3*k]], small[smallIdx[3*k+1]], small[smallIdx[3*k+2]], t, u, w)
+         && t < h.t){
+        h.t = t; h.u = u; h.v = w; h.triangle = uint32_t(k);
+      }
+    }
+    hits[i] = h;
+  });
+  batch(r, "BVH/closest_hits", type, BATCH, [&]{ closestHits(bvh, rays.data(), hits.data(), BATCH); });
+  batch(r, "BVH/closest_hits_threads", type, BATCH, [&]{ closestHits(bvh, rays.data(), hits.data(), BATCH, 0); });
+  batch(r, "BVH/any_hits", type, BATCH, [&]{ anyHits(bvh, rays.data(), any.data(), BATCH); });
+}
+
+template<typename T>
+inline void benchRayPacket(Runner& r, const string& type)
+{
+  typedef Vector3<T> V;
+  vector< RayPacket<T> > packets(N);
+  vector< TrianglePacket<T> > tris(N);
+  vector< Ray<T> > rays(8*N);
+  vector< HitPacket<T> > hits(N);
+  vector<uint32_t> masks(N);
+  for(size_t i=0; i<N; i++)
+    for(int j=0; j<8; j++){
+      V o = vec<V>(8*i + j, 3)*T(4) + V(0,0,8);
+      rays[8*i + j] = Ray<T>(o, vec<V>(8*i + j, 3, 5)*T(0.5) - o);
+      packets[i].set(j, rays[8*i + j]);
+      tris[i].set(j, vec<V>(i + j, 3, 1) - V(1,1,0), vec<V>(i + j, 3, 2) + V(1,0,0), vec<V>(i + j, 3, 3) + V(0,1,0));
+    }
+  V a(-1,-1,0), e1(2,0,0), e2(0,2,0);
+
+  // per 8 ray/triangle pairs
+  throughput(r, "Ray/8_rays_scalar", type, [&](size_t i){
+    uint32_t m = 0;
+    for(int j=0; j<8; j++)
+      if(intersectTriangle(rays[8*i + j].origin, rays[8*i + j].direction, a, e1, e2, rays[8*i + j].tmin,
+                           rays[8*i + j].tmax, hits[i].t[j], hits[i].u[j], hits[i].v[j]))
+        m |= 1u << j;
+    masks[i] = m;
+  });
+  throughput(r, "Ray/8_rays_packet", type, [&](size_t i){ masks[i] = intersectTriangle(packets[i], a, e1, e2, hits[i]); });
+  throughput(r, "Ray/8_triangles_scalar", type, [&](size_t i){
+    uint32_t m = 0;
+    for(int j=0; j<8; j++)
+      if(intersectTriangle(rays[i].origin, rays[i].direction, tris[i].a[j], tris[i].e1[j], tris[i].e2[j],
+                           rays[i].tmin, rays[i].tmax, hits[i].t[j], hits[i].u[j], hits[i].v[j]))
+        m |= 1u << j;
+    masks[i] = m;
+  });
+  throughput(r, "Ray/8_triangles_packet", type, [&](size_t i){ masks[i] = intersectTriangles(rays[i], tris[i], hits[i]); });
+}
+
+template<typename T>
+inline void benchKdTree(Runner& r, const string& type)
+{
+  typedef Vector3<T> V;
+  const size_t small = BATCH, big = 1000000;
+  vector<V> pts(big), queries(BATCH);
+  // spread through a 200^3 cube (vec() alone would put them all on one curve), queries among them
+  for(size_t i=0; i<big; i++)
+    pts[i] = V(value<T>(i, 0), value<T>(i/97, 1), value<T>(i/9409, 2))*T(100);
+  vector<V> sample(small);
+  for(size_t i=0; i<BATCH; i++){
+    queries[i] = pts[i*241 % big] + vec<V>(i, 3, 11);
+    sample[i] = pts[i*big/small];
+  }
+  KdTree<T> tree(sample.data(), small), cloud(pts.data(), big);
+  vector< Neighbor<T> > out(8*BATCH);
+  vector<uint32_t> found;
+  vector<size_t> offsets;
+
+  batch(r, "KdTree/build_4k", type, small, [&]{ tree.build(sample.data(), small); });
+  batch(r, "KdTree/build_1m", type, big, [&]{ cloud.build(pts.data(), big); });
+  batch(r, "KdTree/build_1m_threads", type, big, [&]{ cloud.build(pts.data(), big, 0); });
+
+  // what a brute force loop over the same 4k points costs
+  throughput(r, "KdTree/brute_force_nearest_4k", type, [&](size_t i){
+    T best = std::numeric_limits<T>::infinity();
+    uint32_t id = 0;
+    for(size_t j=0; j<small; j++){
+      T d = (sample[j] - queries[i]).magnitude();
+      if(d < best){ best = d; id = uint32_t(j); }
+    }
+    out[i].index = id;
+  });
+  throughput(r, "KdTree/nearest_4k", type, [&](size_t i){ out[i] = tree.nearest(queries[i]); });
+  throughput(r, "KdTree/nearest_1m", type, [&](size_t i){ out[i] = cloud.nearest(queries[i]); });
+  throughput(r, "KdTree/nearest_8_1m", type, [&](size_t i){ cloud.nearest(queries[i], 8, &out[8*i]); });
+  throughput(r, "KdTree/radius_1m", type, [&](size_t i){
+    found.clear();
+    cloud.inRadius(queries[i], T(1), found);
+  });
+  throughput(r, "KdTree/box_1m", type, [&](size_t i){
+    found.clear();
+    cloud.inBox(AABB<T>(queries[i] - V(1,1,1), queries[i] + V(1,1,1)), found);
+  });
+  batch(r, "KdTree/nearest_8_batch", type, BATCH, [&]{ nearestNeighbors(cloud, queries.data(), BATCH, 8, out.data()); });
+  batch(r, "KdTree/nearest_8_batch_threads", type, BATCH, [&]{
+    nearestNeighbors(cloud, queries.data(), BATCH, 8, out.data(), 0);
+  });
+  batch(r, "KdTree/radius_batch_threads", type, BATCH, [&]{
+    pointsInRadius(cloud, queries.data(), BATCH, T(1), offsets, found, 0);
+  });
+}
+
+/// Particles at SPH density, about 30 neighbours within one cell size
+inline void benchHashGrid(Runner& r)
+{
+  const size_t sizes[3] = { 1000000, 10000000, 50000000 };
+  const char* names[3] = { "1m", "10m", "50m" };
+  for(int s=0; s<3; s++){
+    const size_t n = sizes[s];
+    const string tag = names[s];
+    if(!r.selected("HashGrid/rebuild_" + tag, "float", "batch") && !r.selected("HashGrid/rebuild_" + tag + "_threads", "float", "batch") &&
+       !r.selected("HashGrid/neighbors_" + tag, "float", "batch") && !r.selected("HashGrid/reorder_" + tag, "float", "batch") &&
+       !(s == 0 && r.selected("HashGrid/neighbor_pairs_1m_threads", "float", "batch")))
+      continue;
+
+    float side = std::cbrt(float(n)*0.14f);
+    uint32_t seed = 1;
+    auto uniform = [&]{ seed = seed*1664525u + 1013904223u; return float(seed >> 8)/16777216.0f; };
+    vector<Vector3f> p(n), velocity(n, Vector3f(1,2,3)), sortedVelocity(n);
+    for(size_t i=0; i<n; i++)
+      p[i] = Vector3f(uniform(), uniform(), uniform())*side;
+    HashGrid<float> grid(1);
+    grid.rebuild(p.data(), n);
+
+    batch(r, "HashGrid/rebuild_" + tag, "float", n, [&]{ grid.rebuild(p.data(), n); });
+    batch(r, "HashGrid/rebuild_" + tag + "_threads", "float", n, [&]{ grid.rebuild(p.data(), n, 0); });
+    batch(r, "HashGrid/reorder_" + tag, "float", n, [&]{ grid.reorder(velocity.data(), sortedVelocity.data()); });
+
+    // a run of particles in cell order, the way a simulation step walks them
+    size_t found = 0, first = n/2;
+    batch(r, "HashGrid/neighbors_" + tag, "float", BATCH, [&]{
+      for(size_t i=first; i<first + BATCH; i++)
+        grid.forEachNeighbor(grid.positions()[i], 1.0f, [&](uint32_t, float){ found++; });
+    });
+    keep(found);
+    if(s == 0){
+      vector<uint32_t> counts(n);
+      batch(r, "HashGrid/neighbor_pairs_1m_threads", "float", n, [&]{
+        forEachNeighborPair(grid, 1.0f, [&](uint32_t i, uint32_t, float){ counts[i]++; }, 0);
+      });
+    }
+  }
+}
+
+template<typename T>
+inline void benchType(Runner& r, const string& type)
+{
+  benchVector<T, Vector2>(r, "Vector2", type, 2);
+  benchVector<T, Vector3>(r, "Vector3", type, 3);
+  benchVector<T, Vector4>(r, "Vector4", type, 4);
+  benchCross<T>(r, type);
+
+  Matrix3x3<T> r3 = {0,T(-1),0, 1,0,0, 0,0,1};
+  Matrix4x4<T> r4 = {0,T(-1),0,0, 1,0,0,0, 0,0,1,0, 0,0,0,1};
+  benchMatrix< Matrix3x3<T>, Vector3<T> >(r, "Matrix3x3", type, 3, r3);
+  benchMatrix< Matrix4x4<T>, Vector3<T> >(r, "Matrix4x4", type, 4, r4);
+  benchMatrix4Extra<T>(r, type);
+}
+
+template<typename T>
+inline void benchFloating(Runner& r, const string& type)
+{
+  benchAligned<T>(r, type);
+  benchQuarternion<T>(r, type);
+  benchFastNormal<T>(r, type);
+  benchBatched<T>(r, type);
+  benchExpr<T>(r, type);
+  benchFormat<T>(r, type);
+  benchBinary<T>(r, type);
+  benchTransform<T>(r, type);
+  benchHierarchy<T>(r, type);
+  benchSkinning<T>(r, type);
+  benchQuantize<T>(r, type);
+  benchBounds<T>(r, type);
+  benchBVH<T>(r, type);
+  benchRayPacket<T>(r, type);
+  benchKdTree<T>(r, type);
+}
+
+inline string context()
+{
+  tvml::cpu::Features f = tvml::cpu::features();
+  string simd;
+#if defined(TVML_AVX)
+  simd = "avx";
+#elif defined(TVML_SSE2)
+  simd = "sse2";
+#else
+  simd = "none";
+#endif
+  string cpu = string(f.sse2 ? " sse2" : "") + (f.avx ? " avx" : "") + (f.avx2 ? " avx2" : "") +
+               (f.fma ? " fma" : "") + (f.f16c ? " f16c" : "") + (f.avx512f ? " avx512f" : "");
+  string compiler =
+#if defined(__VERSION__)
+      __VERSION__;
+#else
+      "unknown";
+#endif
+  return "\"compiler\": \"" + Runner::escape(compiler) + "\", \"compiled_simd\": \"" + simd +
+         "\", \"cpu\": \"" + (cpu.empty() ? cpu : cpu.substr(1)) + "\"";
+}
+
+int main(int argc, char** argv)
+{
+  bench::Options opt;
+  const char* json = 0;
+  for(int i=1; i<argc; i++){
+    string arg = argv[i];
+    bool value = i+1 < argc;
+    if(arg == "--filter" && value)           opt.filter = argv[++i];
+    else if(arg == "--json" && value)        json = argv[++i];
+    else if(arg == "--samples" && value)     opt.samples = std::max(1, atoi(argv[++i]));
+    else if(arg == "--min-time-ms" && value) opt.minSampleMs = atof(argv[++i]);
+    else if(arg == "--warmup-ms" && value)   opt.warmupMs = atof(argv[++i]);
+    else if(arg == "--quick"){ opt.samples = 5; opt.minSampleMs = 1; opt.warmupMs = 2; }
+    else{
+      cerr << "usage: " << argv[0] << " [--filter text] [--json file] [--samples n]"
+              " [--min-time-ms x] [--warmup-ms x] [--quick]\n";
+      return 2;
+    }
+  }
+
+  Runner r(opt);
+  benchType<int>(r, "int");
+  benchType<float>(r, "float");
+  benchType<double>(r, "double");
+  benchFloating<float>(r, "float");
+  benchFloating<double>(r, "double");
+  benchHalf(r);
+  benchHashGrid(r);
+
+  if(json && !r.writeJson(json, context())){
+    cerr << "Could not write " << json << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,236 @@
+/*
+  Copyright (c) 2014, Vytautas Mickus (www.github.com/Eximius)
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL Vytautas Mickus BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  include <x86intrin.h>
+#  define BENCH_TSC 1
+#endif
+
+/**
+  Microbenchmark harness for src/bench.cpp.
+
+  A benchmark is a callable f(iterations) doing ops*iterations operations.
+  The runner warms it up, grows the iteration count until one sample takes
+  at least minSampleMs, then takes `samples` samples. Reported per op:
+  median, min, and mean/stddev over the samples inside the Tukey fences
+  (outliers are counted, not dropped from the median), plus cycles/op and
+  ops/cycle in TSC cycles calibrated against steady_clock.
+
+  Modes: "latency" chains every op on the previous result, "throughput"
+  runs independent single calls over an array, "batch" times the batched
+  APIs per element.
+**/
+
+namespace bench
+{
+
+/// Makes the compiler assume v was read and modified, so it can neither
+/// drop the computation of v nor constant fold a value read from it.
+template<typename T>
+inline void keep(T& v)
+{
+#if defined(__GNUC__)
+  asm volatile("" : "+m"(v) : : "memory");
+#else
+  static volatile char sink;
+  sink = *reinterpret_cast<volatile char*>(&v);
+#endif
+}
+
+/// Makes the compiler assume all memory changed (arrays are re-read)
+inline void clobber()
+{
+#if defined(__GNUC__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+struct Options
+{
+  int samples = 15;
+  double minSampleMs = 5;
+  double warmupMs = 20;
+  std::string filter;
+};
+
+struct Result
+{
+  std::string name, type, mode;
+  double iterations;  // per sample
+  int samples, outliers;
+  double median, min, mean, stddev; // ns per op
+  double cyclesPerOp;               // NaN without a TSC
+};
+
+class Runner
+{
+public:
+  explicit Runner(const Options& opt):opt(opt), ghz(tscGHz()){}
+
+  /// Filters match "name/type/mode", e.g. "Matrix4x4/inverse/float/latency"; lets big setups be skipped
+  bool selected(const std::string& name, const std::string& type, const char* mode) const
+  {
+    return opt.filter.empty() || (name + "/" + type + "/" + mode).find(opt.filter) != std::string::npos;
+  }
+
+  /// Times f(iterations), which performs ops operations per iteration
+  template<typename F>
+  void run(const std::string& name, const std::string& type, const char* mode, double ops, F f)
+  {
+    if(!selected(name, type, mode))
+      return;
+
+    size_t iters = 1;
+    double spent = 0, last = 0;
+    while(spent < opt.warmupMs*1e6 || last < opt.minSampleMs*1e6){
+      last = time(f, iters);
+      spent += last;
+      if(last < opt.minSampleMs*1e6)
+        iters *= 2;
+    }
+
+    std::vector<double> ns(opt.samples);
+    for(int s=0; s<opt.samples; s++)
+      ns[s] = time(f, iters) / (double(iters)*ops);
+
+    Result r;
+    r.name = name; r.type = type; r.mode = mode;
+    r.iterations = double(iters);
+    r.samples = opt.samples;
+    summarize(ns, r);
+    r.cyclesPerOp = r.median*ghz;
+    results.push_back(r);
+
+    std::printf("%-34s %-8s %-10s %10.3f ns/op %9.3f cycles/op %8.3f ops/cycle  (min %.3f, sd %.3f, %d outliers)\n",
+                name.c_str(), type.c_str(), mode, r.median, r.cyclesPerOp, 1/r.cyclesPerOp,
+                r.min, r.stddev, r.outliers);
+  }
+
+  /// Writes every result as JSON, returns false if the file can't be written
+  bool writeJson(const char* path, const std::string& context) const
+  {
+    std::FILE* f = std::fopen(path, "w");
+    if(!f)
+      return false;
+    std::fprintf(f, "{\n  \"context\": {%s, \"tsc_ghz\": %s, \"samples\": %d, \"min_sample_ms\": %g},\n"
+                    "  \"benchmarks\": [\n", context.c_str(), number(ghz).c_str(), opt.samples, opt.minSampleMs);
+    for(size_t i=0; i<results.size(); i++){
+      const Result& r = results[i];
+      std::fprintf(f, "    {\"name\": \"%s\", \"type\": \"%s\", \"mode\": \"%s\", \"iterations\": %.0f, "
+                      "\"samples\": %d, \"outliers\": %d, \"ns_per_op\": %s, \"ns_min\": %s, \"ns_mean\": %s, "
+                      "\"ns_stddev\": %s, \"cycles_per_op\": %s, \"ops_per_cycle\": %s}%s\n",
+                   escape(r.name).c_str(), escape(r.type).c_str(), r.mode.c_str(), r.iterations,
+                   r.samples, r.outliers, number(r.median).c_str(), number(r.min).c_str(),
+                   number(r.mean).c_str(), number(r.stddev).c_str(), number(r.cyclesPerOp).c_str(),
+                   number(1/r.cyclesPerOp).c_str(), i+1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    return std::fclose(f) == 0;
+  }
+
+  static std::string escape(const std::string& s)
+  {
+    std::string out;
+    for(size_t i=0; i<s.size(); i++){
+      if(s[i] == '"' || s[i] == '\\')
+        out += '\\';
+      out += s[i];
+    }
+    return out;
+  }
+
+private:
+  template<typename F>
+  static double time(F& f, size_t iters)
+  {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    f(iters);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+  }
+
+  static double quantile(const std::vector<double>& sorted, double q)
+  {
+    double pos = q*(sorted.size() - 1);
+    size_t lo = size_t(pos);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo])*(pos - lo);
+  }
+
+  static void summarize(std::vector<double> ns, Result& r)
+  {
+    std::sort(ns.begin(), ns.end());
+    r.median = quantile(ns, 0.5);
+    r.min = ns.front();
+
+    double q1 = quantile(ns, 0.25), q3 = quantile(ns, 0.75);
+    double lo = q1 - 1.5*(q3 - q1), hi = q3 + 1.5*(q3 - q1);
+    double sum = 0, sum2 = 0;
+    int n = 0;
+    for(size_t i=0; i<ns.size(); i++)
+      if(ns[i] >= lo && ns[i] <= hi){
+        sum += ns[i]; sum2 += ns[i]*ns[i]; n++;
+      }
+    r.outliers = int(ns.size()) - n;
+    r.mean = sum/n;
+    r.stddev = n > 1 ? std::sqrt(std::max(0.0, (sum2 - sum*sum/n)/(n - 1))) : 0;
+  }
+
+  /// TSC ticks per ns, NaN where there is no TSC
+  static double tscGHz()
+  {
+#if defined(BENCH_TSC)
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    unsigned long long c0 = __rdtsc();
+    while(std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(50)){}
+    unsigned long long c1 = __rdtsc();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    return double(c1 - c0) / std::chrono::duration<double, std::nano>(t1 - t0).count();
+#else
+    return std::nan("");
+#endif
+  }
+
+  static std::string number(double v)
+  {
+    if(!std::isfinite(v))
+      return "null";
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%.6g", v);
+    return buf;
+  }
+
+  Options opt;
+  double ghz;
+  std::vector<Result> results;
+};
+
+} // namespace bench
+#endif // BENCH_H
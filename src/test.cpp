@@ -20,17 +20,47 @@
 */
 
 /*
- * Compile with g++ -O3 -Wall test.cpp -I ../include -o test
+ * Compile with g++ -std=c++14 -O3 -Wall -pthread test.cpp -I ../include -o test
  */
 
 #include <tvml/stdvec.h>
 #include <tvml/stdmat.h>
 #include <tvml/quart.h>
+#include <tvml/VectorArray.h>
+#include <tvml/batch.h>
+#include <tvml/QuarternionArray.h>
+#include <tvml/expr.h>
+#include <tvml/aligned.h>
+#include <tvml/binary.h>
+#include <tvml/hierarchy.h>
+#include <tvml/TransformArray.h>
+#include <tvml/skinning.h>
+#include <tvml/quantize.h>
+#include <tvml/half.h>
+#include <tvml/bounds.h>
+#include <tvml/bvh.h>
+#include <tvml/kdtree.h>
+#include <tvml/hashgrid.h>
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <vector>
 
 using namespace std;
 
+static int failures = 0;
+
+inline void check(bool ok, const char* what)
+{
+  cout << (ok ? "  ok: " : "  FAILED: ") << what << "\n";
+  if(!ok)
+    failures++;
+}
+
 template<typename Vec2T>
 inline void testVec2(const char* name)
 {
@@ -65,6 +95,1785 @@ inline void testVec4(const char* name)
   cout << "Normals: "<< v1.normal() << ", " << v2.normal() << "\n\n";
 }
 
+template<typename T>
+inline void testVectorArrays(const char* name)
+{
+  const size_t n = 1003; // not a multiple of any pack width
+  vector< Vector3<T> > a3(n), b3(n);
+  vector< Vector4<T> > a4(n), b4(n);
+  for(size_t i=0; i<n; i++)
+  {
+    T f = T(i % 17) - 8, g = T(i % 5) + 1;
+    a3[i] = Vector3<T>(f, g, f*g + 1);
+    b3[i] = Vector3<T>(g, -f, 3);
+    a4[i] = Vector4<T>(f, g, 2, f - g);
+    b4[i] = Vector4<T>(g, f, -1, 5);
+  }
+
+  Vector3Array<T> sa3(a3.data(), n), sb3(b3.data(), n), so3;
+  Vector4Array<T> sa4(a4.data(), n), sb4(b4.data(), n), so4;
+  vector<T> s(n);
+
+  cout << name << " arrays (" << n << " elements):\n";
+
+  bool ok = true;
+  dot(sa3, sb3, s.data());
+  for(size_t i=0; i<n; i++) ok = ok && s[i] == a3[i]*b3[i];
+  check(ok, "Vector3Array dot");
+
+  ok = true;
+  cross(sa3, sb3, so3);
+  for(size_t i=0; i<n; i++) ok = ok && (so3[i] - a3[i].cross(b3[i]))*Vector3<T>(1,1,1) == 0;
+  check(ok, "Vector3Array cross");
+
+  ok = true;
+  sub(sa3, sb3, so3);
+  add(so3, sb3, so3);
+  scale(so3, T(3), so3);
+  for(size_t i=0; i<n; i++)
+  {
+    Vector3<T> e = (a3[i] - b3[i] + b3[i])*T(3);
+    ok = ok && so3.x[i] == e.x && so3.y[i] == e.y && so3.z[i] == e.z;
+  }
+  check(ok, "Vector3Array add/sub/scale");
+
+  ok = true;
+  magnitude(sa3, s.data());
+  normal(sa3, so3);
+  for(size_t i=0; i<n; i++)
+  {
+    Vector3<T> e = a3[i].normal();
+    ok = ok && s[i] == a3[i].magnitude() && so3.x[i] == e.x && so3.y[i] == e.y && so3.z[i] == e.z;
+  }
+  check(ok, "Vector3Array magnitude/normal");
+
+  ok = true;
+  dot(sa4, sb4, s.data());
+  for(size_t i=0; i<n; i++) ok = ok && s[i] == a4[i]*b4[i];
+  add(sa4, sb4, so4);
+  sub(so4, sb4, so4);
+  scale(so4, T(2), so4);
+  for(size_t i=0; i<n; i++)
+  {
+    Vector4<T> e = (a4[i] + b4[i] - b4[i])*T(2);
+    ok = ok && so4.x[i] == e.x && so4.y[i] == e.y && so4.z[i] == e.z && so4.w[i] == e.w;
+  }
+  normalize(sa4);
+  for(size_t i=0; i<n; i++)
+  {
+    Vector4<T> e = a4[i].normal();
+    ok = ok && sa4.x[i] == e.x && sa4.y[i] == e.y && sa4.z[i] == e.z && sa4.w[i] == e.w;
+  }
+  check(ok, "Vector4Array dot/add/sub/scale/normalize");
+  cout << "\n";
+}
+
+/// f for float, d for double: tolerances for the helpers below
+template<typename T>
+inline double tolerance(double f, double d)
+{
+  return sizeof(T) == sizeof(float) ? f : d;
+}
+
+// Equal up to fused multiply-adds the compiler may or may not emit, within
+// eps*(1 + |b|); pass a larger eps where the math cancels or rounds more.
+template<typename T>
+inline bool closeMatrix(const T* a, const T* b, int n, double eps = tolerance<T>(1e-6, 1e-14))
+{
+  for(int i=0; i<n; i++)
+    if(std::abs(double(a[i]) - double(b[i])) > eps*(1 + std::abs(double(b[i]))))
+      return false;
+  return true;
+}
+
+template<typename T>
+inline void testMatrixMultiply(const char* name)
+{
+  typedef Matrix4x4<T> Mat;
+
+  Mat a, b, ref;
+  for(int i=0; i<16; i++)
+  {
+    a[i] = T(i*7 % 11) / 3 - 1;
+    b[i] = T(i*5 % 13) / 7 + 2;
+  }
+  tvml::detail::mul4x4_scalar(a.data(), b.data(), ref.data());
+
+  cout << name << " multiply:\n";
+  check(closeMatrix((a*b).data(), ref.data(), 16), "operator* matches reference");
+
+  Mat c = a;
+  c *= b;
+  check(closeMatrix(c.data(), ref.data(), 16), "operator*= in place");
+
+  Mat sq, sqref;
+  tvml::detail::mul4x4_scalar(a.data(), a.data(), sqref.data());
+  sq = a;
+  sq *= sq;
+  check(closeMatrix(sq.data(), sqref.data(), 16), "operator*= self");
+
+  cout << "\n";
+}
+
+// Every runtime-dispatched kernel this machine can run, not just the one picked.
+template<typename T>
+inline void testMultiplyKernels(const char* name)
+{
+#if defined(TVML_DISPATCH)
+  typedef Matrix4x4<T> Mat;
+  typedef void (*Kernel)(const T*, const T*, T*);
+
+  Mat a, b, ref, sqref;
+  for(int i=0; i<16; i++)
+  {
+    a[i] = T(i*7 % 11) / 3 - 1;
+    b[i] = T(i*5 % 13) / 7 + 2;
+  }
+  tvml::detail::mul4x4_scalar(a.data(), b.data(), ref.data());
+  tvml::detail::mul4x4_scalar(a.data(), a.data(), sqref.data());
+
+  const tvml::cpu::Features& f = tvml::cpu::features();
+  Kernel kernels[] = { tvml::detail::mul4x4_sse2, tvml::detail::mul4x4_avx, tvml::detail::mul4x4_avx512 };
+  bool have[] = { f.sse2, f.avx, f.avx512f };
+  const char* names[] = { "sse2 kernel", "avx kernel", "avx512 kernel" };
+
+  cout << name << " multiply kernels:\n";
+  for(int k=0; k<3; k++)
+  {
+    if(!have[k])
+      continue;
+    Mat r, s = a;
+    kernels[k](a.data(), b.data(), r.data());
+    kernels[k](s.data(), s.data(), s.data());
+    check(closeMatrix(r.data(), ref.data(), 16) && closeMatrix(s.data(), sqref.data(), 16), names[k]);
+  }
+  cout << "\n";
+#else
+  (void)name;
+#endif
+}
+
+template<typename T>
+inline void testBatchTransforms(const char* name)
+{
+  const size_t n = 40001;
+  Matrix4x4<T> m4 = { 2, 0.5, 0, 3,
+                      0, 1, -1, 4,
+                      1, 0, 3, -2,
+                      0.25, 0, 0, 1 };
+  Matrix3x3<T> m3 = { 1, 2, 0, -1, 1, 3, 0, 0.5, 2 };
+
+  vector< Vector3<T> > v3(n), p(n), d(n), r(n), h(n);
+  vector< Vector4<T> > v4(n), r4(n);
+  for(size_t i=0; i<n; i++)
+  {
+    v3[i] = Vector3<T>(T(i % 13) - 6, T(i % 7), T(1) / (1 + i % 5));
+    v4[i] = Vector4<T>(v3[i].x, v3[i].y, v3[i].z, 1 + T(i % 3));
+  }
+
+  transformPoints(m4, v3.data(), p.data(), n, 4);
+  transformDirections(m4, v3.data(), d.data(), n);
+  transformVectors(m3, v3.data(), r.data(), n, 0);
+  transformVectors(m4, v4.data(), r4.data(), n);
+  transformHomogeneous(m4, v4.data(), h.data(), n, 3);
+
+  bool okp = true, okd = true, okr = true, ok4 = true, okh = true;
+  for(size_t i=0; i<n; i++)
+  {
+    Vector3<T> e = m4*v3[i];
+    Vector4<T> dir = m4*Vector4<T>(v3[i].x, v3[i].y, v3[i].z, 0);
+    Vector3<T> e3 = m3*v3[i];
+    Vector4<T> e4 = m4*v4[i];
+    Vector3<T> eh = Vector3<T>(e4.x/e4.w, e4.y/e4.w, e4.z/e4.w);
+    okp = okp && closeMatrix(p[i].data(), e.data(), 3);
+    okd = okd && closeMatrix(d[i].data(), dir.data(), 3);
+    okr = okr && closeMatrix(r[i].data(), e3.data(), 3);
+    ok4 = ok4 && closeMatrix(r4[i].data(), e4.data(), 4);
+    okh = okh && closeMatrix(h[i].data(), eh.data(), 3);
+  }
+
+  cout << name << " batched transforms (" << n << " vectors):\n";
+  check(okp, "transformPoints (4 threads)");
+  check(okd, "transformDirections");
+  check(okr, "transformVectors mat3 (all cores)");
+  check(ok4, "transformVectors mat4");
+  check(okh, "transformHomogeneous (3 threads)");
+
+  // in place, and the structure of arrays path
+  Vector3Array<T> soa(v3.data(), n), soaOut;
+  transformPoints(m4, soa, soaOut, 2);
+  transformPoints(m4, v3.data(), v3.data(), n);
+  bool ok = true;
+  for(size_t i=0; i<n; i++)
+    ok = ok && closeMatrix(v3[i].data(), p[i].data(), 3) && closeMatrix(soaOut[i].data(), p[i].data(), 3);
+  check(ok, "in place and Vector3Array");
+  cout << "\n";
+}
+
+template<typename T>
+inline bool nearIdentity(const Matrix4x4<T>& m, double eps)
+{
+  for(int i=0; i<16; i++)
+    if(std::abs(double(m[i]) - (i % 5 == 0 ? 1 : 0)) > eps)
+      return false;
+  return true;
+}
+
+template<typename T>
+inline void testInverse(const char* name)
+{
+  typedef Matrix4x4<T> Mat;
+  const double eps = sizeof(T) == sizeof(float) ? 1e-4 : 1e-10;
+
+  Mat m = { 9, 3,  5, -6,
+            -9, 7, -1, -8,
+            1, 3,  6, 10,
+            67,54, 83, 30};
+  Mat neg = { 0, 1, 0, 0,
+              1, 0, 0, 0,
+              0, 0, 2, 0,
+              0, 0, 0, 1 }; // det -2
+  Mat sing = { 1, 2, 3, 4,
+               2, 4, 6, 8,
+               0, 1, 0, 1,
+               3, 1, 2, 0 };
+
+  cout << name << " inverse:\n";
+
+  double cofactorDet = m[0]*m.template MINOR<0,0>() - m[1]*m.template MINOR<0,1>()
+                     + m[2]*m.template MINOR<0,2>() - m[3]*m.template MINOR<0,3>();
+  check(std::abs(m.det() - cofactorDet) < eps*std::abs(cofactorDet), "det matches cofactor expansion");
+  check(nearIdentity(m*m.inverse(), eps) && nearIdentity(m*m.inverseUnchecked(), eps), "m * m.inverse() == I");
+  check(closeMatrix((m.adjoint()/m.det()).data(), m.inverse().data(), 16), "inverse == adjoint / det");
+  check(nearIdentity(neg*neg.inverse(), eps), "negative determinant inverts");
+
+  Mat out = Mat::Identity;
+  bool threw = false;
+  try { sing.inverse(); } catch(const std::runtime_error&) { threw = true; }
+  check(threw && !sing.inverse(out) && nearIdentity(out, 0), "singular: throws / returns false");
+
+  // rotation about z by 90 deg, scale 2, translate (1,2,3)
+  Mat rigid = { 0, -1, 0, 1,
+                1,  0, 0, 2,
+                0,  0, 1, 3,
+                0,  0, 0, 1 };
+  Mat affine = rigid * Mat(Vector3<T>(0,0,0), Vector3<T>(2,2,2));
+  check(closeMatrix(rigid.inverseRigid().data(), rigid.inverse().data(), 16), "inverseRigid");
+  check(closeMatrix(affine.inverseAffine().data(), affine.inverse().data(), 16), "inverseAffine");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testRotate(const char* name)
+{
+  const size_t n = 1001;
+  Quarternion<T> q = Quarternion<T>(T(rad(30)), Vector3<T>(1,2,2)/T(3));
+  Matrix3x3<T> rm = q;
+
+  vector< Vector3<T> > v(n);
+  vector< Quarternion<T> > qs(n);
+  for(size_t i=0; i<n; i++)
+  {
+    v[i] = Vector3<T>(T(i % 9) - 4, T(i % 4), 1);
+    qs[i] = Quarternion<T>(T(rad(double(i))), Vector3<T>(0,0.6,0.8));
+  }
+
+  cout << name << " rotate:\n";
+  bool ok = true;
+  for(size_t i=0; i<n; i++)
+    ok = ok && (q.rotate(v[i]) - rm*v[i]).magnitude() < 1e-5;
+  check(ok, "q.rotate(v) == Matrix3x3(q)*v");
+
+  Matrix4x4<T> m4 = q;
+  ok = m4[3] == 0 && m4[7] == 0 && m4[11] == 0 && m4[12] == 0 && m4[13] == 0 && m4[14] == 0 && m4[15] == 1;
+  for(int r=0; r<3; r++)
+    ok = ok && closeMatrix(m4.data() + 4*r, rm.data() + 3*r, 3);
+  check(ok, "Matrix4x4(q) is Matrix3x3(q) with no translation");
+
+  Vector3Array<T> in(v.data(), n), out, outq;
+  QuarternionArray<T> qa(qs.data(), n);
+  rotate(q, in, out);
+  rotate(qa, in, outq);
+  ok = true;
+  for(size_t i=0; i<n; i++)
+    ok = ok && closeMatrix(out[i].data(), q.rotate(v[i]).data(), 3)
+            && closeMatrix(outq[i].data(), qs[i].rotate(v[i]).data(), 3);
+  check(ok, "batched rotate, one and many quarternions");
+  cout << "\n";
+}
+
+// Rotation angle between two unit quarternions, |a - b| = 2 sin(angle/4)
+template<typename T, typename X>
+inline double angleBetween(const Quarternion<T>& a, const Quarternion<X>& b)
+{
+  Quarternion<double> da = a, db = b;
+  if(dot(da, db) < 0)
+    db = -db;
+  return 4*std::asin(std::min(1.0, (da - db).magnitude()/2));
+}
+
+template<typename T>
+inline void testInterpolation(const char* name)
+{
+  const size_t n = 4099;
+  vector< Quarternion<T> > qa(n), qb(n);
+  for(size_t i=0; i<n; i++)
+  {
+    // spread of axes and angles, including nearly equal and opposite pairs
+    Vector3<T> axis = Vector3<T>(T(std::sin(i*0.7)), T(std::cos(i*1.3)), T(std::sin(i*2.9) + 0.1)).normal();
+    qa[i] = Quarternion<T>(T(i*0.37), axis);
+    qb[i] = Quarternion<T>(T(i*0.37 + (i % 7)*0.5 + (i % 3 ? 1e-4 : 0)), axis.cross(Vector3<T>(1,0,0)) + axis*T(3));
+    qb[i].normalize();
+    if(i % 5 == 0)
+      qb[i] = -qb[i];
+  }
+
+  cout << name << " interpolation:\n";
+
+  Quarternion<T> id(1,0,0,0), rz(T(rad(90)), Vector3<T>(0,0,1)), half(T(rad(45)), Vector3<T>(0,0,1));
+  check(angleBetween(slerp(id, rz, T(0.5)), half) < 1e-3 && angleBetween(nlerp(id, rz, T(0.5)), half) < 1e-3,
+        "slerp/nlerp halfway between identity and 90 deg");
+  check(angleBetween(slerp(id, -rz, T(0.25)), Quarternion<T>(T(rad(22.5)), Vector3<T>(0,0,1))) < 1e-3,
+        "slerp takes the shorter arc");
+
+  double fastErr = 0, nlerpErr = 0;
+  for(size_t i=0; i<n; i++)
+    for(int k=0; k<=16; k++)
+    {
+      T t = T(k/16.0);
+      Quarternion<double> ref = slerp(Quarternion<double>(qa[i]), Quarternion<double>(qb[i]), double(t));
+      fastErr  = std::max(fastErr,  angleBetween(slerpFast(qa[i], qb[i], t), ref));
+      nlerpErr = std::max(nlerpErr, angleBetween(nlerp(qa[i], qb[i], t), ref));
+    }
+  cout << "  max error vs slerp: slerpFast " << fastErr << " rad, nlerp " << nlerpErr << " rad\n";
+  check(fastErr < 8e-4, "slerpFast within documented bound");
+
+  QuarternionArray<T> a(qa.data(), n), b(qb.data(), n), o1, o2, o3;
+  T t = T(0.3);
+  slerp(a, b, t, o1);
+  nlerp(a, b, t, o2);
+  slerpFast(a, b, t, o3);
+  bool ok = true;
+  for(size_t i=0; i<n; i++)
+  {
+    Quarternion<T> s1 = slerp(qa[i], qb[i], t), s2 = nlerp(qa[i], qb[i], t), s3 = slerpFast(qa[i], qb[i], t);
+    ok = ok && closeMatrix(o1[i].data(), s1.data(), 4) && closeMatrix(o2[i].data(), s2.data(), 4)
+            && closeMatrix(o3[i].data(), s3.data(), 4);
+  }
+  check(ok, "batched slerp/nlerp/slerpFast match scalar");
+
+  QuarternionArray<T> poses[3] = { a, b, o1 };
+  T weights[3] = { T(0.5), T(0.3), T(0.2) };
+  QuarternionArray<T> blended;
+  blend(poses, weights, 3, blended);
+  ok = true;
+  for(size_t i=0; i<n; i++)
+  {
+    Quarternion<T> acc = qa[i]*weights[0];
+    for(int k=1; k<3; k++)
+    {
+      Quarternion<T> q = poses[k][i];
+      acc += q*(dot(qa[i], q) < 0 ? -weights[k] : weights[k]);
+    }
+    ok = ok && closeMatrix(blended[i].data(), acc.normal().data(), 4);
+  }
+  check(ok, "weighted multi-pose blend");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testConstexpr(const char* name)
+{
+  cout << name << " constexpr:\n";
+
+  // everything below is evaluated by the compiler
+  constexpr Matrix4x4<T> model = Matrix4x4<T>(Vector3<T>(1,2,3), Vector3<T>(2,2,2));
+  constexpr Matrix4x4<T> view = Matrix4x4<T>::Identity * Matrix4x4<T>(Vector3<T>(0,0,-5));
+  constexpr Matrix4x4<T> mv = view * model;
+  constexpr Vector3<T> p = mv * Vector3<T>(1,1,1);
+  constexpr Matrix3x3<T> rot = {0,-1,0, 1,0,0, 0,0,1};
+  constexpr Quarternion<T> qz(0,0,0,1);
+
+  static_assert(model.det() == 8, "constexpr Matrix4x4::det");
+  static_assert(mv[11] == -2 && mv.transpose()[14] == -2, "constexpr Matrix4x4 product/transpose");
+  static_assert(p.x == 3 && p.y == 4 && p.z == 0, "constexpr Matrix4x4*Vector3");
+  static_assert((rot*rot.transpose())[0] == 1 && rot.det() == 1, "constexpr Matrix3x3");
+  static_assert((Vector3<T>(1,0,0).cross(Vector3<T>(0,1,0)) - Vector3<T>(0,0,1)) * Vector3<T>(1,1,1) == 0,
+                "constexpr Vector3 cross/dot");
+  static_assert((qz*qz).w == -1, "constexpr Quarternion product");
+  static_assert((Matrix4x4<T>::Zero - Matrix4x4<T>::Identity*T(2))[15] == -2, "constexpr Matrix4x4 arithmetic");
+
+  // and matches the runtime (SIMD) path
+  Matrix4x4<T> rview = view, rmodel = model;
+  Matrix4x4<T> rmv = rview * rmodel;
+  check(closeMatrix(rmv.data(), mv.data(), 16), "constexpr product matches runtime product");
+
+  Vector3<T> v(1,2,3);
+  v *= T(2); v -= T(1); v /= T(1);
+  check(v.x == 1 && v.y == 3 && v.z == 5, "Vector3 compound operators apply to z");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testGeneric(const char* name)
+{
+  cout << name << " generic Vector/Matrix:\n";
+
+  // compile time, through the same code as every other size
+  constexpr Matrix2x2<T> m2 = {4, 7, 2, 6};
+  constexpr Matrix3x4<T> affine = Matrix3x4<T>(Vector3<T>(1,2,3), Vector3<T>(2,2,2));
+  constexpr Vector3<T> p = affine * Vector3<T>(1,1,1);
+  constexpr Matrix<T,4,3> at = affine.transpose();
+  static_assert(m2.det() == 10 && (m2*Matrix2x2<T>::Identity)[1] == 7, "constexpr Matrix2x2");
+  static_assert(p.x == 3 && p.y == 4 && p.z == 5 && at[11] == 3, "constexpr Matrix3x4");
+  static_assert((affine*Matrix4x4<T>::Identity)[7] == 2, "constexpr 3x4 * 4x4");
+
+  Matrix2x2<T> i2 = m2.inverse();
+  check(closeMatrix((m2*i2).data(), Matrix2x2<T>::Identity.data(), 4), "Matrix2x2 inverse");
+
+  Matrix4x4<T> full = Matrix4x4<T>(Vector3<T>(1,2,3), Vector3<T>(2,2,2));
+  Matrix3x4<T> inv = affine.inverseAffine();
+  bool ok = true;
+  for(int i=0; i<12; i++)
+    ok = ok && inv[i] == full.inverseAffine()[i];
+  check(ok && closeMatrix((inv*Vector3<T>(3,4,5)).data(), Vector3<T>(1,1,1).data(), 3),
+        "Matrix3x4 inverseAffine matches Matrix4x4");
+
+  Matrix<T,2,3> a = {1, 2, 3, 4, 5, 6};
+  Matrix<T,3,2> b = {1, 0, 0, 1, 1, 1};
+  Matrix2x2<T> ab = a*b;
+  Vector2<T> av = a*Vector3<T>(1,1,1);
+  check(ab[0] == 4 && ab[1] == 5 && ab[2] == 10 && ab[3] == 11 && av.x == 6 && av.y == 15,
+        "non-square products");
+
+  Vector<T,5> v(1, 2, 3, 4, 5), w(5, 4, 3, 2, 1);
+  Vector<T,5> s = v + w*T(2);
+  check(v*w == 35 && s[0] == 11 && s[4] == 7, "Vector<T,5> dot and arithmetic");
+
+  Vector2<T> v2(1,2);
+  Vector4<T> v4(1,2,3,4);
+  v2 += Vector2<T>(3,4);
+  v4 += T(1);
+  check(v2.x == 4 && v2.y == 6 && v4.x == 2 && v4.w == 5, "compound operators take vectors and scalars for every size");
+  cout << "\n";
+}
+
+/// Bit-identical, unless hardware FMA lets the compiler fuse only one side:
+/// then within eps, as closeMatrix
+template<typename T>
+inline bool sameResult(const T* a, const T* b, int n, double eps = tolerance<T>(1e-6, 1e-14))
+{
+#if defined(__FP_FAST_FMA) || defined(__FP_FAST_FMAF)
+  return closeMatrix(a, b, n, eps);
+#else
+  (void)eps;
+  return memcmp(a, b, n*sizeof(T)) == 0;
+#endif
+}
+
+template<typename T>
+inline void testExpr(const char* name)
+{
+  using tvml::lazy;
+  cout << name << " expression templates:\n";
+
+  Matrix4x4<T> a, b, c;
+  for(int i=0; i<16; i++){
+    a[i] = T(i*3 - 7) / T(3);
+    b[i] = T(i*i) * T(0.1);
+    c[i] = T(1) / T(i+2);
+  }
+  Matrix4x4<T> eager = a*1.5 + b*T(0.3) - c/T(7) + (-a)*2;
+  Matrix4x4<T> fused = lazy(a)*1.5 + lazy(b)*T(0.3) - lazy(c)/T(7) + (-lazy(a))*2;
+  check(sameResult(eager.data(), fused.data(), 16), "Matrix4x4 chain bit-identical to eager operators");
+
+  Vector3<T> v(1,2,3), w(T(0.1),T(0.2),T(0.3));
+  Vector3<T> ev = v*T(0.7) - w/3 + v, lv = lazy(v)*T(0.7) - lazy(w)/3 + v;
+  check(sameResult(&ev.x, &lv.x, 3), "Vector3 chain bit-identical to eager operators");
+
+  Vector4<T> p(1,2,3,4), q(T(0.5),T(0.25),T(0.125),T(1));
+  Vector4<T> ep = p*T(3) + q - p/T(9), lp = lazy(p)*T(3) + q - lazy(p)/T(9);
+  check(sameResult(&ep.x, &lp.x, 4), "Vector4 chain bit-identical to eager operators");
+
+  Matrix4x4<T> aliased = a;
+  aliased = lazy(aliased)*2 + aliased;
+  check(sameResult(aliased.data(), (a*2 + a).data(), 16), "assigning to an operand");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testAligned(const char* name)
+{
+  cout << name << " aligned types:\n";
+
+  Matrix4x4a<T> m;
+  for(int i=0; i<16; i++)
+    m[i] = T(i*i % 7) - T(2.5);
+  Matrix4x4<T> pm = m;
+  Vector4a<T> v(T(1.5), T(-2), T(0.25), T(3));
+  Vector3a<T> p(T(0.75), T(4), T(-1));
+  Vector4<T> pv = v;
+  Vector3<T> pp = p;
+
+  Vector4<T> mv = m*v, pmv = pm*pv;
+  Vector3<T> mp = m*p, pmp = pm*pp;
+  Matrix4x4<T> mm = m*m, pmm = pm*pm;
+  check(sameResult(&mv.x, &pmv.x, 4), "Matrix4x4a * Vector4a matches plain types");
+  check(sameResult(&mp.x, &pmp.x, 3), "Matrix4x4a * Vector3a matches plain types");
+  check(sameResult(mm.data(), pmm.data(), 16), "Matrix4x4a * Matrix4x4a matches plain types");
+
+  Vector4<T> av = v + v*T(3) - (-v)/T(7), pav = pv + pv*T(3) - (-pv)/T(7);
+  Vector3<T> ap = p - p/T(3) + p*T(2), pap = pp - pp/T(3) + pp*T(2);
+  check(memcmp(&av.x, &pav.x, sizeof(T)*4) == 0, "Vector4a arithmetic matches Vector4");
+  check(memcmp(&ap.x, &pap.x, sizeof(T)*3) == 0, "Vector3a arithmetic matches Vector3");
+  check(p*p == pp*pp, "Vector3a dot product");
+
+  tvml::aligned_vector< Matrix4x4a<T> > mats(5, m);
+  tvml::aligned_vector< Vector3a<T> > points(9, p);
+  check(size_t(mats.data()) % alignof(Matrix4x4a<T>) == 0 &&
+        size_t(points.data()) % alignof(Vector3a<T>) == 0, "aligned_vector storage is aligned");
+  check(sizeof(Vector3a<T>) == 4*sizeof(T), "Vector3a is padded to four elements");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testFastNormal(const char* name)
+{
+  using tvml::Precision;
+  cout << name << " fast normalize:\n";
+
+  const size_t n = 1027;
+  vector< Vector3<T> > v3(n);
+  vector< Vector4<T> > v4(n);
+  vector< Quarternion<T> > q(n);
+  for(size_t i=0; i<n; i++)
+  {
+    T s = T(std::pow(10.0, double(i % 13) - 6));
+    v3[i] = Vector3<T>(T(std::sin(i*0.7)), T(std::cos(i*1.3)), T(std::sin(i*2.9) + 0.01))*s;
+    v4[i] = Vector4<T>(v3[i].x, v3[i].y, v3[i].z, T(std::cos(i*0.3))*s);
+    q[i] = Quarternion<T>(v4[i].w, v4[i].x, v4[i].y, v4[i].z);
+  }
+
+  // documented bounds plus the rounding of the scaling
+  const Precision modes[3] = { Precision::Approx, Precision::Refined, Precision::Exact };
+  const double bound[3] = { 3.7e-4, 3.5e-7, 4.0e-7 };
+  bool ok = true;
+  double err[3] = { 0, 0, 0 };
+  for(int p=0; p<3; p++)
+    for(size_t i=0; i<n; i++)
+    {
+      Vector3<double> d3 = v3[i];
+      double inv = 1/d3.magnitude();
+      err[p] = std::max(err[p], std::fabs(v3[i].invMagnitude(modes[p])/inv - 1));
+      err[p] = std::max(err[p], std::fabs(Vector3<double>(v3[i].normalFast(modes[p])).magnitude() - 1));
+      err[p] = std::max(err[p], std::fabs(Vector4<double>(v4[i].normalFast(modes[p])).magnitude() - 1));
+      err[p] = std::max(err[p], std::fabs(Quarternion<double>(q[i].normalFast(modes[p])).magnitude() - 1));
+    }
+  for(int p=0; p<3; p++)
+    ok = ok && err[p] < bound[p];
+  cout << "  max relative error: approx " << err[0] << ", refined " << err[1] << ", exact " << err[2] << "\n";
+  check(ok, "normalFast/invMagnitude within documented bounds");
+
+  Vector3Array<T> a3(v3.data(), n), o3;
+  Vector4Array<T> a4(v4.data(), n), o4;
+  QuarternionArray<T> aq(q.data(), n), oq;
+  vector<T> inv(n);
+  ok = true;
+  for(int p=0; p<3; p++)
+  {
+    normalFast(a3, o3, modes[p]);
+    normalFast(a4, o4, modes[p]);
+    normalFast(aq, oq, modes[p]);
+    invMagnitude(a3, inv.data(), modes[p]);
+    for(size_t i=0; i<n; i++)
+    {
+      Vector3<T> s3 = v3[i].normalFast(modes[p]), b3 = o3[i];
+      Vector4<T> s4 = v4[i].normalFast(modes[p]), b4 = o4[i];
+      Quarternion<T> sq = q[i].normalFast(modes[p]), bq = oq[i];
+      T si = v3[i].invMagnitude(modes[p]);
+      ok = ok && sameResult(&s3.x, &b3.x, 3) && sameResult(&s4.x, &b4.x, 4)
+              && sameResult(sq.data(), bq.data(), 4) && sameResult(&si, &inv[i], 1);
+    }
+  }
+  check(ok, "batched fast normalize matches scalar");
+
+  normalizeFast(a3, Precision::Refined);
+  Vector3<T> r = v3[5], b = a3[5];
+  r.normalizeFast(Precision::Refined);
+  check(sameResult(&r.x, &b.x, 3), "normalizeFast in place");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testFormat(const char* name)
+{
+  cout << name << " formatting:\n";
+
+  Vector3<T> v(T(1.5), T(-0.25), T(1)/T(3));
+  Matrix4x4<T> m = Matrix4x4<T>(Vector3<T>(1,2,3), Vector3<T>(2,2,2));
+  char buf[512];
+
+  tvml::FormatResult r = m.format_to(buf, sizeof buf);
+  std::string s(buf, r.ptr);
+  std::ostringstream os;
+  os << m;
+  check(r.ok && s == m.repr() && s == os.str() && s.size() <= Matrix4x4<T>::maxFormattedSize(),
+        "format_to, repr and operator<< agree");
+
+  r = v.format_to(buf, sizeof buf, tvml::FormatSpec::fixed(2));
+  check(r.ok && std::string(buf, r.ptr) == "[1.50, -0.25, 0.33]", "fixed precision");
+
+  r = v.format_to(buf, sizeof buf, tvml::FormatSpec::shortest());
+  T back[3];
+  const char* c = buf;
+  for(int i=0; i<3; i++){
+    char* e;
+    back[i] = T(std::strtod(c + 1, &e));
+    c = e + (i < 2);
+  }
+  check(r.ok && back[0] == v.x && back[1] == v.y && back[2] == v.z, "shortest round trips");
+
+  Vector2<int64_t> l(std::numeric_limits<int64_t>::min(), 0);
+  std::vector<char> lbuf(Vector2<int64_t>::maxFormattedSize());
+  r = l.format_to(lbuf.data(), lbuf.size());
+  check(r.ok && std::string(lbuf.data(), r.ptr) == "[-9223372036854775808, 0]", "integers");
+
+  std::string it;
+  v.format_to(std::back_inserter(it));
+  check(it == v.repr(), "output iterator");
+
+  r = m.format_to(buf, 10);
+  check(!r.ok && r.ptr <= buf + 10 && std::string(buf, r.ptr) == s.substr(0, r.ptr - buf),
+        "too small a buffer is cut short");
+
+  T big = std::numeric_limits<T>::max();
+  Vector3<T> extreme(-big, -std::numeric_limits<T>::denorm_min(), std::numeric_limits<T>::quiet_NaN());
+  tvml::FormatSpec specs[] = { tvml::FormatSpec::general(40), tvml::FormatSpec::fixed(40), tvml::FormatSpec::shortest() };
+  bool ok = true;
+  for(tvml::FormatSpec spec : specs){
+    std::vector<char> exact(Vector3<T>::maxFormattedSize(spec));
+    ok = ok && extreme.format_to(exact.data(), exact.size(), spec).ok;
+  }
+  check(ok, "maxFormattedSize bounds every notation");
+
+  Vector3<T> items[3] = { v, -v, v*T(2) };
+  std::string lines = items[0].repr() + "\n" + items[1].repr() + "\n" + items[2].repr() + "\n";
+  tvml::FormatArrayResult a = tvml::format_array(buf, sizeof buf, items, 3);
+  tvml::FormatArrayResult part = tvml::format_array(buf, lines.size() - 1, items, 3);
+  check(a.count == 3 && std::string(buf, a.ptr) == lines &&
+        part.count == 2 && part.ptr == buf + lines.rfind('['), "format_array stops at whole items");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testBinary(const char* name)
+{
+  cout << name << " binary arrays:\n";
+
+  const size_t n = 1000;
+  std::vector< Vector3<T> > v(n);
+  std::vector< Matrix4x4<T> > m(n);
+  std::vector< Quarternion<T> > q(n);
+  tvml::aligned_vector< Vector3a<T> > va(n);
+  for(size_t i=0; i<n; i++){
+    v[i] = Vector3<T>(T(i), T(0.5)*i, -T(i));
+    m[i] = Matrix4x4<T>(v[i], Vector3<T>(1,2,3));
+    q[i] = Quarternion<T>(T(0.001)*i, Vector3<T>(0,1,0));
+    va[i] = v[i];
+  }
+  std::string path = std::string("tvml_test_") + name + ".bin";
+
+  // streamed in uneven chunks
+  {
+    tvml::BinaryWriter< Matrix4x4<T> > out(path);
+    out.write(m[0]);
+    out.write(&m[1], 600);
+    out.write(&m[601], n - 601);
+  }
+  bool ok;
+  {
+    tvml::MappedArray< Matrix4x4<T> > in(path);
+    ok = in.size() == n && memcmp(in.data(), m.data(), n*sizeof(m[0])) == 0 &&
+         in.header().rows == 4 && in.header().cols == 4 && in.header().scalar == uint32_t(sizeof(T) == 4 ? tvml::BinaryScalar::Float32 : tvml::BinaryScalar::Float64);
+  }
+  check(ok, "streamed Matrix4x4 maps back");
+
+  tvml::writeBinary(path, v.data(), n);
+  tvml::MappedArray< Vector3<T> > in3(path);
+  tvml::MappedArray< Vector3<T> > moved = std::move(in3);
+  tvml::writeBinary(path + "q", q.data(), n);
+  tvml::writeBinary(path + "a", va.data(), n);
+  tvml::MappedArray< Quarternion<T> > inq(path + "q");
+  tvml::MappedArray< Vector3a<T> > ina(path + "a");
+  ok = moved.size() == n && memcmp(moved.data(), v.data(), n*sizeof(v[0])) == 0 &&
+       inq.size() == n && memcmp(inq.data(), q.data(), n*sizeof(q[0])) == 0 && ina.size() == n;
+  for(size_t i=0; i<n; i++)
+    ok = ok && ina[i].x == v[i].x && ina[i].y == v[i].y && ina[i].z == v[i].z;
+  check(ok, "Vector3, Quarternion and padded Vector3a map back");
+
+  int rejected = 0;
+  try{ tvml::MappedArray< Vector4<T> > wrong(path); }catch(const std::runtime_error&){ rejected++; }
+  try{ tvml::MappedArray< Vector3a<T> > padded(path); }catch(const std::runtime_error&){ rejected++; }
+  try{ tvml::MappedArray< Vector3<int32_t> > ints(path); }catch(const std::runtime_error&){ rejected++; }
+  try{ tvml::MappedArray< Vector3<T> > missing(path + "missing"); }catch(const std::runtime_error&){ rejected++; }
+
+  std::vector<char> bytes(sizeof(tvml::BinaryHeader) + n*sizeof(v[0]) + 64);
+  char* at = bytes.data() + (64 - uintptr_t(bytes.data()) % 64) % 64;
+  tvml::BinaryHeader h = tvml::binaryHeader< Vector3<T> >(n);
+  memcpy(at, &h, sizeof h);
+  memcpy(at + sizeof h, v.data(), n*sizeof(v[0]));
+  size_t size = sizeof h + n*sizeof(v[0]);
+  tvml::Span< const Vector3<T> > view = tvml::viewBinary< Vector3<T> >(at, size);
+  try{ tvml::viewBinary< Vector3<T> >(at, size - 1); }catch(const std::runtime_error&){ rejected++; }
+  h.byteOrder = 0x04030201;
+  memcpy(at, &h, sizeof h);
+  try{ tvml::viewBinary< Vector3<T> >(at, size); }catch(const std::runtime_error&){ rejected++; }
+  check(rejected == 6 && view.size() == n && view.data() == (const void*)(at + sizeof h),
+        "mismatched, truncated and foreign byte order files are rejected");
+
+  std::remove(path.c_str());
+  std::remove((path + "q").c_str());
+  std::remove((path + "a").c_str());
+  cout << "\n";
+}
+
+template<typename T>
+inline void testBatchSquare3(const char* name)
+{
+  cout << name << " batched Matrix3x3 det/adjugate/inverse:\n";
+
+  // odd size for the scalar tail, every 7th matrix singular, one NaN.
+  // Small integers keep every product exact, so FMA contraction can't differ.
+  const size_t n = 1003;
+  std::vector< Matrix3x3<T> > m(n);
+  for(size_t i=0; i<n; i++){
+    for(int k=0; k<9; k++)
+      m[i][k] = T(int(std::sin(double(i*9 + k + 1))*8));
+    if(i % 7 == 3)
+      for(int k=0; k<3; k++)
+        m[i][6+k] = m[i][k]*2 - m[i][3+k];
+  }
+  m[500][4] = std::numeric_limits<T>::quiet_NaN();
+
+  std::vector<T> det(n);
+  std::vector< Matrix3x3<T> > adj(n), inv(n, Matrix3x3<T>::Zero);
+  std::vector<char> flags(n);
+  bool* singular = reinterpret_cast<bool*>(flags.data());
+  determinants(m.data(), det.data(), n);
+  adjugates(m.data(), adj.data(), n, 4);
+  size_t count = inverses(m.data(), inv.data(), singular, n, 4);
+
+  bool okDet = true, okAdj = true, okInv = true;
+  size_t expected = 0;
+  for(size_t i=0; i<n; i++){
+    T d = m[i].det();
+    Matrix3x3<T> a = m[i].adjoint(), r = Matrix3x3<T>::Zero;
+    bool invertible = m[i].inverse(r);
+    expected += !invertible;
+    okDet = okDet && (sameResult(&d, &det[i], 1) || (d != d && det[i] != det[i]));
+    okAdj = okAdj && (sameResult(a.data(), adj[i].data(), 9) || i == 500);
+    okInv = okInv && singular[i] == !invertible && sameResult(r.data(), inv[i].data(), 9);
+  }
+  check(okDet, "determinants match det()");
+  check(okAdj, "adjugates match adjoint()");
+  check(okInv && count == expected && count >= n/7 && singular[500], "inverses match inverse(out), singular lanes flagged");
+
+  std::vector< Matrix3x3<T> > inPlace = m;
+  inverses(inPlace.data(), inPlace.data(), nullptr, n);
+  bool same = true;
+  for(size_t i=0; i<n; i++)
+    same = same && (singular[i] ? memcmp(inPlace[i].data(), m[i].data(), sizeof(m[i])) == 0
+                                : sameResult(inPlace[i].data(), inv[i].data(), 9));
+  check(same, "in place");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testHierarchy(const char* name)
+{
+  cout << name << " TransformHierarchy:\n";
+
+  // enough nodes for the per level parallel path: 4-ary trees, a root every 1000 nodes
+  const size_t n = 20000;
+  typedef TransformHierarchy<T> H;
+  H serial, threaded;
+  std::vector<typename H::Handle> parents(n);
+  for(size_t i=0; i<n; i++){
+    parents[i] = i % 1000 == 0 ? H::NO_PARENT : typename H::Handle((i - 1)/4);
+    Quarternion<T> q(T(std::sin(double(i))), Vector3<T>(1,2,3).normal());
+    Vector3<T> t(T(std::sin(i*0.3)), T(std::cos(i*0.7)), 1);
+    serial.add(parents[i], t, q, Vector3<T>(1, T(1.001), 1));
+    threaded.add(parents[i], t, q, Vector3<T>(1, T(1.001), 1));
+  }
+
+  // reference: world = parent world * local with operator*, one chain per node
+  auto reference = [&](const H& h){
+    std::vector< Matrix4x4<T> > w(n);
+    for(size_t i=0; i<n; i++)
+      w[i] = parents[i] == H::NO_PARENT ? h.local(i) : w[parents[i]]*h.local(i);
+    return w;
+  };
+  auto matches = [&](const H& h, const std::vector< Matrix4x4<T> >& w){
+    bool ok = h.worldMatrices().size() == n;
+    for(size_t i=0; i<n && ok; i++)
+      ok = sameResult(h.worldMatrices()[i].data(), w[i].data(), 16);
+    return ok;
+  };
+
+  size_t first = serial.update(), firstThreaded = threaded.update(4);
+  check(first == n && firstThreaded == n && matches(serial, reference(serial)) &&
+        matches(threaded, reference(serial)), "first update computes every world matrix");
+
+  // composeTRS: translation * rotation * scale
+  Quarternion<T> q(T(0.5), Vector3<T>(0,0,1));
+  Vector3<T> t(1,2,3), v(1,1,1);
+  Matrix4x4<T> trs = tvml::detail::composeTRS(t, q, Vector3<T>(2,2,2));
+  Vector3<T> e = trs*v - (q.rotate(v*T(2)) + t);
+  check(std::abs(e.x) + std::abs(e.y) + std::abs(e.z) < 1e-5, "TRS local transform");
+
+  // move every 97th node, only their subtrees are recomputed
+  std::vector<char> below(n, 0);
+  size_t expected = 0;
+  for(size_t i=0; i<n; i++){
+    if(i % 97 == 5){
+      Matrix4x4<T> local = serial.local(i);
+      local[3] += 1;
+      serial.setLocal(i, local);
+      threaded.setLocal(i, local);
+      below[i] = 1;
+    }else if(parents[i] != H::NO_PARENT)
+      below[i] = below[parents[i]];
+    expected += below[i];
+  }
+  size_t count = serial.update(), countThreaded = threaded.update(0);
+  bool flags = true;
+  for(size_t i=0; i<n; i++)
+    flags = flags && serial.changed(i) == (below[i] != 0) && threaded.changed(i) == (below[i] != 0);
+  check(count == expected && countThreaded == expected && expected < n && flags,
+        "update recomputes dirty subtrees only");
+  check(matches(serial, reference(serial)) && matches(threaded, reference(serial)),
+        "incremental update matches full recomputation on any thread count");
+  check(serial.update() == 0 && !serial.changed(5) && serial.updateAll(2) == n, "clean update does nothing");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testTransform(const char* name)
+{
+  cout << name << " Transform:\n";
+
+  // composed rotations round more than a single product; the batches and the
+  // operators may also be contracted into FMAs differently
+  const double eps = tolerance<T>(2e-5, 1e-12);
+  typedef Transform<T> TRS;
+  typedef Matrix4x4<T> Mat;
+  Quarternion<T> qa(T(0.7), Vector3<T>(1,2,3).normal()), qb(T(-2.1), Vector3<T>(-1,0,2).normal());
+  TRS a(Vector3<T>(1,-2,3), qa, T(2)), b(Vector3<T>(T(0.5),4,-1), qb, Vector3<T>(1,2,3));
+  Vector3<T> p(T(0.3), -2, 5);
+
+  Vector3<T> s(p.x*b.scale.x, p.y*b.scale.y, p.z*b.scale.z);
+  Vector3<T> ref = qb.rotate(s) + b.translation, bp = b.transformPoint(p), bd = b.transformDirection(p);
+  Vector3<T> refd = qb.rotate(s), mp = Mat(b)*p;
+  check(sameResult(bp.data(), ref.data(), 3) && sameResult(bd.data(), refd.data(), 3) &&
+        closeMatrix(mp.data(), bp.data(), 3, eps), "point/direction match rotate and the matrix");
+
+  Mat qm = qa, qr = tvml::detail::composeTRS(Vector3<T>(0,0,0), qa, Vector3<T>(1,1,1));
+  check(closeMatrix(qm.data(), qr.data(), 16, eps), "Quarternion to Matrix4x4");
+
+  Mat ab = Mat(a*b), mab = Mat(a)*Mat(b);
+  Vector3<T> abp = (a*b)*p, abp2 = a.transformPoint(b.transformPoint(p));
+  check(closeMatrix(ab.data(), mab.data(), 16, eps) && closeMatrix(abp.data(), abp2.data(), 3, eps),
+        "a*b matches the matrix product");
+
+  Mat ai = Mat(a.inverse()), mai = Mat(a).inverse();
+  Vector3<T> back = a.inverse()*(a*p);
+  check(closeMatrix(ai.data(), mai.data(), 16, eps) && closeMatrix(back.data(), p.data(), 3, eps),
+        "inverse (uniform scale)");
+
+  // decomposition, also of a mirror
+  TRS mirror(Vector3<T>(1,2,3), qb, Vector3<T>(-1,2,T(0.5)));
+  Mat mb = Mat(TRS(Mat(b))), mm = Mat(TRS(Mat(mirror))), rb = Mat(b), rm = Mat(mirror);
+  check(closeMatrix(mb.data(), rb.data(), 16, eps) && closeMatrix(mm.data(), rm.data(), 16, eps),
+        "Matrix4x4 round trip");
+  check(sizeof(TRS) == 10*sizeof(T), "10 numbers per transform");
+
+  // batches: odd size for the scalar tail
+  const size_t n = 1003;
+  std::vector<TRS> x(n), y(n);
+  std::vector< Vector3<T> > v(n);
+  for(size_t i=0; i<n; i++){
+    Vector3<T> axis(T(std::sin(i*1.0)), T(std::cos(i*2.0)), 1);
+    x[i] = TRS(Vector3<T>(T(i % 7), T(std::sin(i*0.3)), -1), Quarternion<T>(T(i*0.1), axis.normal()), T(1 + i % 3));
+    y[i] = TRS(Vector3<T>(1, T(i % 5), 2), Quarternion<T>(T(i*0.2), axis.normal()), Vector3<T>(1, 2, T(0.5)));
+    v[i] = Vector3<T>(T(std::cos(i*0.7)), 2, T(i % 11));
+  }
+  TransformArray<T> xa(x.data(), n), ya(y.data(), n), out, one, inv;
+  Vector3Array<T> va(v.data(), n), pts, dirs, pts1;
+  std::vector<Mat> m(n);
+  compose(xa, ya, out, 4);
+  compose(a, ya, one);
+  inverse(xa, inv);
+  transformPoints(xa, va, pts);
+  transformDirections(xa, va, dirs, 3);
+  transformPoints(a, va, pts1);
+  toMatrices(xa, m.data());
+  bool okc = true, oki = true, okp = true, okm = true;
+  for(size_t i=0; i<n; i++){
+    TRS c = x[i]*y[i], c1 = a*y[i], xi = x[i].inverse();
+    TRS rc = out[i], rc1 = one[i], ri = inv[i];
+    Vector3<T> tp = x[i]*v[i], td = x[i].transformDirection(v[i]), tp1 = a*v[i];
+    Vector3<T> rp = pts[i], rd = dirs[i], rp1 = pts1[i];
+    Mat mi = Mat(x[i]);
+    okc = okc && sameResult(c.data(), rc.data(), 10, eps) && sameResult(c1.data(), rc1.data(), 10, eps);
+    oki = oki && sameResult(xi.data(), ri.data(), 10, eps);
+    okp = okp && sameResult(tp.data(), rp.data(), 3, eps) && sameResult(td.data(), rd.data(), 3, eps) &&
+          sameResult(tp1.data(), rp1.data(), 3, eps);
+    okm = okm && memcmp(mi.data(), m[i].data(), sizeof(mi)) == 0;
+  }
+  check(okc, "batched compose, one and many parents");
+  check(oki, "batched inverse");
+  check(okp, "batched transformPoints/transformDirections");
+  check(okm, "toMatrices");
+
+  TransformArray<T> inPlace = xa;
+  inverse(inPlace, inPlace);
+  bool same = inPlace.size() == n;
+  for(int k=0; k<10 && same; k++)
+    same = inPlace.parts[k] == inv.parts[k];
+  check(same, "in place");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testDualQuaternion(const char* name)
+{
+  cout << name << " DualQuaternion:\n";
+
+  const double eps = tolerance<T>(2e-5, 1e-12);
+  typedef DualQuaternion<T> DQ;
+  Quarternion<T> qa(T(0.7), Vector3<T>(1,2,3).normal()), qb(T(-2.1), Vector3<T>(-1,0,2).normal());
+  Vector3<T> ta(1,-2,3), tb(T(0.5),4,-1), p(T(0.3), -2, 5);
+  DQ a(qa, ta), b(qb, tb);
+
+  Vector3<T> ap = a*p, ref = qa.rotate(p) + ta, at = a.translation();
+  check(closeMatrix(ap.data(), ref.data(), 3, eps) && closeMatrix(at.data(), ta.data(), 3, eps),
+        "rotation then translation");
+
+  Vector3<T> abp = (a*b)*p, abp2 = a*(b*p);
+  check(closeMatrix(abp.data(), abp2.data(), 3, eps), "a*b matches applying b, then a");
+
+  Vector3<T> back = a.inverse()*ap, id = DQ::Identity*p;
+  check(closeMatrix(back.data(), p.data(), 3, eps) && memcmp(id.data(), p.data(), sizeof(p)) == 0,
+        "inverse and Identity");
+
+  Matrix4x4<T> m = Matrix4x4<T>(a), rm = Matrix4x4<T>(Transform<T>(ta, qa));
+  check(closeMatrix(m.data(), rm.data(), 16, eps), "to Matrix4x4");
+
+  DQ scaled = (a*T(3)).normal(), flipped = -a;
+  Vector3<T> fp = flipped*p;
+  check(closeMatrix(scaled.data(), a.data(), 8, eps) && closeMatrix(fp.data(), ap.data(), 3, eps),
+        "normal, and -q is the same transform");
+  check(sizeof(DQ) == 8*sizeof(T), "8 numbers per dual quarternion");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testSkinning(const char* name)
+{
+  cout << name << " skinning:\n";
+
+  typedef DualQuaternion<T> DQ;
+  typedef Matrix4x4<T> Mat;
+  // odd vertex count for the scalar tail, enough for three chunks, every other bone on the negative hemisphere
+  const size_t n = 9001;
+  const int bones = 37, influences = 4;
+  std::vector<DQ> dq(bones);
+  std::vector<Mat> mat(bones);
+  for(int b=0; b<bones; b++){
+    Vector3<T> axis(T(std::sin(b*1.0)), T(std::cos(b*2.0)), 1);
+    Quarternion<T> q(T(b*0.3 - 4), axis.normal());
+    dq[b] = DQ(b % 2 ? -q : q, Vector3<T>(T(b % 5), T(std::sin(b*0.3)), -1));
+    mat[b] = Mat(dq[b]);
+  }
+  std::vector< Vector3<T> > v(n), nv(n);
+  SkinInfluences<T> inf(n, influences);
+  for(size_t i=0; i<n; i++){
+    v[i] = Vector3<T>(T(std::cos(i*0.7)), 2, T(i % 11));
+    nv[i] = Vector3<T>(T(std::sin(i*0.2)), 1, T(std::cos(i*0.4))).normal();
+    T w[influences] = { 4, T(1 + i % 3), 2, T(i % 2) }, sum = w[0] + w[1] + w[2] + w[3];
+    for(int k=0; k<influences; k++)
+      inf.set(i, k, typename SkinInfluences<T>::Bone((i*7 + k*13) % bones), w[k]/sum);
+  }
+  Vector3Array<T> pos(v.data(), n), nrm(nv.data(), n), dp, dn, dpt, dnt, mp, mn, mpt;
+  skinDualQuaternions(dq.data(), inf, pos, nrm, dp, dn);
+  skinDualQuaternions(dq.data(), inf, pos, nrm, dpt, dnt, 3);
+  skinMatrices(mat.data(), inf, pos, nrm, mp, mn);
+  skinMatrices(mat.data(), inf, pos, mpt, 3);
+
+  // with fused multiply-adds on one side only, a coordinate near 0 is off by an ulp of the others
+  auto same = [](const Vector3<T>& a, const Vector3<T>& b){
+    return sameResult(a.data(), b.data(), 3, tolerance<T>(1e-5, 1e-13));
+  };
+  bool okd = true, okm = true, okt = true;
+  for(size_t i=0; i<n; i++){
+    const DQ& first = dq[inf.bone(i,0)];
+    DQ acc = first*inf.weight(i,0);
+    Mat m = mat[inf.bone(i,0)]*inf.weight(i,0);
+    for(int k=1; k<influences; k++){
+      const DQ& q = dq[inf.bone(i,k)];
+      T w = inf.weight(i,k);
+      acc = acc + q*(dot(first.real, q.real) < 0 ? -w : w);
+      m = m + mat[inf.bone(i,k)]*w;
+    }
+    acc.normalize();
+    Vector3<T> rp = acc*v[i], rn = acc.transformDirection(nv[i]), bp = dp[i], bn = dn[i];
+    Vector3<T> mrp = m*v[i], bmp = mp[i], bmn = mn[i];
+    Vector3<T> mrn(nv[i].x*m[0] + nv[i].y*m[1] + nv[i].z*m[2],
+                   nv[i].x*m[4] + nv[i].y*m[5] + nv[i].z*m[6],
+                   nv[i].x*m[8] + nv[i].y*m[9] + nv[i].z*m[10]);
+    Vector3<T> tp = dpt[i], tn = dnt[i], tmp = mpt[i];
+    okd = okd && same(rp, bp) && same(rn, bn);
+    okm = okm && same(mrp, bmp) && same(mrn, bmn);
+    okt = okt && same(tp, bp) && same(tn, bn) && same(tmp, bmp);
+  }
+  check(okd, "dual quarternion skinning matches DualQuaternion operators");
+  check(okm, "matrix skinning matches Matrix4x4 operators");
+  check(okt, "same result on any thread count");
+
+  // a single full weight bone is the bone's own transform, whatever its sign
+  SkinInfluences<T> single(n, 2);
+  for(size_t i=0; i<n; i++){
+    single.set(i, 0, typename SkinInfluences<T>::Bone(i % bones), 1);
+    single.set(i, 1, typename SkinInfluences<T>::Bone((i + 1) % bones), 0);
+  }
+  skinDualQuaternions(dq.data(), single, pos, dp);
+  Vector3Array<T> inPlace = pos;
+  skinMatrices(mat.data(), single, inPlace, inPlace);
+  bool ok = true;
+  for(size_t i=0; i<n; i++){
+    Vector3<T> e = dq[i % bones]*v[i] - dp[i], f = mat[i % bones]*v[i] - inPlace[i];
+    ok = ok && std::abs(e.x) + std::abs(e.y) + std::abs(e.z) < 1e-4 &&
+         std::abs(f.x) + std::abs(f.y) + std::abs(f.z) < 1e-4;
+  }
+  check(ok, "single bone, in place");
+  cout << "\n";
+}
+
+/// Angle between two rotations (q and -q are the same) or two unit vectors
+template<typename T>
+inline double angleBetween(const T* a, const T* b, int n)
+{
+  double d = 0, sum = 0, diff = 0;
+  for(int k=0; k<n; k++)
+    d += double(a[k])*double(b[k]);
+  double s = n == 4 && d < 0 ? -1 : 1;
+  for(int k=0; k<n; k++){
+    sum += (double(a[k]) + s*double(b[k]))*(double(a[k]) + s*double(b[k]));
+    diff += (double(a[k]) - s*double(b[k]))*(double(a[k]) - s*double(b[k]));
+  }
+  double angle = 2*std::atan2(std::sqrt(diff), std::sqrt(sum));
+  return n == 4 ? 2*angle : angle;
+}
+
+template<typename T, class Packed, int K, class V>
+inline void checkQuantized(const char* name, const std::vector<V>& in)
+{
+  const size_t n = in.size();
+  std::vector<Packed> batch(n), threaded(n);
+  std::vector<V> out(n);
+  encode(in.data(), batch.data(), n);
+  encode(in.data(), threaded.data(), n, 3);
+  decode(batch.data(), out.data(), n);
+  bool bits = memcmp(batch.data(), threaded.data(), n*sizeof(Packed)) == 0, same = true;
+  double worst = 0;
+  for(size_t i=0; i<n; i++){
+    Packed p(in[i]);
+    V d = V(p);
+    bits = bits && p.bits() == batch[i].bits();
+    same = same && sameResult(d.data(), out[i].data(), K);
+    worst = std::max(worst, angleBetween(in[i].data(), d.data(), K));
+  }
+  std::string what = std::string(name) + ": batch matches scalar";
+  check(bits && same, what.c_str());
+  what = std::string(name) + ": angle within maxAngleError()";
+  check(worst <= Packed::maxAngleError() && worst > Packed::maxAngleError()/4, what.c_str());
+}
+
+template<typename T>
+inline void testQuantize(const char* name)
+{
+  cout << name << " quantized quarternions and normals:\n";
+
+  // enough for three chunks, odd for the scalar tail
+  const size_t n = 50001;
+  std::vector< Quarternion<T> > q(n);
+  std::vector< Vector3<T> > v(n);
+  for(size_t i=0; i<n; i++){
+    Vector3<T> axis(T(std::sin(i*1.3)), T(std::cos(i*0.7)), T(std::sin(i*0.11)));
+    q[i] = Quarternion<T>(T(i*0.37), axis.normal());
+    v[i] = axis.normal();
+  }
+  // exact components, ties between the largest and both hemispheres
+  q[0] = Quarternion<T>(1,0,0,0);
+  q[1] = Quarternion<T>(0,0,0,-1);
+  q[2] = Quarternion<T>(T(0.5), T(-0.5), T(0.5), T(-0.5));
+  v[0] = Vector3<T>(0,0,1);
+  v[1] = Vector3<T>(0,0,-1);
+  v[2] = Vector3<T>(-1,0,0);
+
+  checkQuantized<T, quart32, 4>("32 bit smallest three", q);
+  checkQuantized<T, quart48, 4>("48 bit smallest three", q);
+  checkQuantized<T, quart64, 4>("64 bit smallest three", q);
+  checkQuantized<T, oct16, 3>("16 bit octahedral", v);
+  checkQuantized<T, oct32, 3>("32 bit octahedral", v);
+
+  Quarternion<T> id = Quarternion<T>(quart32(q[0])), k = Quarternion<T>(quart48(q[1]));
+  Vector3<T> up = Vector3<T>(oct16(v[0])), down = Vector3<T>(oct16(v[1])), left = Vector3<T>(oct32(v[2]));
+  check(id.w == 1 && id.x == 0 && id.y == 0 && id.z == 0 && k.w == 0 && k.z == 1 &&
+        up.z == 1 && down.z == -1 && left.x == -1 && up.x == 0 && left.z == 0, "identity and axes are exact");
+  check(quart32(q[5]).bits() == quart32(-q[5]).bits(), "q and -q encode the same");
+  check(sizeof(quart32) == 4 && sizeof(quart48) == 6 && sizeof(quart64) == 8 && sizeof(oct16) == 2 &&
+        sizeof(oct32) == 4, "packed sizes");
+  cout << "\n";
+}
+
+/// Row major perspective projection looking down -z, depth to -1..1 or 0..1
+template<typename T>
+inline Matrix4x4<T> perspective(double fovy, double aspect, double zn, double zf, tvml::ClipDepth depth)
+{
+  double f = 1/std::tan(fovy/2);
+  bool gl = depth == tvml::ClipDepth::NegativeOneToOne;
+  double a = gl ? (zf + zn)/(zn - zf) : zf/(zn - zf), b = gl ? 2*zf*zn/(zn - zf) : zf*zn/(zn - zf);
+  return Matrix4x4<T>{ T(f/aspect), 0, 0, 0,
+                       0, T(f), 0, 0,
+                       0, 0, T(a), T(b),
+                       0, 0, -1, 0 };
+}
+
+template<typename T>
+inline void testBounds(const char* name)
+{
+  cout << name << " bounds and frustum culling:\n";
+  typedef Vector3<T> V;
+
+  // camera at (3,1,20) turned a little, looking roughly at the origin
+  Matrix4x4<T> view = tvml::detail::composeTRS(V(3,1,20), Quarternion<T>(T(0.3), V(0,1,0)), V(1,1,1)).inverse();
+  Matrix4x4<T> proj = perspective<T>(1.0, 1.5, 0.5, 60, tvml::ClipDepth::NegativeOneToOne);
+  Matrix4x4<T> vp = proj*view;
+  Frustum<T> f(vp);
+
+  Frustum<T> near1(proj), near0(perspective<T>(1.0, 1.5, 0.5, 60, tvml::ClipDepth::ZeroToOne),
+                            tvml::ClipDepth::ZeroToOne);
+  bool planes = true;
+  for(const Frustum<T>* g : { &near1, &near0 }){
+    planes = planes && g->visible(V(0,0,T(-0.6))) && !g->visible(V(0,0,T(-0.4))) &&
+             g->visible(V(0,0,-59)) && !g->visible(V(0,0,-61)) && !g->visible(V(0,0,1)) &&
+             g->visible(V(1,0,-2)) && !g->visible(V(-2,0,-2)) && !g->visible(V(0,2,-2)) &&
+             std::abs(g->distance(Frustum<T>::Near, V(0,0,-1)) - T(0.5)) < T(1e-4);
+  }
+  check(planes, "planes of OpenGL and Direct3D projections");
+
+  // odd count, boxes and spheres all around the frustum
+  const size_t n = 50001;
+  std::vector< AABB<T> > boxes(n);
+  std::vector< Sphere<T> > spheres(n);
+  for(size_t i=0; i<n; i++){
+    V c(T(std::sin(i*0.37)*40), T(std::cos(i*1.3)*30), T(std::sin(i*0.11)*50 - 20));
+    V e(T(1.5 + std::sin(i*0.7)), T(1 + std::cos(i*0.3)*0.5), T(2 + std::sin(i*1.9)));
+    boxes[i] = AABB<T>(c - e, c + e);
+    spheres[i] = Sphere<T>(c, T(1 + std::abs(std::sin(i*0.9))*2));
+  }
+  AABBArray<T> boxArray(boxes.data(), n);
+  SphereArray<T> sphereArray(spheres.data(), n);
+  std::vector<uint32_t> bits(cullMaskWords(n), ~0u), threaded(cullMaskWords(n)), sbits(cullMaskWords(n));
+  cull(f, boxArray, bits.data());
+  cull(f, boxArray, threaded.data(), 4);
+  cull(f, sphereArray, sbits.data());
+
+  // reference: culled when every corner is outside the same clip plane
+  bool same = bits == threaded && bits.back() >> (n % 32) == 0, sameSpheres = true, conservative = true;
+  size_t visible = 0;
+  for(size_t i=0; i<n; i++){
+    bool v = bits[i/32] >> (i%32) & 1, sv = sbits[i/32] >> (i%32) & 1;
+    same = same && v == f.visible(boxes[i]);
+    sameSpheres = sameSpheres && sv == f.visible(spheres[i]);
+    visible += v;
+    double lowest[6] = {1e300, 1e300, 1e300, 1e300, 1e300, 1e300}, highest[6];
+    for(int k=0; k<6; k++)
+      highest[k] = -1e300;
+    for(int c=0; c<8; c++){
+      V p(c & 1 ? boxes[i].max.x : boxes[i].min.x, c & 2 ? boxes[i].max.y : boxes[i].min.y,
+          c & 4 ? boxes[i].max.z : boxes[i].min.z);
+      double clip[4];
+      for(int r=0; r<4; r++)
+        clip[r] = double(vp[r*4])*p.x + double(vp[r*4+1])*p.y + double(vp[r*4+2])*p.z + double(vp[r*4+3]);
+      double d[6] = { clip[3] + clip[0], clip[3] - clip[0], clip[3] + clip[1],
+                      clip[3] - clip[1], clip[3] + clip[2], clip[3] - clip[2] };
+      for(int k=0; k<6; k++){
+        highest[k] = std::max(highest[k], d[k]);
+        lowest[k] = std::min(lowest[k], d[k]);
+      }
+    }
+    bool out = false, margin = true;
+    for(int k=0; k<6; k++){
+      out = out || highest[k] < 0;
+      margin = margin && std::abs(highest[k]) > 1e-3;
+    }
+    conservative = conservative && (!margin || v == !out);
+  }
+  check(same, "cull() boxes match Frustum::visible, any thread count");
+  check(sameSpheres, "cull() spheres match Frustum::visible");
+  check(conservative && visible > n/20 && visible < n/2, "culls exactly the boxes outside one plane");
+
+  // Arvo transform against the eight corners
+  Matrix4x4<T> m = tvml::detail::composeTRS(V(1,-2,3), Quarternion<T>(T(0.8), V(1,2,-1).normal()), V(2,T(0.5),-3));
+  AABBArray<T> moved;
+  transformBoxes(m, boxArray, moved, 3);
+  bool batch = true, tight = true;
+  const double eps = sizeof(T) == sizeof(float) ? 1e-5 : 1e-13;
+  for(size_t i=0; i<n; i+=7){
+    AABB<T> t = boxes[i].transformed(m), b = moved[i];
+    batch = batch && sameResult(t.min.data(), b.min.data(), 3) && sameResult(t.max.data(), b.max.data(), 3);
+    AABB<T> corners = AABB<T>::Empty;
+    for(int c=0; c<8; c++)
+      corners.extend(m*V(c & 1 ? boxes[i].max.x : boxes[i].min.x, c & 2 ? boxes[i].max.y : boxes[i].min.y,
+                         c & 4 ? boxes[i].max.z : boxes[i].min.z));
+    for(int k=0; k<3; k++)
+      tight = tight && std::abs(double(t.min[k]) - corners.min[k]) <= eps*(200 + std::abs(double(t.min[k]))) &&
+                       std::abs(double(t.max[k]) - corners.max[k]) <= eps*(200 + std::abs(double(t.max[k])));
+  }
+  check(batch, "transformBoxes matches AABB::transformed");
+  check(tight, "Arvo bounds equal the transformed corners' bounds");
+
+  AABB<T> e = AABB<T>::Empty;
+  check(e.empty() && !e.contains(V(0,0,0)), "Empty is empty");
+  e.extend(V(1,2,3));
+  e.extend(AABB<T>(V(-1,0,0), V(0,1,1)));
+  Sphere<T> around(e);
+  check(!e.empty() && e.contains(V(0,1,2)) && !e.contains(V(0,3,0)) && e.size().x == 2 &&
+        around.contains(e.min) && around.contains(e.max - V(T(1e-3),T(1e-3),T(1e-3))) &&
+        e.intersects(AABB<T>(V(1,2,3), V(4,4,4))) && !e.intersects(AABB<T>(V(2,2,3), V(4,4,4))),
+        "extend, contains, intersects");
+  Sphere<T> sm = Sphere<T>(V(1,0,0), 1).transformed(m);
+  // x' = x + y stretches more than any column; the image of the surface must stay inside
+  Matrix4x4<T> shear = Matrix4x4<T>::Identity;
+  shear[1] = 1;
+  shear[3] = 2;
+  Sphere<T> unit(V(0,0,0), 1), ss = unit.transformed(shear);
+  bool inside = true;
+  for(int i=0; i<64; i++)
+    for(int j=0; j<=16; j++){
+      double a = i*2*M_PI/64, b = j*M_PI/16;
+      V p = V(T(std::cos(a)*std::sin(b)), T(std::sin(a)*std::sin(b)), T(std::cos(b)))*T(0.999);
+      inside = inside && ss.contains(shear*p);
+    }
+  check(std::abs(sm.radius - 3) < T(1e-5) && sm.contains(m*V(0,0,0)) && sm.contains(m*V(1,0,T(0.99))) &&
+        inside && ss.radius < 2, "sphere transform scales by the largest axis, bounds shear");
+  cout << "\n";
+}
+
+/// Brute force closest hit over the same edge form the BVH stores
+template<typename T>
+inline Hit<T> closestHitRef(const std::vector< Vector3<T> >& v, const std::vector<uint32_t>& idx, const Ray<T>& r)
+{
+  Hit<T> h;
+  h.t = r.tmax; h.u = 0; h.v = 0;
+  h.triangle = Hit<T>::NONE;
+  for(size_t i=0; i<idx.size()/3; i++){
+    const Vector3<T>& a = v[idx[3*i]];
+    T t, u, w;
+    if(intersectTriangle(r.origin, r.direction, a, v[idx[3*i+1]] - a, v[idx[3*i+2]] - a, r.tmin, h.t, t, u, w)){
+      h.t = t; h.u = u; h.v = w;
+      h.triangle = uint32_t(i);
+    }
+  }
+  return h;
+}
+
+template<typename T>
+inline void testBVH(const char* name)
+{
+  cout << name << " BVH:\n";
+  typedef Vector3<T> V;
+
+  // a closed sphere mesh plus small triangles scattered in and around it
+  const int rings = 40, segments = 60;
+  std::vector<V> verts;
+  std::vector<uint32_t> idx;
+  for(int i=0; i<=rings; i++)
+    for(int j=0; j<segments; j++){
+      double th = 3.14159265358979*i/rings, ph = 2*3.14159265358979*j/segments;
+      verts.push_back(V(T(std::sin(th)*std::cos(ph)*5), T(std::cos(th)*5), T(std::sin(th)*std::sin(ph)*5)));
+    }
+  for(int i=0; i<rings; i++)
+    for(int j=0; j<segments; j++){
+      uint32_t a = i*segments + j, b = i*segments + (j+1)%segments, c = a + segments, d = b + segments;
+      idx.insert(idx.end(), { a, c, b, b, c, d });
+    }
+  for(size_t i=0; i<6000; i++){
+    V c(T(std::sin(i*0.37)*8), T(std::cos(i*1.3)*8), T(std::sin(i*0.11)*8));
+    uint32_t base = uint32_t(verts.size());
+    verts.push_back(c);
+    verts.push_back(c + V(T(std::sin(i*0.7))*T(0.3), T(0.2), 0));
+    verts.push_back(c + V(0, T(std::cos(i*0.3))*T(0.3), T(0.25)));
+    idx.insert(idx.end(), { base, base + 1, base + 2 });
+  }
+  const size_t tris = idx.size()/3;
+  BVH<T> bvh(verts.data(), idx.data(), tris), threaded(verts.data(), idx.data(), tris, 4);
+
+  // every triangle in exactly one leaf, every child inside its parent
+  std::vector<int> seen(tris, 0);
+  bool valid = bvh.nodes().size() <= 2*tris - 1, inside = true;
+  for(const typename BVH<T>::Node& n : bvh.nodes()){
+    AABB<T> box(n.min, n.max);
+    if(n.leaf()){
+      valid = valid && n.count <= tvml::detail::BVH_MAX_LEAF;
+      for(uint32_t i=n.offset; i<n.offset + n.count; i++){
+        uint32_t t = bvh.triangleId(i);
+        seen[t]++;
+        for(int k=0; k<3; k++)
+          inside = inside && box.contains(verts[idx[3*t + k]]);
+      }
+    }else
+      for(uint32_t c=n.offset; c<n.offset + 2; c++)
+        inside = inside && box.contains(bvh.nodes()[c].min) && box.contains(bvh.nodes()[c].max);
+  }
+  check(valid && std::count(seen.begin(), seen.end(), 1) == std::ptrdiff_t(tris), "every triangle in one leaf");
+  check(inside, "nodes bound their children and triangles");
+  check(threaded.nodes().size() == bvh.nodes().size(), "threaded build makes the same tree");
+
+  // rays from outside, from inside the sphere, short ones and ones along the axes
+  const size_t n = 3001;
+  std::vector< Ray<T> > rays(n);
+  for(size_t i=0; i<n; i++){
+    V o(T(std::sin(i*0.91)*12), T(std::cos(i*0.53)*12), T(std::sin(i*0.27)*12));
+    if(i % 3 == 1)
+      o = o*T(0.2);
+    V target(T(std::sin(i*1.7)*3), T(std::cos(i*0.2)*3), T(std::sin(i*2.9)*3));
+    rays[i] = Ray<T>(o, target - o, 0, i % 5 == 2 ? T(0.5) : std::numeric_limits<T>::infinity());
+  }
+  rays[0] = Ray<T>(V(0,0,0), V(1,0,0));
+  rays[1] = Ray<T>(V(0,20,0), V(0,-1,0));
+  rays[2] = Ray<T>(V(0,0,20), V(0,0,1));
+
+  std::vector< Hit<T> > hits(n), batch(n);
+  std::vector<uint8_t> any(n);
+  closestHits(threaded, rays.data(), batch.data(), n, 3);
+  anyHits(bvh, rays.data(), any.data(), n, 3);
+  bool same = true, anySame = true, batchSame = true;
+  size_t hitCount = 0;
+  for(size_t i=0; i<n; i++){
+    Hit<T> ref = closestHitRef(verts, idx, rays[i]), h = bvh.closestHit(rays[i]);
+    // rays through a shared edge or vertex may report either triangle
+    bool edge = h.u == 0 || h.v == 0 || h.u + h.v == 1;
+    same = same && bool(ref) == bool(h) && (!ref || (h.triangle == ref.triangle && h.t == ref.t) ||
+           (edge && std::abs(h.t - ref.t) <= T(1e-5)*ref.t));
+    batchSame = batchSame && batch[i].triangle == h.triangle && batch[i].t == h.t &&
+                batch[i].u == h.u && batch[i].v == h.v;
+    anySame = anySame && bool(any[i]) == bool(ref) && bvh.anyHit(rays[i]) == bool(ref);
+    hitCount += bool(ref);
+  }
+  check(same && hitCount > n/2 && hitCount < n, "closestHit matches brute force");
+  check(batchSame, "closestHits, threaded build and queries");
+  check(anySame, "anyHit");
+
+  // triangle soup, degenerate and coincident triangles
+  std::vector<V> soup;
+  for(int i=0; i<100; i++)
+    soup.insert(soup.end(), { V(0,0,0), V(1,0,0), V(0,1,0) });
+  soup.insert(soup.end(), { V(2,2,2), V(2,2,2), V(2,2,2) });
+  BVH<T> pile(soup.data(), soup.size()/3);
+  Hit<T> top = pile.closestHit(Ray<T>(V(T(0.25),T(0.25),5), V(0,0,-1)));
+  check(top && top.t == 5 && top.u == T(0.25) && top.v == T(0.25) && top.triangle < 100 &&
+        !pile.closestHit(Ray<T>(V(2,2,5), V(0,0,-1))) && BVH<T>().closestHit(rays[0]).triangle == Hit<T>::NONE,
+        "soup with coincident and degenerate triangles");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testRayPacket(const char* name)
+{
+  cout << name << " ray packets:\n";
+  typedef Vector3<T> V;
+
+  // rays aimed inside and outside of each triangle, some behind, some cut short
+  const int n = 64;
+  std::vector<V> a(n), b(n), c(n);
+  std::vector< Ray<T> > rays(8*n);
+  for(int i=0; i<n; i++){
+    a[i] = V(T(std::sin(i*0.7)*4), T(std::cos(i*1.1)*4), T(std::sin(i*0.3)*4));
+    b[i] = a[i] + V(T(1 + std::sin(i*2.3)), T(std::cos(i*0.9)), T(0.5));
+    c[i] = a[i] + V(T(std::sin(i*1.9)), T(1 + std::cos(i*0.4)), T(-0.5));
+    for(int j=0; j<8; j++){
+      int k = 8*i + j;
+      T bu = T(std::sin(k*0.83)*0.5 + 0.35), bv = T(std::cos(k*0.61)*0.5 + 0.35);
+      V target = a[i] + (b[i] - a[i])*bu + (c[i] - a[i])*bv;
+      V o(T(std::sin(k*0.37)*10), T(std::cos(k*0.19)*10), T(std::sin(k*0.53)*10));
+      rays[k] = Ray<T>(o, target - o, k % 7 == 3 ? T(2) : T(0), k % 5 == 1 ? T(0.5) : std::numeric_limits<T>::infinity());
+    }
+  }
+  // parallel to the triangle plane, and in it
+  rays[5] = Ray<T>(a[0] + V(0,0,0), b[0] - a[0]);
+  rays[6] = Ray<T>(a[0] + V(0,0,1), c[0] - a[0]);
+
+  // the cross products cancel, so fused multiply-adds move u and v further than the default allows
+  const double eps = tolerance<T>(1e-4, 1e-12);
+  bool raysSame = true, trisSame = true, untouched = true;
+  int hits = 0, misses = 0;
+  for(int i=0; i<n; i++){
+    RayPacket<T> packet;
+    TrianglePacket<T> tris;
+    for(int j=0; j<8; j++){
+      packet.set(j, rays[8*i + j]);
+      tris.set(j, a[(i + j) % n], b[(i + j) % n], c[(i + j) % n]);
+    }
+    HitPacket<T> hr, ht;
+    std::fill(hr.t, hr.t + 8, T(-1)); std::fill(hr.u, hr.u + 8, T(-1)); std::fill(hr.v, hr.v + 8, T(-1));
+    ht = hr;
+    uint32_t mr = intersectTriangle(packet, a[i], b[i] - a[i], c[i] - a[i], hr);
+    uint32_t mt = intersectTriangles(rays[8*i], tris, ht);
+    for(int j=0; j<8; j++){
+      T t = 0, u = 0, v = 0;
+      bool ref = intersectTriangle(rays[8*i + j], a[i], b[i], c[i], t, u, v);
+      T expect[3] = { t, u, v }, got[3] = { hr.t[j], hr.u[j], hr.v[j] };
+      raysSame = raysSame && ref == bool(mr >> j & 1) && (!ref || sameResult(expect, got, 3, eps));
+      untouched = untouched && (ref || (hr.t[j] == -1 && hr.u[j] == -1 && hr.v[j] == -1));
+      hits += ref; misses += !ref;
+
+      ref = intersectTriangle(rays[8*i], a[(i + j) % n], b[(i + j) % n], c[(i + j) % n], t, u, v);
+      T expect2[3] = { t, u, v }, got2[3] = { ht.t[j], ht.u[j], ht.v[j] };
+      trisSame = trisSame && ref == bool(mt >> j & 1) && (!ref || sameResult(expect2, got2, 3, eps));
+      untouched = untouched && (ref || (ht.t[j] == -1 && ht.u[j] == -1 && ht.v[j] == -1));
+    }
+  }
+  check(raysSame && hits > n && misses > n, "8 rays against a triangle match intersectTriangle");
+  check(trisSame, "a ray against 8 triangles matches intersectTriangle");
+  check(untouched, "lanes that miss keep their values");
+
+  RayPacket<T> packet;
+  for(int j=0; j<8; j++)
+    packet.set(j, rays[j]);
+  Ray<T> back = packet[3];
+  check(memcmp(&back, &rays[3], sizeof(back)) == 0, "RayPacket lane access");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testKdTree(const char* name)
+{
+  cout << name << " k-d tree:\n";
+  typedef Vector3<T> V;
+
+  // quarter steps keep every squared distance exact, and give plenty of ties and duplicates
+  const size_t n = 20000;
+  std::vector<V> pts(n);
+  for(size_t i=0; i<n; i++){
+    V p(T(int(std::sin(i*0.37)*40)), T(int(std::cos(i*1.3)*40)), T(int(std::sin(i*0.011)*40)));
+    pts[i] = i % 4 == 3 ? pts[i/2] : p*T(0.25) + V(0, 0, T(i % 2 ? 4 : 0));
+  }
+  KdTree<T> tree(pts.data(), n), threaded(tvml::Span<const V>(pts.data(), n), 4);
+  check(tree.size() == n && tree.bytesPerPoint() <= 5.0 + 1e-9, "5 bytes per point");
+
+  std::vector<V> queries(300);
+  for(size_t i=0; i<queries.size(); i++)
+    queries[i] = V(T(int(std::sin(i*2.1)*48)), T(int(std::cos(i*0.7)*48)), T(int(std::sin(i*0.3)*48)))*T(0.25);
+  queries[0] = pts[17];
+
+  auto bruteForce = [&](const V& q){
+    std::vector< Neighbor<T> > all(n);
+    for(size_t i=0; i<n; i++){
+      all[i].index = uint32_t(i);
+      all[i].distance2 = (pts[i] - q)*(pts[i] - q);
+    }
+    std::sort(all.begin(), all.end(), tvml::detail::nearer<T>);
+    return all;
+  };
+  auto same = [](const Neighbor<T>* a, const Neighbor<T>* b, size_t k){
+    for(size_t j=0; j<k; j++)
+      if(a[j].index != b[j].index || a[j].distance2 != b[j].distance2)
+        return false;
+    return true;
+  };
+
+  const size_t k = 16;
+  bool nearestOk = true, knnOk = true, limitOk = true, radiusOk = true, boxOk = true, threadedOk = true;
+  for(size_t i=0; i<queries.size(); i++){
+    const V& q = queries[i];
+    std::vector< Neighbor<T> > ref = bruteForce(q);
+    Neighbor<T> one = tree.nearest(q), got[k], fromThreaded[k];
+    nearestOk = nearestOk && same(&one, &ref[0], 1);
+    knnOk = knnOk && tree.nearest(q, k, got) == k && same(got, ref.data(), k);
+    threadedOk = threadedOk && threaded.nearest(q, k, fromThreaded) == k && same(fromThreaded, got, k);
+
+    T limit = ref[5].distance2;
+    size_t within = std::upper_bound(ref.begin(), ref.end(), limit,
+                                     [](T d, const Neighbor<T>& a){ return d < a.distance2; }) - ref.begin();
+    size_t found = tree.nearest(q, k, got, limit);
+    limitOk = limitOk && found == std::min(k, within) && same(got, ref.data(), found);
+
+    T radius = T(1.5);
+    std::vector<uint32_t> in, expect;
+    tree.inRadius(q, radius, in);
+    for(size_t j=0; j<n && ref[j].distance2 <= radius*radius; j++)
+      expect.push_back(ref[j].index);
+    std::sort(in.begin(), in.end());
+    std::sort(expect.begin(), expect.end());
+    radiusOk = radiusOk && in == expect;
+
+    AABB<T> box(q - V(1, T(0.5), 2), q + V(T(0.75), 2, T(0.25)));
+    std::vector<uint32_t> inside, boxRef;
+    tree.inBox(box, inside);
+    for(size_t j=0; j<n; j++)
+      if(box.contains(pts[j]))
+        boxRef.push_back(uint32_t(j));
+    std::sort(inside.begin(), inside.end());
+    boxOk = boxOk && inside == boxRef;
+  }
+  check(nearestOk, "nearest matches brute force, ties to the lower index");
+  check(knnOk, "k nearest, nearest first");
+  check(limitOk, "k nearest within a distance");
+  check(radiusOk, "radius query");
+  check(boxOk, "box query, boundary included");
+  check(threadedOk, "threaded build answers the same");
+
+  // batched
+  const size_t m = queries.size();
+  std::vector< Neighbor<T> > batch(m*k), single(k);
+  nearestNeighbors(threaded, queries.data(), m, k, batch.data(), 3);
+  bool batchOk = true;
+  for(size_t i=0; i<m; i++){
+    tree.nearest(queries[i], k, single.data());
+    batchOk = batchOk && same(&batch[i*k], single.data(), k);
+  }
+  std::vector<size_t> offsets;
+  std::vector<uint32_t> indices;
+  pointsInRadius(threaded, queries.data(), m, T(2), offsets, indices, 3);
+  bool listsOk = offsets.size() == m + 1 && offsets[m] == indices.size() && indices.size() > m;
+  for(size_t i=0; i<m && listsOk; i++){
+    std::vector<uint32_t> one;
+    threaded.inRadius(queries[i], T(2), one);
+    listsOk = std::equal(one.begin(), one.end(), indices.begin() + offsets[i]) && offsets[i+1] - offsets[i] == one.size();
+  }
+  check(batchOk, "nearestNeighbors, threaded");
+  check(listsOk, "pointsInRadius lists, threaded");
+
+  // fewer points than k, and none
+  KdTree<T> small(pts.data(), 3), none;
+  std::vector< Neighbor<T> > few(5);
+  nearestNeighbors(small, queries.data(), 1, 5, few.data());
+  std::vector<uint32_t> nothing;
+  none.inRadius(queries[0], 100, nothing);
+  check(few[2].index != Neighbor<T>::NONE && few[3].index == Neighbor<T>::NONE && few[4].distance2 > 1e30 &&
+        none.nearest(queries[0]).index == Neighbor<T>::NONE && nothing.empty(), "fewer points than k, empty tree");
+  cout << "\n";
+}
+
+template<typename T>
+inline void testHashGrid(const char* name)
+{
+  cout << name << " hash grid:\n";
+  typedef Vector3<T> V;
+
+  // quarter steps keep squared distances exact; negative cells and points on cell faces included
+  const size_t n = 12000;
+  std::vector<V> pts(n);
+  for(size_t i=0; i<n; i++)
+    pts[i] = V(T(int(std::sin(i*0.37)*60)), T(int(std::cos(i*1.3)*60)), T(int(std::sin(i*0.011)*60)))*T(0.25);
+  HashGrid<T> grid(T(1.5)), threaded(T(1.5));
+  grid.rebuild(pts.data(), n);
+  threaded.rebuild(pts.data(), n, 3);
+
+  std::vector<uint32_t> perm(grid.order().begin(), grid.order().end());
+  std::sort(perm.begin(), perm.end());
+  bool permutation = true, sortedOk = true;
+  for(size_t j=0; j<n; j++){
+    permutation = permutation && perm[j] == j;
+    sortedOk = sortedOk && memcmp(&grid.positions()[j], &pts[grid.order()[j]], sizeof(V)) == 0;
+  }
+  check(permutation && sortedOk && grid.slotCount() >= n, "cell order is a permutation, positions sorted with it");
+  check(std::equal(grid.order().begin(), grid.order().end(), threaded.order().begin()), "threaded rebuild gives the same order");
+
+  bool neighborsOk = true;
+  const T radii[3] = { T(0.5), T(1.5), T(3.25) };
+  for(size_t q=0; q<200; q++){
+    V p = q % 2 ? pts[q*37 % n] : V(T(std::sin(q*0.9)*15), T(std::cos(q*0.4)*15), T(std::sin(q*0.2)*15));
+    T r = radii[q % 3];
+    std::vector<uint32_t> got, expect;
+    grid.forEachNeighbor(p, r, [&](uint32_t j, T d2){
+      neighborsOk = neighborsOk && d2 == (grid.positions()[j] - p)*(grid.positions()[j] - p);
+      got.push_back(grid.order()[j]);
+    });
+    for(size_t i=0; i<n; i++)
+      if((pts[i] - p)*(pts[i] - p) <= r*r)
+        expect.push_back(uint32_t(i));
+    std::sort(got.begin(), got.end());
+    neighborsOk = neighborsOk && got == expect;
+  }
+  check(neighborsOk, "neighbours match brute force, radii below and above the cell size");
+
+  // every pair within the cell size, threaded
+  const size_t m = 3000;
+  HashGrid<T> few(T(1));
+  few.rebuild(pts.data(), m);
+  std::vector<uint32_t> counts(m, 0);
+  forEachNeighborPair(few, T(1), [&](uint32_t i, uint32_t j, T){ counts[i]++; (void)j; }, 3);
+  bool pairsOk = true;
+  for(size_t j=0; j<m; j++){
+    uint32_t expect = 0;
+    const V& p = few.positions()[j];
+    for(size_t i=0; i<m; i++)
+      expect += i != few.order()[j] && (pts[i] - p)*(pts[i] - p) <= 1;
+    pairsOk = pairsOk && counts[j] == expect;
+  }
+  check(pairsOk, "forEachNeighborPair counts, threaded");
+
+  std::vector<int> data(n), inOrder(n), back(n);
+  for(size_t i=0; i<n; i++)
+    data[i] = int(i*7);
+  grid.reorder(data.data(), inOrder.data(), 2);
+  grid.restore(inOrder.data(), back.data(), 2);
+  check(inOrder[5] == int(grid.order()[5]*7) && back == data, "reorder and restore");
+
+  HashGrid<T> empty;
+  empty.rebuild(pts.data(), 0);
+  std::vector<uint32_t> none;
+  empty.neighbors(V(0,0,0), 10, none);
+  check(empty.size() == 0 && none.empty() && grid.cellOf(V(T(-0.25), 0, T(1.5))).x == -1 &&
+        grid.cellOf(V(T(-0.25), 0, T(1.5))).z == 1, "empty grid, negative cells");
+  cout << "\n";
+}
+
+/// Value of the binary16 nearest to f, ties to even, worked out in double
+inline double nearestHalf(float f)
+{
+  double a = std::fabs(f);
+  int e;
+  std::frexp(a, &e);
+  double ulp = std::ldexp(1.0, std::max(e - 11, -24));
+  double r = std::nearbyint(a/ulp)*ulp;
+  return std::copysign(r > 65504 ? std::numeric_limits<double>::infinity() : r, f);
+}
+
+inline bool sameBits(float a, float b)
+{
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+inline void testHalf()
+{
+  cout << "half:\n";
+  using tvml::detail::floatToHalfBits;
+  using tvml::detail::halfBitsToFloat;
+  using tvml::detail::floatBits;
+  using tvml::detail::bitsFloat;
+
+  bool exact = true, nans = true, trip = true;
+  for(uint32_t h=0; h<0x10000; h++){
+    uint32_t m = h & 0x3ff, e = (h >> 10) & 0x1f;
+    float f = halfBitsToFloat(uint16_t(h));
+    if(e == 31 && m){
+      nans = nans && f != f && ((floatBits(f) >> 13) & 0x3ff) == (m | 0x200);
+      continue;
+    }
+    double ref = e == 31 ? std::numeric_limits<double>::infinity()
+               : e == 0  ? std::ldexp(double(m), -24) : std::ldexp(double(m | 0x400), int(e) - 25);
+    exact = exact && sameBits(f, float(h & 0x8000 ? -ref : ref));
+    trip = trip && floatToHalfBits(f) == h;
+  }
+  check(exact, "every half converts to float exactly");
+  check(nans, "NaNs stay NaN, quieted, payload kept");
+  check(trip, "float -> half -> float round trips");
+
+  // every midpoint between neighbouring halves and the floats either side of it
+  std::vector<float> in;
+  for(uint32_t h=0; h<0x7c00; h++){
+    float mid = float((double(halfBitsToFloat(uint16_t(h))) + halfBitsToFloat(uint16_t(h + 1)))/2);
+    for(float f : { mid, std::nextafter(mid, 0.0f), std::nextafter(mid, 1e9f) }){
+      in.push_back(f);
+      in.push_back(-f);
+    }
+  }
+  // and a sweep of the other floats, NaNs and infinities included
+  for(uint64_t u=0; u<=0xffffffffu; u+=997)
+    in.push_back(bitsFloat(uint32_t(u)));
+  in.push_back(std::numeric_limits<float>::infinity());
+  in.push_back(-std::numeric_limits<float>::infinity());
+
+  bool nearest = true;
+  nans = true;
+  for(float f : in){
+    uint16_t h = floatToHalfBits(f);
+    if(f != f)
+      nans = nans && (h & 0x7e00) == 0x7e00 && (h & 0x3ff) == (((floatBits(f) >> 13) & 0x3ff) | 0x200);
+    else
+      nearest = nearest && sameBits(halfBitsToFloat(h), float(nearestHalf(f)));
+  }
+  check(nearest, "float -> half rounds to nearest even");
+  check(nans, "float NaNs stay NaN");
+
+#if defined(TVML_DISPATCH)
+  if(tvml::cpu::features().f16c){
+    std::vector<uint16_t> bits(0x10000), hw(in.size());
+    std::vector<float> all(0x10000);
+    for(uint32_t h=0; h<0x10000; h++)
+      bits[h] = uint16_t(h);
+    tvml::detail::toFloat_f16c(bits.data(), all.data(), all.size());
+    tvml::detail::toHalf_f16c(in.data(), hw.data(), in.size());
+    bool same = true;
+    for(uint32_t h=0; h<0x10000; h++)
+      same = same && sameBits(all[h], halfBitsToFloat(uint16_t(h)));
+    for(size_t i=0; i<in.size(); i++)
+      same = same && hw[i] == floatToHalfBits(in[i]);
+    check(same, "software conversion matches F16C bit for bit");
+  }
+#endif
+
+  // three chunks and a tail for the threaded version
+  const size_t n = 3*tvml::detail::HALF_GRAIN + 5;
+  std::vector<float4> v(n), back(n), threaded(n);
+  std::vector<half4> h(n), ht(n);
+  for(size_t i=0; i<n; i++)
+    v[i] = float4(float(std::sin(i*0.37)), float(i) - 70000, 1/float(i + 1), float(std::cos(i*1.3))*1e-5f);
+  convert(v.data(), h.data(), n);
+  convert(v.data(), ht.data(), n, 4);
+  convert(h.data(), back.data(), n);
+  convert(h.data(), threaded.data(), n, 4);
+  bool batch = memcmp(h.data(), ht.data(), n*sizeof(half4)) == 0 &&
+               memcmp(back.data(), threaded.data(), n*sizeof(float4)) == 0;
+  for(size_t i=0; i<n; i++)
+    for(int k=0; k<4; k++)
+      batch = batch && h[i][k].bits == floatToHalfBits(v[i][k]) && sameBits(back[i][k], halfBitsToFloat(h[i][k].bits));
+  check(batch, "bulk conversion matches scalar");
+
+  std::vector<float3> v3(1003), b3(1003);
+  std::vector<half3> h3(1003);
+  for(size_t i=0; i<v3.size(); i++)
+    v3[i] = float3(float(i), -float(i)/7, 1e-6f*i);
+  convert(v3.data(), h3.data(), v3.size());
+  convert(h3.data(), b3.data(), b3.size());
+  bool same3 = true;
+  for(size_t i=0; i<v3.size(); i++)
+    same3 = same3 && sameBits(b3[i].y, float(half(v3[i].y))) && b3[i].x == float(i);
+  check(same3, "half3 <-> float3");
+
+  half3 a(1, 2, 3);
+  half3 b = a*2.0f + half3(half(0.5f), 0, 0);
+  b += a;
+  float len = half3(3, 0, 4).magnitude();
+  check(b.x == 3.5f && b.y == 6 && b.z == 9 && len == 5 && a*a == 14, "half vector arithmetic");
+  half3 c(3, 0, 4), hn = c.normal(), h2 = c*half(2);
+  std::ostringstream os;
+  os << hn << h2;
+  check(hn.x.bits == half(0.6f).bits && hn.y == 0 && hn.z.bits == half(0.8f).bits && h2.z == 8 &&
+        os.str() == "[0.6, 0, 0.8][6, 0, 8]" && hn.repr() == "[0.6, 0, 0.8]", "half3 normalizes and prints");
+  half x = 1.0f;
+  x /= 3;
+  check(x.bits == 0x3555 && half(65520.0f).bits == 0x7c00 && half(-0.0f).bits == 0x8000 &&
+        half::fromBits(0x3c00) == 1.0f, "half scalar");
+  check(sizeof(half2) == 4 && sizeof(half3) == 6 && sizeof(half4) == 8, "packed sizes");
+  cout << "\n";
+}
+
 int main()
 {
   cout << "Testing Tiny Vector Math Library\n\n";
@@ -129,6 +1938,77 @@ int main()
     cout << rotm*v << "\n\n";
   }
 
+  testMatrixMultiply<int>("Matrix4x4<int>");
+  testMatrixMultiply<float>("Matrix4x4<float>");
+  testMatrixMultiply<double>("Matrix4x4<double>");
+  testMultiplyKernels<float>("Matrix4x4<float>");
+  testMultiplyKernels<double>("Matrix4x4<double>");
+
+  testInverse<float>("Matrix4x4<float>");
+  testInverse<double>("Matrix4x4<double>");
+
+  testRotate<float>("Quarternion<float>");
+  testRotate<double>("Quarternion<double>");
+
+  testInterpolation<float>("Quarternion<float>");
+  testInterpolation<double>("Quarternion<double>");
+
+  testConstexpr<float>("float");
+  testConstexpr<double>("double");
+
+  testGeneric<float>("float");
+  testGeneric<double>("double");
+
+  testExpr<int>("int");
+  testExpr<float>("float");
+  testExpr<double>("double");
+
+  testAligned<float>("float");
+  testAligned<double>("double");
+
+  testFastNormal<float>("float");
+  testFastNormal<double>("double");
+
+  testFormat<float>("float");
+  testFormat<double>("double");
+
+  testBinary<float>("float");
+  testBinary<double>("double");
+
+  testBatchTransforms<float>("float");
+  testBatchTransforms<double>("double");
+
+  testBatchSquare3<float>("float");
+  testBatchSquare3<double>("double");
+
+  testTransform<float>("float");
+  testTransform<double>("double");
+
+  testHierarchy<float>("float");
+  testHierarchy<double>("double");
+
+  testDualQuaternion<float>("float");
+  testDualQuaternion<double>("double");
+  testSkinning<float>("float");
+  testSkinning<double>("double");
+  testQuantize<float>("float");
+  testQuantize<double>("double");
+  testBounds<float>("float");
+  testBounds<double>("double");
+  testBVH<float>("float");
+  testBVH<double>("double");
+  testRayPacket<float>("float");
+  testRayPacket<double>("double");
+  testKdTree<float>("float");
+  testKdTree<double>("double");
+  testHashGrid<float>("float");
+  testHashGrid<double>("double");
+  testHalf();
+
+  testVectorArrays<int>("int");
+  testVectorArrays<float>("float");
+  testVectorArrays<double>("double");
+
   cout << "That's it, folks.\n" << endl;
-  return 0;
+  return failures;
 }
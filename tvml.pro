@@ -8,12 +8,15 @@ CONFIG -= qt
 
 INCLUDEPATH += include
 
-QMAKE_CXXFLAGS += -std=c++11 -O3
+QMAKE_CXXFLAGS += -std=c++14 -O3 -pthread
+LIBS += -pthread
 
 SOURCES += \
     src/test.cpp
 
 HEADERS += \
+    include/tvml/Vector.h \
+    include/tvml/Matrix.h \
     include/tvml/Matrix3x3.h \
     include/tvml/Matrix4x4.h \
     include/tvml/quart.h \
@@ -23,4 +26,28 @@ HEADERS += \
     include/tvml/Vector2.h \
     include/tvml/Vector3.h \
     include/tvml/Vector4.h \
-    include/tvml/misc.h
+    include/tvml/misc.h \
+    include/tvml/format.h \
+    include/tvml/simd.h \
+    include/tvml/cpu.h \
+    include/tvml/VectorArray.h \
+    include/tvml/parallel.h \
+    include/tvml/batch.h \
+    include/tvml/QuarternionArray.h \
+    include/tvml/expr.h \
+    include/tvml/aligned.h \
+    include/tvml/rsqrt.h \
+    include/tvml/span.h \
+    include/tvml/binary.h \
+    include/tvml/Transform.h \
+    include/tvml/TransformArray.h \
+    include/tvml/hierarchy.h \
+    include/tvml/DualQuaternion.h \
+    include/tvml/skinning.h \
+    include/tvml/quantize.h \
+    include/tvml/half.h \
+    include/tvml/bounds.h \
+    include/tvml/ray.h \
+    include/tvml/bvh.h \
+    include/tvml/kdtree.h \
+    include/tvml/hashgrid.h